@@ -42,7 +42,7 @@ UPDATE_METHOD = afs
 # A list of the test programs you want compiled in from the user/progs
 # directory.
 #
-STUDENTTESTS = pages_alloc_test
+STUDENTTESTS = pages_alloc_test stride_fairness_test irq_trace_dump priority_inversion_test shm_throughput_test mq_pipeline_test zfod_sparse_test malloc_scale_test mutex_contention_test rwlock_read_test print_throughput_test ramfs_test disk_bench swap_bench ring_bench wait_any_test
 
 ###########################################################################
 # Data files provided by course staff to build into the RAM disk
@@ -76,7 +76,7 @@ THREAD_OBJS = malloc.o panic.o mutex.o atomic_ops.o cond_var.o queue.o linked_li
 ###########################################################################
 # Object files for your syscall wrappers
 ###########################################################################
-SYSCALL_OBJS = vanish.o set_status.o print.o deschedule.o exec.o fork.o getchar.o gettid.o make_runnable.o readline.o sleep.o swexn.o wait.o yield.o set_term_color.o get_cursor_pos.o set_cursor_pos.o halt.o readfile.o task_vanish.o new_pages.o remove_pages.o get_ticks.o misbehave.o
+SYSCALL_OBJS = vanish.o set_status.o print.o deschedule.o exec.o fork.o getchar.o gettid.o make_runnable.o readline.o sleep.o swexn.o wait.o yield.o set_term_color.o get_cursor_pos.o set_cursor_pos.o halt.o readfile.o task_vanish.o new_pages.o remove_pages.o get_ticks.o misbehave.o set_weight.o get_irq_trace.o shm_create.o shm_attach.o shm_detach.o mq_create.o mq_destroy.o mq_send.o mq_recv.o make_runnable_many.o open.o read.o write.o close.o unlink.o fmap.o get_swap_stats.o ring_setup.o ring_enter.o wait_any.o
 
 ###########################################################################
 # Object files for your automatic stack handling
@@ -93,16 +93,16 @@ AUTOSTACK_OBJS = autostack.o page_fault_handler.o
 #
 # Kernel object files you provide in from kern/
 #
-KERNEL_OBJS = eff_mutex.o stack_queue.o virtual_memory_helper.o virtual_memory_asm.o kernel_state.o hash_table.o linked_list.o kernel.o loader.o malloc_wrappers.o interrupts.o queue.o page_fault_asm.o page_fault_handler.o virtual_memory.o bitmap.o idt_syscall.o task_create.o context_switch_asm.o context_switch.o scheduler.o atomic_ops.o sw_exception.o exception_handlers.o exception_handlers_asm.o
+KERNEL_OBJS = eff_mutex.o virtual_memory_helper.o virtual_memory_asm.o kernel_state.o tid_table.o kernel.o loader.o malloc_wrappers.o interrupts.o queue.o page_fault_asm.o page_fault_handler.o virtual_memory.o bitmap.o idt_syscall.o task_create.o context_switch_asm.o context_switch.o scheduler.o atomic_ops.o sw_exception.o exception_handlers.o exception_handlers_asm.o fpu.o fpu_asm.o task_heap.o softirq.o irq_trace.o ksm.o reaper.o console_ring.o panic.o bcache.o swap.o
 
 # Files in drivers/
-KERNEL_OBJS += drivers/console.o drivers/keyboard.o drivers/keyboard_asm.o drivers/prechecks.o drivers/timer.o drivers/timer_asm.o
+KERNEL_OBJS += drivers/console.o drivers/keyboard.o drivers/keyboard_asm.o drivers/prechecks.o drivers/timer.o drivers/timer_asm.o drivers/serial.o drivers/serial_asm.o drivers/ata.o drivers/ata_asm.o
 
 # Files in syscalls/
-KERNEL_OBJS += syscalls/terminal.o syscalls/readfile.o syscalls/set_status.o syscalls/get_ticks.o syscalls/sleep.o syscalls/gettid.o syscalls/scheduling_calls.o syscalls/fork.o syscalls/exec.o syscalls/pages.o syscalls/console_io.o syscalls/vanish.o syscalls/wait.o syscalls/swexn.o
+KERNEL_OBJS += syscalls/terminal.o syscalls/readfile.o syscalls/set_status.o syscalls/get_ticks.o syscalls/sleep.o syscalls/gettid.o syscalls/scheduling_calls.o syscalls/fork.o syscalls/exec.o syscalls/pages.o syscalls/console_io.o syscalls/vanish.o syscalls/wait.o syscalls/swexn.o syscalls/get_irq_trace.o syscalls/shm.o syscalls/mq.o syscalls/fs.o syscalls/get_swap_stats.o syscalls/async_io.o syscalls/wait_any.o
 
 # Files in syscalls/wrappers/
-KERNEL_OBJS += syscalls/wrappers/terminal.o syscalls/wrappers/readfile.o syscalls/wrappers/set_status.o syscalls/wrappers/get_ticks.o syscalls/wrappers/halt.o syscalls/wrappers/sleep.o syscalls/wrappers/gettid.o syscalls/wrappers/scheduling_calls.o syscalls/wrappers/fork.o syscalls/wrappers/syscalls_helper.o syscalls/wrappers/exec.o syscalls/wrappers/pages.o syscalls/wrappers/console_io.o syscalls/wrappers/vanish.o syscalls/wrappers/wait.o syscalls/wrappers/exec.o syscalls/wrappers/swexn.o
+KERNEL_OBJS += syscalls/wrappers/terminal.o syscalls/wrappers/readfile.o syscalls/wrappers/set_status.o syscalls/wrappers/get_ticks.o syscalls/wrappers/halt.o syscalls/wrappers/sleep.o syscalls/wrappers/gettid.o syscalls/wrappers/scheduling_calls.o syscalls/wrappers/fork.o syscalls/wrappers/syscalls_helper.o syscalls/wrappers/exec.o syscalls/wrappers/pages.o syscalls/wrappers/console_io.o syscalls/wrappers/vanish.o syscalls/wrappers/wait.o syscalls/wrappers/exec.o syscalls/wrappers/swexn.o syscalls/wrappers/get_irq_trace.o syscalls/wrappers/shm.o syscalls/wrappers/mq.o syscalls/wrappers/fs.o syscalls/wrappers/get_swap_stats.o syscalls/wrappers/async_io.o syscalls/wrappers/wait_any.o
 
 ###########################################################################
 # WARNING: Do not put **test** programs into the REQPROGS variables.  Your
@@ -0,0 +1,439 @@
+/** @file bcache.c
+ *  @brief  This file contains the definitions for the buffer cache, which
+ *          keeps recently used disk blocks in memory
+ *
+ *  The cache holds a fixed number of block-sized buffers, indexed by a hash
+ *  table of (drive, block) pairs and kept in an LRU list. A miss evicts the
+ *  least recently used buffer that nobody references.
+ *
+ *  Writes are write-back: a modified buffer is only written to the disk
+ *  when it is evicted, or when the cache is synced (e.g. when a device file
+ *  opened for writing is closed).
+ *
+ *  Sequential reads are detected per drive. A miss on the block following
+ *  the drive's last accessed block reads the next blocks as well, in the
+ *  same disk command, so that the following reads hit in the cache.
+ *
+ *  The cache's mutex is held across misses, so that a block is never read
+ *  twice. Buffers are referenced while their content is copied, which
+ *  happens without the mutex.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <bcache.h>
+#include <ata.h>
+#include <eff_mutex.h>
+#include <malloc.h>
+#include <string.h>
+#include <page.h>
+
+/* Debugging */
+#include <simics.h>
+#include <assert.h>
+
+/* Number of buffers in the cache */
+#define BCACHE_NB_BUFS 64
+
+/* Number of buckets in the cache's hash table, must be a power of two */
+#define BCACHE_NB_BUCKETS 64
+
+/* Maximum number of blocks read by a sequential miss */
+#define BCACHE_READ_AHEAD 8
+
+/* Drive of a buffer which holds no block */
+#define NO_DRIVE -1
+
+/* Value of last_block for a drive that was not accessed yet */
+#define NO_BLOCK 0xFFFFFFFF
+
+/* Directions of copy_range() */
+#define TO_DISK 1
+#define FROM_DISK 0
+
+/** @brief  The cache's LRU list */
+Q_NEW_HEAD(bcache_lru_t, bcache_buf);
+
+/** @brief  State of the buffer cache */
+typedef struct bcache {
+
+  /** @brief  Mutex protecting the cache */
+  eff_mutex_t mutex;
+
+  /** @brief  The buffers */
+  bcache_buf_t bufs[BCACHE_NB_BUFS];
+
+  /** @brief  Hash table of the valid buffers */
+  bcache_buf_t *buckets[BCACHE_NB_BUCKETS];
+
+  /** @brief  All buffers, least recently used first */
+  bcache_lru_t lru;
+
+  /** @brief  Last block accessed on each drive, to detect sequential
+   *          reads, NO_BLOCK if none */
+  unsigned int last_block[ATA_NB_DRIVES];
+
+} bcache_t;
+
+/* Buffer cache */
+static bcache_t bcache;
+
+/* Static functions prototypes */
+static unsigned int hash_block(int drive, unsigned int block);
+static bcache_buf_t *lookup(int drive, unsigned int block);
+static void hash_insert(bcache_buf_t *buf);
+static void hash_remove(bcache_buf_t *buf);
+static bcache_buf_t *evict(void);
+static int write_back(bcache_buf_t *buf);
+static int read_miss(int drive, unsigned int block, int sequential);
+static int copy_range(int drive, unsigned int offset, char *buf, int count,
+                      int direction);
+
+/** @brief  Initializes the buffer cache
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int bcache_init() {
+
+  if (eff_mutex_init(&bcache.mutex) < 0) {
+    return -1;
+  }
+
+  memset(bcache.buckets, 0, sizeof(bcache.buckets));
+  Q_INIT_HEAD(&bcache.lru);
+
+  int i;
+  for (i = 0; i < BCACHE_NB_BUFS; ++i) {
+    bcache_buf_t *buf = &bcache.bufs[i];
+    buf->data = memalign(PAGE_SIZE, ATA_BLOCK_SIZE);
+    if (buf->data == NULL) {
+      return -1;
+    }
+    buf->drive = NO_DRIVE;
+    buf->block = 0;
+    buf->valid = 0;
+    buf->dirty = 0;
+    buf->refcount = 0;
+    buf->hash_next = NULL;
+    Q_INIT_ELEM(buf, lru_link);
+    Q_INSERT_TAIL(&bcache.lru, buf, lru_link);
+  }
+
+  for (i = 0; i < ATA_NB_DRIVES; ++i) {
+    bcache.last_block[i] = NO_BLOCK;
+  }
+
+  return 0;
+}
+
+/** @brief  Gets a referenced buffer holding a block, reading the block from
+ *          the disk if it is not cached
+ *
+ *  @param  drive  ATA_MASTER or ATA_SLAVE
+ *  @param  block  The block's number
+ *
+ *  @return The buffer on success, NULL on error
+ */
+bcache_buf_t *bcache_get(int drive, unsigned int block) {
+
+  if (block >= ata_nb_blocks(drive)) {
+    return NULL;
+  }
+
+  eff_mutex_lock(&bcache.mutex);
+
+  int sequential = (bcache.last_block[drive] != NO_BLOCK &&
+                    block == bcache.last_block[drive] + 1);
+  bcache.last_block[drive] = block;
+
+  bcache_buf_t *buf = lookup(drive, block);
+  if (buf == NULL && read_miss(drive, block, sequential) == 0) {
+    buf = lookup(drive, block);
+  }
+
+  if (buf != NULL) {
+    buf->refcount++;
+    Q_REMOVE(&bcache.lru, buf, lru_link);
+    Q_INSERT_TAIL(&bcache.lru, buf, lru_link);
+  }
+
+  eff_mutex_unlock(&bcache.mutex);
+  return buf;
+}
+
+/** @brief  Drops a reference on a buffer obtained from bcache_get()
+ *
+ *  @param  buf  The buffer
+ *
+ *  @return void
+ */
+void bcache_release(bcache_buf_t *buf) {
+  eff_mutex_lock(&bcache.mutex);
+  assert(buf->refcount > 0);
+  buf->refcount--;
+  eff_mutex_unlock(&bcache.mutex);
+}
+
+/** @brief  Records that a referenced buffer was modified, it is written to
+ *          the disk later
+ *
+ *  @param  buf  The buffer
+ *
+ *  @return void
+ */
+void bcache_mark_dirty(bcache_buf_t *buf) {
+  eff_mutex_lock(&bcache.mutex);
+  buf->dirty = 1;
+  eff_mutex_unlock(&bcache.mutex);
+}
+
+/** @brief  Writes the modified buffers of a drive to the disk
+ *
+ *  @param  drive  ATA_MASTER or ATA_SLAVE
+ *
+ *  @return 0 on success, a negative number if a block could not be written
+ */
+int bcache_sync(int drive) {
+
+  eff_mutex_lock(&bcache.mutex);
+
+  int ret = 0, i;
+  for (i = 0; i < BCACHE_NB_BUFS; ++i) {
+    bcache_buf_t *buf = &bcache.bufs[i];
+    if (buf->valid && buf->dirty && buf->drive == drive &&
+        write_back(buf) < 0) {
+      ret = -1;
+    }
+  }
+
+  eff_mutex_unlock(&bcache.mutex);
+  return ret;
+}
+
+/** @brief  Reads bytes from a drive through the cache
+ *
+ *  The buffer must have been checked by the caller.
+ *
+ *  @param  drive   ATA_MASTER or ATA_SLAVE
+ *  @param  offset  The position of the first byte on the drive
+ *  @param  buf     The buffer to copy the bytes into
+ *  @param  count   The number of bytes
+ *
+ *  @return The number of bytes read on success, a negative number on error
+ */
+int bcache_read(int drive, unsigned int offset, char *buf, int count) {
+  return copy_range(drive, offset, buf, count, FROM_DISK);
+}
+
+/** @brief  Writes bytes to a drive through the cache
+ *
+ *  The buffer must have been checked by the caller.
+ *
+ *  @param  drive   ATA_MASTER or ATA_SLAVE
+ *  @param  offset  The position of the first byte on the drive
+ *  @param  buf     The bytes to write
+ *  @param  count   The number of bytes
+ *
+ *  @return The number of bytes written on success, a negative number on
+ *          error
+ */
+int bcache_write(int drive, unsigned int offset, char *buf, int count) {
+  return copy_range(drive, offset, buf, count, TO_DISK);
+}
+
+/** @brief  Hashes a block's identity
+ *
+ *  @param  drive  The block's drive
+ *  @param  block  The block's number
+ *
+ *  @return The block's bucket in the hash table
+ */
+static unsigned int hash_block(int drive, unsigned int block) {
+  return (block ^ ((unsigned int)drive * (BCACHE_NB_BUCKETS / 2))) &
+         (BCACHE_NB_BUCKETS - 1);
+}
+
+/** @brief  Looks for the buffer holding a block, the cache's mutex must be
+ *          held
+ *
+ *  @param  drive  The block's drive
+ *  @param  block  The block's number
+ *
+ *  @return The buffer, NULL if the block is not cached
+ */
+static bcache_buf_t *lookup(int drive, unsigned int block) {
+  bcache_buf_t *buf = bcache.buckets[hash_block(drive, block)];
+  while (buf != NULL && (buf->drive != drive || buf->block != block)) {
+    buf = buf->hash_next;
+  }
+  return buf;
+}
+
+/** @brief  Adds a buffer to the hash table, the cache's mutex must be held
+ *
+ *  @param  buf  The buffer
+ *
+ *  @return void
+ */
+static void hash_insert(bcache_buf_t *buf) {
+  unsigned int bucket = hash_block(buf->drive, buf->block);
+  buf->hash_next = bcache.buckets[bucket];
+  bcache.buckets[bucket] = buf;
+}
+
+/** @brief  Removes a buffer from the hash table, the cache's mutex must be
+ *          held
+ *
+ *  @param  buf  The buffer
+ *
+ *  @return void
+ */
+static void hash_remove(bcache_buf_t *buf) {
+  bcache_buf_t **prev = &bcache.buckets[hash_block(buf->drive, buf->block)];
+  while (*prev != buf) {
+    prev = &(*prev)->hash_next;
+  }
+  *prev = buf->hash_next;
+  buf->hash_next = NULL;
+}
+
+/** @brief  Frees the least recently used buffer that nobody references,
+ *          writing it back first if it was modified. The cache's mutex must
+ *          be held
+ *
+ *  @return The free buffer, NULL if every buffer is in use
+ */
+static bcache_buf_t *evict() {
+
+  bcache_buf_t *buf;
+  Q_FOREACH(buf, &bcache.lru, lru_link) {
+    if (buf->refcount > 0 || (buf->dirty && write_back(buf) < 0)) {
+      continue;
+    }
+    if (buf->valid) {
+      hash_remove(buf);
+      buf->valid = 0;
+    }
+    buf->drive = NO_DRIVE;
+    return buf;
+  }
+
+  lprintf("evict(): No buffer available");
+  return NULL;
+}
+
+/** @brief  Writes a modified buffer to the disk, the cache's mutex must be
+ *          held
+ *
+ *  @param  buf  The buffer
+ *
+ *  @return 0 on success, a negative number on error
+ */
+static int write_back(bcache_buf_t *buf) {
+  if (ata_write_blocks(buf->drive, buf->block, &buf->data, 1) < 0) {
+    lprintf("write_back(): Could not write block %u", buf->block);
+    return -1;
+  }
+  buf->dirty = 0;
+  return 0;
+}
+
+/** @brief  Reads a block which is not cached, and the blocks following it
+ *          on a sequential read. The cache's mutex must be held
+ *
+ *  Read-ahead stops at the first block already cached.
+ *
+ *  @param  drive       The block's drive
+ *  @param  block       The block's number
+ *  @param  sequential  Whether the drive is being read sequentially
+ *
+ *  @return 0 on success, a negative number on error
+ */
+static int read_miss(int drive, unsigned int block, int sequential) {
+
+  unsigned int nb_blocks = ata_nb_blocks(drive) - block;
+  int max = sequential ? BCACHE_READ_AHEAD : 1;
+  if (nb_blocks < (unsigned int)max) {
+    max = nb_blocks;
+  }
+
+  bcache_buf_t *bufs[BCACHE_READ_AHEAD];
+  char *data[BCACHE_READ_AHEAD];
+  int nb = 0;
+  while (nb < max && (nb == 0 || lookup(drive, block + nb) == NULL)) {
+    bcache_buf_t *buf = evict();
+    if (buf == NULL) {
+      break;
+    }
+    // Keep the buffer from being evicted again by this loop
+    buf->refcount++;
+    buf->drive = drive;
+    buf->block = block + nb;
+    bufs[nb] = buf;
+    data[nb] = buf->data;
+    ++nb;
+  }
+
+  if (nb == 0) {
+    return -1;
+  }
+
+  int ret = ata_read_blocks(drive, block, data, nb);
+
+  // Read-ahead blocks are inserted as recently used, so that they survive
+  // until the reader gets to them
+  int i;
+  for (i = 0; i < nb; ++i) {
+    bufs[i]->refcount--;
+    if (ret == 0) {
+      bufs[i]->valid = 1;
+      hash_insert(bufs[i]);
+      Q_REMOVE(&bcache.lru, bufs[i], lru_link);
+      Q_INSERT_TAIL(&bcache.lru, bufs[i], lru_link);
+    } else {
+      bufs[i]->drive = NO_DRIVE;
+    }
+  }
+
+  return ret;
+}
+
+/** @brief  Copies bytes between a drive and a buffer, one block at a time
+ *
+ *  @param  drive      ATA_MASTER or ATA_SLAVE
+ *  @param  offset     The position of the first byte on the drive
+ *  @param  buf        The buffer
+ *  @param  count      The number of bytes
+ *  @param  direction  TO_DISK or FROM_DISK
+ *
+ *  @return The number of bytes copied on success, a negative number on
+ *          error
+ */
+static int copy_range(int drive, unsigned int offset, char *buf, int count,
+                      int direction) {
+
+  int done = 0;
+  while (done < count) {
+    unsigned int position = offset + done;
+    unsigned int in_block = position % ATA_BLOCK_SIZE;
+    int len = (ATA_BLOCK_SIZE - in_block < (unsigned int)(count - done)) ?
+              ATA_BLOCK_SIZE - in_block : count - done;
+
+    bcache_buf_t *block = bcache_get(drive, position / ATA_BLOCK_SIZE);
+    if (block == NULL) {
+      return (done > 0) ? done : -1;
+    }
+
+    if (direction == TO_DISK) {
+      memcpy(block->data + in_block, buf + done, len);
+      bcache_mark_dirty(block);
+    } else {
+      memcpy(buf + done, block->data + in_block, len);
+    }
+
+    bcache_release(block);
+    done += len;
+  }
+
+  return done;
+}
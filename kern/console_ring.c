@@ -0,0 +1,283 @@
+/** @file console_ring.c
+ *  @brief  This file contains the definitions for the console output ring
+ *
+ *  print() copies its buffer into the ring and returns, blocking only when
+ *  the ring is full. A kernel thread, the flusher, renders the ring's content
+ *  on the console in as large batches as possible. Since the ring is a FIFO
+ *  filled under the kernel's print mutex, the output of a print() is never
+ *  interleaved with another one and the outputs of a thread appear in order.
+ *
+ *  Operations which depend on what is on the screen (cursor and color
+ *  changes, readline()) first call console_ring_flush() so that they happen
+ *  after the output of earlier print() calls. panic() renders the ring's
+ *  content without taking any lock before printing its message.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <console_ring.h>
+#include <console.h>
+#include <kernel_state.h>
+#include <context_switch.h>
+#include <scheduler.h>
+#include <syscalls.h>
+#include <variable_queue.h>
+#include <eff_mutex.h>
+#include <malloc.h>
+#include <page.h>
+
+/* Debugging */
+#include <simics.h>
+
+/* Size of the ring in bytes, holds several maximum-size print() calls. Must
+ * be a power of two so that the indices can wrap around */
+#define CONSOLE_RING_SIZE 8192
+
+/* Thread id of the flusher (no other thread is allowed to have this tid) */
+#define CONSOLE_FLUSHER_TID -4
+
+/** @brief  State of the console output ring */
+typedef struct console_ring {
+
+  /** @brief  Mutex protecting the ring's indices and queue */
+  eff_mutex_t mutex;
+
+  /** @brief  Held while rendering the ring's content, so that output is
+   *          rendered by one thread at a time and in order */
+  eff_mutex_t flush_mutex;
+
+  /** @brief  The flusher thread, NULL until it is created */
+  tcb_t *thread;
+
+  /** @brief  Indicates whether the flusher is blocked waiting for output */
+  int idle;
+
+  /** @brief  Number of bytes rendered since boot (the next byte to render is
+   *          at head modulo CONSOLE_RING_SIZE) */
+  unsigned int head;
+
+  /** @brief  Number of bytes written since boot (the next byte to write is
+   *          at tail modulo CONSOLE_RING_SIZE) */
+  unsigned int tail;
+
+  /** @brief  Threads waiting for space in the ring */
+  tcb_queue_t writers;
+
+  /** @brief  The ring's content */
+  char buf[CONSOLE_RING_SIZE];
+
+} console_ring_t;
+
+/* Console ring state */
+static console_ring_t ring;
+
+/* Static functions prototypes */
+static void flusher_thread(void);
+static int drain_once(void);
+static void render(const char *buf, int len);
+
+/** @brief  Initializes the console ring's state
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int console_ring_init() {
+
+  if (eff_mutex_init(&ring.mutex) < 0 ||
+      eff_mutex_init(&ring.flush_mutex) < 0) {
+    return -1;
+  }
+
+  ring.thread = NULL;
+  ring.idle = 0;
+  ring.head = 0;
+  ring.tail = 0;
+  Q_INIT_HEAD(&ring.writers);
+
+  return 0;
+}
+
+/** @brief  Creates the flusher thread and makes it runnable
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int console_ring_create_thread() {
+
+  tcb_t *new_tcb = create_kernel_thread(flusher_thread, CONSOLE_FLUSHER_TID,
+                                        NULL, kernel.init_cr3);
+  if (new_tcb == NULL) {
+    lprintf("console_ring_create_thread(): Failed to create the flusher");
+    return -1;
+  }
+
+  ring.thread = new_tcb;
+  add_runnable_thread(new_tcb);
+
+  return 0;
+}
+
+/** @brief  Queues output for the console
+ *
+ *  The invoking thread blocks while the ring does not have room for the whole
+ *  buffer, so that the buffer is never split. Concurrent callers must be
+ *  serialized by the caller (see kern_print_helper()). Before the flusher
+ *  exists, the output is rendered directly.
+ *
+ *  @param  buf   The output, may be in user memory
+ *  @param  len   The output's length, at most CONSOLE_IO_MAX_LEN
+ *
+ *  @return void
+ */
+void console_ring_write(const char *buf, int len) {
+
+  if (ring.thread == NULL) {
+    eff_mutex_lock(&ring.flush_mutex);
+    render(buf, len);
+    eff_mutex_unlock(&ring.flush_mutex);
+    return;
+  }
+
+  eff_mutex_lock(&ring.mutex);
+
+  // Wait for the flusher to make room
+  while (CONSOLE_RING_SIZE - (ring.tail - ring.head) < (unsigned int)len) {
+    Q_INSERT_TAIL(&ring.writers, kernel.current_thread, wait_link);
+    if (ring.idle) {
+      ring.idle = 0;
+      add_runnable_thread(ring.thread);
+    }
+    block_and_switch(HOLDING_MUTEX_TRUE, &ring.mutex);
+    eff_mutex_lock(&ring.mutex);
+  }
+
+  // Copy the output, wrapping around the end of the ring
+  int i;
+  for (i = 0; i < len; ++i) {
+    ring.buf[(ring.tail + i) % CONSOLE_RING_SIZE] = buf[i];
+  }
+  ring.tail += len;
+
+  if (ring.idle) {
+    ring.idle = 0;
+    add_runnable_thread(ring.thread);
+  }
+
+  eff_mutex_unlock(&ring.mutex);
+}
+
+/** @brief  Renders everything queued in the ring before returning
+ *
+ *  @return void
+ */
+void console_ring_flush() {
+  eff_mutex_lock(&ring.flush_mutex);
+  while (drain_once() > 0) {
+    continue;
+  }
+  eff_mutex_unlock(&ring.flush_mutex);
+}
+
+/** @brief  Renders everything queued in the ring without taking any lock
+ *
+ *  Only meant for panic(), when interrupts are disabled and the kernel is
+ *  about to stop. Output being rendered by the flusher may be rendered twice.
+ *
+ *  @return void
+ */
+void console_ring_flush_panic() {
+  while (ring.head != ring.tail) {
+    putbyte(ring.buf[ring.head % CONSOLE_RING_SIZE]);
+    ++ring.head;
+  }
+}
+
+/** @brief  Main function for the flusher thread
+ *
+ *  @return Does not return
+ */
+static void flusher_thread() {
+
+  while (1) {
+
+    eff_mutex_lock(&ring.mutex);
+
+    // Wait for some output
+    while (ring.head == ring.tail) {
+      ring.idle = 1;
+      block_and_switch(HOLDING_MUTEX_TRUE, &ring.mutex);
+      eff_mutex_lock(&ring.mutex);
+    }
+
+    eff_mutex_unlock(&ring.mutex);
+
+    console_ring_flush();
+  }
+}
+
+/** @brief  Renders the longest contiguous part of the ring's content and
+ *          wakes up the threads waiting for room
+ *
+ *  Must be called with the ring's flush mutex held. The bytes between head
+ *  and tail are not modified by writers, so they are rendered without holding
+ *  the ring's mutex.
+ *
+ *  @return The number of bytes rendered
+ */
+static int drain_once() {
+
+  eff_mutex_lock(&ring.mutex);
+  unsigned int start = ring.head % CONSOLE_RING_SIZE;
+  unsigned int len = ring.tail - ring.head;
+  eff_mutex_unlock(&ring.mutex);
+
+  if (len == 0) {
+    return 0;
+  }
+
+  if (start + len > CONSOLE_RING_SIZE) {
+    len = CONSOLE_RING_SIZE - start;
+  }
+
+  render(&ring.buf[start], len);
+
+  eff_mutex_lock(&ring.mutex);
+  ring.head += len;
+  tcb_t *writer;
+  while ((writer = Q_GET_FRONT(&ring.writers)) != NULL) {
+    Q_REMOVE(&ring.writers, writer, wait_link);
+    add_runnable_thread(writer);
+  }
+  eff_mutex_unlock(&ring.mutex);
+
+  return len;
+}
+
+/** @brief  Renders output on the console
+ *
+ *  While a readline() is outstanding, the output is also remembered so that
+ *  the keyboard consumer can echo it again (see keyboard_consumer()).
+ *
+ *  @param  buf   The output
+ *  @param  len   The output's length
+ *
+ *  @return void
+ */
+static void render(const char *buf, int len) {
+
+  eff_mutex_lock(&kernel.console_mutex);
+
+  // The hardware cursor is only moved once
+  putbytes(buf, len);
+
+  // Remember what was printed on the line being read by readline()
+  if (kernel.rl.caller != NULL) {
+    int i;
+    for (i = 0 ; i < len ; ++i) {
+      if (kernel.rl.key_index < CONSOLE_IO_MAX_LEN) {
+        kernel.rl.key_buf[kernel.rl.key_index] = buf[i];
+      }
+      ++kernel.rl.key_index;
+    }
+  }
+
+  eff_mutex_unlock(&kernel.console_mutex);
+}
@@ -12,7 +12,9 @@
 #include <context_switch_asm.h>
 #include <assert.h>
 #include <asm.h>
+#include <irq_trace.h>
 #include <simics.h>
+#include <fpu.h>
 
 /** @brief  Performs a context switch between two threads
  *
@@ -40,8 +42,9 @@ void context_switch(tcb_t* to) {
  *  The function updates information about the currently running thread in the
  *  kernel_t data structure. The function also marks the invoking thread as
  *  THR_RUNNING. Finally, the function sets the cr3 and esp0 value to the one
- *  store in the invoking thread's TCB before enabling back interrupts and 
- *  returning. 
+ *  store in the invoking thread's TCB and sets the Task Switched flag if the
+ *  FPU does not hold the invoking thread's state, before enabling back 
+ *  interrupts and returning. 
  *
  *  @param  to The invoking thread TCB
  *
@@ -61,5 +64,8 @@ void init_thread(tcb_t* to) {
   set_cr3(to->cr3);
   set_esp0(to->esp0);
 
-  enable_interrupts();
+  // Lazily switch the FPU/SSE state on the thread's first FPU instruction
+  fpu_update_ts(to);
+
+  irq_enable();
 }
@@ -0,0 +1,680 @@
+/** @file ata.c
+ *  @brief Implementation of the driver for the disks of the primary IDE
+ *   channel
+ *
+ *  Both drives of the channel (master and slave) are probed with IDENTIFY
+ *  DEVICE at boot and addressed with 28-bit LBAs. The driver transfers
+ *  whole blocks of ATA_BLOCK_SIZE bytes, several contiguous blocks per
+ *  command.
+ *
+ *  If the PCI bus has an IDE controller capable of bus mastering (e.g. the
+ *  PIIX emulated by QEMU), blocks are transferred by DMA, one entry of the
+ *  physical region descriptor table per block. Otherwise, sectors are
+ *  transferred by PIO, one sector per interrupt.
+ *
+ *  One command is in flight at a time, callers are serialized by a mutex.
+ *  The calling thread blocks in a wait queue until the interrupt handler
+ *  reports the completion of its command. The short waits that can not be
+ *  signaled by an interrupt (the drive leaving its busy state, the first
+ *  sector of a PIO write) are polled with interrupts enabled.
+ *
+ *  Buffers must be page-aligned kernel memory, which is direct-mapped, so
+ *  that their virtual address is also their physical address.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include "ata_asm.h"
+#include <asm.h>
+#include <ata.h>
+#include <eff_mutex.h>
+#include <interrupt_defines.h>
+#include <interrupts.h>
+#include <irq_trace.h>
+#include <kernel_state.h>
+#include <scheduler.h>
+#include <seg.h>
+#include <simics.h>
+#include <stdint.h>
+#include <task_queues.h>
+#include <variable_queue.h>
+
+/* I/O ports of the primary channel */
+#define ATA_DATA 0x1F0
+#define ATA_SECTOR_COUNT 0x1F2
+#define ATA_LBA_LOW 0x1F3
+#define ATA_LBA_MID 0x1F4
+#define ATA_LBA_HIGH 0x1F5
+#define ATA_DRIVE_HEAD 0x1F6
+#define ATA_STATUS 0x1F7        /* Status (read) */
+#define ATA_COMMAND 0x1F7       /* Command (write) */
+#define ATA_CONTROL 0x3F6       /* Device control (write) */
+#define ATA_ALT_STATUS 0x3F6    /* Alternate status (read) */
+
+/* IDT entry of the primary channel (IRQ 14, on the slave PIC) */
+#define ATA_IDT_ENTRY 0x2E
+#define PIC_SLAVE_PORT 0xA0
+
+/* Status register */
+#define STATUS_BSY 0x80
+#define STATUS_DF 0x20
+#define STATUS_DRQ 0x08
+#define STATUS_ERR 0x01
+#define STATUS_ABSENT 0xFF
+
+/* Device control register */
+#define CONTROL_NIEN 0x02
+
+/* Drive/head register: LBA addressing, drive number in bit 4 */
+#define DRIVE_HEAD_LBA 0xE0
+#define DRIVE_SHIFT 4
+#define LBA_HIGH_NIBBLE(lba) (((lba) >> 24) & 0x0F)
+
+/* Commands */
+#define CMD_READ_SECTORS 0x20
+#define CMD_WRITE_SECTORS 0x30
+#define CMD_READ_DMA 0xC8
+#define CMD_WRITE_DMA 0xCA
+#define CMD_IDENTIFY 0xEC
+
+/* IDENTIFY DEVICE data */
+#define IDENTIFY_WORDS 256
+#define IDENTIFY_LBA28_LOW 60
+#define IDENTIFY_LBA28_HIGH 61
+
+/* Sectors */
+#define SECTOR_SIZE 512
+#define SECTOR_WORDS (SECTOR_SIZE / 2)
+#define SECTORS_PER_BLOCK (ATA_BLOCK_SIZE / SECTOR_SIZE)
+#define MAX_LBA28 (1 << 28)
+
+/* Bound on the number of status reads while polling the drive */
+#define POLL_LIMIT 1000000
+
+/* PCI configuration space */
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA 0xCFC
+#define PCI_ENABLE 0x80000000
+#define PCI_NB_DEVICES 32
+#define PCI_NB_FUNCTIONS 8
+#define PCI_REG_COMMAND 0x04
+#define PCI_REG_CLASS 0x08
+#define PCI_REG_BAR4 0x20
+#define PCI_COMMAND_IO 0x01
+#define PCI_COMMAND_BUS_MASTER 0x04
+#define PCI_CLASS_IDE 0x0101
+#define PCI_PROG_IF_BUS_MASTER 0x80
+#define PCI_BAR_IO_MASK 0xFFFC
+#define PCI_NO_DEVICE 0xFFFFFFFF
+
+/* Bus master IDE registers, as offsets from the controller's base port */
+#define BM_COMMAND 0
+#define BM_STATUS 2
+#define BM_PRDT 4
+#define BM_COMMAND_START 0x01
+#define BM_COMMAND_READ 0x08   /* Transfer from the disk to memory */
+#define BM_STATUS_ERROR 0x02
+#define BM_STATUS_IRQ 0x04
+
+/* Last entry of a physical region descriptor table */
+#define PRD_LAST 0x8000
+
+/** @brief An entry of the physical region descriptor table */
+typedef struct prd {
+  uint32_t address;
+  uint16_t size;
+  uint16_t flags;
+} prd_t;
+
+/** @brief A command in flight */
+typedef struct ata_request {
+
+  /** @brief Whether the command writes to the disk */
+  int write;
+
+  /** @brief The blocks' buffers */
+  char **bufs;
+
+  /** @brief Number of sectors to transfer */
+  int nb_sectors;
+
+  /** @brief Next sector to transfer by PIO */
+  int next_sector;
+
+  /** @brief Whether the command completed */
+  volatile int done;
+
+  /** @brief 0 if the command succeeded, a negative number otherwise */
+  int status;
+
+} ata_request_t;
+
+/** @brief State of the IDE driver */
+typedef struct ata_state {
+
+  /** @brief Size of each drive in blocks, 0 if the drive is absent */
+  unsigned int nb_blocks[ATA_NB_DRIVES];
+
+  /** @brief Base port of the bus master registers, 0 to use PIO */
+  uint16_t bm_base;
+
+  /** @brief The command in flight, NULL if the channel is idle */
+  ata_request_t *request;
+
+  /** @brief Threads waiting for the completion of a command, protected by
+   *   disabling interrupts */
+  tcb_queue_t waiters;
+
+  /** @brief Mutex serializing the commands */
+  eff_mutex_t mutex;
+
+} ata_state_t;
+
+/* IDE driver state */
+static ata_state_t ata;
+
+/* Physical region descriptor table, its alignment keeps it from crossing a
+ * 64 KB boundary */
+static prd_t prd_table[ATA_MAX_BLOCKS]
+    __attribute__((aligned(ATA_MAX_BLOCKS * sizeof(prd_t))));
+
+/* Static functions prototypes */
+static unsigned int identify(int drive);
+static uint16_t find_bus_master(void);
+static uint32_t pci_read(int device, int function, int reg);
+static void pci_write(int device, int function, int reg, uint32_t value);
+static int transfer(int drive, unsigned int block, char **bufs,
+                    int nb_blocks, int write);
+static void start_request(ata_request_t *req, int drive, unsigned int lba);
+static void pio_sector(ata_request_t *req);
+static void finish_request(ata_request_t *req, int status);
+static int wait_not_busy(void);
+static int wait_drq(void);
+static void select_delay(void);
+
+/** @brief Probes the drives of the primary channel and registers the
+ *   channel's interrupt handler
+ *
+ *   The driver stays disabled if no drive is found.
+ *
+ *   @param void
+ *
+ *   @return A negative error code on error, or 0 on success
+ **/
+int ata_init(void) {
+
+  if (eff_mutex_init(&ata.mutex) < 0) {
+    return -1;
+  }
+  Q_INIT_HEAD(&ata.waiters);
+  ata.request = NULL;
+  ata.bm_base = 0;
+
+  // No interrupts while probing
+  outb(ATA_CONTROL, CONTROL_NIEN);
+
+  int drive, found = 0;
+  for (drive = 0; drive < ATA_NB_DRIVES; ++drive) {
+    ata.nb_blocks[drive] = identify(drive);
+    found |= (ata.nb_blocks[drive] != 0);
+  }
+
+  if (!found) {
+    return 0;
+  }
+
+  ata.bm_base = find_bus_master();
+  lprintf("ata_init(): %u + %u blocks, %s", ata.nb_blocks[ATA_MASTER],
+          ata.nb_blocks[ATA_SLAVE], ata.bm_base ? "DMA" : "PIO");
+
+  if (register_handler((uintptr_t)ata_interrupt_handler, TRAP_GATE,
+                       ATA_IDT_ENTRY, KERNEL_PRIVILEGE_LEVEL,
+                       SEGSEL_KERNEL_CS) < 0) {
+    ata.nb_blocks[ATA_MASTER] = ata.nb_blocks[ATA_SLAVE] = 0;
+    return -1;
+  }
+
+  outb(ATA_CONTROL, 0);
+  return 0;
+}
+
+/** @brief Indicates whether a drive was found
+ *
+ *   @param drive ATA_MASTER or ATA_SLAVE
+ *
+ *   @return A non-zero value if the drive can be used, 0 otherwise
+ **/
+int ata_present(int drive) {
+  return ata_nb_blocks(drive) != 0;
+}
+
+/** @brief Gets the size of a drive
+ *
+ *   @param drive ATA_MASTER or ATA_SLAVE
+ *
+ *   @return The number of blocks of the drive, 0 if it is absent
+ **/
+unsigned int ata_nb_blocks(int drive) {
+  if (drive < 0 || drive >= ATA_NB_DRIVES) {
+    return 0;
+  }
+  return ata.nb_blocks[drive];
+}
+
+/** @brief Reads contiguous blocks from a drive, blocking the invoking
+ *   thread until they are in memory
+ *
+ *   @param drive ATA_MASTER or ATA_SLAVE
+ *   @param block The first block
+ *   @param bufs One page-aligned kernel buffer per block
+ *   @param nb_blocks The number of blocks, at most ATA_MAX_BLOCKS
+ *
+ *   @return A negative error code on error, or 0 on success
+ **/
+int ata_read_blocks(int drive, unsigned int block, char **bufs,
+                    int nb_blocks) {
+  return transfer(drive, block, bufs, nb_blocks, 0);
+}
+
+/** @brief Writes contiguous blocks to a drive, blocking the invoking
+ *   thread until the drive took them
+ *
+ *   @param drive ATA_MASTER or ATA_SLAVE
+ *   @param block The first block
+ *   @param bufs One page-aligned kernel buffer per block
+ *   @param nb_blocks The number of blocks, at most ATA_MAX_BLOCKS
+ *
+ *   @return A negative error code on error, or 0 on success
+ **/
+int ata_write_blocks(int drive, unsigned int block, char **bufs,
+                     int nb_blocks) {
+  return transfer(drive, block, bufs, nb_blocks, 1);
+}
+
+/** @brief The primary IDE channel's C interrupt handler function
+ *
+ *   Completes the DMA command in flight, or transfers the next sector of
+ *   the PIO command in flight, and wakes up the waiting thread once the
+ *   command completed. Reading the status register acknowledges the drive.
+ *
+ *   @param void
+ *
+ *   @return void
+ **/
+void ata_c_handler(void) {
+
+  irq_disable();
+
+  ata_request_t *req = ata.request;
+  uint8_t bm_status = ata.bm_base ? inb(ata.bm_base + BM_STATUS) : 0;
+  uint8_t status = inb(ATA_STATUS);
+  int failed = (status & (STATUS_ERR | STATUS_DF)) != 0;
+
+  if (req != NULL && ata.bm_base) {
+    if (bm_status & BM_STATUS_IRQ) {
+      outb(ata.bm_base + BM_COMMAND, 0);
+      outb(ata.bm_base + BM_STATUS, BM_STATUS_IRQ | BM_STATUS_ERROR);
+      failed |= (bm_status & BM_STATUS_ERROR) != 0;
+      finish_request(req, failed ? -1 : 0);
+    }
+  } else if (req != NULL) {
+    if (failed) {
+      finish_request(req, -1);
+    } else if (!req->write && (status & STATUS_DRQ)) {
+      pio_sector(req);
+      if (req->next_sector == req->nb_sectors) {
+        finish_request(req, 0);
+      }
+    } else if (req->write && !(status & STATUS_BSY)) {
+      if (req->next_sector == req->nb_sectors) {
+        finish_request(req, 0);
+      } else {
+        pio_sector(req);
+      }
+    }
+  }
+
+  // Acknowledge both PICs
+  outb(PIC_SLAVE_PORT, INT_ACK_CURRENT);
+  outb(INT_CTL_PORT, INT_ACK_CURRENT);
+
+  irq_enable();
+}
+
+/** @brief Reads a drive's IDENTIFY DEVICE data by polling it
+ *
+ *   @param drive ATA_MASTER or ATA_SLAVE
+ *
+ *   @return The drive's size in blocks, 0 if there is no usable ATA drive
+ **/
+static unsigned int identify(int drive) {
+
+  outb(ATA_DRIVE_HEAD, DRIVE_HEAD_LBA | (drive << DRIVE_SHIFT));
+  select_delay();
+
+  outb(ATA_SECTOR_COUNT, 0);
+  outb(ATA_LBA_LOW, 0);
+  outb(ATA_LBA_MID, 0);
+  outb(ATA_LBA_HIGH, 0);
+  outb(ATA_COMMAND, CMD_IDENTIFY);
+
+  uint8_t status = inb(ATA_STATUS);
+  if (status == 0 || status == STATUS_ABSENT || wait_not_busy() < 0) {
+    return 0;
+  }
+
+  // ATAPI and SATA devices identify themselves through the LBA registers
+  if (inb(ATA_LBA_MID) != 0 || inb(ATA_LBA_HIGH) != 0) {
+    return 0;
+  }
+
+  int i;
+  for (i = 0; i < POLL_LIMIT; ++i) {
+    status = inb(ATA_STATUS);
+    if (status & (STATUS_DRQ | STATUS_ERR)) {
+      break;
+    }
+  }
+  if (!(status & STATUS_DRQ) || (status & STATUS_ERR)) {
+    return 0;
+  }
+
+  uint16_t id[IDENTIFY_WORDS];
+  for (i = 0; i < IDENTIFY_WORDS; ++i) {
+    id[i] = inw(ATA_DATA);
+  }
+
+  unsigned int nb_sectors = id[IDENTIFY_LBA28_LOW] |
+                            ((unsigned int)id[IDENTIFY_LBA28_HIGH] << 16);
+  return nb_sectors / SECTORS_PER_BLOCK;
+}
+
+/** @brief Looks for a bus mastering IDE controller on the PCI bus, and
+ *   enables bus mastering on it
+ *
+ *   @param void
+ *
+ *   @return The base port of the bus master registers, 0 if there is none
+ **/
+static uint16_t find_bus_master(void) {
+
+  int device, function;
+  for (device = 0; device < PCI_NB_DEVICES; ++device) {
+    for (function = 0; function < PCI_NB_FUNCTIONS; ++function) {
+
+      uint32_t class = pci_read(device, function, PCI_REG_CLASS);
+      if (class == PCI_NO_DEVICE || (class >> 16) != PCI_CLASS_IDE ||
+          !((class >> 8) & PCI_PROG_IF_BUS_MASTER)) {
+        continue;
+      }
+
+      uint16_t base = pci_read(device, function, PCI_REG_BAR4) &
+                      PCI_BAR_IO_MASK;
+      if (base == 0) {
+        continue;
+      }
+
+      uint32_t command = pci_read(device, function, PCI_REG_COMMAND);
+      pci_write(device, function, PCI_REG_COMMAND,
+                command | PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+      return base;
+    }
+  }
+
+  return 0;
+}
+
+/** @brief Reads a register of a device's PCI configuration space (bus 0)
+ *
+ *   @param device The device number
+ *   @param function The function number
+ *   @param reg The register's offset
+ *
+ *   @return The register's value
+ **/
+static uint32_t pci_read(int device, int function, int reg) {
+  outd(PCI_CONFIG_ADDRESS, PCI_ENABLE | (device << 11) | (function << 8) |
+                           reg);
+  return ind(PCI_CONFIG_DATA);
+}
+
+/** @brief Writes a register of a device's PCI configuration space (bus 0)
+ *
+ *   @param device The device number
+ *   @param function The function number
+ *   @param reg The register's offset
+ *   @param value The register's new value
+ *
+ *   @return void
+ **/
+static void pci_write(int device, int function, int reg, uint32_t value) {
+  outd(PCI_CONFIG_ADDRESS, PCI_ENABLE | (device << 11) | (function << 8) |
+                           reg);
+  outd(PCI_CONFIG_DATA, value);
+}
+
+/** @brief Transfers contiguous blocks between a drive and memory, blocking
+ *   the invoking thread until the command completes
+ *
+ *   @param drive ATA_MASTER or ATA_SLAVE
+ *   @param block The first block
+ *   @param bufs One page-aligned kernel buffer per block
+ *   @param nb_blocks The number of blocks, at most ATA_MAX_BLOCKS
+ *   @param write Whether to write to the drive
+ *
+ *   @return A negative error code on error, or 0 on success
+ **/
+static int transfer(int drive, unsigned int block, char **bufs,
+                    int nb_blocks, int write) {
+
+  unsigned int size = ata_nb_blocks(drive);
+  if (nb_blocks <= 0 || nb_blocks > ATA_MAX_BLOCKS || block >= size ||
+      size - block < (unsigned int)nb_blocks) {
+    return -1;
+  }
+
+  ata_request_t req;
+  req.write = write;
+  req.bufs = bufs;
+  req.nb_sectors = nb_blocks * SECTORS_PER_BLOCK;
+  req.next_sector = 0;
+  req.done = 0;
+  req.status = 0;
+
+  eff_mutex_lock(&ata.mutex);
+
+  start_request(&req, drive, block * SECTORS_PER_BLOCK);
+
+  // The interrupt handler may not run between the check and the insertion in
+  // the queue
+  irq_disable();
+  while (!req.done) {
+    Q_INSERT_TAIL(&ata.waiters, kernel.current_thread, wait_link);
+
+    // Interrupts are enabled after the context switch
+    block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+    irq_disable();
+  }
+  irq_enable();
+
+  eff_mutex_unlock(&ata.mutex);
+
+  return req.status;
+}
+
+/** @brief Issues the command of a request to the drive
+ *
+ *   Must be called with the driver's mutex held and interrupts enabled. The
+ *   request is published to the interrupt handler right before the drive
+ *   can raise an interrupt for it.
+ *
+ *   @param req The request
+ *   @param drive ATA_MASTER or ATA_SLAVE
+ *   @param lba The first sector
+ *
+ *   @return void
+ **/
+static void start_request(ata_request_t *req, int drive, unsigned int lba) {
+
+  if (wait_not_busy() < 0) {
+    req->status = -1;
+    req->done = 1;
+    return;
+  }
+
+  outb(ATA_DRIVE_HEAD, DRIVE_HEAD_LBA | (drive << DRIVE_SHIFT) |
+                       LBA_HIGH_NIBBLE(lba));
+  select_delay();
+
+  // A count of 0 stands for 256 sectors
+  outb(ATA_SECTOR_COUNT, req->nb_sectors & 0xFF);
+  outb(ATA_LBA_LOW, lba & 0xFF);
+  outb(ATA_LBA_MID, (lba >> 8) & 0xFF);
+  outb(ATA_LBA_HIGH, (lba >> 16) & 0xFF);
+
+  if (ata.bm_base) {
+    int i, nb_blocks = req->nb_sectors / SECTORS_PER_BLOCK;
+    for (i = 0; i < nb_blocks; ++i) {
+      prd_table[i].address = (uint32_t)req->bufs[i];
+      prd_table[i].size = ATA_BLOCK_SIZE;
+      prd_table[i].flags = (i == nb_blocks - 1) ? PRD_LAST : 0;
+    }
+
+    uint8_t direction = req->write ? 0 : BM_COMMAND_READ;
+    ata.request = req;
+    outd(ata.bm_base + BM_PRDT, (uint32_t)prd_table);
+    outb(ata.bm_base + BM_STATUS, BM_STATUS_IRQ | BM_STATUS_ERROR);
+    outb(ata.bm_base + BM_COMMAND, direction);
+    outb(ATA_COMMAND, req->write ? CMD_WRITE_DMA : CMD_READ_DMA);
+    outb(ata.bm_base + BM_COMMAND, direction | BM_COMMAND_START);
+    return;
+  }
+
+  if (!req->write) {
+    ata.request = req;
+    outb(ATA_COMMAND, CMD_READ_SECTORS);
+    return;
+  }
+
+  outb(ATA_COMMAND, CMD_WRITE_SECTORS);
+
+  // The drive asks for the first sector without raising an interrupt
+  if (wait_drq() < 0) {
+    req->status = -1;
+    req->done = 1;
+    return;
+  }
+
+  // The interrupt for the first sector may not be handled before the
+  // request is published
+  irq_disable();
+  ata.request = req;
+  pio_sector(req);
+  irq_enable();
+}
+
+/** @brief Transfers the next sector of a PIO request through the data port
+ *
+ *   @param req The request
+ *
+ *   @return void
+ **/
+static void pio_sector(ata_request_t *req) {
+
+  uint16_t *data = (uint16_t *)(req->bufs[req->next_sector /
+                                          SECTORS_PER_BLOCK] +
+                   (req->next_sector % SECTORS_PER_BLOCK) * SECTOR_SIZE);
+
+  int i;
+  if (req->write) {
+    for (i = 0; i < SECTOR_WORDS; ++i) {
+      outw(ATA_DATA, data[i]);
+    }
+  } else {
+    for (i = 0; i < SECTOR_WORDS; ++i) {
+      data[i] = inw(ATA_DATA);
+    }
+  }
+
+  ++req->next_sector;
+}
+
+/** @brief Records the completion of the request in flight and wakes up the
+ *   waiting threads
+ *
+ *   Must be called with interrupts disabled.
+ *
+ *   @param req The request
+ *   @param status 0 if the command succeeded, a negative number otherwise
+ *
+ *   @return void
+ **/
+static void finish_request(ata_request_t *req, int status) {
+
+  req->status = status;
+  req->done = 1;
+  ata.request = NULL;
+
+  tcb_t *waiter;
+  while ((waiter = Q_GET_FRONT(&ata.waiters)) != NULL) {
+    Q_REMOVE(&ata.waiters, waiter, wait_link);
+    add_runnable_thread_noint(waiter);
+  }
+}
+
+/** @brief Polls the drive until it is not busy
+ *
+ *   When interrupts are enabled, other threads may run between two polls.
+ *
+ *   @param void
+ *
+ *   @return 0 if the drive is ready, a negative number if it stayed busy
+ **/
+static int wait_not_busy(void) {
+  int i;
+  for (i = 0; i < POLL_LIMIT; ++i) {
+    if (!(inb(ATA_ALT_STATUS) & STATUS_BSY)) {
+      return 0;
+    }
+    preempt_point();
+  }
+  return -1;
+}
+
+/** @brief Polls the drive until it requests data
+ *
+ *   When interrupts are enabled, other threads may run between two polls.
+ *
+ *   @param void
+ *
+ *   @return 0 if the drive requests data, a negative number if it failed or
+ *           did not request data in time
+ **/
+static int wait_drq(void) {
+  int i;
+  for (i = 0; i < POLL_LIMIT; ++i) {
+    uint8_t status = inb(ATA_ALT_STATUS);
+    if (status & (STATUS_ERR | STATUS_DF)) {
+      return -1;
+    }
+    if (status & STATUS_DRQ) {
+      return 0;
+    }
+    preempt_point();
+  }
+  return -1;
+}
+
+/** @brief Gives a newly selected drive the 400 ns it needs to update its
+ *   status register
+ *
+ *   @param void
+ *
+ *   @return void
+ **/
+static void select_delay(void) {
+  int i;
+  for (i = 0; i < 4; ++i) {
+    inb(ATA_ALT_STATUS);
+  }
+}
@@ -0,0 +1,13 @@
+/** @file ata_asm.h
+ *  @brief The file which contains the definition of the handler of the 
+ *   primary IDE channel interrupt
+ *
+ *  @author akanjani, lramire1
+ */
+
+#ifndef __ATA_ASM_H_
+#define __ATA_ASM_H_
+
+void ata_interrupt_handler();
+
+#endif
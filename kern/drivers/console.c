@@ -10,6 +10,10 @@
  *  the cursor, change the default color of the words on the screen and 
  *  reading a value from a position on the screen.
  *
+ *  Output written with putbyte and putbytes goes to the VGA text screen, to
+ *  the serial port or to both, as selected with console_set_outputs. The
+ *  cursor and color only apply to the screen.
+ *
  *  @author akanjani, lramire1
  */
 
@@ -20,7 +24,9 @@
 #include <ctype.h>
 #include <asm.h>
 #include <console.h>
+#include <string.h>
 #include "prechecks.h"
+#include <serial.h>
 #include <simics.h>
 
 #define CURSOR_INVISIBLE 0
@@ -37,6 +43,14 @@
 #define BACKSPACE '\b'
 #define NUM_BYTES_PER_POSITION 2
 
+/* A cell of video memory: the character in the low byte, its color in the
+ * high byte */
+#define CELL(row, col) \
+	( ( uint16_t * ) CONSOLE_MEM_BASE + ( row ) * CONSOLE_WIDTH + ( col ) )
+#define MAKE_CELL(ch, color) \
+	( ( uint16_t ) ( ( ( color ) << BITS_IN_A_BYTE ) | \
+		( uint8_t ) ( ch ) ) )
+
 /* The structure to maintain the cursor position */
 typedef struct cursor_position {
         int row, col;
@@ -49,6 +63,7 @@ typedef struct console_state {
 	cursor_t global_cursor;
 	int term_color;
 	uint8_t cursor_isvisible;
+	int outputs;
 } console_state_t;
 
 /* The console_state_t struct type global variable to maintain the state of the
@@ -56,6 +71,12 @@ typedef struct console_state {
  */
 console_state_t state_;
 
+static void render_byte( char ch );
+static void next_line( void );
+static void scroll_screen( void );
+static void update_hw_cursor( void );
+static void write_hw_cursor( unsigned int offset );
+
 /** @brief The API to print a character on the screen at the current
  *  cursor position.
  *  
@@ -78,47 +99,14 @@ console_state_t state_;
  */
 int putbyte( char ch )
 {
-	int row, col, color;
-	get_cursor( &row, &col );
-	get_term_color( &color );
-	
-	if ( ch == NEWLINE ) {
-		// change the cursor to the beginning of the next line
-		// and scroll up if necessary
-		if ( row == CONSOLE_HEIGHT - 1 ) {
-			scroll_up();
-		} else {
-			set_cursor( row + 1, FIRST_COL );
-
-		}
-	} else if ( ch == CARRIAGE_RETURN ) {
-		// move the cursor to the beginning of the same line
-		set_cursor( row, FIRST_COL );
-	} else if ( ch == BACKSPACE ) {
-		// put ' ' on the column just before the current cursor position
-		if ( col == FIRST_COL ) {
-			return ch;
-		}
-
-		draw_char( row, col - 1, SPACE, color );
-
-		// move the cursor one column to the left
-		set_cursor( row, col - 1 ); 
-	} else if ( isprint( ch ) ) {
-		// put the character at the cursor
-		draw_char( row, col, ch, color );
-		
-		// move the cursor by one to the right
-		if ( col == CONSOLE_WIDTH - 1 ) {
-			if ( row == CONSOLE_HEIGHT - 1 ) {
-				scroll_up();
-			} else {
-				set_cursor( row + 1, FIRST_COL );
-			}
-		} else {
-			set_cursor( row, col + 1 );
-		}
+	if ( state_.outputs & CONSOLE_OUTPUT_SERIAL ) {
+		serial_write( &ch, 1 );
+	}
+	if ( !( state_.outputs & CONSOLE_OUTPUT_VGA ) ) {
+		return ch;
 	}
+	render_byte( ch );
+	update_hw_cursor();
 	return ch;
 }
 
@@ -136,6 +124,10 @@ int putbyte( char ch )
  *  When we scroll the screen, we are not going to remember characters 
  *  which are "pushed off" of the screen.
  *
+ *  Runs of printable characters are written straight to video memory and
+ *  the hardware cursor is only moved once, after the whole string has been
+ *  rendered.
+ *
  *  @return Does not return
  */
 void putbytes( const char *s, int len )
@@ -144,10 +136,39 @@ void putbytes( const char *s, int len )
 		// invalid string or len
 		return;
 	}
-	int i;
-	for ( i = 0; i < len; i++ ) {
-		putbyte( s[i] );
+	if ( state_.outputs & CONSOLE_OUTPUT_SERIAL ) {
+		serial_write( s, len );
+	}
+	if ( !( state_.outputs & CONSOLE_OUTPUT_VGA ) ) {
+		return;
+	}
+	uint16_t color = state_.term_color;
+	int i = 0;
+	while ( i < len ) {
+		if ( !isprint( s[i] ) ) {
+			// control characters go through the slow path
+			render_byte( s[i++] );
+			continue;
+		}
+
+		// write as many characters as fit on the current line
+		int row = state_.global_cursor.row;
+		int col = state_.global_cursor.col;
+		uint16_t *cell = CELL( row, col );
+		while ( i < len && col < CONSOLE_WIDTH && isprint( s[i] ) ) {
+			*cell++ = MAKE_CELL( s[i], color );
+			i++;
+			col++;
+		}
+
+		if ( col == CONSOLE_WIDTH ) {
+			next_line();
+		} else {
+			state_.global_cursor.col = col;
+		}
 	}
+
+	update_hw_cursor();
 }
 
 /** @brief The API to set the color of the characters to be printed on the 
@@ -230,23 +251,7 @@ int set_cursor( int row, int col )
 	state_.global_cursor.row = row;
 	state_.global_cursor.col = col;
 
-	// Hanlde the case where the cursor is visible
-	if ( state_.cursor_isvisible == CURSOR_VISIBLE ) {
-		// Figure out the offset from the screen start
-		unsigned int offset = ( row * CONSOLE_WIDTH ) + ( col );
-
-		// Extract the lsb and the second lsb
-		uint8_t offset_lsb = ( offset & LSB_MASK );
-		uint8_t offset_msb = 
-			( offset & SECOND_LSB_MASK ) >> BITS_IN_A_BYTE;
-
-		// Talk to the port
-		outb( CRTC_IDX_REG, CRTC_CURSOR_LSB_IDX );
-		outb( CRTC_DATA_REG, offset_lsb );
-
-		outb( CRTC_IDX_REG, CRTC_CURSOR_MSB_IDX );
-		outb( CRTC_DATA_REG, offset_msb );
-	}
+	update_hw_cursor();
 	return 0;
 }
 
@@ -289,8 +294,8 @@ void hide_cursor()
 	state_.cursor_isvisible = CURSOR_INVISIBLE;
 
 	// update the hardware cursor to a position out of the console
-	// region to hide it
-	set_cursor( CONSOLE_HEIGHT - 1, CONSOLE_WIDTH );
+	// region to hide it, the logical cursor does not move
+	write_hw_cursor( CONSOLE_HEIGHT * CONSOLE_WIDTH );
 }
 
 /** @brief The API to show the cursor on the console.
@@ -328,12 +333,12 @@ void show_cursor()
  */
 void clear_console()
 {
-	int i, j;
-	for ( i = 0; i < CONSOLE_HEIGHT; i++ ) {
-		for( j = 0; j < CONSOLE_WIDTH; j++ ) {
-			// put spaces on the whole console
-			draw_char( i, j, SPACE, state_.term_color );
-		}
+	// put spaces on the whole console
+	uint16_t blank = MAKE_CELL( SPACE, state_.term_color );
+	uint16_t *cell = CELL( FIRST_ROW, FIRST_COL );
+	int i;
+	for ( i = 0; i < CONSOLE_HEIGHT * CONSOLE_WIDTH; i++ ) {
+		cell[i] = blank;
 	}
 
 	// reset the cursor position to its original state
@@ -397,22 +402,10 @@ char get_char( int row, int col )
  */
 void scroll_up()
 {
-	int i, j;
-	for ( i = 1; i < CONSOLE_HEIGHT; i++ ) {
-		for ( j = 0; j < CONSOLE_WIDTH; j++ ) {
-			// move the character to the same column of the i-1th
-			// row
-			draw_char( i - 1, j, get_char( i, j ), 
-				state_.term_color );
-		}
-	}
-	for ( j = 0; j < CONSOLE_WIDTH; j++ ) {
-		// draw spaces on the last line of the console to clean it
-		draw_char( i - 1, j, SPACE, state_.term_color );
-	}
+	scroll_screen();
 
 	// set the cursor to the first column of the last line
-	set_cursor( i - 1, FIRST_COL );
+	set_cursor( CONSOLE_HEIGHT - 1, FIRST_COL );
 }
 
 /** @brief The function to initialize the console.
@@ -433,4 +426,136 @@ void console_init()
 	state_.global_cursor.col = FIRST_COL;
 	state_.cursor_isvisible = CURSOR_VISIBLE;
 	state_.term_color = BLACK_BG_WHITE_FG;
+	state_.outputs = CONSOLE_OUTPUT_VGA;
+}
+
+/** @brief Selects where the output of putbyte and putbytes goes
+ *
+ *  @param outputs A combination of CONSOLE_OUTPUT_VGA and
+ *  CONSOLE_OUTPUT_SERIAL
+ *
+ *  @return 0 on success, or -1 if outputs selects no valid output
+ */
+int console_set_outputs( int outputs )
+{
+	if ( outputs == 0 ||
+	     ( outputs & ~( CONSOLE_OUTPUT_VGA | CONSOLE_OUTPUT_SERIAL ) ) ) {
+		return -1;
+	}
+	state_.outputs = outputs;
+	return 0;
+}
+
+/** @brief Prints a character at the current cursor position without moving
+ *  the hardware cursor.
+ *
+ *  Handles newlines, carriage returns and backspaces like putbyte. Only the
+ *  cursor position maintained in state_ is updated.
+ *
+ *  @param ch The character to print
+ *
+ *  @return void
+ */
+static void render_byte( char ch )
+{
+	int row = state_.global_cursor.row;
+	int col = state_.global_cursor.col;
+
+	if ( ch == NEWLINE ) {
+		// change the cursor to the beginning of the next line
+		// and scroll up if necessary
+		next_line();
+	} else if ( ch == CARRIAGE_RETURN ) {
+		// move the cursor to the beginning of the same line
+		state_.global_cursor.col = FIRST_COL;
+	} else if ( ch == BACKSPACE ) {
+		// put ' ' on the column just before the current cursor position
+		if ( col == FIRST_COL ) {
+			return;
+		}
+		*CELL( row, col - 1 ) = MAKE_CELL( SPACE, state_.term_color );
+
+		// move the cursor one column to the left
+		state_.global_cursor.col = col - 1;
+	} else if ( isprint( ch ) ) {
+		// put the character at the cursor
+		*CELL( row, col ) = MAKE_CELL( ch, state_.term_color );
+
+		// move the cursor by one to the right
+		if ( col == CONSOLE_WIDTH - 1 ) {
+			next_line();
+		} else {
+			state_.global_cursor.col = col + 1;
+		}
+	}
+}
+
+/** @brief Moves the cursor to the first column of the next line, scrolling
+ *  if the cursor is on the last line. The hardware cursor is not moved.
+ *
+ *  @return void
+ */
+static void next_line( void )
+{
+	if ( state_.global_cursor.row == CONSOLE_HEIGHT - 1 ) {
+		scroll_screen();
+	} else {
+		state_.global_cursor.row++;
+	}
+	state_.global_cursor.col = FIRST_COL;
+}
+
+/** @brief Moves the content of the screen up by one line and clears the last
+ *  line, characters keep their color.
+ *
+ *  @return void
+ */
+static void scroll_screen( void )
+{
+	memmove( CELL( FIRST_ROW, FIRST_COL ), CELL( FIRST_ROW + 1, FIRST_COL ),
+		( CONSOLE_HEIGHT - 1 ) * CONSOLE_WIDTH * 
+		NUM_BYTES_PER_POSITION );
+
+	// draw spaces on the last line of the console to clean it
+	uint16_t blank = MAKE_CELL( SPACE, state_.term_color );
+	uint16_t *cell = CELL( CONSOLE_HEIGHT - 1, FIRST_COL );
+	int j;
+	for ( j = 0; j < CONSOLE_WIDTH; j++ ) {
+		cell[j] = blank;
+	}
+}
+
+/** @brief Moves the hardware cursor to the position maintained in state_,
+ *  if the cursor is visible.
+ *
+ *  @return void
+ */
+static void update_hw_cursor( void )
+{
+	// Hanlde the case where the cursor is visible
+	if ( state_.cursor_isvisible == CURSOR_VISIBLE ) {
+		// Figure out the offset from the screen start
+		write_hw_cursor( ( state_.global_cursor.row * CONSOLE_WIDTH ) + 
+			state_.global_cursor.col );
+	}
+}
+
+/** @brief Writes the position of the hardware cursor to the CRTC.
+ *
+ *  @param offset The offset of the cursor from the screen start
+ *
+ *  @return void
+ */
+static void write_hw_cursor( unsigned int offset )
+{
+	// Extract the lsb and the second lsb
+	uint8_t offset_lsb = ( offset & LSB_MASK );
+	uint8_t offset_msb = ( offset & SECOND_LSB_MASK ) >> BITS_IN_A_BYTE;
+
+	// Talk to the port
+	outb( CRTC_IDX_REG, CRTC_CURSOR_LSB_IDX );
+	outb( CRTC_DATA_REG, offset_lsb );
+
+	outb( CRTC_IDX_REG, CRTC_CURSOR_MSB_IDX );
+	outb( CRTC_DATA_REG, offset_msb );
 }
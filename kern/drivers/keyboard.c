@@ -14,8 +14,14 @@
  *  The keyboard_init function initializes the keyboard interrupt by
  *  registering the address of its handler in the IDT
  *
+ *  The interrupt handler only stores the raw scancode. Scancodes are decoded
+ *  in a bottom half (see softirq.h), outside of the interrupt handler, into
+ *  a buffer of characters.
+ *
  *  The readchar function is the one available to the user to read from the
- *  buffer storing all the characters typed from the keyboard
+ *  buffer storing all the characters typed from the keyboard. The
+ *  readchar_wait function blocks the invoking thread until a character is
+ *  available, the bottom half wakes up the waiting threads.
  *
  *  @author akanjani, lramire1
  */
@@ -34,6 +40,32 @@
 #include <stdio.h>
 #include <tcb.h>
 #include <syscalls.h>
+#include <softirq.h>
+#include <irq_trace.h>
+#include <task_queues.h>
+#include <variable_queue.h>
+#include <kernel_state.h>
+#include <wait_any.h>
+
+/* Static functions prototypes */
+static void keyboard_bottom_half(void);
+static void wake_char_waiters(void);
+
+/* Raw scancodes received by the interrupt handler */
+static byte_queue_t scancodes;
+
+/* Characters decoded by the bottom half */
+static byte_queue_t characters;
+
+/* Deferred work decoding the scancodes */
+static softirq_t keyboard_work;
+
+/* Number of newlines in the characters buffer, only decremented with
+ * interrupts disabled */
+static int nb_lines = 0;
+
+/* Threads blocked in readchar_wait(), protected by disabling interrupts */
+static tcb_queue_t char_waiters = {NULL, NULL};
 
 /** @brief keyboard initialization function
  *
@@ -46,6 +78,8 @@
  **/
 int keyboard_init(void) {
 
+  softirq_init(&keyboard_work, keyboard_bottom_half);
+
   return register_handler((uintptr_t)keyboard_interrupt_handler, TRAP_GATE,
                           KEY_IDT_ENTRY, KERNEL_PRIVILEGE_LEVEL,
                           SEGSEL_KERNEL_CS);
@@ -55,9 +89,10 @@ int keyboard_init(void) {
  *
  *   This is the function that is called via the assembly wrapper
  *   keyboard_interrupt_handler. It reads a byte from the keyboard
- *   port and enqueues it in the static keyboard buffer maintained by the
+ *   port and enqueues it in the static scancode buffer maintained by the
  *   kernel. It then acknowledges the PIC that the handler for keyboard
- *   has run and can service another keyboard_interrupt now.
+ *   has run and can service another keyboard_interrupt now. Decoding the
+ *   scancode is deferred to the bottom half.
  *
  *   @param void
  *
@@ -69,43 +104,157 @@ void keyboard_c_handler(void) {
   uint8_t character = ( int )inb( KEYBOARD_PORT );
 
   // Enqueue the key event
-  enqueue(character);
+  enqueue(&scancodes, character);
   
   // Acknowledge the PIC
   outb(INT_CTL_PORT, INT_ACK_CURRENT);
 
+  // Decode the scancode later
+  softirq_raise(&keyboard_work);
+  softirq_run();
+
+  // Honor a timer tick that arrived while bottom halves were running
+  if (!softirq_is_running()) {
+    preempt_point();
+  }
+}
+
+/** @brief The keyboard's bottom half
+ *
+ *   Feeds every pending scancode to the process_scancode state machine and
+ *   stores the characters of released keys in the characters buffer.
+ *
+ *   @param void
+ *
+ *   @return void
+ **/
+static void keyboard_bottom_half(void) {
+  int scancode;
+  int new_chars = 0;
+  int new_lines = 0;
+  while ((scancode = dequeue(&scancodes)) >= 0) {
+    kh_type aug_char = process_scancode(scancode);
+    if (KH_HASDATA(aug_char) && !KH_ISMAKE(aug_char)) {
+      // Key is released and has a valid character
+      if (enqueue(&characters, KH_GETCHAR(aug_char)) == 0) {
+        new_chars = 1;
+        if (KH_GETCHAR(aug_char) == '\n') {
+          ++nb_lines;
+          new_lines = 1;
+        }
+      }
+    }
+  }
+
+  if (new_chars) {
+    wake_char_waiters();
+  }
+  if (new_lines) {
+    wait_any_notify(EVENT_LINE, NULL);
+  }
+}
+
+/** @brief Adds characters received from another input device (e.g. the
+ *   serial port) to the buffer of characters typed in on the keyboard
+ *
+ *   Must only be called from a bottom half, which are never run
+ *   concurrently, since the buffer has a single producer.
+ *
+ *   @param chars The characters
+ *   @param len The number of characters
+ *
+ *   @return void
+ **/
+void keyboard_input(const char *chars, int len) {
+  int i;
+  int new_lines = 0;
+  for (i = 0; i < len; ++i) {
+    if (enqueue(&characters, chars[i]) == 0 && chars[i] == '\n') {
+      ++nb_lines;
+      new_lines = 1;
+    }
+  }
+
+  if (len > 0) {
+    wake_char_waiters();
+  }
+  if (new_lines) {
+    wait_any_notify(EVENT_LINE, NULL);
+  }
+}
+
+/** @brief Wakes up the threads waiting for a character
+ *
+ *   @param void
+ *
+ *   @return void
+ **/
+static void wake_char_waiters(void) {
+  irq_disable();
+  tcb_t *waiter;
+  while ((waiter = Q_GET_FRONT(&char_waiters)) != NULL) {
+    Q_REMOVE(&char_waiters, waiter, wait_link);
+    add_runnable_thread_noint(waiter);
+  }
+  irq_enable();
 }
 
 /** @brief The API provided to the user to read the characters that were
  *   typed in on the keyboard.
  *
- *   This function looks at the static buffer for keyboard presses
- *   maintained by the kernel and dequeues a character and then feeds it to
- *   process_scancode API which is a state machine used to extract the
- *   actual character from the scan code that we get via the keryboard
- *   interrupts. If the queue is empty, it returns a negative value denoting
- *   error. If the scan_code represents a printable character and the
- *   release of the key is encountered, we return the character.
+ *   This function looks at the static buffer of characters decoded by the
+ *   keyboard's bottom half and dequeues a character. If the queue is empty,
+ *   it returns a negative value denoting error. Must be called with
+ *   interrupts disabled.
  *
  *   @param void
  *
  *   @return A negative error code on error, or the character read on success
  **/
 int readchar(void) {
-  while (1) {
-    int ch = dequeue();
-    if (ch < 0) {
-      // Dequeue error. The queue is empty
-      break;
-    }
-    kh_type aug_char = process_scancode(ch);
-    if (KH_HASDATA(aug_char)) {
-      // has a valid character
-      if (!KH_ISMAKE(aug_char)) {
-        // key is released
-        return KH_GETCHAR(aug_char);
-      }
-    }
+  int ch = dequeue(&characters);
+  if (ch == '\n') {
+    --nb_lines;
+  }
+  return ch;
+}
+
+/** @brief Tells whether a whole line was typed in and not consumed yet, in
+ *   which case a readline() does not wait for input
+ *
+ *   @param void
+ *
+ *   @return 1 if there is a line, 0 otherwise
+ **/
+int keyboard_has_line(void) {
+  return nb_lines > 0;
+}
+
+/** @brief Returns the next character typed in on the keyboard, blocking the
+ *   invoking thread until there is one.
+ *
+ *   Only one thread may consume characters at a time, callers are serialized
+ *   by the kernel's readline mutex.
+ *
+ *   @param void
+ *
+ *   @return The character read
+ **/
+int readchar_wait(void) {
+
+  int ch;
+
+  // The bottom half may not run between the check and the insertion in the
+  // queue
+  irq_disable();
+  while ((ch = readchar()) < 0) {
+    Q_INSERT_TAIL(&char_waiters, kernel.current_thread, wait_link);
+
+    // Interrupts are enabled after the context switch
+    block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+    irq_disable();
   }
-  return -1;
+  irq_enable();
+
+  return ch;
 }
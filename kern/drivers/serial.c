@@ -0,0 +1,441 @@
+/** @file serial.c
+ *  @brief Implementation of the driver for the first serial port (COM1)
+ *
+ *  The port is driven by a 16550 UART, programmed for 115200 bauds, 8 data
+ *  bits, no parity and 1 stop bit, with its FIFOs enabled.
+ *
+ *  Output is written to a transmit ring and sent by the interrupt handler,
+ *  which refills the UART's FIFO every time it becomes empty. The writer only
+ *  fills the FIFO itself when the transmitter is idle, and copies at most
+ *  TX_CHUNK bytes to the ring per interrupts-off section. When the ring is
+ *  full, a thread blocks until the transmit interrupt makes room. Writers
+ *  that can not block (interrupts disabled, bottom halves, panic()) send
+ *  bytes by polling the UART instead.
+ *
+ *  Received bytes are stored by the interrupt handler in a receive buffer,
+ *  and handed to the keyboard driver's buffer of characters by a bottom half
+ *  (see softirq.h), so that readline() and getchar() read from both the
+ *  keyboard and the serial port.
+ *
+ *  Output is "cooked" for terminals: newlines are sent as a carriage return
+ *  followed by a line feed, backspaces erase the previous character.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include "serial_asm.h"
+#include <asm.h>
+#include <eflags.h>
+#include <interrupt_defines.h>
+#include <interrupts.h>
+#include <keyboard.h>
+#include <queue.h>
+#include <scheduler.h>
+#include <seg.h>
+#include <serial.h>
+#include <simics.h>
+#include <softirq.h>
+#include <irq_trace.h>
+#include <kernel_state.h>
+#include <task_queues.h>
+#include <variable_queue.h>
+
+/* Base I/O port and IDT entry of COM1 (IRQ 4) */
+#define COM1_PORT 0x3F8
+#define COM1_IDT_ENTRY 0x24
+
+/* UART registers, as offsets from the base port */
+#define UART_DATA 0   /* Receive buffer / transmit holding (DLAB = 0) */
+#define UART_IER 1    /* Interrupt enable (DLAB = 0) */
+#define UART_DLL 0    /* Divisor latch, low byte (DLAB = 1) */
+#define UART_DLM 1    /* Divisor latch, high byte (DLAB = 1) */
+#define UART_IIR 2    /* Interrupt identification (read) */
+#define UART_FCR 2    /* FIFO control (write) */
+#define UART_LCR 3    /* Line control */
+#define UART_MCR 4    /* Modem control */
+#define UART_LSR 5    /* Line status */
+#define UART_MSR 6    /* Modem status */
+#define UART_SCR 7    /* Scratch */
+
+/* Register values */
+#define IER_RX_DATA 0x01
+#define IER_TX_EMPTY 0x02
+#define LCR_DLAB 0x80
+#define LCR_8N1 0x03
+#define FCR_ENABLE_CLEAR_14 0xC7
+#define MCR_DTR_RTS_OUT2 0x0B
+#define LSR_DATA_READY 0x01
+#define LSR_TX_EMPTY 0x20
+#define LSR_ABSENT 0xFF
+#define IIR_NO_INTERRUPT 0x01
+#define IIR_ID_MASK 0x0E
+#define IIR_MODEM_STATUS 0x00
+#define IIR_TX_EMPTY 0x02
+#define IIR_RX_DATA 0x04
+#define IIR_LINE_STATUS 0x06
+#define IIR_RX_TIMEOUT 0x0C
+#define SCRATCH_PATTERN 0x5A
+
+/* Divisor of the 115200 bauds base clock */
+#define BAUD_DIVISOR 1
+
+/* Number of bytes the transmit FIFO holds */
+#define UART_FIFO_SIZE 16
+
+/* Size of the transmit ring, must be a power of two */
+#define TX_RING_SIZE 8192
+
+/* Maximum number of bytes of the caller's buffer copied to the ring with
+ * interrupts disabled */
+#define TX_CHUNK 64
+
+/* Maximum number of bytes a character takes in the ring once cooked */
+#define TX_MAX_COOKED 3
+
+/* Terminal characters */
+#define NEWLINE '\n'
+#define CARRIAGE_RETURN '\r'
+#define BACKSPACE '\b'
+#define DELETE 0x7F
+#define SPACE ' '
+
+/** @brief State of the serial port driver */
+typedef struct serial_state {
+
+  /** @brief Whether a UART was found on COM1 */
+  int present;
+
+  /** @brief Whether the UART is sending bytes, in which case the interrupt
+   *   handler refills its FIFO */
+  int tx_busy;
+
+  /** @brief Number of bytes sent to the UART since boot */
+  unsigned int tx_head;
+
+  /** @brief Number of bytes written to the ring since boot */
+  unsigned int tx_tail;
+
+  /** @brief Bytes waiting to be sent */
+  char tx_ring[TX_RING_SIZE];
+
+  /** @brief Threads waiting for room in the transmit ring, protected by
+   *   disabling interrupts */
+  tcb_queue_t tx_waiters;
+
+  /** @brief Bytes received, waiting for the bottom half */
+  byte_queue_t rx;
+
+  /** @brief Deferred work handing received bytes to the keyboard driver */
+  softirq_t rx_work;
+
+} serial_state_t;
+
+/* Serial port state */
+static serial_state_t serial;
+
+/* Static functions prototypes */
+static void serial_bottom_half(void);
+static void fill_fifo(void);
+static void send_polled(void);
+static unsigned int tx_room(void);
+static void put_cooked(char ch);
+static void put_raw(char ch);
+
+/** @brief Initializes the serial port and registers its interrupt handler
+ *
+ *   If there is no UART on COM1, the driver stays disabled and output
+ *   written to it is dropped.
+ *
+ *   @param void
+ *
+ *   @return A negative error code on error, or 0 on success
+ **/
+int serial_init(void) {
+
+  serial.present = 0;
+  serial.tx_busy = 0;
+  serial.tx_head = 0;
+  serial.tx_tail = 0;
+  Q_INIT_HEAD(&serial.tx_waiters);
+  serial.rx.front = 0;
+  serial.rx.rear = 0;
+  softirq_init(&serial.rx_work, serial_bottom_half);
+
+  // Check that there is a UART behind the port
+  if (inb(COM1_PORT + UART_LSR) == LSR_ABSENT) {
+    return 0;
+  }
+  outb(COM1_PORT + UART_SCR, SCRATCH_PATTERN);
+  if (inb(COM1_PORT + UART_SCR) != SCRATCH_PATTERN) {
+    return 0;
+  }
+
+  if (register_handler((uintptr_t)serial_interrupt_handler, TRAP_GATE,
+                       COM1_IDT_ENTRY, KERNEL_PRIVILEGE_LEVEL,
+                       SEGSEL_KERNEL_CS) < 0) {
+    return -1;
+  }
+
+  // Program the line: 115200 bauds, 8N1, FIFOs enabled and cleared
+  outb(COM1_PORT + UART_IER, 0);
+  outb(COM1_PORT + UART_LCR, LCR_DLAB);
+  outb(COM1_PORT + UART_DLL, BAUD_DIVISOR);
+  outb(COM1_PORT + UART_DLM, 0);
+  outb(COM1_PORT + UART_LCR, LCR_8N1);
+  outb(COM1_PORT + UART_FCR, FCR_ENABLE_CLEAR_14);
+
+  // OUT2 routes the UART's interrupt line to the PIC
+  outb(COM1_PORT + UART_MCR, MCR_DTR_RTS_OUT2);
+  outb(COM1_PORT + UART_IER, IER_RX_DATA | IER_TX_EMPTY);
+
+  serial.present = 1;
+  return 0;
+}
+
+/** @brief Indicates whether a UART was found on COM1
+ *
+ *   @param void
+ *
+ *   @return A non-zero value if the serial port can be used, 0 otherwise
+ **/
+int serial_present(void) {
+  return serial.present;
+}
+
+/** @brief The serial port's C interrupt handler function
+ *
+ *   Handles every condition pending in the UART: received bytes are stored
+ *   for the bottom half, and the transmit FIFO is refilled from the ring when
+ *   it is empty, waking up the threads waiting for room in the ring. The ring
+ *   is shared with serial_write(), so interrupts are disabled while the
+ *   handler runs.
+ *
+ *   @param void
+ *
+ *   @return void
+ **/
+void serial_c_handler(void) {
+
+  irq_disable();
+
+  int received = 0;
+  tcb_t *waiter;
+  uint8_t iir;
+  while (!((iir = inb(COM1_PORT + UART_IIR)) & IIR_NO_INTERRUPT)) {
+    switch (iir & IIR_ID_MASK) {
+      case IIR_RX_DATA:
+      case IIR_RX_TIMEOUT:
+        while (inb(COM1_PORT + UART_LSR) & LSR_DATA_READY) {
+          enqueue(&serial.rx, inb(COM1_PORT + UART_DATA));
+          received = 1;
+        }
+        break;
+      case IIR_TX_EMPTY:
+        fill_fifo();
+        while ((waiter = Q_GET_FRONT(&serial.tx_waiters)) != NULL) {
+          Q_REMOVE(&serial.tx_waiters, waiter, wait_link);
+          add_runnable_thread_noint(waiter);
+        }
+        break;
+      case IIR_LINE_STATUS:
+        inb(COM1_PORT + UART_LSR);
+        break;
+      case IIR_MODEM_STATUS:
+        inb(COM1_PORT + UART_MSR);
+        break;
+    }
+  }
+
+  // Acknowledge the PIC
+  outb(INT_CTL_PORT, INT_ACK_CURRENT);
+
+  irq_enable();
+
+  if (received) {
+    softirq_raise(&serial.rx_work);
+    softirq_run();
+
+    // Honor a timer tick that arrived while bottom halves were running
+    if (!softirq_is_running()) {
+      preempt_point();
+    }
+  }
+}
+
+/** @brief Writes bytes to the serial port
+ *
+ *   The bytes are queued in the transmit ring and sent by the interrupt
+ *   handler. When the ring is full, the invoking thread blocks until the
+ *   transmit interrupt makes room, unless it can not block. May be called
+ *   with interrupts disabled.
+ *
+ *   @param buf The bytes to write
+ *   @param len The number of bytes
+ *
+ *   @return void
+ **/
+void serial_write(const char *buf, int len) {
+
+  if (!serial.present) {
+    return;
+  }
+
+  int can_block = (get_eflags() & EFL_IF) && !softirq_is_running() &&
+                  kernel.kernel_ready == KERNEL_READY_TRUE;
+
+  int i = 0;
+  while (i < len) {
+
+    int enabled = save_and_disable_interrupts();
+
+    int end = (len - i > TX_CHUNK) ? i + TX_CHUNK : len;
+    while (i < end && tx_room() >= TX_MAX_COOKED) {
+      put_cooked(buf[i++]);
+    }
+
+    // Start the transmitter if it is idle, the interrupt handler takes over
+    if (!serial.tx_busy) {
+      fill_fifo();
+    }
+
+    if (i < end) {
+      if (can_block) {
+        // Interrupts are enabled after the context switch
+        Q_INSERT_TAIL(&serial.tx_waiters, kernel.current_thread, wait_link);
+        block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+        continue;
+      }
+      send_polled();
+    }
+
+    restore_interrupts(enabled);
+  }
+}
+
+/** @brief Sends everything in the transmit ring by polling the UART
+ *
+ *   Meant for panic(), when interrupts are disabled for good.
+ *
+ *   @param void
+ *
+ *   @return void
+ **/
+void serial_drain_polled(void) {
+  while (serial.present && serial.tx_head != serial.tx_tail) {
+    send_polled();
+  }
+}
+
+/** @brief The serial port's bottom half
+ *
+ *   Hands the received bytes to the keyboard driver, translating what
+ *   terminals send for the enter and backspace keys.
+ *
+ *   @param void
+ *
+ *   @return void
+ **/
+static void serial_bottom_half(void) {
+  char chars[UART_FIFO_SIZE];
+  int len = 0;
+  int ch;
+
+  while ((ch = dequeue(&serial.rx)) >= 0) {
+    if (ch == CARRIAGE_RETURN) {
+      ch = NEWLINE;
+    } else if (ch == DELETE) {
+      ch = BACKSPACE;
+    }
+    chars[len++] = ch;
+
+    if (len == UART_FIFO_SIZE) {
+      keyboard_input(chars, len);
+      len = 0;
+    }
+  }
+
+  keyboard_input(chars, len);
+}
+
+/** @brief Moves bytes from the transmit ring to the UART's FIFO
+ *
+ *   Must be called with interrupts disabled, when the FIFO is empty.
+ *
+ *   @param void
+ *
+ *   @return void
+ **/
+static void fill_fifo(void) {
+  int n = 0;
+  while (n < UART_FIFO_SIZE && serial.tx_head != serial.tx_tail) {
+    outb(COM1_PORT + UART_DATA,
+         serial.tx_ring[serial.tx_head % TX_RING_SIZE]);
+    ++serial.tx_head;
+    ++n;
+  }
+
+  // A transmit interrupt follows only if something was sent
+  serial.tx_busy = (n > 0);
+}
+
+/** @brief Waits for the UART's FIFO to be empty by polling it, then refills
+ *   it from the transmit ring
+ *
+ *   Must be called with interrupts disabled, by writers that can not wait
+ *   for the transmit interrupt.
+ *
+ *   @param void
+ *
+ *   @return void
+ **/
+static void send_polled(void) {
+  while (!(inb(COM1_PORT + UART_LSR) & LSR_TX_EMPTY)) {
+    continue;
+  }
+  fill_fifo();
+}
+
+/** @brief Gets the number of free bytes in the transmit ring
+ *
+ *   @param void
+ *
+ *   @return The number of bytes that can be appended to the ring
+ **/
+static unsigned int tx_room(void) {
+  return TX_RING_SIZE - (serial.tx_tail - serial.tx_head);
+}
+
+/** @brief Appends a character to the transmit ring, cooked for terminals
+ *
+ *   Must be called with interrupts disabled, with at least TX_MAX_COOKED
+ *   free bytes in the ring.
+ *
+ *   @param ch The character
+ *
+ *   @return void
+ **/
+static void put_cooked(char ch) {
+  if (ch == NEWLINE) {
+    put_raw(CARRIAGE_RETURN);
+    put_raw(NEWLINE);
+  } else if (ch == BACKSPACE) {
+    put_raw(BACKSPACE);
+    put_raw(SPACE);
+    put_raw(BACKSPACE);
+  } else {
+    put_raw(ch);
+  }
+}
+
+/** @brief Appends a byte to the transmit ring
+ *
+ *   Must be called with interrupts disabled, when the ring is not full.
+ *
+ *   @param ch The byte
+ *
+ *   @return void
+ **/
+static void put_raw(char ch) {
+  serial.tx_ring[serial.tx_tail % TX_RING_SIZE] = ch;
+  ++serial.tx_tail;
+}
@@ -0,0 +1,13 @@
+/** @file serial_asm.h
+ *  @brief The file which contains the definition of the handler of the 
+ *   serial port interrupt
+ *
+ *  @author akanjani, lramire1
+ */
+
+#ifndef __SERIAL_ASM_H_
+#define __SERIAL_ASM_H_
+
+void serial_interrupt_handler();
+
+#endif
@@ -2,7 +2,8 @@
  *  @brief Implementation of the functions required for the timer interrupt
  *
  *   This file contains the implementation of the c interrupt handler and
- *   initializing function for the time interrupt.
+ *   initializing function for the time interrupt. The tick callback is not
+ *   run by the interrupt handler but by a bottom half (see softirq.h).
  *
  *  @author akanjani, lramire1
  */
@@ -19,6 +20,8 @@
 #include <interrupts.h>
 #include "prechecks.h"
 #include <scheduler.h>
+#include <softirq.h>
+#include <irq_trace.h>
 
 #define REQUIRED_FREQUENCY 0.01
 #define ONE_LSB_MASK 0xFF
@@ -29,15 +32,21 @@
 typedef struct timer_state {
 	void ( *global_callback ) ( unsigned int );
 	unsigned int global_counter;
+	unsigned int pending_ticks;
+	softirq_t tick_work;
 } timer_state_t;
 
 timer_state_t timer_state_;
 
+static void timer_bottom_half( void );
+
 /** @brief The function called by the interrupt handler for the timer interrupt
  *
  *   The handler for timer interrupts, timer_interrupt_handler defined in
  *   timer_asm.h calls this function after storing the current context on
- *   stack.
+ *   stack. The handler runs with interrupts disabled, so it only counts the
+ *   tick and defers the callback to the bottom half. The current thread is
+ *   not preempted if it was itself running bottom halves.
  *
  *  @param void
  *
@@ -45,16 +54,56 @@ timer_state_t timer_state_;
  **/
 void timer_c_handler()
 {
+	irq_trace_start( (void *)timer_c_handler );
+
 	// update the tick count
 	timer_state_.global_counter++;
+	timer_state_.pending_ticks++;
 
-	// call the callback function
-	timer_state_.global_callback( timer_state_.global_counter );
+	// call the callback function later
+	softirq_raise( &timer_state_.tick_work );
 
 	// acknowledge the most recent interrupt to the PIC
 	outb( INT_CTL_PORT, INT_ACK_CURRENT );
 
-	make_runnable_and_switch();
+	int nested = softirq_is_running();
+
+	irq_trace_stop( (void *)timer_c_handler );
+
+	softirq_run();
+
+	if ( !nested ) {
+		make_runnable_and_switch();
+	} else {
+		// let the thread running the bottom halves switch once it is done
+		request_resched();
+	}
+}
+
+/** @brief The timer's bottom half
+ *
+ *   Calls the callback function once for each tick received since the last
+ *   time the bottom half ran. The callback is called with interrupts
+ *   enabled, it must protect the state it shares with threads by itself
+ *   (bottom halves never run concurrently with each other).
+ *
+ *  @param void
+ *
+ *  @return void
+ **/
+static void timer_bottom_half( void )
+{
+	// Read the counter and the pending ticks without a tick in between
+	irq_disable();
+	unsigned int ticks = timer_state_.pending_ticks;
+	unsigned int last = timer_state_.global_counter;
+	timer_state_.pending_ticks = 0;
+	irq_enable();
+
+	unsigned int i;
+	for ( i = 0; i < ticks; ++i ) {
+		timer_state_.global_callback( last - ticks + 1 + i );
+	}
 }
 
 /**	@brief Get the total number of ticks since the kernel booted
@@ -105,6 +154,8 @@ int timer_init( void ( *tickback )( unsigned int ) )
 	// Initialize the timer state
 	timer_state_.global_counter = TICK_COUNT_START_VALUE;
 	timer_state_.global_callback = tickback;
+	timer_state_.pending_ticks = 0;
+	softirq_init( &timer_state_.tick_work, timer_bottom_half );
 
 	return 0;
 }
@@ -1,5 +1,13 @@
 /** @file mutex.c
  *  @brief This file contains the definitions for mutex_type.h functions
+ *
+ *  Waiters are queued by decreasing weight, so that the heaviest thread gets
+ *  the mutex first. While a mutex is contended, the task of its owner runs
+ *  with the tickets of the waiters belonging to other tasks in addition to
+ *  its own (priority inheritance through ticket transfer). The tickets are
+ *  taken back when the mutex is released and lent to the next owner. Lent
+ *  tickets are not forwarded if the owner is itself blocked on another mutex.
+ *
  *  @author akanjani, lramire1
  */
 
@@ -11,9 +19,15 @@
 #include <syscalls.h>
 #include <eff_mutex.h>
 #include <asm.h>
+#include <irq_trace.h>
 #include <kernel_state.h>
 #include <stddef.h>
 #include <scheduler.h>
+#include <tcb.h>
+
+/* Static functions prototypes */
+static void enqueue_by_weight(tcb_queue_t *queue, tcb_t *tcb);
+static int lends_to(tcb_t *waiter, tcb_t *owner);
 
 /** @brief  Initializes an eff_mutex
  *
@@ -31,10 +45,11 @@ int eff_mutex_init(eff_mutex_t *mp) {
     return -1;
   }
 
-  stack_queue_init(&mp->mutex_queue);
+  Q_INIT_HEAD(&mp->mutex_queue);
 
   mp->state = MUTEX_UNLOCKED;
-  mp->owner = -1;
+  mp->owner = NULL;
+  mp->donated = 0;
   return 0;
 }
 
@@ -53,17 +68,17 @@ void eff_mutex_destroy(eff_mutex_t *mp) {
   // Check argument
   assert(mp != NULL);
 
-  disable_interrupts();
-  assert(is_stack_queue_empty(&mp->mutex_queue));
-  stack_queue_destroy(&mp->mutex_queue);
-  enable_interrupts();
+  irq_disable();
+  assert(Q_GET_FRONT(&mp->mutex_queue) == NULL);
+  irq_enable();
 
 }
 
 /** @brief  Acquires the lock on an eff_mutex
  *
  *  If another thread is already holding this mutex, the invoking thread's is
- *  descheduled until the mutex is available for it.
+ *  descheduled until the mutex is available for it. Meanwhile, the owner's
+ *  task borrows the invoking thread's tickets.
  *
  *  @param  mp  A pointer to an eff_mutex
  *
@@ -77,25 +92,33 @@ void eff_mutex_lock(eff_mutex_t *mp) {
 
   // Validate parameter and the fact that the mutex is initialized
   assert(mp != NULL);
-  disable_interrupts();
+  irq_disable();
   if (mp->state == MUTEX_LOCKED) {
-    generic_node_t tmp;
-    tmp.value = (void *)kernel.current_thread;
-    tmp.next = NULL;
-    stack_queue_enqueue(&mp->mutex_queue, &tmp);
+    tcb_t *me = kernel.current_thread;
+    me->mutex_weight = thread_weight(me);
+    enqueue_by_weight(&mp->mutex_queue, me);
+
+    // Lend our tickets to the owner
+    if (lends_to(me, mp->owner)) {
+      mp->donated += me->mutex_weight;
+      donate_weight(mp->owner->task, me->mutex_weight);
+    }
+
     // This call will enable interrupts
     block_and_switch(HOLDING_MUTEX_FALSE, NULL);
   }
   mp->state = MUTEX_LOCKED;
-  mp->owner = kernel.current_thread->tid;
-  enable_interrupts();
+  mp->owner = kernel.current_thread;
+  irq_enable();
 }
 
 /** @brief  Releases the lock on the mutex
  *
- *  The function wakes up the next thread in the queue(if any) before returning
- *  so that another thread may take the mutex. The invoking thread should be
- *  holding this mutex before calling the function.
+ *  The function wakes up the heaviest thread in the queue (if any) before
+ *  returning so that another thread may take the mutex. Tickets lent to the
+ *  invoking thread's task are taken back, and the remaining waiters lend
+ *  theirs to the new owner. The invoking thread should be holding this mutex
+ *  before calling the function.
  *
  *  @param  mp  A pointer to an eff_mutex
  *
@@ -106,14 +129,73 @@ void eff_mutex_unlock(eff_mutex_t *mp) {
     return;
   }
   assert(mp != NULL);
-  disable_interrupts();
-  generic_node_t *tmp = stack_queue_dequeue(&mp->mutex_queue);
-  if (tmp) {
-    add_runnable_thread_noint((tcb_t*)tmp->value);
-    mp->owner = ((tcb_t*)tmp->value)->tid;
+  irq_disable();
+
+  // Take back the tickets lent to us
+  if (mp->donated > 0) {
+    donate_weight(mp->owner->task, -(int)mp->donated);
+    mp->donated = 0;
+  }
+
+  tcb_t *next_owner = Q_GET_FRONT(&mp->mutex_queue);
+  if (next_owner != NULL) {
+    Q_REMOVE(&mp->mutex_queue, next_owner, wait_link);
+    mp->owner = next_owner;
+
+    // The remaining waiters now lend their tickets to the new owner
+    tcb_t *waiter;
+    Q_FOREACH(waiter, &mp->mutex_queue, wait_link) {
+      if (lends_to(waiter, next_owner)) {
+        mp->donated += waiter->mutex_weight;
+      }
+    }
+    if (mp->donated > 0) {
+      donate_weight(next_owner->task, mp->donated);
+    }
+
+    add_runnable_thread_noint(next_owner);
   } else {
-    mp->owner = -1;
+    mp->owner = NULL;
     mp->state = MUTEX_UNLOCKED;
   }
-  enable_interrupts();
+  irq_enable();
+}
+
+/** @brief  Inserts a waiter in a mutex's queue, after all waiters at least as
+ *          heavy as itself
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @param  queue   The mutex's queue
+ *  @param  tcb     The waiting thread, its mutex_weight must be set
+ *
+ *  @return void
+ */
+static void enqueue_by_weight(tcb_queue_t *queue, tcb_t *tcb) {
+
+  tcb_t *curr;
+  Q_FOREACH(curr, queue, wait_link) {
+    if (curr->mutex_weight < tcb->mutex_weight) {
+      Q_INSERT_BEFORE(queue, curr, tcb, wait_link);
+      return;
+    }
+  }
+
+  Q_INSERT_TAIL(queue, tcb, wait_link);
+}
+
+/** @brief  Indicates whether a waiting thread lends its tickets to the owner
+ *          of the mutex it waits on
+ *
+ *  Tickets are only lent across tasks, so that a task does not gain weight
+ *  from contention between its own threads. Kernel threads run first
+ *  and do not need to borrow tickets.
+ *
+ *  @param  waiter  The waiting thread
+ *  @param  owner   The mutex's owner
+ *
+ *  @return 1 if the waiter lends its tickets, 0 otherwise
+ */
+static int lends_to(tcb_t *waiter, tcb_t *owner) {
+  return owner != NULL && owner->task != NULL && waiter->task != owner->task;
 }
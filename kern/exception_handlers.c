@@ -14,6 +14,7 @@
 #include <kernel_state.h>
 #include "exception_handlers_asm.h"
 #include <cr.h>
+#include <fpu.h>
 
 /** @brief  Registers all the exception handlers in the IDT
  *
@@ -151,13 +152,22 @@ void opcode_c_handler(char *stack_ptr) {
 }
 
 /** @brief  Exception handler for nofpu exception
+ *
+ *  The exception is raised by the first FPU/SSE instruction a thread executes
+ *  after a context switch. The thread's FPU state is loaded and the 
+ *  instruction is restarted. The exception is only fatal if the thread's FPU
+ *  save area can not be allocated.
+ *
  *  @param  stack_ptr   The address on the invoking thread's kernel stack where
  *                      we should start constructing the stack for executing 
  *                      the potential user-registered handler 
- *  @return Does not return
+ *  @return void once the FPU holds the thread's state, does not return 
+ *          otherwise
  */
 void nofpu_c_handler(char *stack_ptr) {
-  generic_exception_handler(SWEXN_CAUSE_NOFPU, stack_ptr);
+  if (fpu_handle_nofpu() < 0) {
+    generic_exception_handler(SWEXN_CAUSE_NOFPU, stack_ptr);
+  }
 }
 
 /** @brief  Exception handler for segfault exception
@@ -0,0 +1,184 @@
+/** @file fpu.c
+ *  @brief  This file contains the definitions for functions related to lazy
+ *          FPU/SSE context switching
+ *
+ *  The FPU/SSE registers are not saved by context_switch(). Instead, the
+ *  kernel remembers which thread's state is currently loaded in the FPU (the
+ *  FPU owner) and sets the Task Switched flag in %cr0 whenever it switches to
+ *  any other thread. The first FPU/SSE instruction executed by that thread
+ *  raises a #NM exception, at which point the owner's state is saved in its
+ *  TCB and the invoking thread's state is restored. Threads that never use
+ *  the FPU never pay for a save/restore.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <fpu.h>
+#include <fpu_asm.h>
+#include <kernel_state.h>
+#include <malloc.h>
+#include <string.h>
+#include <stdint.h>
+#include <asm.h>
+#include <irq_trace.h>
+#include <cr.h>
+
+/* Default values for the x87 control word and the MXCSR register */
+#define FPU_DEFAULT_FCW 0x037F
+#define FPU_DEFAULT_MXCSR 0x1F80
+
+/* Offset of the MXCSR register in an fxsave area */
+#define FPU_MXCSR_OFFSET 24
+
+/* Static functions prototypes */
+static void *fpu_create_state();
+
+/** @brief  Enables the FPU and the SSE extensions
+ *
+ *  The FPU is marked as present (no emulation) and the OS is marked as 
+ *  supporting fxsave/fxrstor and unmasked SIMD exceptions. Since no thread
+ *  owns the FPU yet, the Task Switched flag is set.
+ *
+ *  @return void
+ */
+void fpu_init() {
+  kernel.fpu_owner = NULL;
+  set_cr0((get_cr0() & ~CR0_EM) | CR0_MP | CR0_TS);
+  set_cr4(get_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+}
+
+/** @brief  Sets or clears the Task Switched flag for the thread we are 
+ *          switching to
+ *
+ *  The function must be called with interrupts disabled.
+ *
+ *  @param  to  The TCB of the thread that is about to run
+ *
+ *  @return void
+ */
+void fpu_update_ts(tcb_t *to) {
+  if (to == kernel.fpu_owner) {
+    // The FPU already holds this thread's state
+    fpu_clear_ts_asm();
+  } else {
+    set_cr0(get_cr0() | CR0_TS);
+  }
+}
+
+/** @brief  Gives the FPU to the invoking thread after a #NM exception
+ *
+ *  The save area is allocated the first time a thread uses the FPU. The
+ *  previous owner's state (if any) is saved before the invoking thread's
+ *  state is loaded.
+ *
+ *  @return 0 on success, a negative number if the save area could not be
+ *          allocated
+ */
+int fpu_handle_nofpu() {
+
+  tcb_t *me = kernel.current_thread;
+
+  // First use of the FPU by this thread, allocate its save area
+  if (me->fpu_state == NULL) {
+    me->fpu_state = fpu_create_state();
+    if (me->fpu_state == NULL) {
+      return -1;
+    }
+  }
+
+  irq_disable();
+
+  fpu_clear_ts_asm();
+  if (kernel.fpu_owner != me) {
+    if (kernel.fpu_owner != NULL) {
+      fpu_save_asm(kernel.fpu_owner->fpu_state);
+    }
+    fpu_restore_asm(me->fpu_state);
+    kernel.fpu_owner = me;
+  }
+
+  irq_enable();
+
+  return 0;
+}
+
+/** @brief  Gives a thread a copy of another thread's FPU/SSE state
+ *
+ *  Used by fork() so that the child task starts with the same FPU state as
+ *  its parent. Nothing is done if the original thread never used the FPU.
+ *
+ *  @param  from  The thread whose state is copied (the invoking thread)
+ *  @param  to    The thread receiving the copy (must not own the FPU)
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int fpu_copy_state(tcb_t *from, tcb_t *to) {
+
+  if (from->fpu_state == NULL) {
+    return 0;
+  }
+
+  void *area = smemalign(FPU_STATE_ALIGN, FPU_STATE_SIZE);
+  if (area == NULL) {
+    return -1;
+  }
+
+  // Flush the live registers to the save area if they belong to us
+  irq_disable();
+  if (kernel.fpu_owner == from) {
+    fpu_save_asm(from->fpu_state);
+  }
+  irq_enable();
+
+  memcpy(area, from->fpu_state, FPU_STATE_SIZE);
+  to->fpu_state = area;
+
+  return 0;
+}
+
+/** @brief  Releases the FPU/SSE state of a thread
+ *
+ *  Used when a thread vanishes or calls exec(). If the thread is the invoking
+ *  thread, the Task Switched flag is set again so that its next use of the FPU
+ *  starts from a fresh state.
+ *
+ *  @param  tcb The thread whose state is released
+ *
+ *  @return void
+ */
+void fpu_release(tcb_t *tcb) {
+
+  irq_disable();
+  if (kernel.fpu_owner == tcb) {
+    kernel.fpu_owner = NULL;
+  }
+  if (tcb == kernel.current_thread) {
+    set_cr0(get_cr0() | CR0_TS);
+  }
+  irq_enable();
+
+  if (tcb->fpu_state != NULL) {
+    sfree(tcb->fpu_state, FPU_STATE_SIZE);
+    tcb->fpu_state = NULL;
+  }
+}
+
+/** @brief  Allocates and initializes a save area with the default FPU/SSE 
+ *          state
+ *
+ *  @return The new save area on success, NULL otherwise
+ */
+static void *fpu_create_state() {
+
+  void *area = smemalign(FPU_STATE_ALIGN, FPU_STATE_SIZE);
+  if (area == NULL) {
+    return NULL;
+  }
+
+  // All registers empty, exceptions masked (state after fninit)
+  memset(area, 0, FPU_STATE_SIZE);
+  *(uint16_t *)area = FPU_DEFAULT_FCW;
+  *(uint32_t *)((char *)area + FPU_MXCSR_OFFSET) = FPU_DEFAULT_MXCSR;
+
+  return area;
+}
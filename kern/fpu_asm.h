@@ -0,0 +1,33 @@
+/** @file fpu_asm.h
+ *  @brief  This file contains the declarations for assembly functions used to
+ *          save and restore the FPU/SSE state of threads
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _FPU_ASM_H_
+#define _FPU_ASM_H_
+
+/** @brief  Saves the current FPU/SSE state using fxsave
+ *
+ *  @param  area  A 16-bytes aligned, FPU_STATE_SIZE bytes long save area
+ *
+ *  @return void
+ */
+void fpu_save_asm(void *area);
+
+/** @brief  Restores the FPU/SSE state using fxrstor
+ *
+ *  @param  area  A 16-bytes aligned save area previously filled by 
+ *                fpu_save_asm()
+ *
+ *  @return void
+ */
+void fpu_restore_asm(void *area);
+
+/** @brief  Clears the Task Switched flag in %cr0 (clts)
+ *
+ *  @return void
+ */
+void fpu_clear_ts_asm(void);
+
+#endif /* _FPU_ASM_H_ */
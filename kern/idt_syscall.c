@@ -40,7 +40,18 @@ int idt_syscall_install() {
                           (uintptr_t)sleep, (uintptr_t)set_status,
                           (uintptr_t)get_ticks, (uintptr_t)halt,
                           (uintptr_t)readfile, (uintptr_t)set_term_color,
-                          (uintptr_t)set_cursor_pos, (uintptr_t)get_cursor_pos
+                          (uintptr_t)set_cursor_pos, (uintptr_t)get_cursor_pos,
+                          (uintptr_t)set_weight, (uintptr_t)get_irq_trace,
+                          (uintptr_t)shm_create, (uintptr_t)shm_attach,
+                          (uintptr_t)shm_detach, (uintptr_t)mq_create,
+                          (uintptr_t)mq_destroy, (uintptr_t)mq_send,
+                          (uintptr_t)mq_recv, (uintptr_t)make_runnable_many,
+                          (uintptr_t)getchar, (uintptr_t)open,
+                          (uintptr_t)read, (uintptr_t)write,
+                          (uintptr_t)close, (uintptr_t)unlink,
+                          (uintptr_t)fmap, (uintptr_t)get_swap_stats,
+                          (uintptr_t)ring_setup, (uintptr_t)ring_enter,
+                          (uintptr_t)wait_any
                           };
 
   // List of offsets in the IDT corresponding to syscalls
@@ -50,7 +61,14 @@ int idt_syscall_install() {
                             PRINT_INT, SWEXN_INT, VANISH_INT, WAIT_INT, 
                             SLEEP_INT, SET_STATUS_INT, GET_TICKS_INT, HALT_INT,
                             READFILE_INT, SET_TERM_COLOR_INT, 
-                            SET_CURSOR_POS_INT, GET_CURSOR_POS_INT
+                            SET_CURSOR_POS_INT, GET_CURSOR_POS_INT,
+                            SET_WEIGHT_INT, GET_IRQ_TRACE_INT,
+                            SHM_CREATE_INT, SHM_ATTACH_INT, SHM_DETACH_INT,
+                            MQ_CREATE_INT, MQ_DESTROY_INT, MQ_SEND_INT,
+                            MQ_RECV_INT, MAKE_RUNNABLE_MANY_INT, GETCHAR_INT,
+                            OPEN_INT, READ_INT, WRITE_INT, CLOSE_INT,
+                            UNLINK_INT, FMAP_INT, GET_SWAP_STATS_INT,
+                            RING_SETUP_INT, RING_ENTER_INT, WAIT_ANY_INT
                             };
 
   int nb_syscalls = sizeof(syscalls) / sizeof(uintptr_t);
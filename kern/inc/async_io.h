@@ -0,0 +1,22 @@
+/** @file async_io.h
+ *  @brief  This file contains the declarations for the asynchronous system
+ *          call rings set up by ring_setup()
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _ASYNC_IO_H_
+#define _ASYNC_IO_H_
+
+#include <pcb.h>
+#include <tcb.h>
+
+/* Number of worker threads executing the requests of a ring */
+#define ASYNC_IO_WORKERS 4
+
+void async_io_fork(pcb_t *parent, unsigned int *child_cr3);
+void async_io_release(pcb_t *task);
+int async_io_is_closing(tcb_t *tcb);
+int async_io_busy(pcb_t *task);
+void async_io_tick(unsigned int ticks);
+
+#endif /* _ASYNC_IO_H_ */
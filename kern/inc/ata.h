@@ -0,0 +1,31 @@
+/** @file ata.h
+ *  @brief The file which contains the declarations of the functions of the
+ *   IDE/ATA disk driver
+ *
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _ATA_H_
+#define _ATA_H_
+
+/* Drives of the primary channel */
+#define ATA_MASTER 0
+#define ATA_SLAVE 1
+#define ATA_NB_DRIVES 2
+
+/* Size of the blocks transferred by the driver */
+#define ATA_BLOCK_SIZE 4096
+
+/* Maximum number of blocks transferred by one command */
+#define ATA_MAX_BLOCKS 32
+
+int ata_init(void);
+int ata_present(int drive);
+unsigned int ata_nb_blocks(int drive);
+int ata_read_blocks(int drive, unsigned int block, char **bufs,
+                    int nb_blocks);
+int ata_write_blocks(int drive, unsigned int block, char **bufs,
+                     int nb_blocks);
+void ata_c_handler(void);
+
+#endif /* _ATA_H_ */
@@ -0,0 +1,52 @@
+/** @file bcache.h
+ *  @brief  This file contains the declarations for the buffer cache, which
+ *          keeps recently used disk blocks in memory
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _BCACHE_H_
+#define _BCACHE_H_
+
+#include <variable_queue.h>
+
+/** @brief  A disk block held in memory */
+typedef struct bcache_buf {
+
+  /** @brief  The drive the block belongs to */
+  int drive;
+
+  /** @brief  The block's number on the drive */
+  unsigned int block;
+
+  /** @brief  The block's content, ATA_BLOCK_SIZE page-aligned bytes */
+  char *data;
+
+  /** @brief  Whether data holds the block's content */
+  int valid;
+
+  /** @brief  Whether data was modified since it was read or written back */
+  int dirty;
+
+  /** @brief  Number of users of the buffer, which may not be evicted while
+   *          it is referenced */
+  int refcount;
+
+  /** @brief  Next buffer in the cache's hash bucket */
+  struct bcache_buf *hash_next;
+
+  /** @brief  Link in the LRU list, least recently used first */
+  Q_NEW_LINK(bcache_buf) lru_link;
+
+} bcache_buf_t;
+
+int bcache_init(void);
+bcache_buf_t *bcache_get(int drive, unsigned int block);
+void bcache_release(bcache_buf_t *buf);
+void bcache_mark_dirty(bcache_buf_t *buf);
+int bcache_sync(int drive);
+
+/* Byte ranges of a drive, as seen by the filesystem's device files */
+int bcache_read(int drive, unsigned int offset, char *buf, int count);
+int bcache_write(int drive, unsigned int offset, char *buf, int count);
+
+#endif /* _BCACHE_H_ */
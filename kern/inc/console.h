@@ -13,6 +13,10 @@
 
 #include <video_defines.h>
 
+/* Outputs of putbyte() and putbytes(), see console_set_outputs() */
+#define CONSOLE_OUTPUT_VGA 1
+#define CONSOLE_OUTPUT_SERIAL 2
+
 /** @brief Prints character ch at the current location
  *         of the cursor.
  *
@@ -144,6 +148,15 @@ char get_char(int row, int col);
  */
 void console_init();
 
+/** @brief Selects where the output of putbyte() and putbytes() goes.
+ *
+ *  @param outputs A combination of CONSOLE_OUTPUT_VGA and
+ *         CONSOLE_OUTPUT_SERIAL.
+ *  @return 0 on success or integer error code less than 0 if
+ *          outputs selects no valid output.
+ */
+int console_set_outputs(int outputs);
+
 /** @brief Scrolls up the whole screen by a row
  *  @return void
  */
@@ -0,0 +1,16 @@
+/** @file console_ring.h
+ *  @brief  This file contains the declarations for the console output ring,
+ *          which lets print() return before its output is rendered
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _CONSOLE_RING_H_
+#define _CONSOLE_RING_H_
+
+int console_ring_init(void);
+int console_ring_create_thread(void);
+void console_ring_write(const char *buf, int len);
+void console_ring_flush(void);
+void console_ring_flush_panic(void);
+
+#endif /* _CONSOLE_RING_H_ */
@@ -9,19 +9,27 @@
 #define MUTEX_LOCKED 1
 #define MUTEX_UNLOCKED 0
 
-#include <stack_queue.h>
+#include <task_queues.h>
+#include <stdint.h>
 
-/** @brief A mutex implementation using a waiting queue */
+struct tcb;
+
+/** @brief A mutex implementation using a waiting queue ordered by weight,
+ *         with priority inheritance */
 typedef struct eff_mutex {
   
-  /** @brief A waiting queue for threads waiting for the mutex to be unlocked */
-  stack_queue_t mutex_queue;
+  /** @brief A waiting queue for threads waiting for the mutex to be unlocked,
+   *  heaviest thread first (FIFO among threads of equal weight) */
+  tcb_queue_t mutex_queue;
 
   /** @brief The mutex's state, either MUTEX_LOCKED or MUTEX_UNLOCKED */
   int state;
 
-  /** @brief The tid of the mutex's owner */
-  int owner;
+  /** @brief The mutex's owner, NULL if the mutex is unlocked */
+  struct tcb *owner;
+
+  /** @brief Number of tickets lent to the owner's task by the waiters */
+  uint32_t donated;
 
 } eff_mutex_t; 
 
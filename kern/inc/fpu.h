@@ -0,0 +1,22 @@
+/** @file fpu.h
+ *  @brief  This file contains the declarations for functions related to lazy
+ *          FPU/SSE context switching
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _FPU_H_
+#define _FPU_H_
+
+#include <tcb.h>
+
+/* Size and alignment of an fxsave area */
+#define FPU_STATE_SIZE 512
+#define FPU_STATE_ALIGN 16
+
+void fpu_init();
+void fpu_update_ts(tcb_t *to);
+int fpu_handle_nofpu();
+int fpu_copy_state(tcb_t *from, tcb_t *to);
+void fpu_release(tcb_t *tcb);
+
+#endif /* _FPU_H_ */
@@ -0,0 +1,80 @@
+/** @file fs.h
+ *  @brief  This file contains the declarations for the RAM filesystem layered
+ *          over the executables' table of contents
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _FS_H_
+#define _FS_H_
+
+#include <pcb.h>
+#include <shm.h>
+#include <eff_mutex.h>
+
+/* Maximum length of a file's name, excluding the NULL terminator */
+#define FS_NAME_MAX_LEN 63
+
+/* Returned by fs_readfile() when the file is not in the RAM filesystem */
+#define FS_NOT_FOUND -2
+
+/* Device of the files which are not device files */
+#define FS_NO_DEVICE -1
+
+/** @brief  A file of the RAM filesystem */
+typedef struct fs_file {
+
+  /** @brief  The file's name */
+  char name[FS_NAME_MAX_LEN + 1];
+
+  /** @brief  The file's size, in bytes */
+  unsigned int size;
+
+  /** @brief  The file's content, one page-sized extent per frame of the
+   *          segment, NULL while the file is empty */
+  shm_segment_t *pages;
+
+  /** @brief  Whether the file is a copy of an executable's image */
+  int read_only;
+
+  /** @brief  The drive whose content the file exposes through the buffer
+   *          cache (see bcache.h), FS_NO_DEVICE for a regular file */
+  int device;
+
+  /** @brief  Number of references to the file: one for its directory entry
+   *          and one per open file, protected by the directory's mutex */
+  int refcount;
+
+  /** @brief  Mutex protecting the file's size and content */
+  eff_mutex_t mutex;
+
+  /** @brief  Next file in the directory's hash bucket */
+  struct fs_file *next;
+
+} fs_file_t;
+
+/** @brief  An open file, shared by the descriptors copied by fork() */
+typedef struct fs_open {
+
+  /** @brief  The file */
+  fs_file_t *file;
+
+  /** @brief  The flags given to open() */
+  int flags;
+
+  /** @brief  Position of the next read() or write(), protected by the
+   *          file's mutex */
+  unsigned int offset;
+
+  /** @brief  Number of descriptors (and calls in progress) referring to the
+   *          open file, protected by the directory's mutex */
+  int refcount;
+
+} fs_open_t;
+
+int fs_init(void);
+void fs_fork(pcb_t *parent, pcb_t *child);
+void fs_close_all(pcb_t *task);
+int fs_readfile(char *filename, char *buf, int count, int offset);
+int fs_add_device(char *name, int drive, unsigned int size);
+
+#endif /* _FS_H_ */
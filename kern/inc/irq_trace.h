@@ -0,0 +1,24 @@
+/** @file irq_trace.h
+ *  @brief  This file contains the declarations for the interrupts-off latency
+ *          tracer
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _IRQ_TRACE_H_
+#define _IRQ_TRACE_H_
+
+#include <stdint.h>
+#include <irq_trace_entry.h>
+
+/* Number of intervals kept by the tracer */
+#define IRQ_TRACE_NB_ENTRIES 8
+
+void irq_disable(void);
+void irq_enable(void);
+int save_and_disable_interrupts(void);
+void restore_interrupts(int enabled);
+void irq_trace_start(void *site);
+void irq_trace_stop(void *site);
+int irq_trace_get(irq_trace_entry_t *entries, int count);
+
+#endif /* _IRQ_TRACE_H_ */
@@ -7,13 +7,13 @@
 #ifndef _KERNEL_STATE_H_
 #define _KERNEL_STATE_H_
 
-#include <hash_table.h>
+#include <tid_table.h>
 #include <eff_mutex.h>
-#include <generic_node.h>
 #include <tcb.h>
 #include <pcb.h>
-#include <stack_queue.h>
+#include <task_queues.h>
 #include <syscalls.h>
+#include <task_heap.h>
 
 /* Boolean values for fields related to the kernel state*/
 #define KERNEL_INIT_FALSE 0
@@ -56,8 +56,9 @@ typedef struct {
   /** @brief  The mutex to protect the queue */
   eff_mutex_t mp;
 
-  /** @brief  The queue of memory to be freed */
-  stack_queue_t zombie_memory;
+  /** @brief  The queue of vanished threads whose TCB (and possibly kernel
+   *          stack) must be freed */
+  tcb_queue_t zombie_memory;
 
 } garbage_collector_t;
 
@@ -82,8 +83,18 @@ typedef struct kernel {
    *          created */
   int thread_id;
 
-  /** @brief  Queue of runnable threads */
-  stack_queue_t runnable_queue;
+  /** @brief  Queue of runnable kernel threads (threads without a task), 
+   *          these run before user threads for a bounded
+   *          number of quanta */
+  tcb_queue_t runnable_queue;
+
+  /** @brief  Heap of tasks having at least one runnable thread, ordered by
+   *          stride scheduling pass value */
+  task_heap_t runnable_tasks;
+
+  /** @brief  Pass value of the last task scheduled, used as the virtual time
+   *          for tasks becoming runnable again */
+  uint64_t global_pass;
 
   /** @brief  Idle thread (ran when there is nothing to run) */
   tcb_t *idle_thread;
@@ -91,6 +102,10 @@ typedef struct kernel {
   /** @brief  Keyboard consumer thread (to handler keyboard input) */
   tcb_t *keyboard_consumer_thread;
 
+  /** @brief  Thread whose FPU/SSE state is currently loaded in the FPU, NULL
+   *          if the FPU holds no thread's state */
+  tcb_t *fpu_owner;
+
   /** @brief  Indicates wether the CPU is currently running the idle thread */
   int cpu_idle;
 
@@ -139,16 +154,16 @@ typedef struct kernel {
 
   /* ------------------------- */
 
-  /** @brief Hash table holding all the PCBs */
-  generic_hash_table_t pcbs;
+  /** @brief Table holding all the PCBs, keyed by task id */
+  tid_table_t pcbs;
 
-  /** @brief Hash table holding all the TCBs */
-  generic_hash_table_t tcbs;
+  /** @brief Table holding all the TCBs, keyed by thread id */
+  tid_table_t tcbs;
 
 } kernel_t;
 
 /** @brief  Holds information about an allocation made using new_pages() */
-typedef struct {
+typedef struct alloc {
 
   /** @brief The base address for the allocation*/
   void* base;
@@ -156,6 +171,9 @@ typedef struct {
   /** @brief The length for the allocation (in number of pages) */
   int len;
 
+  /** @brief Link in the task's list of allocations */
+  Q_NEW_LINK(alloc) link;
+
 } alloc_t;
 
 /* Holds the kernel state*/
@@ -165,6 +183,8 @@ int kernel_init();
 pcb_t *create_new_pcb();
 tcb_t *create_new_tcb(pcb_t *pcb, uint32_t esp0, uint32_t cr3,
                       swexn_struct_t* handler, int root_thread);
+tcb_t *create_kernel_thread(void (*entry)(void), int tid, pcb_t *task,
+                            uint32_t cr3);
 
 /* Frames management */
 int reserve_frames(unsigned int nb);
@@ -172,12 +192,7 @@ void release_frames(unsigned int nb);
 
 
 /* Functions used by the kernel's internal data strutures */
-unsigned int hash_function_pcb(void *pcb, unsigned int nb_buckets);
-int find_pcb(void *pcb1, void *pcb2);
-unsigned int hash_function_tcb(void *tcb, unsigned int nb_buckets);
-int find_tcb(void *tcb1, void *tcb2);
-int find_alloc(void* alloc, void* base);
-int find_pcb_ll(void* pcb1, void* pcb2);
+alloc_t *find_alloc(pcb_t *task, void *base);
 
 void keyboard_consumer();
 
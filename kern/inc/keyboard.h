@@ -12,6 +12,8 @@ int keyboard_init();
 
 void keyboard_c_handler();
 
+void keyboard_input(const char *chars, int len);
+
 /*********************************************************************/
 /*                                                                   */
 /* Keyboard driver interface                                         */
@@ -28,5 +30,18 @@ void keyboard_c_handler();
  **/
 int readchar(void);
 
+/** @brief Returns the next character in the keyboard buffer, blocking until
+ *         there is one
+ *
+ *  @return The next character in the keyboard buffer
+ **/
+int readchar_wait(void);
+
+/** @brief Tells whether a whole line is in the keyboard buffer
+ *
+ *  @return 1 if there is a line, 0 otherwise
+ **/
+int keyboard_has_line(void);
+
 #endif /* _KEYBOARD_H_ */
 
@@ -0,0 +1,18 @@
+/** @file ksm.h
+ *  @brief  This file contains the declarations for the kernel same-page
+ *          merging daemon
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _KSM_H_
+#define _KSM_H_
+
+int ksm_init(void);
+int ksm_create_daemon(void);
+void ksm_register(unsigned int *cr3);
+void ksm_unregister(unsigned int *cr3);
+void ksm_get_frame(unsigned int frame);
+void ksm_put_frame(unsigned int frame);
+int ksm_unmerge_page(unsigned int address);
+
+#endif /* _KSM_H_ */
@@ -1,5 +1,6 @@
 /** @file loader.h
- *  @brief This file contains the declaration for the get_bytes() function
+ *  @brief This file contains the declarations for the get_bytes() and
+ *   get_file_size() functions
  *  @author akanjani, lramire1
  */
 
@@ -7,5 +8,6 @@
 #define _LOADER_H_
      
 int getbytes( const char *filename, int offset, int size, char *buf );
+int get_file_size( const char *filename );
 
 #endif /* _LOADER_H_ */
@@ -0,0 +1,88 @@
+/** @file mq.h
+ *  @brief  This file contains the declarations for the message queues used
+ *          to exchange data between tasks
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _MQ_H_
+#define _MQ_H_
+
+#include <eff_mutex.h>
+#include <task_queues.h>
+#include <pcb.h>
+
+/* Maximum number of messages a queue may hold */
+#define MQ_MAX_CAPACITY 64
+
+/* Maximum length of a message, in bytes */
+#define MQ_MAX_MSG_LEN (16 * PAGE_SIZE)
+
+/* Values for the destroyed field of a queue */
+#define MQ_DESTROYED_FALSE 0
+#define MQ_DESTROYED_TRUE 1
+
+/** @brief  A message waiting in a queue */
+typedef struct mq_message {
+
+  /** @brief  Link in the queue's list of messages */
+  Q_NEW_LINK(mq_message) link;
+
+  /** @brief  The message's length, in bytes */
+  int len;
+
+  /** @brief  Copy of the message's content, NULL if the message's frames
+   *          were moved out of the sender's address space */
+  char *data;
+
+  /** @brief  Frames holding the message's content if it was sent by page
+   *          remapping, NULL otherwise */
+  unsigned int *frames;
+
+} mq_message_t;
+
+/** @brief  A list of messages */
+Q_NEW_HEAD(mq_message_queue_t, mq_message);
+
+/** @brief  A bounded message queue */
+typedef struct mq {
+
+  /** @brief  The queue's identifier */
+  int id;
+
+  /** @brief  Id of the task that created the queue, the queue is destroyed
+   *          when this task exits */
+  int owner;
+
+  /** @brief  Maximum number of messages in the queue */
+  int capacity;
+
+  /** @brief  Number of messages currently in the queue */
+  int count;
+
+  /** @brief  Messages in the queue, oldest first */
+  mq_message_queue_t messages;
+
+  /** @brief  Threads blocked because the queue is full */
+  tcb_queue_t senders;
+
+  /** @brief  Threads blocked because the queue is empty */
+  tcb_queue_t receivers;
+
+  /** @brief  Mutex protecting the queue */
+  eff_mutex_t mutex;
+
+  /** @brief  Number of threads currently using the queue */
+  int users;
+
+  /** @brief  Whether mq_destroy() was called on the queue */
+  int destroyed;
+
+  /** @brief  Next queue in the list of existing queues */
+  struct mq *next;
+
+} mq_t;
+
+int mq_init(void);
+void mq_release_all(pcb_t *task);
+
+#endif /* _MQ_H_ */
@@ -8,12 +8,22 @@
 
 #include <eff_mutex.h>
 #include <stdint.h>
-#include <linked_list.h>
-#include <stack_queue.h>
+#include <task_queues.h>
 
 #define TASK_RUNNING 0
 #define TASK_ZOMBIE 1
 
+/* Stride scheduling parameters */
+#define STRIDE_ONE (1 << 20)
+#define DEFAULT_TASK_WEIGHT 10
+#define MAX_TASK_WEIGHT 1000
+
+/* Maximum number of files a task may have open at once */
+#define TASK_MAX_OPEN_FILES 16
+
+struct fs_open;
+struct async_io;
+
 typedef struct pcb {
 
   /* @brief The task's kernel issued id */
@@ -51,17 +61,33 @@ typedef struct pcb {
   /* @brief Number of threads associated with this task */
   uint32_t num_running_children;
 
-  /* @brief List of allocations made using new_pages() */
-  generic_linked_list_t allocations;
+  /* @brief List of allocations made using new_pages(), protected by 
+   *  mutex */
+  alloc_queue_t allocations;
+
+  /* @brief List of shared memory segments attached to the task, protected 
+   *  by mutex */
+  shm_attachment_queue_t shm_attachments;
+
+  /* @brief Files opened by the task, indexed by descriptor, protected by 
+   *  mutex */
+  struct fs_open *open_files[TASK_MAX_OPEN_FILES];
+
+  /* @brief Asynchronous system call ring set up by ring_setup(), NULL if 
+   *  none, protected by mutex */
+  struct async_io *async_io;
 
   /* @brief Queue of running children */
-  generic_linked_list_t running_children;
+  pcb_queue_t running_children;
 
   /* @brief Queue of zombie children */
-  stack_queue_t zombie_children;
+  pcb_queue_t zombie_children;
+
+  /* @brief Link in the parent's queue of running or zombie children */
+  Q_NEW_LINK(pcb) child_link;
 
   /* @brief Queue of waiting threads */
-  stack_queue_t waiting_threads;
+  tcb_queue_t waiting_threads;
 
   /** @brief  Mutex used to ensure atomicity when changing the above 
     *         three queues */
@@ -70,6 +96,28 @@ typedef struct pcb {
   /** @brief Mutex used to ensure atomicity when changing the task state */
   eff_mutex_t mutex;
 
+  /* @brief Number of tickets held by the task for stride scheduling */
+  uint32_t weight;
+
+  /* @brief Tickets lent to the task by threads waiting on a mutex held by
+   *  one of its threads (priority inheritance) */
+  uint32_t donated_weight;
+
+  /* @brief Pass increment for each quantum given to the task 
+   *  (STRIDE_ONE / (weight + donated_weight)) */
+  uint32_t stride;
+
+  /* @brief Virtual time of the task, the task with the smallest pass runs 
+   *  next */
+  uint64_t pass;
+
+  /* @brief Index of the task in the scheduler's heap, TASK_NOT_IN_HEAP if 
+   *  the task has no runnable thread */
+  int heap_index;
+
+  /* @brief Queue of the task's runnable threads (round robin) */
+  tcb_queue_t runnable_threads;
+
 } pcb_t;
 
 #endif /* _PCB_H_ */
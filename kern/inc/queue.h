@@ -1,7 +1,7 @@
 /** @file queue.h
  *  @brief The file which contains the defintions of the helper functions
- *   needed by the kernel to maintain the static buffer of characters 
- *   pressed on the keyboard
+ *   needed by the kernel to maintain the static buffers of scancodes and 
+ *   characters pressed on the keyboard
  *
  *  @author Anirudh Kanjani
  */
@@ -11,7 +11,30 @@
 
 #include <stdint.h>
 
-int enqueue( uint8_t ch );
-int dequeue();
+/* The size of the cyclic static buffers storing the keyboard input. The size
+ * is chosen to be big enough so that the buffer does not run out of space 
+ * every time the user puts in a lot of data before reading it and small 
+ * enough to not take up a lot of space in memory all the time.
+ */
+#define QUEUE_SIZE 2048
+
+/** @brief A cyclic buffer of bytes with a single producer and a single
+ *   consumer, which may run concurrently without locking */
+typedef struct byte_queue {
+
+  /** @brief The buffer */
+  uint8_t buf[QUEUE_SIZE];
+
+  /** @brief Index of the next byte to dequeue (only written by the 
+   *   consumer) */
+  volatile int front;
+
+  /** @brief Index of the next free slot (only written by the producer) */
+  volatile int rear;
+
+} byte_queue_t;
+
+int enqueue( byte_queue_t *queue, uint8_t ch );
+int dequeue( byte_queue_t *queue );
 
 #endif /* _QUEUE_H_ */
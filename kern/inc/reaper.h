@@ -0,0 +1,19 @@
+/** @file reaper.h
+ *  @brief  This file contains the declarations for the reaper thread, which
+ *          tears down dead address spaces in the background
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _REAPER_H_
+#define _REAPER_H_
+
+#include <task_queues.h>
+
+int reaper_init(void);
+int reaper_create_thread(void);
+void reaper_free_address_space(unsigned int *cr3, unsigned int nb_frames,
+                               alloc_queue_t *allocations);
+void reaper_wake(void);
+int reaper_reserve_frames(unsigned int nb);
+
+#endif /* _REAPER_H_ */
@@ -8,15 +8,25 @@
 #define _SCHEDULER_H_
 
 #include <tcb.h>
+#include <pcb.h>
+#include <stdint.h>
 
 #define HOLDING_MUTEX_FALSE 0
 #define HOLDING_MUTEX_TRUE 1
 
+#define NEED_RESCHED_FALSE 0
+#define NEED_RESCHED_TRUE 1
+
 tcb_t *next_thread();
 void make_runnable_and_switch();
+void request_resched();
+void preempt_point();
 void block_and_switch(int holding_mutex, eff_mutex_t *mp);
 void add_runnable_thread(tcb_t *tcb);
 void add_runnable_thread_noint(tcb_t *tcb);
 int force_next_thread(tcb_t *force_next_tcb);
+void set_task_weight(pcb_t *task, uint32_t weight);
+void donate_weight(pcb_t *task, int amount);
+uint32_t thread_weight(tcb_t *tcb);
 
 #endif /* _SCHEDULER_H_ */
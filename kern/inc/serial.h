@@ -0,0 +1,17 @@
+/** @file serial.h
+ *  @brief The file which contains the declarations of the functions of the
+ *   serial port (COM1) driver
+ *
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _SERIAL_H_
+#define _SERIAL_H_
+
+int serial_init(void);
+int serial_present(void);
+void serial_c_handler(void);
+void serial_write(const char *buf, int len);
+void serial_drain_polled(void);
+
+#endif /* _SERIAL_H_ */
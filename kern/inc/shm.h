@@ -0,0 +1,64 @@
+/** @file shm.h
+ *  @brief  This file contains the declarations for the shared memory segments
+ *          shared between tasks
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _SHM_H_
+#define _SHM_H_
+
+#include <pcb.h>
+
+/* Maximum length of a segment's name, excluding the NULL terminator */
+#define SHM_NAME_MAX_LEN 31
+
+/** @brief  A named shared memory segment backed by physical frames */
+typedef struct shm_segment {
+
+  /** @brief  The segment's name, empty for an anonymous segment */
+  char name[SHM_NAME_MAX_LEN + 1];
+
+  /** @brief  The segment's size, in pages */
+  unsigned int nb_pages;
+
+  /** @brief  Physical address of each of the segment's frames */
+  unsigned int *frames;
+
+  /** @brief  Number of attachments (across all tasks) to the segment */
+  int refcount;
+
+  /** @brief  Next segment in the list of existing segments */
+  struct shm_segment *next;
+
+} shm_segment_t;
+
+/** @brief  A segment attached to a task's address space */
+typedef struct shm_attachment {
+
+  /** @brief  Virtual address at which the segment is mapped */
+  void *base;
+
+  /** @brief  The attached segment */
+  shm_segment_t *segment;
+
+  /** @brief  Number of pages mapped, an anonymous segment may have grown
+   *          since it was attached */
+  unsigned int nb_pages;
+
+  /** @brief  Link in the task's list of attachments */
+  Q_NEW_LINK(shm_attachment) link;
+
+} shm_attachment_t;
+
+int shm_init(void);
+int shm_fork(pcb_t *parent, pcb_t *child);
+unsigned int shm_release_all(pcb_t *task);
+
+/* Anonymous segments, backing other kernel objects */
+shm_segment_t *shm_segment_create(unsigned int nb_pages);
+int shm_segment_grow(shm_segment_t *segment, unsigned int nb_pages);
+int shm_segment_attach(shm_segment_t *segment, void *base,
+                       unsigned int nb_pages, int writable);
+void shm_segment_put(shm_segment_t *segment);
+
+#endif /* _SHM_H_ */
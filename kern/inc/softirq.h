@@ -0,0 +1,35 @@
+/** @file softirq.h
+ *  @brief  This file contains the declaration for the softirq_t data
+ *          structure and the functions used to defer work out of interrupt
+ *          handlers (bottom halves)
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _SOFTIRQ_H_
+#define _SOFTIRQ_H_
+
+#define SOFTIRQ_PENDING_FALSE 0
+#define SOFTIRQ_PENDING_TRUE 1
+
+/** @brief  A unit of deferred work. Raising an item that is already pending
+ *          has no effect, so work raised several times before the queue is
+ *          drained runs once */
+typedef struct softirq {
+
+  /** @brief  Function to run in the bottom half */
+  void (*handler)(void);
+
+  /** @brief  Whether the item is currently in the pending queue */
+  int pending;
+
+  /** @brief  Next item in the pending queue */
+  struct softirq *next;
+
+} softirq_t;
+
+void softirq_init(softirq_t *work, void (*handler)(void));
+void softirq_raise(softirq_t *work);
+void softirq_run(void);
+int softirq_is_running(void);
+
+#endif /* _SOFTIRQ_H_ */
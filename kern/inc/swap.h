@@ -0,0 +1,37 @@
+/** @file swap.h
+ *  @brief  This file contains the declarations for the swapper, which pages
+ *          user memory out to a disk when physical frames run low
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _SWAP_H_
+#define _SWAP_H_
+
+#include <swap_stats.h>
+
+/* Drive number meaning that the kernel runs without swap */
+#define SWAP_NO_DRIVE -1
+
+/* Below this many unused frames, the swapper starts paging memory out */
+#define SWAP_LOW_FRAMES 32
+
+/* The swapper pages memory out until this many frames are unused */
+#define SWAP_HIGH_FRAMES 64
+
+/* Values for the wait_stalled argument of swap_wait_for_frames() */
+#define SWAP_WAIT_STALLED_FALSE 0
+#define SWAP_WAIT_STALLED_TRUE 1
+
+int swap_init(int drive);
+int swap_create_daemon(void);
+void swap_register(unsigned int *cr3);
+void swap_unregister(unsigned int *cr3);
+void swap_wake(void);
+int swap_wait_for_frames(int wait_stalled);
+int swap_in_page(unsigned int address);
+void swap_in_range(unsigned int address, unsigned int len);
+void swap_dup_entry(unsigned int *entry_addr);
+void swap_drop_entry(unsigned int *entry_addr);
+void swap_get_stats(swap_stats_t *stats);
+
+#endif /* _SWAP_H_ */
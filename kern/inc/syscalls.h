@@ -11,6 +11,8 @@
 #include <video_defines.h>
 #include <tcb.h>
 #include <pcb.h>
+#include <irq_trace_entry.h>
+#include <swap_stats.h>
 
 int kern_gettid();
 
@@ -18,6 +20,8 @@ int kern_gettid();
 int kern_yield(int tid);
 int kern_deschedule(int *reject);
 int kern_make_runnable(int tid);
+int kern_make_runnable_many(int *tids, int count);
+int kern_set_weight(int tid, int weight);
 
 /* Forking calls */
 int thread_fork();
@@ -28,11 +32,34 @@ int kern_thread_fork(unsigned int * esp);
 int kern_new_pages(void *base, int len);
 int kern_remove_pages(void *base);
 
+/* Shared memory calls */
+int kern_shm_create(char *name, void *base, int len);
+int kern_shm_attach(char *name, void *base);
+int kern_shm_detach(void *base);
+
+/* Message queue calls */
+int kern_mq_create(int capacity);
+int kern_mq_destroy(int id);
+int kern_mq_send(int id, char *buf, int len);
+int kern_mq_recv(int id, char *buf, int len);
+
+/* RAM filesystem calls */
+int kern_open(char *name, int flags);
+int kern_read(int fd, char *buf, int count);
+int kern_write(int fd, char *buf, int count);
+int kern_close(int fd);
+int kern_unlink(char *name);
+int kern_fmap(int fd, void *base);
+
+/* Asynchronous system calls */
+int kern_ring_setup(void *base);
+int kern_ring_enter(int min_complete);
+
 /* Console IO */
 int kern_readline(int len, char *buf);
 int kern_print(int len, char *buf);
 void kern_print_helper(int len, char *buf);
-int kern_getchar(void); // NOT IMPLEMENTED, ALWAYS RETURN ERROR
+int kern_getchar(void);
 
 /* Terminal */
 int kern_set_term_color(int color);
@@ -64,6 +91,11 @@ void cleanup_process(pcb_t *task);
 /* Sleep */
 int kern_sleep(int ticks);
 void wake_up_threads(unsigned int ticks);
+void sleep_add(tcb_t *me, int ticks);
+void sleep_cancel(tcb_t *tcb);
+
+/* Multi-event wait */
+int kern_wait_any(int *events, int n, int timeout_ticks);
 
 /* Set status */
 void kern_set_status(int status);
@@ -71,6 +103,12 @@ void kern_set_status(int status);
 /* Get ticks*/
 unsigned int kern_get_ticks();
 
+/* Get irq trace */
+int kern_get_irq_trace(irq_trace_entry_t *entries, int count);
+
+/* Get swap stats */
+int kern_get_swap_stats(swap_stats_t *stats);
+
 /* Readfile */
 int kern_readfile(char *filename, char *buf, int count, int offset);
 
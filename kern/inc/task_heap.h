@@ -0,0 +1,43 @@
+/** @file task_heap.h
+ *  @brief  This file declares the task_heap_t structure, a binary min-heap of
+ *          tasks keyed by their stride scheduling pass value, as well as the
+ *          functions used to manipulate it.
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _TASK_HEAP_H_
+#define _TASK_HEAP_H_
+
+#include <pcb.h>
+
+/* Value of a PCB's heap_index field when the task is not in the heap */
+#define TASK_NOT_IN_HEAP -1
+
+/** @brief  A binary min-heap of PCBs ordered by pass value. Slots are reserved
+ *          when tasks are created so that insertions (done with interrupts
+ *          disabled) never have to allocate memory */
+typedef struct task_heap {
+
+  /** @brief  Array of tasks, the task with the smallest pass is at index 0 */
+  pcb_t **tasks;
+
+  /** @brief  Number of tasks currently in the heap */
+  int size;
+
+  /** @brief  Number of slots reserved by existing tasks */
+  int reserved;
+
+  /** @brief  Number of slots allocated in the tasks array */
+  int capacity;
+
+} task_heap_t;
+
+void task_heap_init(task_heap_t *heap);
+int task_heap_reserve_slot(task_heap_t *heap);
+void task_heap_release_slot(task_heap_t *heap);
+void task_heap_insert(task_heap_t *heap, pcb_t *task);
+pcb_t *task_heap_min(task_heap_t *heap);
+void task_heap_remove(task_heap_t *heap, pcb_t *task);
+void task_heap_update(task_heap_t *heap, pcb_t *task);
+
+#endif /* _TASK_HEAP_H_ */
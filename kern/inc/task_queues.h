@@ -0,0 +1,33 @@
+/** @file task_queues.h
+ *  @brief  This file declares the queue types used to link threads and tasks
+ *          together, and the per task lists
+ *
+ *  The queues are intrusive: the links live in the queued structures
+ *  themselves, so enqueuing an element never allocates memory.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _TASK_QUEUES_H_
+#define _TASK_QUEUES_H_
+
+#include <variable_queue.h>
+
+struct tcb;
+struct pcb;
+struct alloc;
+struct shm_attachment;
+
+/** @brief  A queue of threads */
+Q_NEW_HEAD(tcb_queue_t, tcb);
+
+/** @brief  A queue of tasks */
+Q_NEW_HEAD(pcb_queue_t, pcb);
+
+/** @brief  A list of allocations made using new_pages() */
+Q_NEW_HEAD(alloc_queue_t, alloc);
+
+/** @brief  A list of shared memory segments attached to a task */
+Q_NEW_HEAD(shm_attachment_queue_t, shm_attachment);
+
+#endif /* _TASK_QUEUES_H_ */
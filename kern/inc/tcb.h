@@ -8,6 +8,7 @@
 
 #include <eff_mutex.h>
 #include <pcb.h>
+#include <task_queues.h>
 #include <ureg.h>
 #include <stdint.h>
 
@@ -60,9 +61,43 @@ typedef struct tcb {
    */
   pcb_t *reaped_task;
 
+  /* @brief 16-bytes aligned fxsave area holding the thread's FPU/SSE state,
+   *  NULL if the thread never used the FPU */
+  void *fpu_state;
+
   /** @brief Mutex used to ensure atomicity when changing the thread state */
   eff_mutex_t mutex;
 
+  /* @brief Link in the queue of runnable threads (kernel's or task's) */
+  Q_NEW_LINK(tcb) runq_link;
+
+  /* @brief Link in the queue the thread is blocked on (mutex, wait(), message
+   *  queue, reaper) or in the garbage collector's queue once it vanished */
+  Q_NEW_LINK(tcb) wait_link;
+
+  /* @brief The thread's weight when it started waiting on a mutex */
+  uint32_t mutex_weight;
+
+  /* @brief Link in the sleep list, ordered by wake up time */
+  Q_NEW_LINK(tcb) sleep_link;
+
+  /* @brief Number of ticks a sleeping thread sleeps for, counted from the
+   *  sleep list's last update */
+  int sleep_ticks;
+
+  /* @brief Events a thread blocked in wait_any() waits for (one bit per
+   *  event type), 0 if the thread is not in the queue of event waiters */
+  int event_mask;
+
+  /* @brief Indicates whether the garbage collector must free the thread's
+   *  kernel stack along with its TCB (the last thread's stack is freed by
+   *  wait()) */
+  int free_stack;
+
+  /* @brief Set by deschedule(), only a descheduled thread may be made
+   *  runnable by make_runnable() */
+  int descheduled;
+
 } tcb_t;
 
 #endif /* _TCB_H_ */
@@ -0,0 +1,70 @@
+/** @file tid_table.h
+ *  @brief  This file declares the table mapping thread/task ids to their
+ *          control blocks, as well as the functions to use it
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _TID_TABLE_H_
+#define _TID_TABLE_H_
+
+#include <eff_mutex.h>
+
+/** @brief  A slot of the table */
+typedef struct tid_slot {
+
+  /** @brief  The id stored in the slot */
+  int tid;
+
+  /** @brief  The value associated with the id, NULL if the slot is empty */
+  void *value;
+
+} tid_slot_t;
+
+/** @brief  An open-addressing hash table keyed by id, with linear probing
+ *
+ *  When the table gets too full, a table twice as large is allocated and the
+ *  entries are moved to it a few at a time on each following operation, so
+ *  that no single insertion pays for the whole resize. While entries are
+ *  being moved, both tables are searched.
+ */
+typedef struct tid_table {
+
+  /** @brief  The table new entries are inserted in */
+  tid_slot_t *slots;
+
+  /** @brief  Number of slots in the table (a power of 2) */
+  unsigned int nb_slots;
+
+  /** @brief  Log2 of the number of slots */
+  unsigned int nb_slots_log2;
+
+  /** @brief  Number of entries in the table */
+  unsigned int nb_entries;
+
+  /** @brief  The table being emptied into the new one, NULL if no resize is
+   *          in progress */
+  tid_slot_t *old_slots;
+
+  /** @brief  Number of slots in the old table */
+  unsigned int old_nb_slots;
+
+  /** @brief  Log2 of the number of slots in the old table */
+  unsigned int old_nb_slots_log2;
+
+  /** @brief  Number of entries left in the old table */
+  unsigned int old_nb_entries;
+
+  /** @brief  Next slot of the old table to move */
+  unsigned int migrate_index;
+
+  /** @brief  Mutex protecting the table */
+  eff_mutex_t mutex;
+
+} tid_table_t;
+
+int tid_table_init(tid_table_t *table);
+int tid_table_insert(tid_table_t *table, int tid, void *value);
+void *tid_table_remove(tid_table_t *table, int tid);
+void *tid_table_get(tid_table_t *table, int tid);
+
+#endif /* _TID_TABLE_H_ */
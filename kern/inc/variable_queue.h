@@ -2,10 +2,17 @@
  *
  *  @brief Generalized queue module for data collection
  *
- *  @author Your name here
+ *  All the macros evaluate their arguments at most once, except Q_FOREACH
+ *  which evaluates CURRENT_ELEM on each iteration. Elements are linked both
+ *  ways, so that any element can be removed in constant time.
+ *
+ *  @author akanjani, lramire1
  **/
 
+#ifndef _VARIABLE_QUEUE_H_
+#define _VARIABLE_QUEUE_H_
 
+#include <stddef.h>
 
 /** @def Q_NEW_HEAD(Q_HEAD_TYPE, Q_ELEM_TYPE) 
  *
@@ -22,7 +29,11 @@
  *  
  **/
  
-#define Q_NEW_HEAD(Q_HEAD_TYPE, Q_ELEM_TYPE) ;
+#define Q_NEW_HEAD(Q_HEAD_TYPE, Q_ELEM_TYPE)                                  \
+  typedef struct {                                                            \
+    struct Q_ELEM_TYPE *front;                                                \
+    struct Q_ELEM_TYPE *tail;                                                 \
+  } Q_HEAD_TYPE
 
 /** @def Q_NEW_LINK(Q_ELEM_TYPE)
  *
@@ -40,7 +51,11 @@
  *
  *  @param Q_ELEM_TYPE the type of the structure containing the link
  **/
- #define Q_NEW_LINK(Q_ELEM_TYPE) ;
+#define Q_NEW_LINK(Q_ELEM_TYPE)                                               \
+  struct {                                                                    \
+    struct Q_ELEM_TYPE *next;                                                 \
+    struct Q_ELEM_TYPE *prev;                                                 \
+  }
  
  
 /** @def Q_INIT_HEAD(Q_HEAD)
@@ -49,7 +64,11 @@
  *         properly.
  *  @param Q_HEAD Pointer to queue head to initialize
  **/
-#define Q_INIT_HEAD(Q_HEAD) ;
+#define Q_INIT_HEAD(Q_HEAD)                                                   \
+  do {                                                                        \
+    (Q_HEAD)->front = NULL;                                                   \
+    (Q_HEAD)->tail = NULL;                                                    \
+  } while (0)
 
 /** @def Q_INIT_ELEM(Q_ELEM, LINK_NAME)
  *
@@ -61,7 +80,11 @@
  *  @param Q_ELEM Pointer to the structure instance containing the link
  *  @param LINK_NAME The name of the link to initialize
  **/
-#define Q_INIT_ELEM(Q_ELEM, LINK_NAME) ;
+#define Q_INIT_ELEM(Q_ELEM, LINK_NAME)                                        \
+  do {                                                                        \
+    (Q_ELEM)->LINK_NAME.next = NULL;                                          \
+    (Q_ELEM)->LINK_NAME.prev = NULL;                                          \
+  } while (0)
  
 /** @def Q_INSERT_FRONT(Q_HEAD, Q_ELEM, LINK_NAME)
  *
@@ -79,7 +102,19 @@
  *  @return Void (you may change this if your implementation calls for a 
  *                return value)
  **/
-#define Q_INSERT_FRONT(Q_HEAD, Q_ELEM, LINK_NAME) ;
+#define Q_INSERT_FRONT(Q_HEAD, Q_ELEM, LINK_NAME)                             \
+  do {                                                                        \
+    __typeof__(Q_HEAD) _q_head = (Q_HEAD);                                    \
+    __typeof__(Q_ELEM) _q_elem = (Q_ELEM);                                    \
+    _q_elem->LINK_NAME.prev = NULL;                                           \
+    _q_elem->LINK_NAME.next = _q_head->front;                                 \
+    if (_q_head->front != NULL) {                                             \
+      _q_head->front->LINK_NAME.prev = _q_elem;                               \
+    } else {                                                                  \
+      _q_head->tail = _q_elem;                                                \
+    }                                                                         \
+    _q_head->front = _q_elem;                                                 \
+  } while (0)
  
 /** @def Q_INSERT_TAIL(Q_HEAD, Q_ELEM, LINK_NAME) 
  *  @brief Inserts the queue element pointed to by Q_ELEM at the end of the 
@@ -96,7 +131,19 @@
  *  @return Void (you may change this if your implementation calls for a 
  *                return value)
  **/
-#define Q_INSERT_TAIL(Q_HEAD, Q_ELEM, LINK_NAME) ;
+#define Q_INSERT_TAIL(Q_HEAD, Q_ELEM, LINK_NAME)                              \
+  do {                                                                        \
+    __typeof__(Q_HEAD) _q_head = (Q_HEAD);                                    \
+    __typeof__(Q_ELEM) _q_elem = (Q_ELEM);                                    \
+    _q_elem->LINK_NAME.next = NULL;                                           \
+    _q_elem->LINK_NAME.prev = _q_head->tail;                                  \
+    if (_q_head->tail != NULL) {                                              \
+      _q_head->tail->LINK_NAME.next = _q_elem;                                \
+    } else {                                                                  \
+      _q_head->front = _q_elem;                                               \
+    }                                                                         \
+    _q_head->tail = _q_elem;                                                  \
+  } while (0)
 
 
 /** @def Q_GET_FRONT(Q_HEAD)
@@ -108,7 +155,7 @@
  *  @return Pointer to the first element in the queue, or NULL if the queue
  *          is empty
  **/
-#define Q_GET_FRONT(Q_HEAD) ;
+#define Q_GET_FRONT(Q_HEAD) ((Q_HEAD)->front)
  
 /** @def Q_GET_TAIL(Q_HEAD)
  *
@@ -119,7 +166,7 @@
  *  @return Pointer to the last element in the queue, or NULL if the queue
  *          is empty
  **/
-#define Q_GET_TAIL(Q_HEAD) ;
+#define Q_GET_TAIL(Q_HEAD) ((Q_HEAD)->tail)
 
 
 /** @def Q_GET_NEXT(Q_ELEM, LINK_NAME)
@@ -135,7 +182,7 @@
  *
  *  @return The element after Q_ELEM, or NULL if there is no next element
  **/
-#define Q_GET_NEXT(Q_ELEM, LINK_NAME) ;
+#define Q_GET_NEXT(Q_ELEM, LINK_NAME) ((Q_ELEM)->LINK_NAME.next)
  
 /** @def Q_GET_PREV(Q_ELEM, LINK_NAME)
  * 
@@ -150,7 +197,7 @@
  *
  *  @return The element before Q_ELEM, or NULL if there is no next element
  **/
-#define Q_GET_PREV(Q_ELEM, LINK_NAME) ;
+#define Q_GET_PREV(Q_ELEM, LINK_NAME) ((Q_ELEM)->LINK_NAME.prev)
 
 /** @def Q_INSERT_AFTER(Q_HEAD, Q_INQ, Q_TOINSERT, LINK_NAME)
  *
@@ -167,7 +214,20 @@
  *  @param LINK_NAME  Name of link field used to organize the queue
  **/
 
-#define Q_INSERT_AFTER(Q_HEAD,Q_INQ,Q_TOINSERT,LINK_NAME);
+#define Q_INSERT_AFTER(Q_HEAD, Q_INQ, Q_TOINSERT, LINK_NAME)                  \
+  do {                                                                        \
+    __typeof__(Q_HEAD) _q_head = (Q_HEAD);                                    \
+    __typeof__(Q_INQ) _q_inq = (Q_INQ);                                       \
+    __typeof__(Q_TOINSERT) _q_elem = (Q_TOINSERT);                            \
+    _q_elem->LINK_NAME.prev = _q_inq;                                         \
+    _q_elem->LINK_NAME.next = _q_inq->LINK_NAME.next;                         \
+    if (_q_inq->LINK_NAME.next != NULL) {                                     \
+      _q_inq->LINK_NAME.next->LINK_NAME.prev = _q_elem;                       \
+    } else {                                                                  \
+      _q_head->tail = _q_elem;                                                \
+    }                                                                         \
+    _q_inq->LINK_NAME.next = _q_elem;                                         \
+  } while (0)
 
 /** @def Q_INSERT_BEFORE(Q_HEAD, Q_INQ, Q_TOINSERT, LINK_NAME)
  *
@@ -184,7 +244,20 @@
  *  @param LINK_NAME  Name of link field used to organize the queue
  **/
 
-#define Q_INSERT_BEFORE(Q_HEAD,Q_INQ,Q_TOINSERT,LINK_NAME);
+#define Q_INSERT_BEFORE(Q_HEAD, Q_INQ, Q_TOINSERT, LINK_NAME)                 \
+  do {                                                                        \
+    __typeof__(Q_HEAD) _q_head = (Q_HEAD);                                    \
+    __typeof__(Q_INQ) _q_inq = (Q_INQ);                                       \
+    __typeof__(Q_TOINSERT) _q_elem = (Q_TOINSERT);                            \
+    _q_elem->LINK_NAME.next = _q_inq;                                         \
+    _q_elem->LINK_NAME.prev = _q_inq->LINK_NAME.prev;                         \
+    if (_q_inq->LINK_NAME.prev != NULL) {                                     \
+      _q_inq->LINK_NAME.prev->LINK_NAME.next = _q_elem;                       \
+    } else {                                                                  \
+      _q_head->front = _q_elem;                                               \
+    }                                                                         \
+    _q_inq->LINK_NAME.prev = _q_elem;                                         \
+  } while (0)
 
 /** @def Q_REMOVE(Q_HEAD,Q_ELEM,LINK_NAME)
  * 
@@ -205,7 +278,23 @@
  *  @return Void (if you would like to return a value, you may change this
  *                specification)
  **/
-#define Q_REMOVE(Q_HEAD,Q_ELEM,LINK_NAME) ;
+#define Q_REMOVE(Q_HEAD, Q_ELEM, LINK_NAME)                                   \
+  do {                                                                        \
+    __typeof__(Q_HEAD) _q_head = (Q_HEAD);                                    \
+    __typeof__(Q_ELEM) _q_elem = (Q_ELEM);                                    \
+    if (_q_elem->LINK_NAME.prev != NULL) {                                    \
+      _q_elem->LINK_NAME.prev->LINK_NAME.next = _q_elem->LINK_NAME.next;      \
+    } else {                                                                  \
+      _q_head->front = _q_elem->LINK_NAME.next;                               \
+    }                                                                         \
+    if (_q_elem->LINK_NAME.next != NULL) {                                    \
+      _q_elem->LINK_NAME.next->LINK_NAME.prev = _q_elem->LINK_NAME.prev;      \
+    } else {                                                                  \
+      _q_head->tail = _q_elem->LINK_NAME.prev;                                \
+    }                                                                         \
+    _q_elem->LINK_NAME.next = NULL;                                           \
+    _q_elem->LINK_NAME.prev = NULL;                                           \
+  } while (0)
 
 /** @def Q_FOREACH(CURRENT_ELEM,Q_HEAD,LINK_NAME) 
  *
@@ -236,4 +325,8 @@
  *         by Q_HEAD.
  **/
 
-#define Q_FOREACH(CURRENT_ELEM,Q_HEAD,LINK_NAME) ;
+#define Q_FOREACH(CURRENT_ELEM, Q_HEAD, LINK_NAME)                            \
+  for ((CURRENT_ELEM) = (Q_HEAD)->front ; (CURRENT_ELEM) != NULL ;            \
+       (CURRENT_ELEM) = (CURRENT_ELEM)->LINK_NAME.next)
+
+#endif /* _VARIABLE_QUEUE_H_ */
@@ -29,6 +29,9 @@
 #define PAGE_SIZE_FLAG  0x080 // Should be unset
 #define PAGE_GLOBAL     0x100
 #define PAGE_TABLE_RESERVED_BIT 0x200
+#define PAGE_SHARED_BIT 0x400 // Frame belongs to a shared memory segment
+#define PAGE_MERGED_BIT 0x800 // Frame shared by the same-page merging daemon
+#define PAGE_SWAPPED_BIT 0x100 // Non-present page whose content is in swap
 
 #define DIRECTORY_FLAGS PRESENT_BIT | PAGE_WRITABLE | USER_ACCESSIBLE
 #define PAGE_KERN_FLAGS PRESENT_BIT | PAGE_WRITABLE | PAGE_GLOBAL
@@ -46,6 +49,7 @@
 /* --------  CONTROL REGISTERS  -------- */
 #define PAGING_ENABLE_MASK 0x80000000
 #define PAGE_GLOBAL_ENABLE_MASK 0x80
+#define WRITE_PROTECT_ENABLE_MASK 0x10000
 
 /* --------  SIZES  -------- */
 #define ENTRY_SIZE_LOG2 2
@@ -64,6 +68,10 @@
 #define FIRST_TASK_TRUE 1
 #define FIRST_TASK_FALSE 0
 
+/* Constants for get_movable_page_entry() function */
+#define MOVE_PAGE_OUT 0
+#define MOVE_PAGE_IN 1
+
 /* Constants for is_buffer_valid() function */
 #define READ_ONLY 0
 #define AT_LEAST_READ 1
@@ -30,6 +30,9 @@ unsigned int get_virtual_address(unsigned int *page_directory_entry_addr,
 /* Frame allocation */
 unsigned int* allocate_frame();
 int free_frame(unsigned int* addr);
+void free_frame_keep_reservation(unsigned int *addr);
+unsigned int get_user_frame_count(void);
+unsigned int get_unused_frame_count(void);
 
 /* ZFOD related functions */
 int mark_address_requested(unsigned int address);
@@ -37,6 +40,26 @@ int mark_address_range_requested(unsigned int address, unsigned int len);
 int allocate_frame_if_address_requested(unsigned int address);
 int is_page_requested(unsigned int *addr);
 
+/* Shared memory related functions */
+int map_shared_frame(unsigned int address, unsigned int frame,
+                     int writable);
+void unmap_shared_frame(unsigned int address);
+int is_page_shared(unsigned int *addr);
+
+/* Same-page merging related functions */
+int is_page_merged(unsigned int *addr);
+char *map_frame_window(unsigned int frame);
+void unmap_frame_window(void);
+
+/* Swap related functions */
+int is_page_swapped(unsigned int *addr);
+
+/* Page remapping functions */
+unsigned int *get_movable_page_entry(unsigned int address, int receiving);
+unsigned int detach_user_frame(unsigned int *entry_addr, unsigned int address);
+void attach_user_frame(unsigned int *entry_addr, unsigned int address,
+                       unsigned int frame);
+
 
 /** @brief Invalidates a page stored in the TCB
  *
@@ -0,0 +1,18 @@
+/** @file wait_any.h
+ *  @brief  This file contains the declarations for the threads blocked in
+ *          wait_any()
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _WAIT_ANY_H_
+#define _WAIT_ANY_H_
+
+#include <wait_any_events.h>
+#include <pcb.h>
+
+/* Maximum number of events a thread may wait for at once */
+#define WAIT_ANY_MAX_EVENTS 16
+
+void wait_any_notify(int event, pcb_t *task);
+
+#endif /* _WAIT_ANY_H_ */
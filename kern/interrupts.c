@@ -18,16 +18,19 @@
 #include <stdio.h>
 #include <timer_defines.h>
 
+#include <ata.h>
 #include <console.h>
 #include <interrupts.h>
 #include <keyboard.h>
+#include <serial.h>
 #include <timer.h>
 
 #define NUM_32BIT_INT_PER_IDT_ENTRY 2
 
 /** @brief  The driver-library initialization function
  *
- *  Installs the timer and keyboard interrupt handler.
+ *  Installs the timer, keyboard, serial port and IDE channel interrupt
+ *  handlers.
  *  NOTE: The console has to be initialized or cleared in case the user
  *  decides not to call handler_install and not use the timer or the keyboard.
  *
@@ -52,6 +55,18 @@ int handler_install(void (*tickback)(unsigned int)) {
     return -1;
   }
 
+  // Initializes the serial port
+  if (serial_init() < 0) {
+    printf("Serial port init failed\n");
+    return -1;
+  }
+
+  // Initializes the disks
+  if (ata_init() < 0) {
+    printf("Disk init failed\n");
+    return -1;
+  }
+
   return 0;
 }
 
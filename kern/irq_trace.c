@@ -0,0 +1,208 @@
+/** @file irq_trace.c
+ *  @brief  This file contains the definitions for the interrupts-off latency
+ *          tracer
+ *
+ *  Kernel code disables and enables interrupts through irq_disable() and
+ *  irq_enable(), which time every interrupts-off interval with the TSC and
+ *  remember the return addresses of both calls. Interrupt handlers that run
+ *  with interrupts disabled call irq_trace_start() and irq_trace_stop()
+ *  directly.
+ *
+ *  If interrupts are disabled while an interval is already being timed (e.g.
+ *  nested calls, or a context switch in the middle of an interval), the
+ *  interval keeps its original start. The IRQ_TRACE_NB_ENTRIES longest
+ *  intervals are kept sorted in decreasing order, with at most one entry per
+ *  starting site, and can be retrieved from user space with get_irq_trace().
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <irq_trace.h>
+#include <asm.h>
+#include <eflags.h>
+#include <kernel_state.h>
+#include <stddef.h>
+#include <simics.h>
+
+/** @brief  State of the interrupts-off latency tracer */
+typedef struct irq_trace {
+
+  /** @brief  TSC value when interrupts were disabled, 0 if not tracing */
+  uint64_t start;
+
+  /** @brief  Address at which the current interval started */
+  void *start_site;
+
+  /** @brief  Number of valid entries in the longest array */
+  int nb_entries;
+
+  /** @brief  Longest intervals observed, sorted in decreasing order */
+  irq_trace_entry_t longest[IRQ_TRACE_NB_ENTRIES];
+
+} irq_trace_t;
+
+/* Tracer state (the kernel runs on a single CPU) */
+static irq_trace_t trace;
+
+/* Static functions prototypes */
+static void record_interval(unsigned int cycles, void *start_site,
+                            void *stop_site);
+
+/** @brief  Disables interrupts and starts timing the interval
+ *
+ *  @return void
+ */
+void irq_disable() {
+  disable_interrupts();
+  irq_trace_start(__builtin_return_address(0));
+}
+
+/** @brief  Stops timing the current interval and enables interrupts
+ *
+ *  @return void
+ */
+void irq_enable() {
+  irq_trace_stop(__builtin_return_address(0));
+  enable_interrupts();
+}
+
+/** @brief  Disables interrupts if they are enabled
+ *
+ *  For code that may run both with interrupts enabled and disabled (e.g. at
+ *  boot time and from a system call), the previous state is preserved.
+ *
+ *  @return A non-zero value if interrupts were enabled, 0 otherwise
+ */
+int save_and_disable_interrupts() {
+  int enabled = get_eflags() & EFL_IF;
+  if (enabled) {
+    disable_interrupts();
+    irq_trace_start(__builtin_return_address(0));
+  }
+  return enabled;
+}
+
+/** @brief  Enables interrupts if they were enabled before
+ *
+ *  @param  enabled  The value returned by save_and_disable_interrupts()
+ *
+ *  @return void
+ */
+void restore_interrupts(int enabled) {
+  if (enabled) {
+    irq_trace_stop(__builtin_return_address(0));
+    enable_interrupts();
+  }
+}
+
+/** @brief  Starts timing an interrupts-off interval
+ *
+ *  Must be called with interrupts disabled. Has no effect if an interval is
+ *  already being timed or if the kernel is still booting.
+ *
+ *  @param  site  The address at which interrupts were disabled
+ *
+ *  @return void
+ */
+void irq_trace_start(void *site) {
+  if (trace.start != 0 || kernel.kernel_ready != KERNEL_READY_TRUE) {
+    return;
+  }
+  trace.start_site = site;
+  trace.start = rdtsc();
+}
+
+/** @brief  Stops timing the current interrupts-off interval
+ *
+ *  Must be called with interrupts still disabled. Has no effect if no
+ *  interval is being timed.
+ *
+ *  @param  site  The address at which interrupts are going to be enabled
+ *
+ *  @return void
+ */
+void irq_trace_stop(void *site) {
+
+  if (trace.start == 0) {
+    return;
+  }
+
+  uint64_t cycles = rdtsc() - trace.start;
+  trace.start = 0;
+
+  if (cycles > UINT32_MAX) {
+    cycles = UINT32_MAX;
+  }
+
+  record_interval((unsigned int)cycles, trace.start_site, site);
+}
+
+/** @brief  Copies the longest intervals observed since boot
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @param  entries   The array to fill, longest interval first
+ *  @param  count     The number of entries in the array
+ *
+ *  @return The number of entries filled
+ */
+int irq_trace_get(irq_trace_entry_t *entries, int count) {
+
+  int i;
+  for (i = 0 ; i < count && i < trace.nb_entries ; ++i) {
+    entries[i] = trace.longest[i];
+  }
+  return i;
+}
+
+/** @brief  Inserts an interval in the sorted array of longest intervals
+ *
+ *  If the array already holds an interval with the same starting site, it is
+ *  replaced only if the new one is longer.
+ *
+ *  @param  cycles      The interval's length, in cycles
+ *  @param  start_site  The address at which interrupts were disabled
+ *  @param  stop_site   The address at which interrupts were enabled
+ *
+ *  @return void
+ */
+static void record_interval(unsigned int cycles, void *start_site,
+                            void *stop_site) {
+
+  // Find the slot the interval would take (or the existing one for the site)
+  int i, pos = trace.nb_entries;
+  for (i = 0 ; i < trace.nb_entries ; ++i) {
+    if (trace.longest[i].start_site == start_site) {
+      if (cycles <= trace.longest[i].cycles) {
+        return;
+      }
+      pos = i;
+      break;
+    }
+  }
+
+  if (pos == IRQ_TRACE_NB_ENTRIES) {
+    if (cycles <= trace.longest[pos - 1].cycles) {
+      return;
+    }
+    // Evict the shortest interval
+    --pos;
+  } else if (pos == trace.nb_entries) {
+    ++trace.nb_entries;
+  }
+
+  // Shift shorter entries down to keep the array sorted
+  while (pos > 0 && trace.longest[pos - 1].cycles < cycles) {
+    trace.longest[pos] = trace.longest[pos - 1];
+    --pos;
+  }
+
+  trace.longest[pos].cycles = cycles;
+  trace.longest[pos].start_site = start_site;
+  trace.longest[pos].stop_site = stop_site;
+
+  if (pos == 0) {
+    lprintf("irq_trace: new max interrupts-off window of %u cycles (%p-%p)",
+            cycles, start_site, stop_site);
+  }
+}
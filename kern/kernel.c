@@ -14,6 +14,7 @@
 
 /* x86 specific includes */
 #include <x86/asm.h> /* enable_interrupts() */
+#include <irq_trace.h>
 
 #include <console.h>
 #include <context_switch_asm.h>
@@ -33,9 +34,34 @@
 #include <keyboard.h>
 #include <context_switch.h>
 #include <cr.h>
+#include <fpu.h>
+#include <shm.h>
+#include <mq.h>
+#include <fs.h>
+#include <ksm.h>
+#include <reaper.h>
+#include <console_ring.h>
+#include <serial.h>
+#include <ata.h>
+#include <bcache.h>
+#include <swap.h>
+
+/* Boot argument selecting the console's outputs */
+#define CONSOLE_ARG "console="
+#define CONSOLE_ARG_LEN (sizeof(CONSOLE_ARG) - 1)
+
+/* Boot argument selecting the drive holding the swap area */
+#define SWAP_ARG "swap="
+#define SWAP_ARG_LEN (sizeof(SWAP_ARG) - 1)
+
+/* Number of blocks of a disk exposed through its device file */
+#define MAX_DEVICE_BLOCKS (0x80000000u / ATA_BLOCK_SIZE)
 
 /* Static functions prototypes */
 static void idle();
+static void select_console_outputs(int argc, char **argv);
+static int select_swap_drive(int argc, char **argv);
+static int add_disk_devices(int swap_drive);
 
 void tick(unsigned int numTicks);
 
@@ -55,10 +81,52 @@ int kernel_main(mbinfo_t *mbinfo, int argc, char **argv, char **envp) {
     assert(0);
   }
 
+  // Enable the FPU and SSE extensions (lazily switched)
+  fpu_init();
+
+  // Initialize the shared memory segments list
+  if (shm_init() < 0) {
+    lprintf("kernel_main(): Failed to initialize shared memory");
+    assert(0);
+  }
+
+  // Initialize the RAM filesystem
+  if (fs_init() < 0) {
+    lprintf("kernel_main(): Failed to initialize RAM filesystem");
+    assert(0);
+  }
+
+  // Initialize the message queues list
+  if (mq_init() < 0) {
+    lprintf("kernel_main(): Failed to initialize message queues");
+    assert(0);
+  }
+
+  // Initialize the same-page merging state
+  if (ksm_init() < 0) {
+    lprintf("kernel_main(): Failed to initialize same-page merging");
+    assert(0);
+  }
+
+  // Initialize the reaper's state
+  if (reaper_init() < 0) {
+    lprintf("kernel_main(): Failed to initialize reaper");
+    assert(0);
+  }
+
+  // Initialize the console output ring
+  if (console_ring_init() < 0) {
+    lprintf("kernel_main(): Failed to initialize console ring");
+    assert(0);
+  }
+
   // Initialize the IDT
   handler_install(wake_up_threads);
   exception_handlers_init();
- 
+
+  // Send the console's output where the boot arguments ask for
+  select_console_outputs(argc, argv);
+
   if (idt_syscall_install() < 0) {
     lprintf("kernel_main(): Failed to register syscall handlers");
     assert(0);
@@ -78,12 +146,49 @@ int kernel_main(mbinfo_t *mbinfo, int argc, char **argv, char **envp) {
 
   memset((char*)kernel.zeroed_out_frame, 0, PAGE_SIZE);
 
+  // Page user memory out to the drive the boot arguments ask for
+  int swap_drive = select_swap_drive(argc, argv);
+  if (swap_init(swap_drive) < 0) {
+    lprintf("kernel_main(): Failed to initialize swap");
+    assert(0);
+  }
+
+  // Expose the other disks as device files of the RAM filesystem
+  if (bcache_init() < 0 || add_disk_devices(swap_drive) < 0) {
+    lprintf("kernel_main(): Failed to initialize disks");
+    assert(0);
+  }
+
   // Create the initial task and load everything into memory
   if (create_task_from_executable(FIRST_TASK) < 0 ) {
     lprintf("Failed to create user task");
     assert(0);
   }
 
+  // Start merging identical pages in the background
+  if (ksm_create_daemon() < 0) {
+    lprintf("kernel_main(): Failed to create same-page merging daemon");
+    assert(0);
+  }
+
+  // Tear down dead address spaces in the background
+  if (reaper_create_thread() < 0) {
+    lprintf("kernel_main(): Failed to create reaper thread");
+    assert(0);
+  }
+
+  // Render print() output in the background
+  if (console_ring_create_thread() < 0) {
+    lprintf("kernel_main(): Failed to create console flusher thread");
+    assert(0);
+  }
+
+  // Page memory out in the background when frames run low
+  if (swap_create_daemon() < 0) {
+    lprintf("kernel_main(): Failed to create swapper thread");
+    assert(0);
+  }
+
   // Clear the console before running anything
   clear_console();
 
@@ -98,6 +203,101 @@ int kernel_main(mbinfo_t *mbinfo, int argc, char **argv, char **envp) {
   return 0;
 }
 
+/** @brief  Selects the console's outputs from the boot arguments
+ *
+ *  "console=serial" sends the console's output to the serial port only,
+ *  "console=both" to the serial port and the screen. The output stays on the
+ *  screen by default, or if there is no serial port.
+ *
+ *  @param  argc  The number of boot arguments
+ *  @param  argv  The boot arguments
+ *
+ *  @return void
+ */
+static void select_console_outputs(int argc, char **argv) {
+
+  int outputs = CONSOLE_OUTPUT_VGA;
+
+  int i;
+  for (i = 0; i < argc; ++i) {
+    if (argv[i] == NULL || strncmp(argv[i], CONSOLE_ARG, CONSOLE_ARG_LEN)) {
+      continue;
+    }
+    char *value = argv[i] + CONSOLE_ARG_LEN;
+    if (!strcmp(value, "serial")) {
+      outputs = CONSOLE_OUTPUT_SERIAL;
+    } else if (!strcmp(value, "both")) {
+      outputs = CONSOLE_OUTPUT_VGA | CONSOLE_OUTPUT_SERIAL;
+    } else if (!strcmp(value, "vga")) {
+      outputs = CONSOLE_OUTPUT_VGA;
+    }
+  }
+
+  if (!serial_present()) {
+    outputs = CONSOLE_OUTPUT_VGA;
+  }
+
+  console_set_outputs(outputs);
+}
+
+/** @brief  Selects the drive holding the swap area from the boot arguments
+ *
+ *  "swap=ata0" or "swap=ata1" uses the whole drive as the swap area, its
+ *  content is lost. The kernel runs without swap by default.
+ *
+ *  @param  argc  The number of boot arguments
+ *  @param  argv  The boot arguments
+ *
+ *  @return The drive's number, SWAP_NO_DRIVE if there is no swap
+ */
+static int select_swap_drive(int argc, char **argv) {
+
+  int i;
+  for (i = 0; i < argc; ++i) {
+    if (argv[i] == NULL || strncmp(argv[i], SWAP_ARG, SWAP_ARG_LEN)) {
+      continue;
+    }
+    char *value = argv[i] + SWAP_ARG_LEN;
+    if (!strcmp(value, "ata0")) {
+      return ATA_MASTER;
+    } else if (!strcmp(value, "ata1")) {
+      return ATA_SLAVE;
+    }
+  }
+
+  return SWAP_NO_DRIVE;
+}
+
+/** @brief  Adds a device file for each disk found on the IDE channel
+ *
+ *  @param  swap_drive  The drive holding the swap area, which is not exposed
+ *
+ *  @return 0 on success, a negative number on error
+ */
+static int add_disk_devices(int swap_drive) {
+
+  char name[] = "ata0";
+
+  int drive;
+  for (drive = 0; drive < ATA_NB_DRIVES; ++drive) {
+    if (!ata_present(drive) || drive == swap_drive) {
+      continue;
+    }
+    name[sizeof(name) - 2] = '0' + drive;
+
+    // Files are limited to 2 GB, larger disks are truncated
+    unsigned int nb_blocks = ata_nb_blocks(drive);
+    if (nb_blocks > MAX_DEVICE_BLOCKS) {
+      nb_blocks = MAX_DEVICE_BLOCKS;
+    }
+    if (fs_add_device(name, drive, nb_blocks * ATA_BLOCK_SIZE) < 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
 /** @brief  Idle function for the idle thread
  *
  *  @return Does not return
@@ -125,20 +325,16 @@ void keyboard_consumer() {
     eff_mutex_lock(&kernel.console_mutex);
 
     // Echo again characters that were not consumed by the previous readline
-    int k;
-    for ( k = 0 ; k < kernel.rl.key_index ; ++k) {
-      putbyte(kernel.rl.key_buf[k]);
-    }
+    putbytes(kernel.rl.key_buf, kernel.rl.key_index);
 
     // Unlock the mutex on the console
     eff_mutex_unlock(&kernel.console_mutex);
 
     do {
       
-      // Get the character from the keyboard buffer
-      while ((ch = readchar()) < 0) {
-        continue;
-      }
+      // Get the character from the keyboard buffer, sleeping until a key is
+      // pressed
+      ch = readchar_wait();
 
       // Lock the mutex on the console
       eff_mutex_lock(&kernel.console_mutex);
@@ -221,7 +417,7 @@ void keyboard_consumer() {
 
     eff_mutex_unlock(&kernel.console_mutex);    
     
-    disable_interrupts();
+    irq_disable();
     kernel.keyboard_consumer_thread->thread_state = THR_BLOCKED;
     context_switch(tmp);
 
@@ -12,7 +12,6 @@
 #include <virtual_memory_defines.h>
 #include <syscalls.h>
 #include <cr.h>
-#include <stack_queue.h>
 #include <string.h>
 #include <context_switch.h>
 #include <atomic_ops.h>
@@ -21,9 +20,6 @@
 #include <simics.h>
 #include <assert.h>
 
-/* Number of buckets for hash tables*/
-#define NB_BUCKETS 8
-
 /* Number of registers poped during a popa instruction */
 #define NB_REGISTERS_POPA 8
 
@@ -61,19 +57,41 @@ static tcb_t *create_idle_thread() {
   new_tcb->tid = 0; // No other thread is allowed to have this tid
   new_tcb->esp0 = get_esp0();
   new_tcb->cr3 = get_cr3();
+  new_tcb->fpu_state = NULL;
 
   return new_tcb;
 }
 
 /** @brief  Creates the kernel's keyboard consumer thread
  *
- *  The function creates a particular TCB for the idle thread which does not
- *  have an englobing task and is not added to the TCBs hash table.
- *  Only some fields of the TCB data structure are filled with meaningful data.
+ *  The function creates a particular TCB for the keyboard consumer thread
+ *  which does not have an englobing task and is not added to the TCBs hash
+ *  table.
  *
- *  @return The idle thread's TCB on success, NULL otherwise
+ *  @return The keyboard consumer thread's TCB on success, NULL otherwise
  */
 static tcb_t *create_keyboard_consumer_thread() {
+  // No other thread is allowed to have this tid
+  return create_kernel_thread(keyboard_consumer, -1, NULL, get_cr3());
+}
+
+/** @brief  Creates a kernel thread running a function of the kernel
+ *
+ *  The function allocates a TCB and a kernel stack for the thread, fills
+ *  every field of the TCB and crafts the stack so that the first context
+ *  switch to the thread starts running entry(). The thread is left blocked
+ *  and is not added to the TCBs hash table, making it runnable is up to the
+ *  caller.
+ *
+ *  @param  entry   The function run by the thread, it should never return
+ *  @param  tid     The thread's tid, no other thread is allowed to have it
+ *  @param  task    The thread's englobing task, NULL if it has none
+ *  @param  cr3     The page directory the thread runs with
+ *
+ *  @return The thread's TCB on success, NULL otherwise
+ */
+tcb_t *create_kernel_thread(void (*entry)(void), int tid, pcb_t *task,
+                            uint32_t cr3) {
 
   // Allocate space for the new TCB
   tcb_t *new_tcb = malloc(sizeof(tcb_t));
@@ -90,26 +108,37 @@ static tcb_t *create_keyboard_consumer_thread() {
 
   // Initialize the mutex on this TCB
   if (eff_mutex_init(&new_tcb->mutex) < 0) {
-    lprintf("create_idle_thread(): Failed to initialize TCB mutex");
+    lprintf("create_kernel_thread(): Failed to initialize TCB mutex");
+    free(kernel_stack);
     free(new_tcb);
     return NULL;
   }
 
-  // Set various fields to their initial value (only the one that matters for
-  // the keyboard consumer thread)
-  new_tcb->task = NULL;
+  // Set various fields to their initial value
+  new_tcb->task = task;
+  new_tcb->tid = tid;
   new_tcb->thread_state = THR_BLOCKED;
-  new_tcb->tid = -1; // No other thread is allowed to have this tid
   new_tcb->esp0 = ((uint32_t)kernel_stack) + PAGE_SIZE;
-  new_tcb->cr3 = get_cr3();
+  new_tcb->cr3 = cr3;
+  new_tcb->num_of_frames_requested = 0;
+  new_tcb->swexn_values.esp3 = NULL;
+  new_tcb->swexn_values.eip = NULL;
+  new_tcb->swexn_values.arg = NULL;
+  new_tcb->reaped_task = NULL;
+  new_tcb->fpu_state = NULL;
+  new_tcb->mutex_weight = 0;
+  new_tcb->sleep_ticks = 0;
+  new_tcb->event_mask = 0;
+  new_tcb->free_stack = 1;
+  new_tcb->descheduled = 0;
 
   // Craft the stack for first context switch to this thread
   unsigned int * stack_addr = (unsigned int *) new_tcb->esp0;
   --stack_addr;
   *stack_addr = (unsigned int) new_tcb;
   --stack_addr;
-  *stack_addr = (unsigned int) keyboard_consumer;
-  --stack_addr;  
+  *stack_addr = (unsigned int) entry;
+  --stack_addr;
   *stack_addr = (unsigned int) init_thread;
   stack_addr -= NB_REGISTERS_POPA;
 
@@ -134,6 +163,7 @@ int kernel_init() {
   // Set various fields of the state to their initial value
   kernel.kernel_ready = KERNEL_READY_FALSE;
   kernel.current_thread = NULL;
+  kernel.fpu_owner = NULL;
   kernel.task_id = 1;
   kernel.thread_id = 1;
   kernel.cpu_idle = CPU_IDLE_TRUE;
@@ -146,11 +176,13 @@ int kernel_init() {
   kernel.rl.caller = NULL;
   kernel.rl.key_index = 0; 
 
-  // Initialize the runnable thread queue
-  stack_queue_init(&kernel.runnable_queue);
+  // Initialize the runnable kernel threads queue and tasks heap
+  Q_INIT_HEAD(&kernel.runnable_queue);
+  task_heap_init(&kernel.runnable_tasks);
+  kernel.global_pass = 0;
 
   // Initialize the garbage collector queue
-  stack_queue_init(&kernel.gc.zombie_memory);
+  Q_INIT_HEAD(&kernel.gc.zombie_memory);
 
 
   // Initialize all mutexes
@@ -164,17 +196,15 @@ int kernel_init() {
     return -1;
   }
 
-  // Initialize the PCBs hash table
-  if (hash_table_init(&kernel.pcbs, NB_BUCKETS, find_pcb, hash_function_pcb) <
-      0) {
-    lprintf("kernel_init(): Failed to initialize hash table for PCBs");
+  // Initialize the PCBs table
+  if (tid_table_init(&kernel.pcbs) < 0) {
+    lprintf("kernel_init(): Failed to initialize table for PCBs");
     return -1;
   }
 
-  // Initialize the TCBs hash table
-  if (hash_table_init(&kernel.tcbs, NB_BUCKETS, find_tcb, hash_function_tcb) <
-      0) {
-    lprintf("kernel_init(): Failed to initialize hash table for TCBs");
+  // Initialize the TCBs table
+  if (tid_table_init(&kernel.tcbs) < 0) {
+    lprintf("kernel_init(): Failed to initialize table for TCBs");
     return -1;
   }
 
@@ -234,23 +264,18 @@ pcb_t *create_new_pcb() {
     return NULL;
   }
 
-  // Initialize the allocations list
-  if (linked_list_init(&new_pcb->allocations, find_alloc) < 0) {
-    lprintf("create_new_pcb(): Failed to initialize linked list");
-    free(new_pcb);
-    return NULL;
-  }
-
-  // Initialize the running children queue
-  if (linked_list_init(&new_pcb->running_children, find_pcb_ll) < 0) {
-    lprintf("create_new_pcb(): Failed to initialize running_children");
-    free(new_pcb);
-    return NULL;
-  }
+  // Initialize the allocations and shared memory attachments lists
+  Q_INIT_HEAD(&new_pcb->allocations);
+  Q_INIT_HEAD(&new_pcb->shm_attachments);
+  memset(new_pcb->open_files, 0, sizeof(new_pcb->open_files));
+  new_pcb->async_io = NULL;
 
-  // Initialize the zombie children and waiting children queues
-  stack_queue_init(&new_pcb->zombie_children);
-  stack_queue_init(&new_pcb->waiting_threads);
+  // Initialize the children, waiting threads and runnable threads queues
+  Q_INIT_HEAD(&new_pcb->running_children);
+  Q_INIT_HEAD(&new_pcb->zombie_children);
+  Q_INIT_ELEM(new_pcb, child_link);
+  Q_INIT_HEAD(&new_pcb->waiting_threads);
+  Q_INIT_HEAD(&new_pcb->runnable_threads);
 
   // Set various fields to their initial value
   new_pcb->return_status = 0;
@@ -262,6 +287,18 @@ pcb_t *create_new_pcb() {
   new_pcb->num_running_children = 0;
   new_pcb->num_waiting_threads = 0;
   new_pcb->last_thread_esp0 = 0;
+  new_pcb->weight = DEFAULT_TASK_WEIGHT;
+  new_pcb->donated_weight = 0;
+  new_pcb->stride = STRIDE_ONE / DEFAULT_TASK_WEIGHT;
+  new_pcb->pass = kernel.global_pass;
+  new_pcb->heap_index = TASK_NOT_IN_HEAP;
+
+  // Reserve a slot for the task in the scheduler's heap
+  if (task_heap_reserve_slot(&kernel.runnable_tasks) < 0) {
+    lprintf("create_new_pcb(): Failed to reserve slot in scheduler's heap");
+    free(new_pcb);
+    return NULL;
+  }
 
   // Assign a unique id to the PCB
   eff_mutex_lock(&kernel.mutex);
@@ -271,9 +308,10 @@ pcb_t *create_new_pcb() {
   }
   eff_mutex_unlock(&kernel.mutex);
 
-  // Add the new PCB to the hash table
-  if (hash_table_add_element(&kernel.pcbs, new_pcb) < 0) {
-    lprintf("create_new_pcb(): Failed to add new PCB to hash table");
+  // Add the new PCB to the table
+  if (tid_table_insert(&kernel.pcbs, new_pcb->tid, new_pcb) < 0) {
+    lprintf("create_new_pcb(): Failed to add new PCB to table");
+    task_heap_release_slot(&kernel.runnable_tasks);
     free(new_pcb);
     return NULL;
   }
@@ -324,6 +362,10 @@ tcb_t *create_new_tcb(pcb_t *pcb, uint32_t esp0, uint32_t cr3,
   new_tcb->esp0 = esp0;
   new_tcb->cr3 = cr3;
   new_tcb->num_of_frames_requested = 0;
+  new_tcb->fpu_state = NULL;
+  new_tcb->free_stack = 1;
+  new_tcb->descheduled = 0;
+  new_tcb->event_mask = 0;
 
   // Register an exception handler for this thread if the handler argument is 
   // not NULL
@@ -348,9 +390,9 @@ tcb_t *create_new_tcb(pcb_t *pcb, uint32_t esp0, uint32_t cr3,
     pcb->original_thread_id = new_tcb->tid;
   }
 
-  // Add the new PCB to the hash table
-  if (hash_table_add_element(&kernel.tcbs, new_tcb) < 0) {
-    lprintf("create_new_tcb(): Failed to add new TCB to hash table");
+  // Add the new TCB to the table
+  if (tid_table_insert(&kernel.tcbs, new_tcb->tid, new_tcb) < 0) {
+    lprintf("create_new_tcb(): Failed to add new TCB to table");
     free(new_tcb);
     return NULL;
   }
@@ -394,84 +436,21 @@ int reserve_frames(unsigned int nb) {
 }
 
 
-/** @brief Hash function for PCBs hash table
- *
- *  @param pcb The PCB to hash
- *  @param nb_buckets The number of buckets in the hash table
- *
- *  @return The PCB's hashed value
- */
-unsigned int hash_function_pcb(void *pcb, unsigned int nb_buckets) {
-  pcb_t *p = pcb;
-  return p->tid % nb_buckets;
-}
-
-/** @brief Find a PCB by its tid
- *
- *  @param pcb A thread's PCB
- *  @param tid A process tid
- *
- *  @return 1 if the PCB is the good one (its tid is tid), 0 otherwise
- */
-int find_pcb(void *pcb1, void *pcb2) {
-  if (((pcb_t*)pcb1)->tid == ((pcb_t*)pcb2)->tid) {
-    return 1;
-  }
-  return 0;
-}
-
-/** @brief Hash function for TCBs hash table
- *
- *  @param tcb The TCB to hash
- *  @param nb_buckets The number of buckets in the hash table
- *
- *  @return The TCB's hashed value
- */
-unsigned int hash_function_tcb(void *tcb, unsigned int nb_buckets) {
-  tcb_t *t = tcb;
-  return t->tid % nb_buckets;
-}
-
-/** @brief Find a TCB by its tid
- *
- *  @param tcb A thread's TCB
- *  @param tid A thread tid
- *
- *  @return 1 if the TCB is the good one (its tid is tid), 0 otherwise
- */
-int find_tcb(void *tcb1, void *tcb2) {
-  
-  if (((tcb_t*)tcb1)->tid == ((tcb_t*)tcb2)->tid) {
-    return 1;
-  }
-  
-  return 0;
-}
-
 /** @brief Find an allocation made by new_pages() by its base address
  *
- *  @param alloc An allocation made by new_pages()
+ *  The caller must hold the task's mutex.
+ *
+ *  @param task  The task which made the allocation
  *  @param base  A base address
  *
- *  @reutrn 1 if the allocation is the good one (the base addresses match), 
- *    0 otherwise
+ *  @return The allocation starting at base, NULL if there is none
  */
-int find_alloc(void* alloc, void* base) {
-  alloc_t * allocation = alloc;
-  if (base == allocation->base) {
-    return 1;
+alloc_t *find_alloc(pcb_t *task, void *base) {
+  alloc_t *allocation;
+  Q_FOREACH(allocation, &task->allocations, link) {
+    if (allocation->base == base) {
+      return allocation;
+    }
   }
-  return 0;
-}
-
-/** @brief Find a PCB in the linked list
- *
- *  @param tcb A task's PCB
- *  @param tid The value in the linked list
- *
- *  @return 1 if the PCB address is the same as the one stored in the 
- *            linked list, 0 otherwise
- */
-int find_pcb_ll(void *pcb1, void *pcb2) {
-  return (uint32_t)pcb1 == (uint32_t)pcb2;
+  return NULL;
 }
@@ -0,0 +1,885 @@
+/** @file ksm.c
+ *  @brief  This file contains the definitions for the kernel same-page
+ *          merging daemon
+ *
+ *  A kernel thread periodically walks the page tables of every registered
+ *  address space, a few pages at a time, looking for private writable pages
+ *  with identical content:
+ *
+ *  - Pages filled with zeros are mapped to the kernel's zeroed out frame.
+ *  - Pages identical to a frame that was already merged (a "stable" frame)
+ *    are mapped to that frame.
+ *  - Other pages are remembered, by checksum, in the "unstable" table. When
+ *    a later page has the same content as a page in the table, the table's
+ *    page frame becomes a stable frame shared by both pages.
+ *
+ *  Merged pages are mapped read-only with the PAGE_MERGED_BIT set. The first
+ *  write to such a page (from user or kernel mode, since the kernel runs with
+ *  CR0.WP set) faults and ksm_unmerge_page() gives the page a private copy.
+ *
+ *  A page is only considered if it was not written to since the daemon last
+ *  looked at it (its DIRTY bit is still clear), so that frequently written
+ *  pages are not merged and split over and over. Contents are always compared
+ *  in full, with interrupts disabled, before any page table entry is changed.
+ *
+ *  A merged page does not hold a frame reservation: the frames freed by
+ *  merging are released to the kernel and a frame is reserved again when a
+ *  page is split. Each stable frame holds one reservation, released when its
+ *  last mapping goes away.
+ *
+ *  Stable frames and the unstable table are also used from the page fault
+ *  handler, so they are only accessed with interrupts disabled. The list of
+ *  address spaces and the scanning cursor are protected by a mutex, which
+ *  ksm_unregister() takes before an address space is torn down.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <ksm.h>
+#include <page.h>
+#include <common_kern.h>
+#include <kernel_state.h>
+#include <context_switch.h>
+#include <scheduler.h>
+#include <syscalls.h>
+#include <cr.h>
+#include <asm.h>
+#include <irq_trace.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+
+/* VM system */
+#include <virtual_memory.h>
+#include <virtual_memory_helper.h>
+#include <virtual_memory_defines.h>
+
+/* Debugging */
+#include <simics.h>
+#include <assert.h>
+
+/* Number of ticks the daemon sleeps between two batches */
+#define KSM_SLEEP_TICKS 10
+
+/* Maximum number of candidate pages examined in one batch */
+#define KSM_PAGES_PER_BATCH 32
+
+/* Maximum number of page directory/table entries walked in one batch */
+#define KSM_ENTRIES_PER_BATCH 1024
+
+/* Maximum number of stable frames */
+#define KSM_MAX_STABLE_FRAMES 1024
+
+/* Number of buckets in the stable frames hash tables */
+#define KSM_NB_BUCKETS 256
+
+/* Number of slots in the unstable table */
+#define KSM_UNSTABLE_SIZE 256
+
+/* Thread id of the daemon (no other thread is allowed to have this tid) */
+#define KSM_DAEMON_TID -2
+
+/* Number of 32-bit words in a page */
+#define WORDS_PER_PAGE (PAGE_SIZE / sizeof(uint32_t))
+
+/** @brief  A frame shared by several merged pages */
+typedef struct ksm_frame {
+
+  /** @brief  The frame's physical address */
+  unsigned int frame;
+
+  /** @brief  Checksum of the frame's content */
+  uint32_t checksum;
+
+  /** @brief  Number of page table entries mapping the frame */
+  int refcount;
+
+  /** @brief  Next frame in the same checksum bucket (or in the free list) */
+  struct ksm_frame *next_sum;
+
+  /** @brief  Next frame in the same frame address bucket */
+  struct ksm_frame *next_frame;
+
+} ksm_frame_t;
+
+/** @brief  A page seen during the current pass, candidate for merging */
+typedef struct ksm_candidate {
+
+  /** @brief  The page table entry mapping the page, NULL if slot is empty */
+  unsigned int *entry_addr;
+
+  /** @brief  The frame mapped when the page was seen */
+  unsigned int frame;
+
+  /** @brief  Checksum of the page's content when it was seen */
+  uint32_t checksum;
+
+  /** @brief  The page's virtual address */
+  unsigned int address;
+
+  /** @brief  The page directory of the page's address space */
+  unsigned int *cr3;
+
+} ksm_candidate_t;
+
+/** @brief  An address space scanned by the daemon */
+typedef struct ksm_space {
+
+  /** @brief  The page directory */
+  unsigned int *cr3;
+
+  /** @brief  Next address space in the list */
+  struct ksm_space *next;
+
+} ksm_space_t;
+
+/** @brief  State of the same-page merging daemon */
+typedef struct ksm {
+
+  /** @brief  Mutex protecting the list of address spaces and the cursor */
+  eff_mutex_t mutex;
+
+  /** @brief  Registered address spaces */
+  ksm_space_t *spaces;
+
+  /** @brief  Address space being scanned, NULL between two passes */
+  ksm_space_t *cursor;
+
+  /** @brief  Next virtual address to scan in the cursor's address space */
+  unsigned int cursor_address;
+
+  /** @brief  Stable frames, hashed by checksum */
+  ksm_frame_t *by_checksum[KSM_NB_BUCKETS];
+
+  /** @brief  Stable frames, hashed by physical address */
+  ksm_frame_t *by_frame[KSM_NB_BUCKETS];
+
+  /** @brief  Unused stable frame descriptors */
+  ksm_frame_t *free_frames;
+
+  /** @brief  Pages seen during the current pass, hashed by checksum */
+  ksm_candidate_t unstable[KSM_UNSTABLE_SIZE];
+
+  /** @brief  Number of candidate pages examined since boot */
+  unsigned int pages_scanned;
+
+  /** @brief  Number of pages merged since boot */
+  unsigned int pages_merged;
+
+  /** @brief  Number of merged pages split again since boot */
+  unsigned int pages_unmerged;
+
+  /** @brief  Number of page table entries currently mapping merged frames */
+  unsigned int pages_sharing;
+
+  /** @brief  Number of stable frames currently in use */
+  unsigned int stable_frames;
+
+  /** @brief  Number of pages merged and split when counters were last
+   *          logged */
+  unsigned int logged_merged, logged_unmerged;
+
+} ksm_t;
+
+/* Daemon state */
+static ksm_t ksm;
+
+/* Descriptors for stable frames */
+static ksm_frame_t frame_pool[KSM_MAX_STABLE_FRAMES];
+
+/* Static functions prototypes */
+static void ksm_daemon(void);
+static void scan_batch(void);
+static void end_pass(void);
+static void switch_address_space(unsigned int *cr3);
+static int scan_page(unsigned int *entry_addr, unsigned int address);
+static void merge_zero_page(unsigned int *entry_addr, unsigned int address);
+static int merge_stable_page(unsigned int *entry_addr, unsigned int address,
+                             uint32_t checksum);
+static void merge_unstable_page(unsigned int *entry_addr, unsigned int address,
+                                uint32_t checksum);
+static int is_mergeable(unsigned int entry);
+static void map_merged(unsigned int *entry_addr, unsigned int address,
+                       unsigned int frame);
+static uint32_t page_checksum(uint32_t *page, int *is_zero);
+static int page_is_zero(uint32_t *page);
+static int frame_equals(unsigned int frame, unsigned int address);
+static ksm_frame_t *find_frame(unsigned int frame);
+static void insert_frame(ksm_frame_t *node);
+static void remove_frame(ksm_frame_t *node);
+
+/** @brief  Initializes the same-page merging state
+ *
+ *  Must be called once before any address space is registered.
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int ksm_init() {
+
+  memset(&ksm, 0, sizeof(ksm_t));
+
+  int i;
+  for (i = 0 ; i < KSM_MAX_STABLE_FRAMES ; ++i) {
+    frame_pool[i].next_sum = ksm.free_frames;
+    ksm.free_frames = &frame_pool[i];
+  }
+
+  return eff_mutex_init(&ksm.mutex);
+}
+
+/** @brief  Creates the same-page merging daemon thread and makes it runnable
+ *
+ *  Must be called after the first task is created, the daemon runs with the
+ *  first task's page directory when it is not scanning.
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int ksm_create_daemon() {
+
+  tcb_t *new_tcb = create_kernel_thread(ksm_daemon, KSM_DAEMON_TID, NULL,
+                                        kernel.init_cr3);
+  if (new_tcb == NULL) {
+    lprintf("ksm_create_daemon(): Failed to create the daemon thread");
+    return -1;
+  }
+
+  add_runnable_thread(new_tcb);
+
+  return 0;
+}
+
+/** @brief  Adds an address space to the ones scanned by the daemon
+ *
+ *  If the address space can not be registered, its pages are simply never
+ *  merged.
+ *
+ *  @param  cr3   The address space's page directory
+ *
+ *  @return void
+ */
+void ksm_register(unsigned int *cr3) {
+
+  ksm_space_t *space = malloc(sizeof(ksm_space_t));
+  if (space == NULL) {
+    lprintf("ksm_register(): Failed to register address space");
+    return;
+  }
+  space->cr3 = cr3;
+
+  eff_mutex_lock(&ksm.mutex);
+  space->next = ksm.spaces;
+  ksm.spaces = space;
+  eff_mutex_unlock(&ksm.mutex);
+}
+
+/** @brief  Removes an address space from the ones scanned by the daemon
+ *
+ *  Must be called before the address space's page tables are freed. When
+ *  the function returns, the daemon does not hold any reference to the
+ *  address space anymore. Has no effect if the address space is not
+ *  registered.
+ *
+ *  @param  cr3   The address space's page directory
+ *
+ *  @return void
+ */
+void ksm_unregister(unsigned int *cr3) {
+
+  eff_mutex_lock(&ksm.mutex);
+
+  ksm_space_t **it = &ksm.spaces;
+  while (*it != NULL && (*it)->cr3 != cr3) {
+    it = &(*it)->next;
+  }
+
+  ksm_space_t *space = *it;
+  if (space == NULL) {
+    eff_mutex_unlock(&ksm.mutex);
+    return;
+  }
+  *it = space->next;
+
+  if (ksm.cursor == space) {
+    ksm.cursor = space->next;
+    ksm.cursor_address = USER_MEM_START;
+  }
+
+  // Forget the candidate pages living in the address space
+  int enabled = save_and_disable_interrupts();
+  int i;
+  for (i = 0 ; i < KSM_UNSTABLE_SIZE ; ++i) {
+    if (ksm.unstable[i].cr3 == cr3) {
+      ksm.unstable[i].entry_addr = NULL;
+      ksm.unstable[i].cr3 = NULL;
+    }
+  }
+  restore_interrupts(enabled);
+
+  eff_mutex_unlock(&ksm.mutex);
+
+  free(space);
+}
+
+/** @brief  Accounts for a new page table entry mapping a merged frame
+ *
+ *  Used by fork() to share merged pages between parent and child.
+ *
+ *  @param  frame   The merged frame's physical address
+ *
+ *  @return void
+ */
+void ksm_get_frame(unsigned int frame) {
+
+  int enabled = save_and_disable_interrupts();
+
+  ++ksm.pages_sharing;
+  if (frame != kernel.zeroed_out_frame) {
+    ksm_frame_t *node = find_frame(frame);
+    assert(node != NULL);
+    ++node->refcount;
+  }
+
+  restore_interrupts(enabled);
+}
+
+/** @brief  Drops a page table entry mapping a merged frame
+ *
+ *  The frame is freed if the entry was its last mapping.
+ *
+ *  @param  frame   The merged frame's physical address
+ *
+ *  @return void
+ */
+void ksm_put_frame(unsigned int frame) {
+
+  int enabled = save_and_disable_interrupts();
+
+  --ksm.pages_sharing;
+  if (frame != kernel.zeroed_out_frame) {
+    ksm_frame_t *node = find_frame(frame);
+    assert(node != NULL);
+    if (--node->refcount == 0) {
+      remove_frame(node);
+      free_frame((unsigned int *)frame);
+    }
+  }
+
+  restore_interrupts(enabled);
+}
+
+/** @brief  Gives a private, writable copy of a merged page to the current
+ *          address space
+ *
+ *  Called by the page fault handler on a write to a merged page. If the page
+ *  is the frame's last mapping, the frame is simply made writable again.
+ *
+ *  @param  address   The faulting virtual address
+ *
+ *  @return 0 on success, a negative number if the address does not belong to
+ *          a merged page or if no frame is available
+ */
+int ksm_unmerge_page(unsigned int address) {
+
+  if (address < USER_MEM_START) {
+    return -1;
+  }
+  address &= PAGE_ADDR_MASK;
+
+  unsigned int *page_directory_entry_addr = get_page_dir_entry(address);
+  if (!is_entry_present(page_directory_entry_addr)) {
+    return -1;
+  }
+
+  unsigned int *page_table_entry_addr =
+      get_page_table_entry(page_directory_entry_addr, address);
+
+  // Another thread of the task may have split the page concurrently, in which
+  // case the faulting access can simply be retried
+  int enabled = save_and_disable_interrupts();
+  if (!is_entry_present(page_table_entry_addr) ||
+      !is_page_merged(page_table_entry_addr)) {
+    int ret = (is_entry_present(page_table_entry_addr) &&
+               (*page_table_entry_addr & PAGE_WRITABLE)) ? 0 : -1;
+    restore_interrupts(enabled);
+    return ret;
+  }
+
+  unsigned int frame = (unsigned int)get_frame_addr(page_table_entry_addr);
+  ksm_frame_t *node = NULL;
+  if (frame != kernel.zeroed_out_frame) {
+    node = find_frame(frame);
+    assert(node != NULL);
+  }
+
+  if (node != NULL && node->refcount == 1) {
+
+    // Last mapping, the page takes the frame (and its reservation) back
+    remove_frame(node);
+    *page_table_entry_addr = (frame & PAGE_ADDR_MASK) | PAGE_USER_FLAGS;
+
+  } else {
+
+    if (reserve_frames(1) < 0) {
+      restore_interrupts(enabled);
+      return -1;
+    }
+
+    unsigned int new_frame = (unsigned int)allocate_frame();
+    if (new_frame == 0) {
+      release_frames(1);
+      restore_interrupts(enabled);
+      return -1;
+    }
+
+    char *window = map_frame_window(new_frame);
+    if (node == NULL) {
+      memset(window, 0, PAGE_SIZE);
+    } else {
+      memcpy(window, (char *)address, PAGE_SIZE);
+      --node->refcount;
+    }
+    unmap_frame_window();
+
+    *page_table_entry_addr = (new_frame & PAGE_ADDR_MASK) | PAGE_USER_FLAGS;
+  }
+
+  invalidate_tlb(address);
+  --ksm.pages_sharing;
+  ++ksm.pages_unmerged;
+
+  restore_interrupts(enabled);
+
+  return 0;
+}
+
+/** @brief  Main function for the same-page merging daemon
+ *
+ *  @return Does not return
+ */
+static void ksm_daemon() {
+
+  while (1) {
+
+    kern_sleep(KSM_SLEEP_TICKS);
+
+    eff_mutex_lock(&ksm.mutex);
+    scan_batch();
+    eff_mutex_unlock(&ksm.mutex);
+  }
+}
+
+/** @brief  Scans the next few pages, starting from the cursor
+ *
+ *  At most KSM_PAGES_PER_BATCH candidate pages and KSM_ENTRIES_PER_BATCH
+ *  page directory/table entries are examined. Must be called with the
+ *  daemon's mutex held.
+ *
+ *  @return void
+ */
+static void scan_batch() {
+
+  int nb_pages = 0, nb_entries = 0;
+
+  if (ksm.cursor == NULL) {
+    // Start a new pass
+    ksm.cursor = ksm.spaces;
+    ksm.cursor_address = USER_MEM_START;
+  }
+
+  while (ksm.cursor != NULL && nb_pages < KSM_PAGES_PER_BATCH &&
+         nb_entries < KSM_ENTRIES_PER_BATCH) {
+
+    switch_address_space(ksm.cursor->cr3);
+
+    unsigned int address = ksm.cursor_address;
+    unsigned int *page_directory_entry_addr = get_page_dir_entry(address);
+    ++nb_entries;
+
+    if (!is_entry_present(page_directory_entry_addr)) {
+      // Skip the whole page table
+      address = (address & PAGE_TABLE_DIRECTORY_MASK) +
+                (1 << PAGE_DIR_RIGHT_SHIFT);
+    } else {
+      unsigned int *page_table_entry_addr =
+          get_page_table_entry(page_directory_entry_addr, address);
+      nb_pages += scan_page(page_table_entry_addr, address);
+      address += PAGE_SIZE;
+    }
+
+    if (address < USER_MEM_START) {
+      // Wrapped around the end of the address space, go to the next one
+      ksm.cursor = ksm.cursor->next;
+      ksm.cursor_address = USER_MEM_START;
+      if (ksm.cursor == NULL) {
+        end_pass();
+      }
+    } else {
+      ksm.cursor_address = address;
+    }
+  }
+
+  switch_address_space((unsigned int *)kernel.init_cr3);
+}
+
+/** @brief  Ends a pass over every address space
+ *
+ *  The unstable table is emptied, so that it only holds pages seen during the
+ *  next pass, and the counters are logged if pages were merged or split
+ *  since they were last logged.
+ *
+ *  @return void
+ */
+static void end_pass() {
+
+  int enabled = save_and_disable_interrupts();
+  int i;
+  for (i = 0 ; i < KSM_UNSTABLE_SIZE ; ++i) {
+    ksm.unstable[i].entry_addr = NULL;
+    ksm.unstable[i].cr3 = NULL;
+  }
+  unsigned int merged = ksm.pages_merged, unmerged = ksm.pages_unmerged;
+  restore_interrupts(enabled);
+
+  // Only log passes that changed something
+  if (merged == ksm.logged_merged && unmerged == ksm.logged_unmerged) {
+    return;
+  }
+  ksm.logged_merged = merged;
+  ksm.logged_unmerged = unmerged;
+
+  lprintf("ksm: %u pages scanned, %u merged, %u unmerged, %u pages sharing "
+          "%u frames, %u KB saved", ksm.pages_scanned, merged, unmerged,
+          ksm.pages_sharing, ksm.stable_frames,
+          (ksm.pages_sharing - ksm.stable_frames) * (PAGE_SIZE / 1024));
+}
+
+/** @brief  Makes the daemon run in an address space
+ *
+ *  @param  cr3   The address space's page directory
+ *
+ *  @return void
+ */
+static void switch_address_space(unsigned int *cr3) {
+  if (kernel.current_thread->cr3 != (uint32_t)cr3) {
+    kernel.current_thread->cr3 = (uint32_t)cr3;
+    set_cr3((uint32_t)cr3);
+  }
+}
+
+/** @brief  Tries to merge a page of the current address space
+ *
+ *  @param  entry_addr  The page table entry mapping the page
+ *  @param  address     The page's virtual address
+ *
+ *  @return 1 if the page was a candidate for merging, 0 otherwise
+ */
+static int scan_page(unsigned int *entry_addr, unsigned int address) {
+
+  if (!is_mergeable(*entry_addr)) {
+    return 0;
+  }
+
+  ++ksm.pages_scanned;
+
+  if (*entry_addr & DIRTY) {
+    // Written to since last time, look at the page again next pass
+    *entry_addr &= ~DIRTY;
+    invalidate_tlb(address);
+    return 1;
+  }
+
+  int is_zero;
+  uint32_t checksum = page_checksum((uint32_t *)address, &is_zero);
+
+  if (is_zero) {
+    merge_zero_page(entry_addr, address);
+  } else if (merge_stable_page(entry_addr, address, checksum) < 0) {
+    merge_unstable_page(entry_addr, address, checksum);
+  }
+
+  return 1;
+}
+
+/** @brief  Maps a page filled with zeros to the zeroed out frame
+ *
+ *  @param  entry_addr  The page table entry mapping the page
+ *  @param  address     The page's virtual address
+ *
+ *  @return void
+ */
+static void merge_zero_page(unsigned int *entry_addr, unsigned int address) {
+
+  irq_disable();
+
+  if (is_mergeable(*entry_addr) && page_is_zero((uint32_t *)address)) {
+    unsigned int frame = (unsigned int)get_frame_addr(entry_addr);
+    map_merged(entry_addr, address, kernel.zeroed_out_frame);
+    free_frame((unsigned int *)frame);
+    ++ksm.pages_merged;
+    ++ksm.pages_sharing;
+  }
+
+  irq_enable();
+}
+
+/** @brief  Maps a page to a stable frame with the same content, if any
+ *
+ *  @param  entry_addr  The page table entry mapping the page
+ *  @param  address     The page's virtual address
+ *  @param  checksum    The page's checksum
+ *
+ *  @return 0 if the page was merged, a negative number otherwise
+ */
+static int merge_stable_page(unsigned int *entry_addr, unsigned int address,
+                             uint32_t checksum) {
+
+  irq_disable();
+
+  ksm_frame_t *node = ksm.by_checksum[checksum % KSM_NB_BUCKETS];
+  for ( ; node != NULL ; node = node->next_sum) {
+
+    if (node->checksum != checksum || !is_mergeable(*entry_addr) ||
+        !frame_equals(node->frame, address)) {
+      continue;
+    }
+
+    unsigned int frame = (unsigned int)get_frame_addr(entry_addr);
+    map_merged(entry_addr, address, node->frame);
+    free_frame((unsigned int *)frame);
+    ++node->refcount;
+    ++ksm.pages_merged;
+    ++ksm.pages_sharing;
+
+    irq_enable();
+    return 0;
+  }
+
+  irq_enable();
+  return -1;
+}
+
+/** @brief  Merges a page with a page of the unstable table having the same
+ *          content, or adds the page to the table
+ *
+ *  On a match, the frame of the page in the table becomes a stable frame
+ *  mapped by both pages.
+ *
+ *  @param  entry_addr  The page table entry mapping the page
+ *  @param  address     The page's virtual address
+ *  @param  checksum    The page's checksum
+ *
+ *  @return void
+ */
+static void merge_unstable_page(unsigned int *entry_addr, unsigned int address,
+                                uint32_t checksum) {
+
+  irq_disable();
+
+  ksm_candidate_t *slot = &ksm.unstable[checksum % KSM_UNSTABLE_SIZE];
+
+  if (slot->entry_addr != NULL && slot->entry_addr != entry_addr &&
+      slot->checksum == checksum && ksm.free_frames != NULL) {
+
+    // The other page must still map the same frame and not have been
+    // written to since it was seen
+    unsigned int other = *slot->entry_addr;
+    if (is_mergeable(other) && !(other & DIRTY) &&
+        (other & PAGE_ADDR_MASK) == slot->frame &&
+        is_mergeable(*entry_addr) && frame_equals(slot->frame, address)) {
+
+      ksm_frame_t *node = ksm.free_frames;
+      ksm.free_frames = node->next_sum;
+      node->frame = slot->frame;
+      node->checksum = checksum;
+      node->refcount = 2;
+      insert_frame(node);
+
+      unsigned int frame = (unsigned int)get_frame_addr(entry_addr);
+      map_merged(entry_addr, address, slot->frame);
+      free_frame((unsigned int *)frame);
+
+      // The other page's TLB entry only needs to be flushed if it lives in
+      // the address space being scanned
+      *slot->entry_addr = (slot->frame & PAGE_ADDR_MASK) | PAGE_MERGED_BIT |
+                          PAGE_USER_RO_FLAGS;
+      if (slot->cr3 == (unsigned int *)kernel.current_thread->cr3) {
+        invalidate_tlb(slot->address);
+      }
+
+      slot->entry_addr = NULL;
+      slot->cr3 = NULL;
+
+      ++ksm.stable_frames;
+      ksm.pages_merged += 2;
+      ksm.pages_sharing += 2;
+
+      irq_enable();
+      return;
+    }
+  }
+
+  // Remember the page for the rest of the pass
+  slot->entry_addr = entry_addr;
+  slot->frame = (unsigned int)get_frame_addr(entry_addr);
+  slot->checksum = checksum;
+  slot->address = address;
+  slot->cr3 = (unsigned int *)kernel.current_thread->cr3;
+
+  irq_enable();
+}
+
+/** @brief  Checks whether a page table entry maps a private, writable user
+ *          page backed by its own frame
+ *
+ *  @param  entry   The page table entry
+ *
+ *  @return A non-zero value if the page may be merged, 0 otherwise
+ */
+static int is_mergeable(unsigned int entry) {
+
+  unsigned int user_flags = PAGE_USER_FLAGS;
+  unsigned int frame = entry & PAGE_ADDR_MASK;
+
+  return (entry & user_flags) == user_flags &&
+         !(entry & (PAGE_TABLE_RESERVED_BIT | PAGE_SHARED_BIT |
+                    PAGE_MERGED_BIT)) &&
+         frame >= USER_MEM_START && frame != kernel.zeroed_out_frame;
+}
+
+/** @brief  Maps a page of the current address space to a merged frame
+ *
+ *  @param  entry_addr  The page table entry mapping the page
+ *  @param  address     The page's virtual address
+ *  @param  frame       The merged frame's physical address
+ *
+ *  @return void
+ */
+static void map_merged(unsigned int *entry_addr, unsigned int address,
+                       unsigned int frame) {
+  *entry_addr = (frame & PAGE_ADDR_MASK) | PAGE_MERGED_BIT |
+                PAGE_USER_RO_FLAGS;
+  invalidate_tlb(address);
+}
+
+/** @brief  Computes the checksum of a page's content
+ *
+ *  @param  page      The page's address
+ *  @param  is_zero   Set to a non-zero value if the page is filled with zeros
+ *
+ *  @return The checksum
+ */
+static uint32_t page_checksum(uint32_t *page, int *is_zero) {
+
+  uint32_t checksum = 0, bits = 0;
+
+  int i;
+  for (i = 0 ; i < WORDS_PER_PAGE ; ++i) {
+    checksum = ((checksum << 5) + checksum) ^ page[i];
+    bits |= page[i];
+  }
+
+  *is_zero = (bits == 0);
+  return checksum;
+}
+
+/** @brief  Checks whether a page is filled with zeros
+ *
+ *  @param  page  The page's address
+ *
+ *  @return A non-zero value if the page is filled with zeros, 0 otherwise
+ */
+static int page_is_zero(uint32_t *page) {
+
+  int i;
+  for (i = 0 ; i < WORDS_PER_PAGE ; ++i) {
+    if (page[i] != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/** @brief  Compares a frame's content with a page of the current address
+ *          space
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @param  frame     The frame's physical address
+ *  @param  address   The page's virtual address
+ *
+ *  @return A non-zero value if the contents are identical, 0 otherwise
+ */
+static int frame_equals(unsigned int frame, unsigned int address) {
+
+  char *window = map_frame_window(frame);
+  int equal = (memcmp(window, (char *)address, PAGE_SIZE) == 0);
+  unmap_frame_window();
+
+  return equal;
+}
+
+/** @brief  Finds the descriptor of a stable frame
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @param  frame   The frame's physical address
+ *
+ *  @return The frame's descriptor, NULL if the frame is not a stable frame
+ */
+static ksm_frame_t *find_frame(unsigned int frame) {
+
+  ksm_frame_t *node =
+      ksm.by_frame[(frame >> PAGE_SIZE_LOG2) % KSM_NB_BUCKETS];
+  while (node != NULL && node->frame != frame) {
+    node = node->next_frame;
+  }
+  return node;
+}
+
+/** @brief  Adds a stable frame to both hash tables
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @param  node  The frame's descriptor
+ *
+ *  @return void
+ */
+static void insert_frame(ksm_frame_t *node) {
+
+  ksm_frame_t **sum_bucket = &ksm.by_checksum[node->checksum % KSM_NB_BUCKETS];
+  node->next_sum = *sum_bucket;
+  *sum_bucket = node;
+
+  ksm_frame_t **frame_bucket =
+      &ksm.by_frame[(node->frame >> PAGE_SIZE_LOG2) % KSM_NB_BUCKETS];
+  node->next_frame = *frame_bucket;
+  *frame_bucket = node;
+}
+
+/** @brief  Removes a stable frame from both hash tables and puts its
+ *          descriptor back in the free list
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @param  node  The frame's descriptor
+ *
+ *  @return void
+ */
+static void remove_frame(ksm_frame_t *node) {
+
+  ksm_frame_t **it = &ksm.by_checksum[node->checksum % KSM_NB_BUCKETS];
+  while (*it != node) {
+    it = &(*it)->next_sum;
+  }
+  *it = node->next_sum;
+
+  it = &ksm.by_frame[(node->frame >> PAGE_SIZE_LOG2) % KSM_NB_BUCKETS];
+  while (*it != node) {
+    it = &(*it)->next_frame;
+  }
+  *it = node->next_frame;
+
+  node->next_sum = ksm.free_frames;
+  ksm.free_frames = node;
+  --ksm.stable_frames;
+}
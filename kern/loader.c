@@ -1,6 +1,7 @@
 /** @file   loader.c
  *  @brief  This file contains the definition for the get_bytes() function,
- *          which allows to copy data from a file into a buffer.
+ *          which allows to copy data from a file into a buffer, and for the
+ *          get_file_size() function.
  *  @author akanjani, lramire1
  */
 
@@ -61,3 +62,22 @@ int getbytes( const char *filename, int offset, int size, char *buf ) {
   return -1;
 }
 
+/** @brief  Gets the size of a file
+ *
+ *  @param  filename   The name of the file
+ *
+ *  @return The file's size (in bytes) on success, -1 if no file exists with
+ *          the given filename
+ */
+int get_file_size( const char *filename ) {
+
+  int i;
+  for (i = 0; i < MAX_NUM_APP_ENTRIES; i++) {
+    if (!strcmp(exec2obj_userapp_TOC[i].execname, filename)) {
+      return exec2obj_userapp_TOC[i].execlen;
+    }
+  }
+
+  // No file exists with the given filename
+  return -1;
+}
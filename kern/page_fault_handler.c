@@ -9,7 +9,13 @@
 #include <seg.h>
 #include <simics.h>
 #include <virtual_memory_helper.h>
+#include <common_kern.h>
+#include <ksm.h>
+#include <swap.h>
 #include <cr.h>
+#include <eflags.h>
+#include <ureg.h>
+#include <irq_trace.h>
 #include <syscalls.h>
 #include <kernel_state.h>
 #include <string.h>
@@ -19,6 +25,18 @@
 #define PAGE_FAULT_IDT 0xE
 #define NB_REGISTERS_POPA 8
 
+/* Offset of the faulting code's EFLAGS from the start of the saved state
+ * (segment selectors, popa registers, return address in the wrapper, error
+ * code, %eip and %cs) */
+#define SAVED_EFLAGS_OFFSET 64
+
+/* Number of bytes pushed on the exception stack of a user-registered handler
+ * (a ureg and the handler's arguments) */
+#define SWEXN_FRAME_SIZE (sizeof(ureg_t) + 4 * sizeof(void *))
+
+/* Static functions prototypes */
+static int is_frame_owed(unsigned int address);
+
 /** @brief  Registers the page fault handler in the IDT
  *
  *  @return 0 on success, a negative number on error
@@ -37,7 +55,11 @@ int page_fault_init(void) {
  *
  *  The function first checks whether the page fault is cause by a first write
  *  to a page allocated with new_pages(), in which case it allocates the page
- *  and returns void. If that is not the case, the user-registered handler (if
+ *  and returns void, or by a write to a page merged by the same-page merging
+ *  daemon, in which case the page gets its own copy of the frame. If the
+ *  faulting code ran with interrupts enabled, a page whose content is in the
+ *  swap area is paged back in first. If that is not the case, the
+ *  user-registered handler (if
  *  any) is called. If the handler is not able to resolve the issue, the kernel
  *  sets the current task's exit status to -2 and kill the faulting thread.   
  *
@@ -50,7 +72,46 @@ int page_fault_init(void) {
  */
 void page_fault_c_handler(char *stack_ptr) {
 
-  if (allocate_frame_if_address_requested(get_cr2()) < 0) {
+  unsigned int address = get_cr2();
+
+  // The handler runs with interrupts disabled, it may only block (to read
+  // from the swap area) if the faulting code could
+  int can_block =
+      *(unsigned int *)(stack_ptr + SAVED_EFLAGS_OFFSET) & EFL_IF;
+
+  if (can_block) {
+    irq_enable();
+    int swapped_in = swap_in_page(address);
+    irq_disable();
+
+    // Allocating a frame below can not wait for the swapper. A requested or
+    // merged page holds a frame reservation, so wait for a frame even if the
+    // swapper is stalled instead of killing the thread
+    swap_wait_for_frames(is_frame_owed(address) ? SWAP_WAIT_STALLED_TRUE :
+                                                  SWAP_WAIT_STALLED_FALSE);
+
+    // Another thread may have faulted while this one was blocked
+    set_cr2(address);
+
+    if (swapped_in == 0) {
+      return;
+    }
+  }
+
+  if (allocate_frame_if_address_requested(address) < 0 &&
+      ksm_unmerge_page(address) < 0) {
+
+    if (can_block &&
+        kernel.current_thread->swexn_values.esp3 != NULL) {
+      // The handler's stack is written to with interrupts disabled, so it
+      // must not be in the swap area
+      irq_enable();
+      swap_in_range((unsigned int)kernel.current_thread->swexn_values.esp3 -
+                    SWEXN_FRAME_SIZE, SWEXN_FRAME_SIZE);
+      irq_disable();
+      set_cr2(address);
+    }
+
     // Calls the user-registered handler, if any
     create_stack_sw_exception(SWEXN_CAUSE_PAGEFAULT, stack_ptr);
 
@@ -60,7 +121,7 @@ void page_fault_c_handler(char *stack_ptr) {
     char err_msg[] = "Vanishing thread due to a PAGE FAULT at address";
     kern_print_helper(strlen(err_msg), err_msg);
     char addr_string[10];
-    snprintf(addr_string, 10, "%x", (unsigned int)get_cr2());
+    snprintf(addr_string, 10, "%x", address);
     kern_print_helper(strlen(addr_string), addr_string);
     char *regs[] = {"\nedi: ", "\nesi: ", "\nebp: ", "\nesp: ", "\nebx: ", 
                     "\nedx: ", "\necx: ", "\neax: "};
@@ -76,6 +137,35 @@ void page_fault_c_handler(char *stack_ptr) {
     kern_vanish();
   }
   
-  // The page fault was because of the ZFOD system, we can return to user-space
+  // The page fault was because of the ZFOD system, of a merged page or of a
+  // page in the swap area, we can return to the faulting code
   return;
 }
+
+/** @brief  Tells whether a page of the current address space is owed a frame
+ *          on a fault, i.e. it was requested with new_pages() and not
+ *          touched yet, or it is merged with other pages
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @param  address   A virtual address in the page
+ *
+ *  @return 1 if the page holds a frame reservation but no frame of its own,
+ *          0 otherwise
+ */
+static int is_frame_owed(unsigned int address) {
+
+  if (address < USER_MEM_START) {
+    return 0;
+  }
+
+  unsigned int *page_directory_entry_addr = get_page_dir_entry(address);
+  if (!is_entry_present(page_directory_entry_addr)) {
+    return 0;
+  }
+
+  unsigned int *page_table_entry_addr =
+      get_page_table_entry(page_directory_entry_addr, address);
+  return is_page_requested(page_table_entry_addr) ||
+         is_page_merged(page_table_entry_addr);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 1996-1995 The University of Utah and
+ * the Computer Systems Laboratory at the University of Utah (CSL).
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <simics.h>
+#include <x86/asm.h>
+#include <console_ring.h>
+#include <serial.h>
+
+/*
+ * This function is called by the assert() macro defined in assert.h;
+ * it's also a nice simple general-purpose panic function.
+ *
+ * Overrides the 410kern version so that output still queued in the console
+ * ring is rendered before the panic message, and so that the message reaches
+ * the serial port although its interrupts are disabled.
+ */
+void panic(const char *fmt, ...)
+{
+	va_list vl;
+
+	disable_interrupts();
+	console_ring_flush_panic();
+
+	va_start(vl, fmt);
+	sim_vprintf(fmt, vl);
+	va_end(vl);
+
+	va_start(vl, fmt);
+	vprintf(fmt, vl);
+	va_end(vl);
+	printf("\n");
+	serial_drain_polled();
+
+	/*
+	 * loop with interrupts disabled.
+	 */
+	while(1)
+		continue;
+}
@@ -0,0 +1,405 @@
+/** @file reaper.c
+ *  @brief  This file contains the definitions for the reaper thread, which
+ *          tears down dead address spaces in the background
+ *
+ *  When a task vanishes or execs, its old page directory is handed to the
+ *  reaper instead of being freed by the exiting thread, so that neither the
+ *  parent's wait() nor the new program pays for the old image's cleanup. The
+ *  reaper also frees the TCBs and kernel stacks of dead threads queued in the
+ *  kernel's garbage collector.
+ *
+ *  To stay out of the way of user tasks, the reaper thread belongs to a
+ *  pseudo-task holding a single ticket, so the stride scheduler only gives it
+ *  the CPU share of the lightest task. When frames are running low or a
+ *  thread is waiting for the frames being freed (see reaper_reserve_frames()),
+ *  the pseudo-task is given the maximum weight until the reaper has caught up.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <reaper.h>
+#include <page.h>
+#include <kernel_state.h>
+#include <context_switch.h>
+#include <scheduler.h>
+#include <variable_queue.h>
+#include <eff_mutex.h>
+#include <malloc.h>
+#include <string.h>
+
+/* VM system */
+#include <virtual_memory.h>
+#include <virtual_memory_defines.h>
+
+/* Debugging */
+#include <simics.h>
+#include <assert.h>
+
+/* Weight of the reaper's pseudo-task when nobody needs frames */
+#define REAPER_WEIGHT 1
+
+/* Weight of the reaper's pseudo-task when frames are needed */
+#define REAPER_URGENT_WEIGHT MAX_TASK_WEIGHT
+
+/* Below this many free frames, the reaper runs with REAPER_URGENT_WEIGHT */
+#define REAPER_LOW_FRAMES 256
+
+/* Thread id of the reaper (no other thread is allowed to have this tid) */
+#define REAPER_TID -3
+
+/** @brief  A dead address space waiting to be torn down */
+typedef struct reaper_job {
+
+  /** @brief  The address space's page directory */
+  unsigned int *cr3;
+
+  /** @brief  Number of frames reserved by the task, released once the
+   *          address space is gone */
+  unsigned int nb_frames;
+
+  /** @brief  The task's list of new_pages() allocations */
+  alloc_queue_t allocations;
+
+  /** @brief  Link in the reaper's queue of jobs */
+  Q_NEW_LINK(reaper_job) link;
+
+} reaper_job_t;
+
+/** @brief  A queue of reaper jobs */
+Q_NEW_HEAD(reaper_job_queue_t, reaper_job);
+
+/** @brief  State of the reaper */
+typedef struct reaper {
+
+  /** @brief  Mutex protecting the reaper's state */
+  eff_mutex_t mutex;
+
+  /** @brief  The reaper thread, NULL until it is created */
+  tcb_t *thread;
+
+  /** @brief  Indicates whether the reaper is blocked waiting for work */
+  int idle;
+
+  /** @brief  Indicates whether there may be work in the garbage collector */
+  int gc_pending;
+
+  /** @brief  Address spaces waiting to be torn down */
+  reaper_job_queue_t jobs;
+
+  /** @brief  Number of address spaces queued or being torn down */
+  unsigned int nb_pending;
+
+  /** @brief  Threads waiting for the reaper to free frames */
+  tcb_queue_t waiters;
+
+  /** @brief  Number of address spaces torn down since boot */
+  unsigned int nb_reaped;
+
+  /** @brief  Pseudo-task the reaper thread is scheduled as */
+  pcb_t task;
+
+} reaper_t;
+
+/* Reaper state */
+static reaper_t reaper;
+
+/* Static functions prototypes */
+static void reaper_thread(void);
+static void reap(reaper_job_t *job);
+static void drain_garbage_collector(void);
+static void wake_reaper_locked(void);
+static int init_reaper_task(void);
+
+/** @brief  Initializes the reaper's state
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int reaper_init() {
+
+  if (eff_mutex_init(&reaper.mutex) < 0) {
+    return -1;
+  }
+
+  reaper.thread = NULL;
+  reaper.idle = 0;
+  reaper.gc_pending = 0;
+  reaper.nb_pending = 0;
+  reaper.nb_reaped = 0;
+  Q_INIT_HEAD(&reaper.jobs);
+  Q_INIT_HEAD(&reaper.waiters);
+
+  return 0;
+}
+
+/** @brief  Creates the reaper thread and makes it runnable
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int reaper_create_thread() {
+
+  // Create the pseudo-task the reaper is scheduled as
+  if (init_reaper_task() < 0) {
+    lprintf("reaper_create_thread(): Failed to create the reaper's task");
+    return -1;
+  }
+
+  tcb_t *new_tcb = create_kernel_thread(reaper_thread, REAPER_TID,
+                                        &reaper.task, kernel.init_cr3);
+  if (new_tcb == NULL) {
+    lprintf("reaper_create_thread(): Failed to create the reaper thread");
+    task_heap_release_slot(&kernel.runnable_tasks);
+    return -1;
+  }
+
+  reaper.thread = new_tcb;
+  add_runnable_thread(new_tcb);
+
+  return 0;
+}
+
+/** @brief  Hands a dead address space to the reaper
+ *
+ *  The address space must not be used by any thread anymore. If the reaper
+ *  can not take it, the address space is torn down by the invoking thread.
+ *
+ *  @param  cr3           The address space's page directory
+ *  @param  nb_frames     Number of frames to release once the address space
+ *                        is gone
+ *  @param  allocations   The task's list of new_pages() allocations, moved to
+ *                        the reaper and freed with the address space (may be
+ *                        NULL)
+ *
+ *  @return void
+ */
+void reaper_free_address_space(unsigned int *cr3, unsigned int nb_frames,
+                               alloc_queue_t *allocations) {
+
+  reaper_job_t inline_job;
+  reaper_job_t *job = malloc(sizeof(reaper_job_t));
+  int run_inline = (job == NULL || reaper.thread == NULL);
+  if (run_inline) {
+    if (job != NULL) {
+      free(job);
+    }
+    job = &inline_job;
+  }
+
+  job->cr3 = cr3;
+  job->nb_frames = nb_frames;
+  Q_INIT_HEAD(&job->allocations);
+  if (allocations != NULL) {
+    job->allocations = *allocations;
+    Q_INIT_HEAD(allocations);
+  }
+
+  if (run_inline) {
+    lprintf("reaper_free_address_space(): Tearing down address space inline");
+    reap(job);
+    return;
+  }
+
+  eff_mutex_lock(&reaper.mutex);
+  Q_INSERT_TAIL(&reaper.jobs, job, link);
+  ++reaper.nb_pending;
+  wake_reaper_locked();
+  eff_mutex_unlock(&reaper.mutex);
+}
+
+/** @brief  Tells the reaper that there is memory to free in the kernel's
+ *          garbage collector
+ *
+ *  @return void
+ */
+void reaper_wake() {
+
+  if (reaper.thread == NULL) {
+    return;
+  }
+
+  eff_mutex_lock(&reaper.mutex);
+  reaper.gc_pending = 1;
+  wake_reaper_locked();
+  eff_mutex_unlock(&reaper.mutex);
+}
+
+/** @brief  Reserves frames, waiting for the reaper if needed
+ *
+ *  When there are not enough free frames but address spaces are still waiting
+ *  to be torn down, the invoking thread blocks until the reaper is done with
+ *  them and tries again. Must not be called with interrupts disabled.
+ *
+ *  @param  nb  The number of frames to reserve
+ *
+ *  @return 0 on success, a negative number if there are not enough frames
+ *          even once the reaper is idle
+ */
+int reaper_reserve_frames(unsigned int nb) {
+
+  while (reserve_frames(nb) < 0) {
+
+    eff_mutex_lock(&reaper.mutex);
+
+    if (reaper.nb_pending == 0) {
+      eff_mutex_unlock(&reaper.mutex);
+
+      // The reaper may have finished between the two checks
+      return reserve_frames(nb);
+    }
+
+    // Wait for the reaper to make progress
+    Q_INSERT_TAIL(&reaper.waiters, kernel.current_thread, wait_link);
+    set_task_weight(&reaper.task, REAPER_URGENT_WEIGHT);
+    wake_reaper_locked();
+    block_and_switch(HOLDING_MUTEX_TRUE, &reaper.mutex);
+  }
+
+  return 0;
+}
+
+/** @brief  Main function for the reaper thread
+ *
+ *  @return Does not return
+ */
+static void reaper_thread() {
+
+  while (1) {
+
+    eff_mutex_lock(&reaper.mutex);
+
+    // Wait for some work
+    while (Q_GET_FRONT(&reaper.jobs) == NULL && !reaper.gc_pending) {
+      reaper.idle = 1;
+      block_and_switch(HOLDING_MUTEX_TRUE, &reaper.mutex);
+      eff_mutex_lock(&reaper.mutex);
+    }
+
+    reaper.gc_pending = 0;
+    reaper_job_t *job = Q_GET_FRONT(&reaper.jobs);
+    if (job != NULL) {
+      Q_REMOVE(&reaper.jobs, job, link);
+    }
+
+    eff_mutex_unlock(&reaper.mutex);
+
+    drain_garbage_collector();
+
+    if (job == NULL) {
+      continue;
+    }
+
+    reap(job);
+    free(job);
+
+    eff_mutex_lock(&reaper.mutex);
+
+    --reaper.nb_pending;
+    ++reaper.nb_reaped;
+
+    // Let the waiting threads try to reserve their frames again, they come
+    // back to the waiters queue if they still miss frames
+    tcb_t *waiter;
+    while ((waiter = Q_GET_FRONT(&reaper.waiters)) != NULL) {
+      Q_REMOVE(&reaper.waiters, waiter, wait_link);
+      add_runnable_thread(waiter);
+    }
+
+    // Stay behind user tasks unless frames are running low
+    int urgent = Q_GET_FRONT(&reaper.jobs) != NULL &&
+                 kernel.free_frame_count < REAPER_LOW_FRAMES;
+    set_task_weight(&reaper.task, urgent ? REAPER_URGENT_WEIGHT :
+                                           REAPER_WEIGHT);
+
+    eff_mutex_unlock(&reaper.mutex);
+  }
+}
+
+/** @brief  Tears down an address space
+ *
+ *  @param  job   The address space to tear down
+ *
+ *  @return void
+ */
+static void reap(reaper_job_t *job) {
+
+  free_address_space(job->cr3, KERNEL_AND_USER_SPACE);
+  release_frames(job->nb_frames);
+
+  alloc_t *allocation;
+  while ((allocation = Q_GET_FRONT(&job->allocations)) != NULL) {
+    Q_REMOVE(&job->allocations, allocation, link);
+    free(allocation);
+  }
+}
+
+/** @brief  Frees the TCBs and kernel stacks of dead threads
+ *
+ *  A thread queues its own TCB while holding the garbage collector's mutex,
+ *  and releases it with interrupts disabled right before switching away for
+ *  the last time, so everything in the queue can be freed. The kernel stack
+ *  of a task's last thread is left to wait().
+ *
+ *  @return void
+ */
+static void drain_garbage_collector() {
+
+  eff_mutex_lock(&kernel.gc.mp);
+  tcb_t *dead;
+  while ((dead = Q_GET_FRONT(&kernel.gc.zombie_memory)) != NULL) {
+    Q_REMOVE(&kernel.gc.zombie_memory, dead, wait_link);
+    if (dead->free_stack) {
+      free((void *)(dead->esp0 - PAGE_SIZE));
+    }
+    free(dead);
+  }
+  eff_mutex_unlock(&kernel.gc.mp);
+}
+
+/** @brief  Makes the reaper runnable if it is waiting for work
+ *
+ *  Must be called with the reaper's mutex held.
+ *
+ *  @return void
+ */
+static void wake_reaper_locked() {
+  if (reaper.idle) {
+    reaper.idle = 0;
+    add_runnable_thread(reaper.thread);
+  }
+}
+
+/** @brief  Initializes the pseudo-task the reaper thread is scheduled as
+ *
+ *  The pseudo-task is never added to the PCBs hash table, it only holds the
+ *  reaper's scheduling state.
+ *
+ *  @return 0 on success, a negative number on error
+ */
+static int init_reaper_task() {
+
+  pcb_t *task = &reaper.task;
+  memset(task, 0, sizeof(pcb_t));
+
+  if (eff_mutex_init(&task->mutex) < 0 ||
+      eff_mutex_init(&task->list_mutex) < 0) {
+    return -1;
+  }
+
+  Q_INIT_HEAD(&task->allocations);
+  Q_INIT_HEAD(&task->shm_attachments);
+  Q_INIT_HEAD(&task->running_children);
+  Q_INIT_HEAD(&task->zombie_children);
+  Q_INIT_HEAD(&task->waiting_threads);
+  Q_INIT_HEAD(&task->runnable_threads);
+
+  task->tid = REAPER_TID;
+  task->task_state = TASK_RUNNING;
+  task->num_of_threads = 1;
+  task->weight = REAPER_WEIGHT;
+  task->donated_weight = 0;
+  task->stride = STRIDE_ONE / REAPER_WEIGHT;
+  task->pass = kernel.global_pass;
+  task->heap_index = TASK_NOT_IN_HEAP;
+
+  // Reserve a slot for the task in the scheduler's heap
+  return task_heap_reserve_slot(&kernel.runnable_tasks);
+}
@@ -1,25 +1,58 @@
 /** @file scheduler.c
  *  @brief  This file contains the definition for the functions related to
  *          thread scheduling
+ *
+ *  Kernel threads (threads without a task) are kept in a FIFO queue and run
+ *  first, but only for KERNEL_MAX_STREAK quanta in a row while a user task is
+ *  runnable, so that a busy kernel thread can not starve user tasks. User
+ *  threads are scheduled with a stride scheduler: each task
+ *  holds a number of tickets (its weight) and the task with the smallest pass
+ *  value is picked from a min-heap each time a thread has to be chosen. Its
+ *  pass is then advanced by its stride (STRIDE_ONE / weight). Threads of the
+ *  same task are run in a round robin fashion, so the CPU share of a task
+ *  does not depend on how many threads it has.
+ *
  *  @author akanjani, lramire1
  */
 
 #include <asm.h>
+#include <irq_trace.h>
 #include <context_switch.h>
 #include <kernel_state.h>
 #include <scheduler.h>
-#include <generic_node.h>
+#include <variable_queue.h>
 #include <stdlib.h>
 #include <tcb.h>
-#include <page.h>
 
+#include <eflags.h>
 #include <assert.h>
 #include <simics.h>
 
-/** @brief  Returns the next thread to run from the queue of runnable threads
+/* Maximum number of kernel threads picked in a row while a user task is
+ * runnable */
+#define KERNEL_MAX_STREAK 4
+
+/* Set when a timer tick could not preempt the running thread */
+static int need_resched = NEED_RESCHED_FALSE;
+
+/* Number of kernel threads picked in a row while a user task was runnable */
+static unsigned int kernel_streak = 0;
+
+/* Static functions prototypes */
+static void enqueue_runnable(tcb_t *tcb);
+static void remove_runnable(tcb_t *tcb);
+static void charge_task(pcb_t *task);
+static void update_stride(pcb_t *task);
+
+/** @brief  Returns the next thread to run and removes it from the runnable
+ *          threads
  *
- *  If the queue of runnable threads is empty, then the function returns the
- *  TCB of the idle thread
+ *  Runnable kernel threads are returned first, unless KERNEL_MAX_STREAK of
+ *  them were picked in a row while a user task was runnable. Otherwise, the
+ *  task with the smallest pass value is charged for one quantum and its first
+ *  runnable thread is returned. If no thread is runnable, then the function
+ *  returns the TCB of the idle thread. Must be called with interrupts
+ *  disabled.
  *
  *  @return The next thread's TCB
  */
@@ -28,13 +61,36 @@ tcb_t *next_thread() {
   // Check if the kernel state is initialized
   assert(kernel.current_thread != NULL && kernel.init == KERNEL_INIT_TRUE);
 
-  generic_node_t *next_thread = stack_queue_dequeue(&kernel.runnable_queue);
-  if (next_thread == NULL) {
-    // If the queue is empty, run the idle thread
+  need_resched = NEED_RESCHED_FALSE;
+
+  tcb_t *next_thread = Q_GET_FRONT(&kernel.runnable_queue);
+  pcb_t *task = task_heap_min(&kernel.runnable_tasks);
+
+  if (next_thread != NULL &&
+      (task == NULL || kernel_streak < KERNEL_MAX_STREAK)) {
+    Q_REMOVE(&kernel.runnable_queue, next_thread, runq_link);
+    if (task != NULL) {
+      ++kernel_streak;
+    }
+    return next_thread;
+  }
+
+  kernel_streak = 0;
+
+  if (task == NULL) {
+    // If no thread is runnable, run the idle thread
     return kernel.idle_thread;
   }
 
-  return next_thread->value;
+  next_thread = Q_GET_FRONT(&task->runnable_threads);
+  assert(next_thread != NULL);
+  Q_REMOVE(&task->runnable_threads, next_thread, runq_link);
+
+  // The virtual time is the pass of the task we are giving the CPU to
+  kernel.global_pass = task->pass;
+  charge_task(task);
+
+  return next_thread;
 
 }
 
@@ -50,7 +106,7 @@ void make_runnable_and_switch() {
 
   assert(kernel.current_thread != NULL && kernel.init == KERNEL_INIT_TRUE);
 
-  disable_interrupts();
+  irq_disable();
 
   kernel.current_thread->thread_state = THR_RUNNABLE;
 
@@ -59,13 +115,42 @@ void make_runnable_and_switch() {
     return;
   }
 
-  generic_node_t new_tail = {kernel.current_thread, NULL};
-  stack_queue_enqueue(&kernel.runnable_queue, &new_tail);
+  enqueue_runnable(kernel.current_thread);
 
   context_switch(next_thread());
   
 }
 
+/** @brief  Asks for the running thread to be preempted at the next
+ *          preemption point
+ *
+ *  Used by the timer interrupt handler when it cannot switch threads itself
+ *  (e.g. when it interrupted bottom halves).
+ *
+ *  @return void
+ */
+void request_resched() {
+  need_resched = NEED_RESCHED_TRUE;
+}
+
+/** @brief  Yields the CPU if a reschedule was requested since the invoking
+ *          thread was last scheduled
+ *
+ *  Long kernel loops call this function between iterations so that a
+ *  deferred timer tick does not wait for the loop to finish. The function has
+ *  no effect if interrupts are disabled, as the caller may then rely on not
+ *  being preempted.
+ *
+ *  @return void
+ */
+void preempt_point() {
+  if (need_resched == NEED_RESCHED_TRUE &&
+      kernel.kernel_ready == KERNEL_READY_TRUE &&
+      (get_eflags() & EFL_IF)) {
+    make_runnable_and_switch();
+  }
+}
+
 /** @brief  Blocks the invoking thread and context switches to another thread
  *
  *  @param  holding_mutex Indicates whether the function should unlock mutex
@@ -79,7 +164,7 @@ void block_and_switch(int holding_mutex, eff_mutex_t *mp) {
 
   assert(kernel.current_thread != NULL && kernel.init == KERNEL_INIT_TRUE);
 
-  disable_interrupts();
+  irq_disable();
 
   if (holding_mutex == HOLDING_MUTEX_TRUE) {
     eff_mutex_unlock(mp);
@@ -105,26 +190,21 @@ void add_runnable_thread(tcb_t *tcb) {
   assert(tcb != NULL && kernel.init == KERNEL_INIT_TRUE);
   assert(tcb != kernel.idle_thread);
 
-  disable_interrupts();
+  irq_disable();
 
   // Reject the call if the thread is already in the runnable queue
   if (tcb->thread_state == THR_RUNNABLE) {
-    enable_interrupts();
+    irq_enable();
     return;
   }
 
 
   tcb->thread_state = THR_RUNNABLE;
 
-  // Create node at the lowest address of the thread's kernel stack
-  generic_node_t new_tail = {tcb, NULL};
-  generic_node_t * node_addr = (generic_node_t *)(tcb->esp0 - PAGE_SIZE);
-  *(node_addr) = new_tail;
-
   // Enqueue the thread
-  stack_queue_enqueue(&kernel.runnable_queue, node_addr);
+  enqueue_runnable(tcb);
 
-  enable_interrupts();
+  irq_enable();
 
 }
 
@@ -152,13 +232,8 @@ void add_runnable_thread_noint(tcb_t *tcb) {
 
   tcb->thread_state = THR_RUNNABLE;
 
-  // Create node at the lowest address of the thread's kernel stack
-  generic_node_t new_tail = {tcb, NULL};
-  generic_node_t * node_addr = (generic_node_t *)(tcb->esp0 - PAGE_SIZE);
-  *(node_addr) = new_tail;
-
   // Enqueue the thread
-  stack_queue_enqueue(&kernel.runnable_queue, node_addr);
+  enqueue_runnable(tcb);
 
 }
 
@@ -180,38 +255,198 @@ int force_next_thread(tcb_t *force_next_tcb) {
          kernel.init == KERNEL_INIT_TRUE);
   assert(force_next_tcb != kernel.idle_thread);
 
-  disable_interrupts();    
+  irq_disable();    
 
   if (force_next_tcb->thread_state != THR_RUNNABLE) {
-    enable_interrupts();
+    irq_enable();
     return -1;
   }
 
   kernel.current_thread->thread_state = THR_RUNNABLE;
 
-  // Create new node for runnable queue
-  generic_node_t new_tail = {kernel.current_thread, NULL};
-
   // Enqueue the current thread
-  stack_queue_enqueue(&kernel.runnable_queue, &new_tail);
-
-  // Traverse the queue of runnable threads and delete any occurence of the
-  // forced thread
-  generic_node_t *it = kernel.runnable_queue.head, *prev = NULL;
-  while (it != NULL) {
-    if (it->value == force_next_tcb) {
-      if (prev == NULL) {
-        kernel.runnable_queue.head = it->next;
-      } else {
-        prev->next = it->next;
-      }
-    }
-    prev = it;
-    it = it->next;
-  }
+  enqueue_runnable(kernel.current_thread);
+
+  // Delete the forced thread from the runnable threads and charge its task
+  // for the quantum it is about to receive
+  remove_runnable(force_next_tcb);
 
   context_switch(force_next_tcb);
 
   return 0;
 
 }
+
+/** @brief  Sets the scheduling weight of a task
+ *
+ *  @param  task    The task
+ *  @param  weight  The task's new number of tickets, between 1 and
+ *                  MAX_TASK_WEIGHT
+ *
+ *  @return void
+ */
+void set_task_weight(pcb_t *task, uint32_t weight) {
+
+  assert(task != NULL && weight > 0 && weight <= MAX_TASK_WEIGHT);
+
+  irq_disable();
+  task->weight = weight;
+  update_stride(task);
+  irq_enable();
+}
+
+/** @brief  Lends tickets to a task, or takes back lent tickets
+ *
+ *  Used by eff_mutex to let the owner of a contended mutex run with the
+ *  tickets of the threads waiting on it (priority inheritance). Must be
+ *  called with interrupts disabled.
+ *
+ *  @param  task    The task
+ *  @param  amount  The number of tickets to lend (positive) or to take back
+ *                  (negative)
+ *
+ *  @return void
+ */
+void donate_weight(pcb_t *task, int amount) {
+
+  assert(task != NULL);
+  assert(amount >= 0 || task->donated_weight >= (uint32_t)(-amount));
+
+  task->donated_weight += amount;
+  update_stride(task);
+}
+
+/** @brief  Returns the number of tickets a thread currently runs with
+ *
+ *  Kernel threads are favored over user threads, so they are given the
+ *  maximum weight.
+ *
+ *  @param  tcb   The thread's TCB
+ *
+ *  @return The thread's weight, including tickets lent to its task
+ */
+uint32_t thread_weight(tcb_t *tcb) {
+
+  assert(tcb != NULL);
+
+  if (tcb->task == NULL) {
+    return MAX_TASK_WEIGHT;
+  }
+
+  uint32_t weight = tcb->task->weight + tcb->task->donated_weight;
+  return (weight > MAX_TASK_WEIGHT) ? MAX_TASK_WEIGHT : weight;
+}
+
+/** @brief  Adds a thread to the runnable threads
+ *
+ *  Kernel threads are added to the kernel's runnable queue. User threads are
+ *  added to their task's queue, and the task is inserted in the heap if it
+ *  had no runnable thread. A task joining the heap starts no earlier than the
+ *  global virtual time so that it can not monopolize the CPU after having 
+ *  been blocked for a long time. Must be called with interrupts disabled.
+ *
+ *  @param  tcb   The TCB of the thread
+ *
+ *  @return void
+ */
+static void enqueue_runnable(tcb_t *tcb) {
+
+  pcb_t *task = tcb->task;
+
+  if (task == NULL) {
+    Q_INSERT_TAIL(&kernel.runnable_queue, tcb, runq_link);
+    return;
+  }
+
+  Q_INSERT_TAIL(&task->runnable_threads, tcb, runq_link);
+
+  if (task->heap_index == TASK_NOT_IN_HEAP) {
+    if (task->pass < kernel.global_pass) {
+      task->pass = kernel.global_pass;
+    }
+    task_heap_insert(&kernel.runnable_tasks, task);
+  }
+}
+
+/** @brief  Removes a thread from the runnable threads
+ *
+ *  If the thread belongs to a task, the task is charged for one quantum. 
+ *  Must be called with interrupts disabled.
+ *
+ *  @param  tcb   The TCB of the thread
+ *
+ *  @return void
+ */
+static void remove_runnable(tcb_t *tcb) {
+
+  tcb_queue_t *queue = (tcb->task == NULL) ? &kernel.runnable_queue :
+                        &tcb->task->runnable_threads;
+
+  // The thread is linked in its queue, no need to look for it
+  Q_REMOVE(queue, tcb, runq_link);
+
+  if (tcb->task != NULL) {
+    charge_task(tcb->task);
+  }
+}
+
+/** @brief  Charges a task for one quantum
+ *
+ *  The task's pass is advanced by its stride and the task is removed from the
+ *  heap if it has no runnable thread left. Must be called with interrupts 
+ *  disabled.
+ *
+ *  @param  task  The task
+ *
+ *  @return void
+ */
+static void charge_task(pcb_t *task) {
+
+  task->pass += task->stride;
+
+  if (task->heap_index == TASK_NOT_IN_HEAP) {
+    return;
+  }
+
+  if (Q_GET_FRONT(&task->runnable_threads) == NULL) {
+    task_heap_remove(&kernel.runnable_tasks, task);
+  } else {
+    task_heap_update(&kernel.runnable_tasks, task);
+  }
+}
+
+/** @brief  Recomputes a task's stride from its own and lent tickets
+ *
+ *  The task's remaining pass (relative to the global virtual time) is scaled
+ *  to its new stride, so that a task that just got more tickets does not have
+ *  to wait for a pass computed with its old stride. Must be called with
+ *  interrupts disabled.
+ *
+ *  @param  task  The task
+ *
+ *  @return void
+ */
+static void update_stride(pcb_t *task) {
+
+  uint32_t weight = task->weight + task->donated_weight;
+  if (weight > MAX_TASK_WEIGHT) {
+    weight = MAX_TASK_WEIGHT;
+  }
+
+  uint32_t new_stride = STRIDE_ONE / weight;
+  if (new_stride == task->stride) {
+    return;
+  }
+
+  if (task->pass > kernel.global_pass) {
+    // Number of quanta the task is ahead of the virtual time
+    uint32_t quanta = (uint32_t)(task->pass - kernel.global_pass) / 
+                      task->stride;
+    task->pass = kernel.global_pass + (uint64_t)quanta * new_stride;
+  }
+  task->stride = new_stride;
+
+  if (task->heap_index != TASK_NOT_IN_HEAP) {
+    task_heap_update(&kernel.runnable_tasks, task);
+  }
+}
@@ -0,0 +1,130 @@
+/** @file softirq.c
+ *  @brief  This file contains the definitions for functions used to defer 
+ *          work out of interrupt handlers
+ *
+ *  Interrupt handlers only do the minimal amount of work with interrupts
+ *  disabled (acknowledge the device and the PIC) and raise a softirq_t for
+ *  the rest. Raised items are pushed on a lock-free stack with a compare and
+ *  exchange, so handlers never have to take a lock. The queue is drained with
+ *  interrupts enabled when the outermost interrupt handler returns.
+ *
+ *  There is a single queue since the kernel runs on a single CPU.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <softirq.h>
+#include <atomic_ops.h>
+#include <stddef.h>
+#include <asm.h>
+#include <irq_trace.h>
+#include <assert.h>
+
+#define SOFTIRQ_RUNNING_FALSE 0
+#define SOFTIRQ_RUNNING_TRUE 1
+
+/* Pending work items, most recently raised first */
+static softirq_t *pending_head = NULL;
+
+/* Whether the queue is currently being drained */
+static int running = SOFTIRQ_RUNNING_FALSE;
+
+/** @brief  Initializes a work item
+ *
+ *  @param  work    The work item
+ *  @param  handler The function to run when the work item is drained
+ *
+ *  @return void
+ */
+void softirq_init(softirq_t *work, void (*handler)(void)) {
+  assert(work != NULL && handler != NULL);
+  work->handler = handler;
+  work->pending = SOFTIRQ_PENDING_FALSE;
+  work->next = NULL;
+}
+
+/** @brief  Marks a work item as pending
+ *
+ *  The function is safe to call from any interrupt handler.
+ *
+ *  @param  work  The work item
+ *
+ *  @return void
+ */
+void softirq_raise(softirq_t *work) {
+
+  // The item is already in the queue
+  if (atomic_exchange(&work->pending, SOFTIRQ_PENDING_TRUE) ==
+      SOFTIRQ_PENDING_TRUE) {
+    return;
+  }
+
+  softirq_t *old_head;
+  do {
+    old_head = pending_head;
+    work->next = old_head;
+  } while (!atomic_compare_and_exchange_32(&pending_head, (uint32_t)old_head,
+                                           (uint32_t)work));
+}
+
+/** @brief  Runs all pending work items
+ *
+ *  Interrupts are enabled while work items run, and are left enabled when
+ *  the function returns. If the queue is already being drained by an
+ *  interrupted handler, the function returns immediately and the new items
+ *  are run by the interrupted drain.
+ *
+ *  @return void
+ */
+void softirq_run() {
+
+  if (atomic_exchange(&running, SOFTIRQ_RUNNING_TRUE) == 
+      SOFTIRQ_RUNNING_TRUE) {
+    return;
+  }
+
+  irq_enable();
+
+  do {
+
+    softirq_t *list;
+    while ((list = (softirq_t *)atomic_exchange(&pending_head, 0)) != NULL) {
+
+      // Reverse the list so that items run in the order they were raised
+      softirq_t *ordered = NULL;
+      while (list != NULL) {
+        softirq_t *next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+      }
+
+      while (ordered != NULL) {
+        softirq_t *work = ordered;
+        ordered = ordered->next;
+
+        // Clear the flag first so the item may be raised again while running
+        work->pending = SOFTIRQ_PENDING_FALSE;
+        work->handler();
+      }
+    }
+
+    running = SOFTIRQ_RUNNING_FALSE;
+
+    // An item may have been raised after the queue was seen empty but before
+    // the running flag was cleared
+  } while (pending_head != NULL &&
+           atomic_exchange(&running, SOFTIRQ_RUNNING_TRUE) ==
+           SOFTIRQ_RUNNING_FALSE);
+}
+
+/** @brief  Indicates whether the queue is currently being drained
+ *
+ *  Interrupt handlers use this to avoid preempting a thread that is in the 
+ *  middle of running work items.
+ *
+ *  @return A non-zero value if the queue is being drained, 0 otherwise
+ */
+int softirq_is_running() {
+  return running;
+}
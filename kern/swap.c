@@ -0,0 +1,817 @@
+/** @file swap.c
+ *  @brief  This file contains the definitions for the swapper, which pages
+ *          user memory out to a disk when physical frames run low
+ *
+ *  A whole drive, chosen at boot, is used as the swap area. It is divided in
+ *  page-sized slots, and the frame reservation pool (kernel.free_frame_count)
+ *  grows by the number of slots: reserving frames only fails once both
+ *  physical memory and the swap area are committed.
+ *
+ *  The swapper is a kernel thread woken up when fewer than SWAP_LOW_FRAMES
+ *  frames are unused. It walks the page tables of every registered address
+ *  space with a clock hand and gives each private user page a second chance:
+ *  a page whose ACCESSED bit is set has the bit cleared, a page whose bit is
+ *  still clear when the hand comes back is paged out. Its content is copied
+ *  to a bounce buffer and its page table entry is replaced by a non-present
+ *  entry holding the PAGE_SWAPPED_BIT and the slot's number, which keeps the
+ *  page's access rights. Its frame is freed but the page keeps its frame
+ *  reservation. The swapper goes on until SWAP_HIGH_FRAMES frames are unused,
+ *  writing the pages of a batch to the disk in as few commands as possible.
+ *
+ *  An access to a swapped out page faults and the page fault handler pages
+ *  it back in with swap_in_page(). Pages are only paged back in on faults
+ *  taken with interrupts enabled, kernel code that touches user memory with
+ *  interrupts disabled must make sure that it is not in the swap area.
+ *
+ *  Slots are reference counted so that fork() can share them between the
+ *  parent and the child, each gets its own frame when it pages the page back
+ *  in. Slot counts and page table entries are only changed with interrupts
+ *  disabled. The bounce buffers, the list of address spaces and the clock
+ *  hand are protected by a mutex, held while the disk is accessed, which
+ *  swap_unregister() takes before an address space is torn down.
+ *
+ *  When nothing can be paged out (every page is shared, merged, or recently
+ *  used twice in a row, or the swap area is full), the swapper is stalled:
+ *  threads waiting for frames give up, then the swapper tries again after
+ *  SWAP_STALL_TICKS. Threads faulting on a page that holds a frame
+ *  reservation (a swapped out, requested or merged page) do not give up,
+ *  they are owed a frame and keep waiting until the swapper or an exiting
+ *  task frees one.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <swap.h>
+#include <ata.h>
+#include <page.h>
+#include <common_kern.h>
+#include <kernel_state.h>
+#include <context_switch.h>
+#include <scheduler.h>
+#include <syscalls.h>
+#include <variable_queue.h>
+#include <eff_mutex.h>
+#include <cr.h>
+#include <asm.h>
+#include <irq_trace.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+
+/* VM system */
+#include <virtual_memory.h>
+#include <virtual_memory_helper.h>
+#include <virtual_memory_defines.h>
+
+/* Debugging */
+#include <simics.h>
+#include <assert.h>
+
+/* Maximum number of slots in the swap area (128 MB) */
+#define SWAP_MAX_SLOTS 32768
+
+/* Maximum number of pages paged out in one batch */
+#define SWAP_BATCH_PAGES 8
+
+/* Number of times the clock hand goes around without paging anything out
+ * before the swapper is stalled (the hand may start in the middle of a pass,
+ * and the first full pass may only clear ACCESSED bits) */
+#define SWAP_STALL_PASSES 3
+
+/* Number of ticks a stalled swapper waits before trying again */
+#define SWAP_STALL_TICKS 10
+
+/* Position of the slot's number in the entry of a swapped out page */
+#define SWAP_SLOT_SHIFT 12
+
+/* Value returned when no slot is free */
+#define SWAP_NO_SLOT 0xffffffff
+
+/* Thread id of the swapper (no other thread is allowed to have this tid) */
+#define SWAP_TID -5
+
+/** @brief  An address space scanned by the swapper */
+typedef struct swap_space {
+
+  /** @brief  The page directory */
+  unsigned int *cr3;
+
+  /** @brief  Next address space in the list */
+  struct swap_space *next;
+
+} swap_space_t;
+
+/** @brief  State of the swapper */
+typedef struct swap {
+
+  /** @brief  The drive holding the swap area, SWAP_NO_DRIVE if none */
+  int drive;
+
+  /** @brief  Number of slots in the swap area */
+  unsigned int nb_slots;
+
+  /** @brief  Number of references to each slot, 0 if the slot is free */
+  uint16_t *slot_refs;
+
+  /** @brief  Number of free slots */
+  unsigned int free_slots;
+
+  /** @brief  Slot where the search for a free slot starts */
+  unsigned int next_slot;
+
+  /** @brief  Mutex protecting the address spaces, the clock hand and the
+   *          bounce buffers */
+  eff_mutex_t mutex;
+
+  /** @brief  Registered address spaces */
+  swap_space_t *spaces;
+
+  /** @brief  Address space under the clock hand, NULL between two passes */
+  swap_space_t *cursor;
+
+  /** @brief  Next virtual address to look at in the cursor's address space */
+  unsigned int cursor_address;
+
+  /** @brief  Pages being paged out, SWAP_BATCH_PAGES page-aligned pages */
+  char *out_bufs[SWAP_BATCH_PAGES];
+
+  /** @brief  Page being paged in, page-aligned */
+  char *in_buf;
+
+  /** @brief  The swapper thread, NULL until it is created */
+  tcb_t *thread;
+
+  /** @brief  Indicates whether the swapper is blocked waiting for work */
+  int idle;
+
+  /** @brief  Indicates whether the swapper could not page anything out */
+  int stalled;
+
+  /** @brief  Threads waiting for the swapper to free frames */
+  tcb_queue_t waiters;
+
+  /** @brief  Number of pages paged back in since boot */
+  unsigned int swap_ins;
+
+  /** @brief  Number of pages paged out since boot */
+  unsigned int swap_outs;
+
+} swap_t;
+
+/* Swapper state */
+static swap_t swap;
+
+/* Static functions prototypes */
+static void swap_daemon(void);
+static int evict_batch(void);
+static int evict_page(unsigned int *entry_addr, unsigned int address,
+                      int index, unsigned int *slot);
+static int is_evictable(unsigned int entry);
+static void write_batch(unsigned int *slots, int nb_pages);
+static void wake_waiters(void);
+static void switch_address_space(unsigned int *cr3);
+static unsigned int alloc_slot(void);
+static void put_slot(unsigned int slot);
+
+/** @brief  Initializes the swapper's state and adds the swap area to the
+ *          frame reservation pool
+ *
+ *  Must be called once after vm_init() and before any address space is
+ *  registered. The drive's content is overwritten.
+ *
+ *  @param  drive   The drive holding the swap area, SWAP_NO_DRIVE to run
+ *                  without swap
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int swap_init(int drive) {
+
+  memset(&swap, 0, sizeof(swap_t));
+  swap.drive = SWAP_NO_DRIVE;
+  Q_INIT_HEAD(&swap.waiters);
+
+  if (eff_mutex_init(&swap.mutex) < 0) {
+    return -1;
+  }
+
+  if (drive == SWAP_NO_DRIVE) {
+    return 0;
+  }
+
+  if (!ata_present(drive)) {
+    lprintf("swap_init(): No drive %d, running without swap", drive);
+    return 0;
+  }
+
+  unsigned int nb_slots = ata_nb_blocks(drive);
+  if (nb_slots > SWAP_MAX_SLOTS) {
+    nb_slots = SWAP_MAX_SLOTS;
+  }
+
+  swap.slot_refs = malloc(nb_slots * sizeof(uint16_t));
+  swap.in_buf = memalign(PAGE_SIZE, PAGE_SIZE);
+  char *out = memalign(PAGE_SIZE, SWAP_BATCH_PAGES * PAGE_SIZE);
+  if (swap.slot_refs == NULL || swap.in_buf == NULL || out == NULL) {
+    return -1;
+  }
+  memset(swap.slot_refs, 0, nb_slots * sizeof(uint16_t));
+
+  int i;
+  for (i = 0; i < SWAP_BATCH_PAGES; ++i) {
+    swap.out_bufs[i] = out + i * PAGE_SIZE;
+  }
+
+  swap.drive = drive;
+  swap.nb_slots = nb_slots;
+  swap.free_slots = nb_slots;
+
+  // Every slot can hold a reserved page
+  release_frames(nb_slots);
+
+  lprintf("swap_init(): %u KB of swap on drive %d",
+          nb_slots * (PAGE_SIZE / 1024), drive);
+
+  return 0;
+}
+
+/** @brief  Creates the swapper thread and makes it runnable
+ *
+ *  Has no effect if the kernel runs without swap. Must be called after the
+ *  first task is created, the swapper runs with the first task's page
+ *  directory when it is not scanning.
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int swap_create_daemon() {
+
+  if (swap.drive == SWAP_NO_DRIVE) {
+    return 0;
+  }
+
+  tcb_t *new_tcb = create_kernel_thread(swap_daemon, SWAP_TID, NULL,
+                                        kernel.init_cr3);
+  if (new_tcb == NULL) {
+    lprintf("swap_create_daemon(): Failed to create the swapper thread");
+    return -1;
+  }
+
+  swap.thread = new_tcb;
+  add_runnable_thread(new_tcb);
+
+  return 0;
+}
+
+/** @brief  Adds an address space to the ones whose pages may be paged out
+ *
+ *  If the address space can not be registered, its pages are simply never
+ *  paged out.
+ *
+ *  @param  cr3   The address space's page directory
+ *
+ *  @return void
+ */
+void swap_register(unsigned int *cr3) {
+
+  if (swap.drive == SWAP_NO_DRIVE) {
+    return;
+  }
+
+  swap_space_t *space = malloc(sizeof(swap_space_t));
+  if (space == NULL) {
+    lprintf("swap_register(): Failed to register address space");
+    return;
+  }
+  space->cr3 = cr3;
+
+  eff_mutex_lock(&swap.mutex);
+  space->next = swap.spaces;
+  swap.spaces = space;
+  eff_mutex_unlock(&swap.mutex);
+}
+
+/** @brief  Removes an address space from the ones whose pages may be paged
+ *          out
+ *
+ *  Must be called before the address space's page tables are freed. When
+ *  the function returns, the swapper does not hold any reference to the
+ *  address space anymore. Has no effect if the address space is not
+ *  registered.
+ *
+ *  @param  cr3   The address space's page directory
+ *
+ *  @return void
+ */
+void swap_unregister(unsigned int *cr3) {
+
+  if (swap.drive == SWAP_NO_DRIVE) {
+    return;
+  }
+
+  eff_mutex_lock(&swap.mutex);
+
+  swap_space_t **it = &swap.spaces;
+  while (*it != NULL && (*it)->cr3 != cr3) {
+    it = &(*it)->next;
+  }
+
+  swap_space_t *space = *it;
+  if (space == NULL) {
+    eff_mutex_unlock(&swap.mutex);
+    return;
+  }
+  *it = space->next;
+
+  if (swap.cursor == space) {
+    swap.cursor = space->next;
+    swap.cursor_address = USER_MEM_START;
+  }
+
+  eff_mutex_unlock(&swap.mutex);
+
+  free(space);
+}
+
+/** @brief  Makes the swapper runnable if it is waiting for work
+ *
+ *  May be called with interrupts disabled.
+ *
+ *  @return void
+ */
+void swap_wake() {
+
+  int enabled = save_and_disable_interrupts();
+  if (swap.idle) {
+    swap.idle = 0;
+    add_runnable_thread_noint(swap.thread);
+  }
+  restore_interrupts(enabled);
+}
+
+/** @brief  Waits for the swapper to page memory out until at least one
+ *          frame is unused
+ *
+ *  Must be called with interrupts disabled, which are enabled while the
+ *  invoking thread is blocked and disabled again when the function returns,
+ *  so that the caller can allocate a frame before anybody else.
+ *
+ *  @param  wait_stalled  SWAP_WAIT_STALLED_TRUE to keep waiting while the
+ *                        swapper is stalled, for a caller that holds a
+ *                        frame reservation and no lock needed to free
+ *                        frames, SWAP_WAIT_STALLED_FALSE otherwise
+ *
+ *  @return 0 if a frame is unused, a negative number if there is none and
+ *          the swapper can not free any
+ */
+int swap_wait_for_frames(int wait_stalled) {
+
+  while (get_unused_frame_count() == 0) {
+
+    if (swap.thread == NULL ||
+        (swap.stalled && wait_stalled == SWAP_WAIT_STALLED_FALSE)) {
+      return -1;
+    }
+
+    Q_INSERT_TAIL(&swap.waiters, kernel.current_thread, wait_link);
+    if (swap.idle) {
+      swap.idle = 0;
+      add_runnable_thread_noint(swap.thread);
+    }
+
+    // Interrupts are enabled after the context switch
+    block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+    irq_disable();
+  }
+
+  return 0;
+}
+
+/** @brief  Pages a page of the current address space back in
+ *
+ *  Must be called with interrupts enabled. The page gets a new frame (out of
+ *  the reservation it kept while swapped out) and its content is read from
+ *  the swap area.
+ *
+ *  @param  address   A virtual address in the page
+ *
+ *  @return 0 if the page is not in the swap area anymore (the faulting
+ *          access can be retried), a negative number if it was never there
+ *          or could not be paged in
+ */
+int swap_in_page(unsigned int address) {
+
+  if (swap.drive == SWAP_NO_DRIVE || address < USER_MEM_START) {
+    return -1;
+  }
+  address &= PAGE_ADDR_MASK;
+
+  unsigned int *page_directory_entry_addr = get_page_dir_entry(address);
+  if (!is_entry_present(page_directory_entry_addr)) {
+    return -1;
+  }
+
+  unsigned int *entry_addr =
+      get_page_table_entry(page_directory_entry_addr, address);
+  if (!is_page_swapped(entry_addr)) {
+    return -1;
+  }
+
+  while (1) {
+
+    // Make room for the page, the swapper needs the mutex to do so. The page
+    // kept its reservation, so wait even if the swapper is stalled
+    irq_disable();
+    int frames_left = swap_wait_for_frames(SWAP_WAIT_STALLED_TRUE);
+    irq_enable();
+
+    eff_mutex_lock(&swap.mutex);
+
+    // Another thread of the task may have paged the page in or removed it
+    // while this one was waiting
+    unsigned int entry = *entry_addr;
+    if (!is_page_swapped(&entry)) {
+      eff_mutex_unlock(&swap.mutex);
+      return 0;
+    }
+
+    unsigned int slot = entry >> SWAP_SLOT_SHIFT;
+    if (ata_read_blocks(swap.drive, slot, &swap.in_buf, 1) < 0) {
+      lprintf("swap_in_page(): Failed to read slot %u", slot);
+      eff_mutex_unlock(&swap.mutex);
+      return -1;
+    }
+
+    irq_disable();
+
+    unsigned int frame = 0;
+    if (*entry_addr == entry &&
+        (frame = (unsigned int)allocate_frame()) != 0) {
+
+      memcpy(map_frame_window(frame), swap.in_buf, PAGE_SIZE);
+      unmap_frame_window();
+
+      *entry_addr = (frame & PAGE_ADDR_MASK) | PRESENT_BIT | ACCESSED |
+                    (entry & (PAGE_WRITABLE | USER_ACCESSIBLE));
+      invalidate_tlb(address);
+
+      // The page keeps its reservation, which now backs the frame
+      put_slot(slot);
+      ++swap.swap_ins;
+    }
+
+    int changed = (*entry_addr != entry);
+    irq_enable();
+    eff_mutex_unlock(&swap.mutex);
+
+    if (frame != 0) {
+      return 0;
+    }
+    if (!changed && frames_left < 0) {
+      // No frame, and the swapper can not free any
+      return -1;
+    }
+  }
+}
+
+/** @brief  Pages back in every page of a range of the current address space
+ *          that is in the swap area
+ *
+ *  Must be called with interrupts enabled.
+ *
+ *  @param  address   The range's first virtual address
+ *  @param  len       The range's length in bytes
+ *
+ *  @return void
+ */
+void swap_in_range(unsigned int address, unsigned int len) {
+
+  unsigned int end = address + len;
+  address &= PAGE_ADDR_MASK;
+  for ( ; address < end; address += PAGE_SIZE) {
+    swap_in_page(address);
+  }
+}
+
+/** @brief  Accounts for a new page table entry referring to the slot of a
+ *          swapped out page
+ *
+ *  Used by fork() to share the slot between the parent and the child. Must
+ *  be called with interrupts disabled.
+ *
+ *  @param  entry_addr  The parent's page table entry
+ *
+ *  @return void
+ */
+void swap_dup_entry(unsigned int *entry_addr) {
+  unsigned int slot = *entry_addr >> SWAP_SLOT_SHIFT;
+  assert(slot < swap.nb_slots && swap.slot_refs[slot] > 0);
+  ++swap.slot_refs[slot];
+}
+
+/** @brief  Drops a swapped out page
+ *
+ *  The page's slot is freed if the entry was its last reference, and the
+ *  page's frame reservation is released. The entry is cleared.
+ *
+ *  @param  entry_addr  The page table entry
+ *
+ *  @return void
+ */
+void swap_drop_entry(unsigned int *entry_addr) {
+
+  int enabled = save_and_disable_interrupts();
+
+  if (is_page_swapped(entry_addr)) {
+    put_slot(*entry_addr >> SWAP_SLOT_SHIFT);
+    *entry_addr = 0;
+    release_frames(1);
+  }
+
+  restore_interrupts(enabled);
+}
+
+/** @brief  Gets the usage of physical memory and of the swap area
+ *
+ *  @param  stats   The structure to fill
+ *
+ *  @return void
+ */
+void swap_get_stats(swap_stats_t *stats) {
+
+  int enabled = save_and_disable_interrupts();
+
+  stats->total_frames = get_user_frame_count();
+  stats->free_frames = get_unused_frame_count();
+  stats->total_slots = swap.nb_slots;
+  stats->free_slots = swap.free_slots;
+  stats->swap_ins = swap.swap_ins;
+  stats->swap_outs = swap.swap_outs;
+
+  restore_interrupts(enabled);
+}
+
+/** @brief  Main function for the swapper thread
+ *
+ *  @return Does not return
+ */
+static void swap_daemon() {
+
+  while (1) {
+
+    // Wait for frames to run low
+    irq_disable();
+    while (get_unused_frame_count() > SWAP_LOW_FRAMES &&
+           Q_GET_FRONT(&swap.waiters) == NULL) {
+      swap.idle = 1;
+      block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+      irq_disable();
+    }
+    irq_enable();
+
+    // Page memory out until enough frames are unused
+    int evicted = 1;
+    while (evicted && get_unused_frame_count() < SWAP_HIGH_FRAMES) {
+      eff_mutex_lock(&swap.mutex);
+      evicted = evict_batch();
+      eff_mutex_unlock(&swap.mutex);
+      wake_waiters();
+    }
+
+    if (!evicted) {
+      // Let the waiting threads fail instead of waiting for nothing
+      lprintf("swap_daemon(): Nothing left to page out");
+      swap.stalled = 1;
+      wake_waiters();
+      kern_sleep(SWAP_STALL_TICKS);
+      swap.stalled = 0;
+
+      // Frames may have been freed in the meantime, let the threads that
+      // kept waiting check again
+      wake_waiters();
+    }
+  }
+}
+
+/** @brief  Pages out the next few pages under the clock hand
+ *
+ *  At most SWAP_BATCH_PAGES pages are paged out, the hand stops early if it
+ *  went SWAP_STALL_PASSES times around every address space without finding
+ *  one. Must be called with the swapper's mutex held.
+ *
+ *  @return The number of pages paged out
+ */
+static int evict_batch() {
+
+  unsigned int slots[SWAP_BATCH_PAGES];
+  int nb_pages = 0, nb_passes = 0;
+
+  if (swap.cursor == NULL) {
+    // Start a new pass
+    swap.cursor = swap.spaces;
+    swap.cursor_address = USER_MEM_START;
+  }
+
+  while (swap.cursor != NULL && nb_pages < SWAP_BATCH_PAGES &&
+         nb_passes < SWAP_STALL_PASSES) {
+
+    switch_address_space(swap.cursor->cr3);
+
+    unsigned int address = swap.cursor_address;
+    unsigned int *page_directory_entry_addr = get_page_dir_entry(address);
+
+    if (!is_entry_present(page_directory_entry_addr)) {
+      // Skip the whole page table
+      address = (address & PAGE_TABLE_DIRECTORY_MASK) +
+                (1 << PAGE_DIR_RIGHT_SHIFT);
+    } else {
+      unsigned int *page_table_entry_addr =
+          get_page_table_entry(page_directory_entry_addr, address);
+      nb_pages += evict_page(page_table_entry_addr, address, nb_pages,
+                             &slots[nb_pages]);
+      address += PAGE_SIZE;
+
+      // Let a pending reschedule happen between two page tables
+      if ((address & PAGE_TABLE_MASK) == 0) {
+        preempt_point();
+      }
+    }
+
+    if (address < USER_MEM_START) {
+      // Wrapped around the end of the address space, go to the next one
+      swap.cursor = swap.cursor->next;
+      swap.cursor_address = USER_MEM_START;
+      if (swap.cursor == NULL) {
+        swap.cursor = swap.spaces;
+        ++nb_passes;
+      }
+    } else {
+      swap.cursor_address = address;
+    }
+  }
+
+  switch_address_space((unsigned int *)kernel.init_cr3);
+
+  write_batch(slots, nb_pages);
+  return nb_pages;
+}
+
+/** @brief  Gives a page of the current address space a second chance, or
+ *          pages it out if it already had one
+ *
+ *  @param  entry_addr  The page table entry mapping the page
+ *  @param  address     The page's virtual address
+ *  @param  index       The bounce buffer receiving the page's content
+ *  @param  slot        Receives the slot allocated to the page
+ *
+ *  @return 1 if the page was paged out, 0 otherwise
+ */
+static int evict_page(unsigned int *entry_addr, unsigned int address,
+                      int index, unsigned int *slot) {
+
+  int evicted = 0;
+
+  irq_disable();
+
+  unsigned int entry = *entry_addr;
+  if (!is_evictable(entry)) {
+    irq_enable();
+    return 0;
+  }
+
+  if (entry & ACCESSED) {
+    // Used since the hand last passed, look at the page again next pass
+    *entry_addr = entry & ~ACCESSED;
+    invalidate_tlb(address);
+  } else if ((*slot = alloc_slot()) != SWAP_NO_SLOT) {
+    memcpy(swap.out_bufs[index], (char *)address, PAGE_SIZE);
+    *entry_addr = (*slot << SWAP_SLOT_SHIFT) | PAGE_SWAPPED_BIT |
+                  (entry & (PAGE_WRITABLE | USER_ACCESSIBLE));
+    invalidate_tlb(address);
+    free_frame_keep_reservation(get_frame_addr(&entry));
+    ++swap.swap_outs;
+    evicted = 1;
+  }
+
+  irq_enable();
+
+  return evicted;
+}
+
+/** @brief  Checks whether a page may be paged out
+ *
+ *  Only private user pages backed by their own frame are paged out: pages
+ *  requested with new_pages() that were never written to, shared and merged
+ *  pages are left alone.
+ *
+ *  @param  entry   The page table entry mapping the page
+ *
+ *  @return A non-zero value if the page may be paged out, 0 otherwise
+ */
+static int is_evictable(unsigned int entry) {
+
+  unsigned int required = PRESENT_BIT | USER_ACCESSIBLE;
+  unsigned int excluded = PAGE_TABLE_RESERVED_BIT | PAGE_SHARED_BIT |
+                          PAGE_MERGED_BIT;
+  unsigned int frame = entry & PAGE_ADDR_MASK;
+
+  return (entry & required) == required && !(entry & excluded) &&
+         frame >= USER_MEM_START && frame != kernel.zeroed_out_frame;
+}
+
+/** @brief  Writes the pages of a batch to their slots
+ *
+ *  Pages whose slots are contiguous are written with a single command. The
+ *  pages' frames are already freed, so a failed write loses their content
+ *  and the kernel panics.
+ *
+ *  @param  slots     The pages' slots
+ *  @param  nb_pages  The number of pages
+ *
+ *  @return void
+ */
+static void write_batch(unsigned int *slots, int nb_pages) {
+
+  int first = 0;
+  while (first < nb_pages) {
+    int last = first;
+    while (last + 1 < nb_pages && slots[last + 1] == slots[last] + 1) {
+      ++last;
+    }
+    if (ata_write_blocks(swap.drive, slots[first], &swap.out_bufs[first],
+                         last - first + 1) < 0) {
+      panic("swap: Failed to write to the swap area");
+    }
+    first = last + 1;
+  }
+}
+
+/** @brief  Makes the threads waiting for frames runnable
+ *
+ *  @return void
+ */
+static void wake_waiters() {
+
+  irq_disable();
+  tcb_t *waiter;
+  while ((waiter = Q_GET_FRONT(&swap.waiters)) != NULL) {
+    Q_REMOVE(&swap.waiters, waiter, wait_link);
+    add_runnable_thread_noint(waiter);
+  }
+  irq_enable();
+}
+
+/** @brief  Makes the swapper run in an address space
+ *
+ *  @param  cr3   The address space's page directory
+ *
+ *  @return void
+ */
+static void switch_address_space(unsigned int *cr3) {
+  if (kernel.current_thread->cr3 != (uint32_t)cr3) {
+    kernel.current_thread->cr3 = (uint32_t)cr3;
+    set_cr3((uint32_t)cr3);
+  }
+}
+
+/** @brief  Allocates a free slot, searching from the last one allocated so
+ *          that the pages of a batch tend to get contiguous slots
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @return The slot's number, SWAP_NO_SLOT if the swap area is full
+ */
+static unsigned int alloc_slot() {
+
+  if (swap.free_slots == 0) {
+    return SWAP_NO_SLOT;
+  }
+
+  unsigned int i;
+  for (i = 0; i < swap.nb_slots; ++i) {
+    unsigned int slot = (swap.next_slot + i) % swap.nb_slots;
+    if (swap.slot_refs[slot] == 0) {
+      swap.slot_refs[slot] = 1;
+      --swap.free_slots;
+      swap.next_slot = slot + 1;
+      return slot;
+    }
+  }
+
+  return SWAP_NO_SLOT;
+}
+
+/** @brief  Drops a reference to a slot, the slot is freed when its last
+ *          reference goes away
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @param  slot  The slot's number
+ *
+ *  @return void
+ */
+static void put_slot(unsigned int slot) {
+
+  assert(slot < swap.nb_slots && swap.slot_refs[slot] > 0);
+  if (--swap.slot_refs[slot] == 0) {
+    ++swap.free_slots;
+  }
+}
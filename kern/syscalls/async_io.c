@@ -0,0 +1,645 @@
+/** @file async_io.c
+ *  @brief This file contains the definitions for the ring_setup() and
+ *  ring_enter() system calls, which let a task keep many print(),
+ *  readfile(), sleep() and wait() requests in flight with a single kernel
+ *  entry.
+ *
+ *  A task has at most one ring. The ring is a page of kernel memory mapped
+ *  in the task's address space with the PAGE_SHARED_BIT set, so that it is
+ *  neither freed nor copied when the address space is torn down or forked
+ *  (a forked child does not inherit it). The kernel accesses it through its
+ *  direct mapping, from any address space.
+ *
+ *  ring_enter() copies the new requests from the submission queue to kernel
+ *  memory. Sleep requests are put on a timer list which the timer callback
+ *  completes, they do not need a thread. Other requests are queued for the
+ *  ring's worker threads, which run the system call as if the task had made
+ *  it: they are kernel threads that belong to the task (they share its
+ *  address space and its scheduling weight) but are not counted among its
+ *  threads and never return to user mode. ASYNC_IO_WORKERS requests may be
+ *  executing at once, others wait in the queue.
+ *
+ *  Completions are posted and the ring's queues are changed with interrupts
+ *  disabled, as sleep requests complete from the timer callback. The mutex
+ *  serializes threads consuming the submission queue.
+ *
+ *  The ring lives until the task's last thread vanishes or the task calls
+ *  exec(). The workers are then stopped: queued requests are dropped,
+ *  pending sleeps are cancelled, workers waiting for a child give up, and
+ *  requests being executed are completed first.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <async_io.h>
+#include <async_ring.h>
+#include <page.h>
+#include <common_kern.h>
+#include <kernel_state.h>
+#include <context_switch.h>
+#include <scheduler.h>
+#include <syscalls.h>
+#include <variable_queue.h>
+#include <eff_mutex.h>
+#include <reaper.h>
+#include <cr.h>
+#include <asm.h>
+#include <irq_trace.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+
+/* VM system */
+#include <virtual_memory.h>
+#include <virtual_memory_helper.h>
+#include <virtual_memory_defines.h>
+
+/* Debugging */
+#include <simics.h>
+#include <assert.h>
+
+/* Special thread ID for the workers */
+#define ASYNC_IO_TID -6
+
+/* Boolean values for the closing field */
+#define ASYNC_IO_CLOSING_FALSE 0
+#define ASYNC_IO_CLOSING_TRUE 1
+
+struct async_io;
+
+/** @brief  A request consumed from a ring's submission queue */
+typedef struct async_req {
+
+  /** @brief  Copy of the request, the task may overwrite the ring's entry */
+  async_sqe_t sqe;
+
+  /** @brief  The ring the request was submitted to */
+  struct async_io *io;
+
+  /** @brief  Tick at which a sleep request completes */
+  unsigned int wake_tick;
+
+  /** @brief  Link in the ring's free or queued requests, or in the timer
+   *          list */
+  Q_NEW_LINK(async_req) link;
+
+} async_req_t;
+
+/** @brief  A queue of requests */
+Q_NEW_HEAD(async_req_queue_t, async_req);
+
+/** @brief  A task's ring and the kernel state attached to it */
+typedef struct async_io {
+
+  /** @brief  The shared page, through the kernel's direct mapping */
+  async_ring_t *ring;
+
+  /** @brief  Address at which the ring is mapped in the task */
+  void *base;
+
+  /** @brief  Storage for the requests, one per completion queue entry */
+  async_req_t reqs[ASYNC_RING_ENTRIES];
+
+  /** @brief  Requests not in use */
+  async_req_queue_t free_reqs;
+
+  /** @brief  Requests waiting for a worker */
+  async_req_queue_t queued_reqs;
+
+  /** @brief  Number of requests consumed and not completed yet */
+  unsigned int in_flight;
+
+  /** @brief  Number of workers that did not exit yet */
+  int nb_workers;
+
+  /** @brief  Workers waiting for a request */
+  tcb_queue_t idle_workers;
+
+  /** @brief  Threads waiting in ring_enter() for completions */
+  tcb_queue_t enter_waiters;
+
+  /** @brief  Thread waiting for the workers to exit, NULL if none */
+  tcb_t *destroyer;
+
+  /** @brief  Set once the ring is being destroyed */
+  int closing;
+
+  /** @brief  Mutex serializing the consumption of the submission queue */
+  eff_mutex_t mutex;
+
+} async_io_t;
+
+/* Sleep requests of all rings, ordered by wake up tick */
+static async_req_queue_t timers = {NULL, NULL};
+
+/* Static functions prototypes */
+static void worker(void);
+static void worker_exit(async_io_t *io);
+static int run_request(async_sqe_t *sqe);
+static int submit_requests(async_io_t *io);
+static void start_request(async_io_t *io, async_req_t *req);
+static void complete_request(async_io_t *io, async_req_t *req, int result);
+static unsigned int completions_ready(async_ring_t *ring);
+
+/** @brief  Sets up the invoking task's ring and maps it at a given address
+ *
+ *  The ring starts empty. The page must not be mapped already.
+ *
+ *  @param  base  The page-aligned address at which to map the ring
+ *
+ *  @return 0 on success, a negative number if the task already has a ring,
+ *          if base is invalid or if the ring could not be created
+ */
+int kern_ring_setup(void *base) {
+
+  unsigned int address = (unsigned int)base;
+  if (address < USER_MEM_START || (address % PAGE_SIZE) != 0) {
+    lprintf("kern_ring_setup(): Invalid base argument");
+    return -1;
+  }
+
+  pcb_t *task = kernel.current_thread->task;
+  eff_mutex_lock(&task->mutex);
+
+  if (task->async_io != NULL) {
+    eff_mutex_unlock(&task->mutex);
+    return -1;
+  }
+
+  async_io_t *io = malloc(sizeof(async_io_t));
+  if (io == NULL) {
+    eff_mutex_unlock(&task->mutex);
+    return -1;
+  }
+
+  io->ring = smemalign(PAGE_SIZE, PAGE_SIZE);
+  if (io->ring == NULL || eff_mutex_init(&io->mutex) < 0) {
+    if (io->ring != NULL) {
+      sfree(io->ring, PAGE_SIZE);
+    }
+    free(io);
+    eff_mutex_unlock(&task->mutex);
+    return -1;
+  }
+  memset(io->ring, 0, PAGE_SIZE);
+
+  io->base = base;
+  io->in_flight = 0;
+  io->nb_workers = 0;
+  io->destroyer = NULL;
+  io->closing = ASYNC_IO_CLOSING_FALSE;
+  Q_INIT_HEAD(&io->free_reqs);
+  Q_INIT_HEAD(&io->queued_reqs);
+  Q_INIT_HEAD(&io->idle_workers);
+  Q_INIT_HEAD(&io->enter_waiters);
+
+  int i;
+  for (i = 0 ; i < ASYNC_RING_ENTRIES ; ++i) {
+    io->reqs[i].io = io;
+    Q_INIT_ELEM(&io->reqs[i], link);
+    Q_INSERT_TAIL(&io->free_reqs, &io->reqs[i], link);
+  }
+
+  // Create the workers, they only start once the ring is set up. A worker
+  // belongs to the task so that it runs system calls in its name
+  tcb_t *workers[ASYNC_IO_WORKERS];
+  for (i = 0 ; i < ASYNC_IO_WORKERS ; ++i) {
+    workers[i] = create_kernel_thread(worker, ASYNC_IO_TID, task,
+                                      kernel.current_thread->cr3);
+    if (workers[i] == NULL) {
+      break;
+    }
+  }
+
+  if (i < ASYNC_IO_WORKERS ||
+      map_shared_frame(address, (unsigned int)io->ring, 1) < 0) {
+    while (i-- > 0) {
+      free((void *)(workers[i]->esp0 - PAGE_SIZE));
+      free(workers[i]);
+    }
+    sfree(io->ring, PAGE_SIZE);
+    free(io);
+    eff_mutex_unlock(&task->mutex);
+    return -1;
+  }
+
+  io->nb_workers = ASYNC_IO_WORKERS;
+  task->async_io = io;
+  eff_mutex_unlock(&task->mutex);
+
+  for (i = 0 ; i < ASYNC_IO_WORKERS ; ++i) {
+    add_runnable_thread(workers[i]);
+  }
+
+  return 0;
+}
+
+/** @brief  Submits the requests in the invoking task's submission queue and
+ *          waits for completions
+ *
+ *  Requests are consumed as long as there is room for their completion. The
+ *  invoking thread then blocks until at least min_complete completions are
+ *  in the completion queue, or until no request is in flight anymore.
+ *
+ *  @param  min_complete  The number of completions to wait for, 0 to only
+ *                        submit requests
+ *
+ *  @return The number of requests consumed, a negative number if the task
+ *          has no ring or if min_complete is negative
+ */
+int kern_ring_enter(int min_complete) {
+
+  async_io_t *io = kernel.current_thread->task->async_io;
+  if (io == NULL || min_complete < 0) {
+    return -1;
+  }
+
+  if (min_complete > ASYNC_RING_ENTRIES) {
+    min_complete = ASYNC_RING_ENTRIES;
+  }
+
+  eff_mutex_lock(&io->mutex);
+  int submitted = submit_requests(io);
+  eff_mutex_unlock(&io->mutex);
+
+  irq_disable();
+  while (completions_ready(io->ring) < (unsigned int)min_complete &&
+         io->in_flight > 0) {
+    Q_INSERT_TAIL(&io->enter_waiters, kernel.current_thread, wait_link);
+    block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+    irq_disable();
+  }
+  irq_enable();
+
+  return submitted;
+}
+
+/** @brief  Removes a parent's ring from its forked child's address space
+ *
+ *  The ring's page table entry was copied as is, since it is shared.
+ *
+ *  @param  parent      The parent task
+ *  @param  child_cr3   The child's page directory
+ *
+ *  @return void
+ */
+void async_io_fork(pcb_t *parent, unsigned int *child_cr3) {
+
+  async_io_t *io = parent->async_io;
+  if (io == NULL) {
+    return;
+  }
+
+  uint32_t orig_cr3 = kernel.current_thread->cr3;
+  kernel.current_thread->cr3 = (uint32_t)child_cr3;
+  set_cr3((uint32_t)child_cr3);
+  unmap_shared_frame((unsigned int)io->base);
+  kernel.current_thread->cr3 = orig_cr3;
+  set_cr3(orig_cr3);
+}
+
+/** @brief  Stops a task's workers and frees its ring
+ *
+ *  Must be called by the task's only thread, before the task's address space
+ *  is torn down. The ring stays mapped in the address space, which must not
+ *  be used anymore.
+ *
+ *  @param  task  The task
+ *
+ *  @return void
+ */
+void async_io_release(pcb_t *task) {
+
+  async_io_t *io = task->async_io;
+  if (io == NULL) {
+    return;
+  }
+
+  // The list mutex orders this with workers about to wait for a child
+  eff_mutex_lock(&task->list_mutex);
+
+  irq_disable();
+  io->closing = ASYNC_IO_CLOSING_TRUE;
+
+  // Wake up idle workers so that they exit
+  tcb_t *tcb;
+  while ((tcb = Q_GET_FRONT(&io->idle_workers)) != NULL) {
+    Q_REMOVE(&io->idle_workers, tcb, wait_link);
+    add_runnable_thread_noint(tcb);
+  }
+
+  // Cancel the ring's sleep requests
+  async_req_t *req = Q_GET_FRONT(&timers);
+  while (req != NULL) {
+    async_req_t *next = Q_GET_NEXT(req, link);
+    if (req->io == io) {
+      Q_REMOVE(&timers, req, link);
+    }
+    req = next;
+  }
+  irq_enable();
+
+  // Workers waiting for a child give up
+  tcb = Q_GET_FRONT(&task->waiting_threads);
+  while (tcb != NULL) {
+    tcb_t *next = Q_GET_NEXT(tcb, wait_link);
+    if (tcb->tid == ASYNC_IO_TID) {
+      Q_REMOVE(&task->waiting_threads, tcb, wait_link);
+      task->num_waiting_threads--;
+      tcb->reaped_task = NULL;
+      add_runnable_thread(tcb);
+    }
+    tcb = next;
+  }
+
+  eff_mutex_unlock(&task->list_mutex);
+
+  // Wait for the workers to finish the requests they are executing
+  irq_disable();
+  while (io->nb_workers > 0) {
+    io->destroyer = kernel.current_thread;
+    block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+    irq_disable();
+  }
+  io->destroyer = NULL;
+  irq_enable();
+
+  eff_mutex_lock(&task->mutex);
+  task->async_io = NULL;
+  eff_mutex_unlock(&task->mutex);
+
+  sfree(io->ring, PAGE_SIZE);
+  free(io);
+}
+
+/** @brief  Tells whether a thread is a worker of a ring being destroyed
+ *
+ *  Used by wait() so that a worker does not start waiting for a child once
+ *  its task is exiting. The task's list mutex must be held.
+ *
+ *  @param  tcb   The thread
+ *
+ *  @return 1 if the thread must give up waiting, 0 otherwise
+ */
+int async_io_is_closing(tcb_t *tcb) {
+  return tcb->tid == ASYNC_IO_TID && tcb->task->async_io != NULL &&
+         tcb->task->async_io->closing == ASYNC_IO_CLOSING_TRUE;
+}
+
+/** @brief  Tells whether a task's ring has requests in flight
+ *
+ *  Used by fork(), which can not copy an address space that the ring's
+ *  workers may be writing to. Only the task's own threads submit requests,
+ *  so the answer can only go from 1 to 0 while a single thread runs.
+ *
+ *  @param  task  The task
+ *
+ *  @return 1 if some requests are not completed yet, 0 otherwise
+ */
+int async_io_busy(pcb_t *task) {
+
+  async_io_t *io = task->async_io;
+  if (io == NULL) {
+    return 0;
+  }
+
+  irq_disable();
+  int busy = io->in_flight > 0;
+  irq_enable();
+
+  return busy;
+}
+
+/** @brief  Timer callback, completes the sleep requests whose time is up
+ *
+ *  Called from the timer's bottom half, with interrupts enabled. Threads
+ *  only touch the list of timers with interrupts disabled.
+ *
+ *  @param  ticks   The total number of ticks since system boot
+ *
+ *  @return void
+ */
+void async_io_tick(unsigned int ticks) {
+
+  async_req_t *req;
+  while ((req = Q_GET_FRONT(&timers)) != NULL &&
+         (int)(ticks - req->wake_tick) >= 0) {
+    Q_REMOVE(&timers, req, link);
+    complete_request(req->io, req, 0);
+  }
+}
+
+/** @brief  Worker threads' main loop, runs queued requests until the ring is
+ *          destroyed
+ *
+ *  @return Does not return
+ */
+static void worker() {
+
+  async_io_t *io = kernel.current_thread->task->async_io;
+
+  while (1) {
+
+    irq_disable();
+    while (Q_GET_FRONT(&io->queued_reqs) == NULL &&
+           io->closing == ASYNC_IO_CLOSING_FALSE) {
+      Q_INSERT_TAIL(&io->idle_workers, kernel.current_thread, wait_link);
+      block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+      irq_disable();
+    }
+
+    if (io->closing == ASYNC_IO_CLOSING_TRUE) {
+      irq_enable();
+      worker_exit(io);
+    }
+
+    async_req_t *req = Q_GET_FRONT(&io->queued_reqs);
+    Q_REMOVE(&io->queued_reqs, req, link);
+    irq_enable();
+
+    complete_request(io, req, run_request(&req->sqe));
+  }
+}
+
+/** @brief  Hands a worker over to the garbage collector and wakes up the
+ *          thread destroying the ring if it was the last one
+ *
+ *  @param  io  The worker's ring
+ *
+ *  @return Does not return
+ */
+static void worker_exit(async_io_t *io) {
+
+  eff_mutex_lock(&kernel.gc.mp);
+
+  // See kern_vanish(), the reaper must be woken up before the TCB is in the
+  // garbage collector's queue
+  reaper_wake();
+  Q_INSERT_TAIL(&kernel.gc.zombie_memory, kernel.current_thread, wait_link);
+
+  irq_disable();
+
+  if (--io->nb_workers == 0 && io->destroyer != NULL) {
+    add_runnable_thread_noint(io->destroyer);
+  }
+
+  // Interrupts are disabled so no one can free this kernel stack/TCB before
+  // the context switch
+  eff_mutex_unlock(&kernel.gc.mp);
+
+  block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+
+  lprintf("worker_exit(): Should never have reached here");
+  assert(0);
+}
+
+/** @brief  Runs a request's system call
+ *
+ *  @param  sqe   The request
+ *
+ *  @return The system call's return value, a negative number for an unknown
+ *          operation
+ */
+static int run_request(async_sqe_t *sqe) {
+
+  switch (sqe->op) {
+    case ASYNC_OP_PRINT:
+      return kern_print(sqe->len, sqe->buf);
+    case ASYNC_OP_READFILE:
+      return kern_readfile(sqe->name, sqe->buf, sqe->len, sqe->offset);
+    case ASYNC_OP_WAIT:
+      return kern_wait((int *)sqe->buf);
+    default:
+      return -1;
+  }
+}
+
+/** @brief  Consumes the requests in a ring's submission queue
+ *
+ *  The ring's mutex must be held.
+ *
+ *  @param  io  The ring
+ *
+ *  @return The number of requests consumed
+ */
+static int submit_requests(async_io_t *io) {
+
+  async_ring_t *ring = io->ring;
+  int submitted = 0;
+
+  while (ring->sq_head != ring->sq_tail) {
+
+    // Each request in flight owns a completion queue entry
+    irq_disable();
+    if (io->in_flight + completions_ready(ring) >= ASYNC_RING_ENTRIES) {
+      irq_enable();
+      break;
+    }
+    async_req_t *req = Q_GET_FRONT(&io->free_reqs);
+    assert(req != NULL);
+    Q_REMOVE(&io->free_reqs, req, link);
+    io->in_flight++;
+    irq_enable();
+
+    req->sqe = ring->sq[ring->sq_head % ASYNC_RING_ENTRIES];
+    ring->sq_head++;
+    ++submitted;
+
+    start_request(io, req);
+  }
+
+  return submitted;
+}
+
+/** @brief  Starts a request, either by arming a timer or by queuing it for
+ *          the workers
+ *
+ *  @param  io    The ring
+ *  @param  req   The request
+ *
+ *  @return void
+ */
+static void start_request(async_io_t *io, async_req_t *req) {
+
+  if (req->sqe.op == ASYNC_OP_SLEEP) {
+
+    // Same return values as sleep()
+    if (req->sqe.len <= 0) {
+      complete_request(io, req, (req->sqe.len == 0) ? 0 : -1);
+      return;
+    }
+
+    req->wake_tick = kern_get_ticks() + req->sqe.len;
+
+    irq_disable();
+    async_req_t *it;
+    Q_FOREACH(it, &timers, link) {
+      if ((int)(it->wake_tick - req->wake_tick) > 0) {
+        break;
+      }
+    }
+    if (it == NULL) {
+      Q_INSERT_TAIL(&timers, req, link);
+    } else {
+      Q_INSERT_BEFORE(&timers, it, req, link);
+    }
+    irq_enable();
+    return;
+  }
+
+  irq_disable();
+  Q_INSERT_TAIL(&io->queued_reqs, req, link);
+  tcb_t *idle = Q_GET_FRONT(&io->idle_workers);
+  if (idle != NULL) {
+    Q_REMOVE(&io->idle_workers, idle, wait_link);
+    add_runnable_thread_noint(idle);
+  }
+  irq_enable();
+}
+
+/** @brief  Posts a request's completion and wakes up the threads waiting in
+ *          ring_enter()
+ *
+ *  May be called with interrupts disabled.
+ *
+ *  @param  io      The ring
+ *  @param  req     The request
+ *  @param  result  The request's result
+ *
+ *  @return void
+ */
+static void complete_request(async_io_t *io, async_req_t *req, int result) {
+
+  int enabled = save_and_disable_interrupts();
+
+  async_ring_t *ring = io->ring;
+  async_cqe_t *cqe = &ring->cq[ring->cq_tail % ASYNC_RING_ENTRIES];
+  cqe->user_data = req->sqe.user_data;
+  cqe->result = result;
+  ring->cq_tail++;
+
+  io->in_flight--;
+  Q_INSERT_TAIL(&io->free_reqs, req, link);
+
+  tcb_t *waiter;
+  while ((waiter = Q_GET_FRONT(&io->enter_waiters)) != NULL) {
+    Q_REMOVE(&io->enter_waiters, waiter, wait_link);
+    add_runnable_thread_noint(waiter);
+  }
+
+  restore_interrupts(enabled);
+}
+
+/** @brief  Returns the number of completions the task did not consume yet
+ *
+ *  The task may have corrupted its head index, the result is capped to the
+ *  size of the queue.
+ *
+ *  @param  ring  The ring
+ *
+ *  @return The number of completions ready
+ */
+static unsigned int completions_ready(async_ring_t *ring) {
+  unsigned int ready = ring->cq_tail - ring->cq_head;
+  return (ready > ASYNC_RING_ENTRIES) ? ASYNC_RING_ENTRIES : ready;
+}
@@ -1,11 +1,12 @@
 /** @file console_io.c
- *  @brief  This file contains the definition for the kern_readline() and
- *          kern_print() system calls.
+ *  @brief  This file contains the definition for the kern_readline(),
+ *          kern_print() and kern_getchar() system calls.
  *  @author akanjani, lramire1
  */
 
 #include <eff_mutex.h>
 #include <console.h>
+#include <console_ring.h>
 #include <assert.h>
 #include <common_kern.h>
 #include <keyboard.h>
@@ -14,6 +15,7 @@
 #include <tcb.h>
 #include <kernel_state.h>
 #include <asm.h>
+#include <irq_trace.h>
 #include <scheduler.h>
 #include <atomic_ops.h>
 #include <syscalls.h>
@@ -63,13 +65,16 @@ int kern_readline(int len, char *buf) {
   // Block concurrent threads
   eff_mutex_lock(&kernel.readline_mutex);
 
+  // Let earlier output (e.g. a prompt) reach the console before the echo
+  console_ring_flush();
+
   // Update readline_t data structure in kernel state
   kernel.rl.buf = buf;
   kernel.rl.len = len;
   kernel.rl.caller = kernel.current_thread;
 
   // Deschedule myself until a line of input is available
-  disable_interrupts();
+  irq_disable();
   kernel.current_thread->thread_state = THR_BLOCKED;
   context_switch(kernel.keyboard_consumer_thread);
 
@@ -116,8 +121,8 @@ int kern_print(int len, char *buf) {
  *
  *  Outputs of two concurrent call to print() cannot be intermixed. Characters 
  *  printed to the console invoke standard newline, backspace, and scrolling 
- *  behaviors. The calling thread does not continue until all characters have
- *  been printed to the console.
+ *  behaviors. The output is queued in the console ring and rendered by the
+ *  flusher thread, the calling thread only blocks if the ring is full.
  *
  *  @param  len     The number of bytes of memory to write
  *  @param  buf     The starting memory address
@@ -129,32 +134,33 @@ void kern_print_helper(int len, char *buf) {
   // Block concurrent threads
   eff_mutex_lock(&kernel.print_mutex);
 
-  // Lock the mutex on the console
-  eff_mutex_lock(&kernel.console_mutex);
-
-  // Print the buffer's content on the console
-  int i;
-  for (i = 0 ; i < len ; ++i) {
-    putbyte(buf[i]);
-    if (kernel.rl.caller != NULL) {
-      if (kernel.rl.key_index < CONSOLE_IO_MAX_LEN) {
-      kernel.rl.key_buf[kernel.rl.key_index] = buf[i];
-    }
-      ++kernel.rl.key_index;
-    }
-  }
-
-  // Unlock the mutex on the console
-  eff_mutex_unlock(&kernel.console_mutex);
+  // Queue the buffer's content for the console
+  console_ring_write(buf, len);
 
   // Allow other threads to run
   eff_mutex_unlock(&kernel.print_mutex);
 }
 
-/** @brief  Not implemented
- *  @return -1
+/** @brief  Returns a single character from the character input stream
+ *
+ *  If the input stream is empty the calling thread is descheduled until a
+ *  character is available. If some other thread is descheduled on a
+ *  readline() or getchar(), the calling thread blocks and waits its turn to
+ *  access the input stream. Characters processed by getchar() are not echoed
+ *  to the console.
+ *
+ *  @return The character read
  */
 int kern_getchar(void) {
-  return -1;
+
+  // Block concurrent threads
+  eff_mutex_lock(&kernel.readline_mutex);
+
+  int ch = readchar_wait();
+
+  // Allow other threads to run
+  eff_mutex_unlock(&kernel.readline_mutex);
+
+  return ch;
 }
 
@@ -23,6 +23,10 @@
 #include <virtual_memory_defines.h>
 #include <eflags.h>
 #include <context_switch_asm.h>
+#include <fpu.h>
+#include <shm.h>
+#include <reaper.h>
+#include <async_io.h>
 
 #define ERR_INVALID_ARGS -1
 #define ARGS_MAX_SIZE 256
@@ -101,8 +105,17 @@ int kern_exec(char *execname, char **argvec) {
   curr_tcb->swexn_values.eip = NULL;
   curr_tcb->swexn_values.arg = NULL;
 
-  // Free the entire old address space
-  free_address_space(old_cr3, KERNEL_AND_USER_SPACE);
+  // The new program starts with a fresh FPU state
+  fpu_release(curr_tcb);
+
+  // The ring's workers use the old address space, stop them first
+  async_io_release(curr_tcb->task);
+
+  // The old address space is torn down in the background
+  reaper_free_address_space(old_cr3, 0, NULL);
+
+  // Shared memory segments are not inherited by the new program
+  release_frames(shm_release_all(curr_tcb->task));
 
   // Run the new program
   run_first_thread(elf.e_entry, (uint32_t)new_stack_addr, get_eflags());
@@ -16,6 +16,14 @@
 #include <asm.h>
 #include <syscalls.h>
 #include <assert.h>
+#include <fpu.h>
+#include <shm.h>
+#include <fs.h>
+#include <ksm.h>
+#include <swap.h>
+#include <reaper.h>
+#include <async_io.h>
+#include <irq_trace.h>
 
 /* VM system */
 #include <virtual_memory.h>
@@ -58,8 +66,15 @@ int kern_fork(unsigned int *esp) {
     return -1;
   }
 
+  // The ring's workers may be writing to the address space we would copy
+  if (async_io_busy(kernel.current_thread->task)) {
+    lprintf("fork(): Asynchronous requests are still in flight");
+    return -1;
+  }
+
   // Reserve the number of frames needed for the new task
-  if (reserve_frames(kernel.current_thread->num_of_frames_requested) < 0) {
+  if (reaper_reserve_frames(kernel.current_thread->num_of_frames_requested) <
+      0) {
     return -1;
   }
 
@@ -79,6 +94,9 @@ int kern_fork(unsigned int *esp) {
     return -1;
   }
 
+  // The child does not inherit the asynchronous system call ring
+  async_io_fork(kernel.current_thread->task, new_cr3);
+
   // Highest address of child's kernel stack
   uint32_t esp0 = (uint32_t)(stack_kernel) + PAGE_SIZE;
 
@@ -91,6 +109,18 @@ int kern_fork(unsigned int *esp) {
     return -1;
   }
 
+  // The child shares the parent's shared memory segments
+  if (shm_fork(kernel.current_thread->task, new_pcb) < 0) {
+    lprintf("fork(): Could not share memory segments");
+    free(stack_kernel);
+    shm_release_all(new_pcb);
+    tid_table_remove(&kernel.pcbs, new_pcb->tid);
+    task_heap_release_slot(&kernel.runnable_tasks);
+    free(new_pcb);
+    free_address_space(new_cr3, KERNEL_AND_USER_SPACE);
+    return -1;
+  }
+
   // Create new TCB for the root thread
   tcb_t *new_tcb = create_new_tcb(new_pcb, esp0, (uint32_t)new_cr3, 
                     &kernel.current_thread->swexn_values, ROOT_THREAD_TRUE);
@@ -98,17 +128,43 @@ int kern_fork(unsigned int *esp) {
   if (new_tcb == NULL) {
     lprintf("fork(): TCB initialization failed");
     free(stack_kernel);
-    hash_table_remove_element(&kernel.pcbs, new_pcb);
+    shm_release_all(new_pcb);
+    tid_table_remove(&kernel.pcbs, new_pcb->tid);
+    task_heap_release_slot(&kernel.runnable_tasks);
+    free(new_pcb);
     free_address_space(new_cr3, KERNEL_AND_USER_SPACE);
     return -1;
   }
   new_pcb->parent = kernel.current_thread->task;
 
+  // The child inherits the FPU state of its parent
+  if (fpu_copy_state(kernel.current_thread, new_tcb) < 0) {
+    lprintf("fork(): Could not copy FPU state");
+    tid_table_remove(&kernel.tcbs, new_tcb->tid);
+    free(new_tcb);
+    free(stack_kernel);
+    shm_release_all(new_pcb);
+    tid_table_remove(&kernel.pcbs, new_pcb->tid);
+    task_heap_release_slot(&kernel.runnable_tasks);
+    free(new_pcb);
+    free_address_space(new_cr3, KERNEL_AND_USER_SPACE);
+    return -1;
+  }
+
+  // The child shares the parent's open files
+  fs_fork(kernel.current_thread->task, new_pcb);
+
+  // The child inherits the scheduling weight of its parent (but not the
+  // tickets lent to it)
+  new_pcb->weight = kernel.current_thread->task->weight;
+  new_pcb->stride = STRIDE_ONE / new_pcb->weight;
+
   // Add the child to the running queue
-  eff_mutex_lock(&kernel.current_thread->task->list_mutex);
-  kernel.current_thread->task->num_running_children++;
-linked_list_insert_node(&kernel.current_thread->task->running_children,new_pcb);
-  eff_mutex_unlock(&kernel.current_thread->task->list_mutex);
+  pcb_t *parent = kernel.current_thread->task;
+  eff_mutex_lock(&parent->list_mutex);
+  parent->num_running_children++;
+  Q_INSERT_TAIL(&parent->running_children, new_pcb, child_link);
+  eff_mutex_unlock(&parent->list_mutex);
 
   // Craft the kernel stack for the new thread
   new_tcb->esp = (uint32_t) initialize_stack_fork(kernel.current_thread->esp0,
@@ -271,18 +327,41 @@ static unsigned int * copy_memory_regions() {
            orig_tab_entry < orig_page_table_addr + nb_entries;
            ++orig_tab_entry, ++new_tab_entry) {
 
-        // If the page table entry is present
-        if (is_entry_present(orig_tab_entry)) {
+        // The entry is read once, the swapper may page the original page out
+        // and back in while it is being copied. Pages in the swap area share
+        // their slot with the child, which gets its own frame when it pages
+        // it back in
+        irq_disable();
+        unsigned int orig_entry = *orig_tab_entry;
+        if (is_page_swapped(&orig_entry)) {
+          *new_tab_entry = orig_entry;
+          swap_dup_entry(orig_tab_entry);
+        }
+        irq_enable();
 
-          if ((unsigned int)get_frame_addr(orig_tab_entry) < USER_MEM_START) {
-            // This is direct mapped kernel memory
-            *new_tab_entry = *orig_tab_entry;
+        // If the page table entry is present
+        if (is_entry_present(&orig_entry)) {
+
+          if ((unsigned int)get_frame_addr(&orig_entry) < USER_MEM_START ||
+              is_page_shared(&orig_entry)) {
+            // This is direct mapped kernel memory or a shared memory segment
+            *new_tab_entry = orig_entry;
+          } else if (is_page_requested(&orig_entry)) {
+            // Untouched page from new_pages(), the child maps the zeroed out
+            // frame as well and gets its own frame on its first write
+            *new_tab_entry = orig_entry;
+          } else if (is_page_merged(&orig_entry)) {
+            // The child maps the same merged frame (the parent is the only
+            // thread of its task, so the page can not be split meanwhile)
+            *new_tab_entry = orig_entry;
+            ksm_get_frame((unsigned int)get_frame_addr(&orig_entry));
           } else {
             // This is user space memory, we have to allocate a new frame
 
-            // Create a new page table entry
+            // Create a new page table entry (writable until the frame is
+            // filled, since the kernel runs with CR0.WP set)
             if (create_page_table_entry(new_tab_entry,
-                                    get_entry_flags(orig_tab_entry)) == NULL) {
+                  get_entry_flags(&orig_entry) | PAGE_WRITABLE) == NULL) {
               lprintf("copy_memory_regions(): Unable to allocate frame");
               free(buffer);    
 
@@ -307,8 +386,14 @@ static unsigned int * copy_memory_regions() {
             kernel.current_thread->cr3 = (uint32_t)new_cr3;
             set_cr3((uint32_t)new_cr3);
             memcpy((unsigned int *)new_virtual_address, buffer, PAGE_SIZE);
+            *new_tab_entry = (*new_tab_entry & PAGE_ADDR_MASK) |
+                             get_entry_flags(&orig_entry);
+            invalidate_tlb(new_virtual_address);
             kernel.current_thread->cr3 = (uint32_t)orig_cr3;
             set_cr3((uint32_t)orig_cr3);
+
+            // Let a pending reschedule happen between two frames
+            preempt_point();
           }
         }
       }
@@ -318,5 +403,10 @@ static unsigned int * copy_memory_regions() {
   // Free the buffer
   free(buffer);
 
+  // Let the same-page merging daemon and the swapper scan the new address
+  // space
+  ksm_register(new_cr3);
+  swap_register(new_cr3);
+
   return new_cr3;
 }
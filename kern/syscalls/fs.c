@@ -0,0 +1,855 @@
+/** @file fs.c
+ *  @brief This file contains the definitions for the open(), read(),
+ *  write(), close(), unlink() and fmap() system calls, as well as helper
+ *  functions used to manage the RAM filesystem.
+ *
+ *  The filesystem is a single directory, indexed by a hash table of file
+ *  names. A file's content is stored in page-sized extents, the frames of an
+ *  anonymous shared memory segment (see shm.c) which grows with the file.
+ *  fmap() maps these frames in the invoking task's address space without
+ *  copying them, the mapping is removed with shm_detach() like any other
+ *  segment. Files never shrink, so that the frames of a mapping always
+ *  belong to the file.
+ *
+ *  The filesystem is layered over the executables' table of contents: the
+ *  first open() of an executable's name copies its image into a read-only
+ *  file, which is then shared (and mapped) without further copies. Other
+ *  files are created by open() with FS_CREATE and live until they are
+ *  unlinked and their last open file is closed.
+ *
+ *  Open files are shared by the descriptors copied by fork() and survive
+ *  exec(), they are closed when their task vanishes.
+ *
+ *  The disks found at boot appear as device files ("ata0", "ata1"), whose
+ *  content is the drive's, read and written through the buffer cache (see
+ *  bcache.c). Device files have the size of their drive and can not be
+ *  mapped or unlinked. Closing a device file opened for writing writes the
+ *  drive's modified blocks back.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <fs.h>
+#include <syscall.h>
+#include <common_kern.h>
+#include <kernel_state.h>
+#include <eff_mutex.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+#include <loader.h>
+#include <irq_trace.h>
+#include <bcache.h>
+
+/* VM system */
+#include <virtual_memory.h>
+#include <virtual_memory_helper.h>
+#include <virtual_memory_defines.h>
+
+/* Debugging */
+#include <simics.h>
+#include <assert.h>
+
+/* Number of buckets in the directory's hash table, must be a power of two */
+#define FS_NB_BUCKETS 64
+
+/* Files are limited to what an int can describe */
+#define FS_MAX_FILE_SIZE 0x7fffffff
+
+/* Flags accepted by open() */
+#define FS_ALL_FLAGS (FS_READ | FS_WRITE | FS_CREATE | FS_APPEND)
+
+/* FNV-1a hash parameters */
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+/* Directions of copy_data() */
+#define TO_FILE 1
+#define FROM_FILE 0
+
+/* The directory's hash table */
+static fs_file_t *directory[FS_NB_BUCKETS];
+
+/* Mutex protecting the directory and the reference counts of the files and
+ * open files */
+static eff_mutex_t fs_mutex;
+
+/* Static functions prototypes */
+static int check_name(char *name);
+static unsigned int hash_name(char *name);
+static fs_file_t *find_file(char *name);
+static fs_file_t *create_file(char *name);
+static void add_file(fs_file_t *file);
+static int import_image(fs_file_t *file, int size);
+static void put_file(fs_file_t *file);
+static void destroy_file(fs_file_t *file);
+static fs_open_t *get_open(int fd);
+static void put_open(fs_open_t *open);
+static int grow_file(fs_file_t *file, unsigned int size);
+static int copy_data(fs_file_t *file, unsigned int offset, char *buf,
+                     int count, int direction);
+static int file_io(fs_file_t *file, unsigned int offset, char *buf,
+                   int count, int direction);
+
+/** @brief  Initializes the RAM filesystem
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int fs_init() {
+  memset(directory, 0, sizeof(directory));
+  return eff_mutex_init(&fs_mutex);
+}
+
+/** @brief  Opens a file of the RAM filesystem
+ *
+ *  flags must contain FS_READ and/or FS_WRITE. The file is created (empty)
+ *  if it does not exist and flags contains FS_CREATE. With FS_APPEND, every
+ *  write() appends to the file. Executables' images may only be opened for
+ *  reading.
+ *
+ *  @param  name   The file's name (at most FS_NAME_MAX_LEN characters)
+ *  @param  flags  A combination of FS_READ, FS_WRITE, FS_CREATE and
+ *                 FS_APPEND
+ *
+ *  @return A file descriptor on success, a negative number on error
+ */
+int kern_open(char *name, int flags) {
+
+  if (check_name(name) < 0) {
+    lprintf("\tkern_open(): Invalid name argument");
+    return -1;
+  }
+
+  if ((flags & ~FS_ALL_FLAGS) || !(flags & (FS_READ | FS_WRITE))) {
+    lprintf("\tkern_open(): Invalid flags argument");
+    return -1;
+  }
+
+  fs_open_t *open = malloc(sizeof(fs_open_t));
+  if (open == NULL) {
+    return -1;
+  }
+
+  eff_mutex_lock(&fs_mutex);
+
+  fs_file_t *file = find_file(name);
+  int image_size = (file == NULL) ? get_file_size(name) : -1;
+
+  if (image_size >= 0) {
+    // First use of an executable's image
+    file = create_file(name);
+    if (file != NULL && import_image(file, image_size) < 0) {
+      destroy_file(file);
+      file = NULL;
+    }
+  } else if (file == NULL && (flags & FS_CREATE)) {
+    file = create_file(name);
+  }
+
+  if (file != NULL && file->refcount == 0) {
+    // New file, give it its directory entry
+    add_file(file);
+  }
+
+  if (file == NULL || (file->read_only && (flags & FS_WRITE))) {
+    eff_mutex_unlock(&fs_mutex);
+    free(open);
+    return -1;
+  }
+
+  file->refcount++;
+  eff_mutex_unlock(&fs_mutex);
+
+  open->file = file;
+  open->flags = flags;
+  open->offset = 0;
+  open->refcount = 1;
+
+  // Install the open file in the first free descriptor
+  pcb_t *task = kernel.current_thread->task;
+  eff_mutex_lock(&task->mutex);
+  int fd;
+  for (fd = 0; fd < TASK_MAX_OPEN_FILES; ++fd) {
+    if (task->open_files[fd] == NULL) {
+      task->open_files[fd] = open;
+      break;
+    }
+  }
+  eff_mutex_unlock(&task->mutex);
+
+  if (fd == TASK_MAX_OPEN_FILES) {
+    lprintf("\tkern_open(): Too many open files");
+    put_open(open);
+    return -1;
+  }
+
+  return fd;
+}
+
+/** @brief  Reads bytes from an open file, starting at its current position
+ *
+ *  @param  fd     The file descriptor, opened with FS_READ
+ *  @param  buf    The buffer to copy the bytes into
+ *  @param  count  The maximum number of bytes to read
+ *
+ *  @return The number of bytes read (0 at the end of the file) on success,
+ *          a negative number on error
+ */
+int kern_read(int fd, char *buf, int count) {
+
+  if (count < 0 ||
+      (count > 0 && is_buffer_valid((unsigned int)buf, count,
+                                    READ_WRITE) < 0)) {
+    return -1;
+  }
+
+  fs_open_t *open = get_open(fd);
+  if (open == NULL) {
+    return -1;
+  }
+
+  if (!(open->flags & FS_READ)) {
+    put_open(open);
+    return -1;
+  }
+
+  fs_file_t *file = open->file;
+  eff_mutex_lock(&file->mutex);
+
+  int len = 0;
+  if (open->offset < file->size) {
+    len = (file->size - open->offset < (unsigned int)count) ?
+          file->size - open->offset : count;
+    len = file_io(file, open->offset, buf, len, FROM_FILE);
+    if (len > 0) {
+      open->offset += len;
+    }
+  }
+
+  eff_mutex_unlock(&file->mutex);
+  put_open(open);
+
+  return len;
+}
+
+/** @brief  Writes bytes to an open file, starting at its current position
+ *          (or at its end if it was opened with FS_APPEND)
+ *
+ *  The file grows as needed.
+ *
+ *  @param  fd     The file descriptor, opened with FS_WRITE
+ *  @param  buf    The bytes to write
+ *  @param  count  The number of bytes to write
+ *
+ *  @return The number of bytes written on success, a negative number on
+ *          error
+ */
+int kern_write(int fd, char *buf, int count) {
+
+  if (count < 0 ||
+      (count > 0 && is_buffer_valid((unsigned int)buf, count,
+                                    AT_LEAST_READ) < 0)) {
+    return -1;
+  }
+
+  fs_open_t *open = get_open(fd);
+  if (open == NULL) {
+    return -1;
+  }
+
+  if (!(open->flags & FS_WRITE)) {
+    put_open(open);
+    return -1;
+  }
+
+  fs_file_t *file = open->file;
+  eff_mutex_lock(&file->mutex);
+
+  if (open->flags & FS_APPEND) {
+    open->offset = file->size;
+  }
+
+  int len = -1;
+  if (file->device != FS_NO_DEVICE) {
+    // Device files do not grow
+    len = 0;
+    if (open->offset < file->size) {
+      len = (file->size - open->offset < (unsigned int)count) ?
+            file->size - open->offset : count;
+      len = file_io(file, open->offset, buf, len, TO_FILE);
+      if (len > 0) {
+        open->offset += len;
+      }
+    }
+  } else if ((unsigned int)count <= FS_MAX_FILE_SIZE - open->offset &&
+             grow_file(file, open->offset + count) == 0) {
+    len = copy_data(file, open->offset, buf, count, TO_FILE);
+    if (len > 0) {
+      open->offset += len;
+    }
+    if (open->offset > file->size) {
+      file->size = open->offset;
+    }
+  }
+
+  eff_mutex_unlock(&file->mutex);
+  put_open(open);
+
+  return len;
+}
+
+/** @brief  Closes a file descriptor
+ *
+ *  The file is destroyed if it was unlinked and this was its last open file.
+ *
+ *  @param  fd  The file descriptor
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int kern_close(int fd) {
+
+  if (fd < 0 || fd >= TASK_MAX_OPEN_FILES) {
+    return -1;
+  }
+
+  pcb_t *task = kernel.current_thread->task;
+  eff_mutex_lock(&task->mutex);
+  fs_open_t *open = task->open_files[fd];
+  task->open_files[fd] = NULL;
+  eff_mutex_unlock(&task->mutex);
+
+  if (open == NULL) {
+    return -1;
+  }
+
+  put_open(open);
+  return 0;
+}
+
+/** @brief  Removes a file from the directory
+ *
+ *  The file's content remains accessible through its open files and
+ *  mappings, it is freed when the last of them goes away. Executables'
+ *  images can not be unlinked.
+ *
+ *  @param  name  The file's name
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int kern_unlink(char *name) {
+
+  if (check_name(name) < 0) {
+    lprintf("\tkern_unlink(): Invalid name argument");
+    return -1;
+  }
+
+  eff_mutex_lock(&fs_mutex);
+
+  fs_file_t *file = find_file(name);
+  if (file == NULL || file->read_only || file->device != FS_NO_DEVICE) {
+    eff_mutex_unlock(&fs_mutex);
+    return -1;
+  }
+
+  fs_file_t **prev = &directory[hash_name(name)];
+  while (*prev != file) {
+    prev = &(*prev)->next;
+  }
+  *prev = file->next;
+
+  eff_mutex_unlock(&fs_mutex);
+
+  // Drop the directory's reference
+  put_file(file);
+  return 0;
+}
+
+/** @brief  Maps the content of an open file in the invoking task's address
+ *          space, without copying it
+ *
+ *  The whole file is mapped at base, rounded up to a number of pages. The
+ *  pages are writable if the file was opened with FS_WRITE, writes to the
+ *  mapping are writes to the file. Later writes beyond the mapped pages are
+ *  not visible through the mapping. The mapping is removed with shm_detach().
+ *
+ *  @param  fd    The file descriptor
+ *  @param  base  The page-aligned address at which to map the file
+ *
+ *  @return The file's size on success, a negative number on error
+ */
+int kern_fmap(int fd, void *base) {
+
+  fs_open_t *open = get_open(fd);
+  if (open == NULL) {
+    return -1;
+  }
+
+  fs_file_t *file = open->file;
+  eff_mutex_lock(&file->mutex);
+
+  int ret = -1;
+  if (file->size > 0 && file->device == FS_NO_DEVICE &&
+      shm_segment_attach(file->pages, base,
+                         (file->size + PAGE_SIZE - 1) / PAGE_SIZE,
+                         open->flags & FS_WRITE) == 0) {
+    ret = file->size;
+  }
+
+  eff_mutex_unlock(&file->mutex);
+  put_open(open);
+
+  return ret;
+}
+
+/** @brief  Reads a file of the RAM filesystem on behalf of readfile()
+ *
+ *  The buffer must have been checked by the caller.
+ *
+ *  @param  filename  The file's name
+ *  @param  buf       The buffer to copy the data into
+ *  @param  count     The number of bytes to be copied
+ *  @param  offset    The location in the file to begin copying from
+ *
+ *  @return The number of bytes copied on success, FS_NOT_FOUND if the file
+ *          is not in the RAM filesystem, another negative number on error
+ */
+int fs_readfile(char *filename, char *buf, int count, int offset) {
+
+  if (check_name(filename) < 0) {
+    return FS_NOT_FOUND;
+  }
+
+  eff_mutex_lock(&fs_mutex);
+  fs_file_t *file = find_file(filename);
+  if (file != NULL) {
+    file->refcount++;
+  }
+  eff_mutex_unlock(&fs_mutex);
+
+  if (file == NULL) {
+    return FS_NOT_FOUND;
+  }
+
+  eff_mutex_lock(&file->mutex);
+
+  int len = -1;
+  if ((unsigned int)offset <= file->size) {
+    len = (file->size - offset < (unsigned int)count) ?
+          file->size - offset : count;
+    len = file_io(file, offset, buf, len, FROM_FILE);
+  }
+
+  eff_mutex_unlock(&file->mutex);
+  put_file(file);
+
+  return len;
+}
+
+/** @brief  Adds a device file exposing the content of a drive
+ *
+ *  @param  name   The file's name
+ *  @param  drive  The drive
+ *  @param  size   The drive's size in bytes, capped to what a file can
+ *                 describe
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int fs_add_device(char *name, int drive, unsigned int size) {
+
+  fs_file_t *file = create_file(name);
+  if (file == NULL) {
+    return -1;
+  }
+
+  file->device = drive;
+  file->size = (size > FS_MAX_FILE_SIZE) ? FS_MAX_FILE_SIZE : size;
+
+  eff_mutex_lock(&fs_mutex);
+  add_file(file);
+  eff_mutex_unlock(&fs_mutex);
+
+  return 0;
+}
+
+/** @brief  Makes a child task share the open files of its parent
+ *
+ *  @param  parent  The parent task
+ *  @param  child   The child task, which is not running yet
+ *
+ *  @return void
+ */
+void fs_fork(pcb_t *parent, pcb_t *child) {
+
+  eff_mutex_lock(&parent->mutex);
+
+  int fd;
+  for (fd = 0; fd < TASK_MAX_OPEN_FILES; ++fd) {
+    fs_open_t *open = parent->open_files[fd];
+    if (open != NULL) {
+      eff_mutex_lock(&fs_mutex);
+      open->refcount++;
+      eff_mutex_unlock(&fs_mutex);
+    }
+    child->open_files[fd] = open;
+  }
+
+  eff_mutex_unlock(&parent->mutex);
+}
+
+/** @brief  Closes all the file descriptors of a task
+ *
+ *  @param  task  The task
+ *
+ *  @return void
+ */
+void fs_close_all(pcb_t *task) {
+
+  fs_open_t *opens[TASK_MAX_OPEN_FILES];
+
+  eff_mutex_lock(&task->mutex);
+  memcpy(opens, task->open_files, sizeof(opens));
+  memset(task->open_files, 0, sizeof(task->open_files));
+  eff_mutex_unlock(&task->mutex);
+
+  int fd;
+  for (fd = 0; fd < TASK_MAX_OPEN_FILES; ++fd) {
+    if (opens[fd] != NULL) {
+      put_open(opens[fd]);
+    }
+  }
+}
+
+/** @brief  Checks that a file name is a valid string of acceptable length
+ *
+ *  @param  name  The name
+ *
+ *  @return 0 if the name is valid, a negative number otherwise
+ */
+static int check_name(char *name) {
+
+  if ((unsigned int)name < USER_MEM_START || is_valid_string(name) < 0) {
+    return -1;
+  }
+
+  int len = strlen(name);
+  if (len == 0 || len > FS_NAME_MAX_LEN) {
+    return -1;
+  }
+
+  return 0;
+}
+
+/** @brief  Computes the directory bucket of a file name
+ *
+ *  @param  name  The name
+ *
+ *  @return The index of the name's bucket
+ */
+static unsigned int hash_name(char *name) {
+
+  unsigned int hash = FNV_OFFSET_BASIS;
+  while (*name != '\0') {
+    hash = (hash ^ (unsigned char)*name++) * FNV_PRIME;
+  }
+
+  return hash & (FS_NB_BUCKETS - 1);
+}
+
+/** @brief  Looks for a file by name, fs_mutex must be held
+ *
+ *  @param  name  The file's name
+ *
+ *  @return The file if it exists, NULL otherwise
+ */
+static fs_file_t *find_file(char *name) {
+
+  fs_file_t *file;
+  for (file = directory[hash_name(name)]; file != NULL; file = file->next) {
+    if (strcmp(file->name, name) == 0) {
+      return file;
+    }
+  }
+
+  return NULL;
+}
+
+/** @brief  Creates an empty file, not yet in the directory
+ *
+ *  @param  name  The file's name
+ *
+ *  @return The new file on success, NULL on error
+ */
+static fs_file_t *create_file(char *name) {
+
+  fs_file_t *file = malloc(sizeof(fs_file_t));
+  if (file == NULL) {
+    return NULL;
+  }
+
+  if (eff_mutex_init(&file->mutex) < 0) {
+    free(file);
+    return NULL;
+  }
+
+  strcpy(file->name, name);
+  file->size = 0;
+  file->pages = NULL;
+  file->read_only = 0;
+  file->device = FS_NO_DEVICE;
+  file->refcount = 0;
+  file->next = NULL;
+
+  return file;
+}
+
+/** @brief  Adds a new file to the directory, fs_mutex must be held
+ *
+ *  The directory entry holds a reference on the file.
+ *
+ *  @param  file  The file
+ *
+ *  @return void
+ */
+static void add_file(fs_file_t *file) {
+
+  unsigned int bucket = hash_name(file->name);
+  file->next = directory[bucket];
+  directory[bucket] = file;
+  file->refcount++;
+}
+
+/** @brief  Copies an executable's image into a new, empty file
+ *
+ *  The image is read from the table of contents one page at a time, through
+ *  the kernel's frame window.
+ *
+ *  @param  file  The file, named after the executable
+ *  @param  size  The image's size
+ *
+ *  @return 0 on success, a negative number on error
+ */
+static int import_image(fs_file_t *file, int size) {
+
+  file->read_only = 1;
+
+  if (size == 0) {
+    return 0;
+  }
+
+  if (grow_file(file, size) < 0) {
+    return -1;
+  }
+
+  int offset;
+  for (offset = 0; offset < size; offset += PAGE_SIZE) {
+    irq_disable();
+    char *window = map_frame_window(file->pages->frames[offset / PAGE_SIZE]);
+    getbytes(file->name, offset, PAGE_SIZE, window);
+    unmap_frame_window();
+    irq_enable();
+  }
+
+  file->size = size;
+  return 0;
+}
+
+/** @brief  Drops a reference on a file, the file is destroyed when the last
+ *          reference goes away
+ *
+ *  @param  file  The file
+ *
+ *  @return void
+ */
+static void put_file(fs_file_t *file) {
+
+  eff_mutex_lock(&fs_mutex);
+
+  assert(file->refcount > 0);
+  if (--file->refcount > 0) {
+    eff_mutex_unlock(&fs_mutex);
+    return;
+  }
+
+  eff_mutex_unlock(&fs_mutex);
+
+  destroy_file(file);
+}
+
+/** @brief  Frees a file that nothing refers to anymore
+ *
+ *  @param  file  The file
+ *
+ *  @return void
+ */
+static void destroy_file(fs_file_t *file) {
+
+  // The frames are freed once the last mapping is removed as well
+  if (file->pages != NULL) {
+    shm_segment_put(file->pages);
+  }
+
+  eff_mutex_destroy(&file->mutex);
+  free(file);
+}
+
+/** @brief  Gets the open file of a descriptor of the invoking task, and a
+ *          reference on it
+ *
+ *  @param  fd  The file descriptor
+ *
+ *  @return The open file, NULL if the descriptor is not valid
+ */
+static fs_open_t *get_open(int fd) {
+
+  if (fd < 0 || fd >= TASK_MAX_OPEN_FILES) {
+    return NULL;
+  }
+
+  pcb_t *task = kernel.current_thread->task;
+  eff_mutex_lock(&task->mutex);
+
+  fs_open_t *open = task->open_files[fd];
+  if (open != NULL) {
+    eff_mutex_lock(&fs_mutex);
+    open->refcount++;
+    eff_mutex_unlock(&fs_mutex);
+  }
+
+  eff_mutex_unlock(&task->mutex);
+  return open;
+}
+
+/** @brief  Drops a reference on an open file, the open file is destroyed
+ *          when the last reference goes away
+ *
+ *  @param  open  The open file
+ *
+ *  @return void
+ */
+static void put_open(fs_open_t *open) {
+
+  eff_mutex_lock(&fs_mutex);
+
+  assert(open->refcount > 0);
+  if (--open->refcount > 0) {
+    eff_mutex_unlock(&fs_mutex);
+    return;
+  }
+
+  eff_mutex_unlock(&fs_mutex);
+
+  if (open->file->device != FS_NO_DEVICE && (open->flags & FS_WRITE)) {
+    bcache_sync(open->file->device);
+  }
+
+  put_file(open->file);
+  free(open);
+}
+
+/** @brief  Allocates the extents needed to store a number of bytes in a
+ *          file, the file's mutex must be held
+ *
+ *  The file's size is left to the caller.
+ *
+ *  @param  file  The file
+ *  @param  size  The number of bytes
+ *
+ *  @return 0 on success, a negative number on error
+ */
+static int grow_file(fs_file_t *file, unsigned int size) {
+
+  unsigned int nb_pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+  if (nb_pages == 0) {
+    return 0;
+  }
+
+  if (file->pages == NULL) {
+    file->pages = shm_segment_create(nb_pages);
+    return (file->pages == NULL) ? -1 : 0;
+  }
+
+  return shm_segment_grow(file->pages, nb_pages);
+}
+
+/** @brief  Copies bytes between a file's extents and a buffer of the
+ *          invoking task, the file's mutex must be held
+ *
+ *  The extents are only reachable through the kernel's frame window, which
+ *  may only be used with interrupts disabled. The bytes go through a bounce
+ *  buffer, so that the task's buffer is accessed (and its pages possibly
+ *  faulted in) with interrupts enabled.
+ *
+ *  @param  file       The file
+ *  @param  offset     The position of the first byte in the file
+ *  @param  buf        The task's buffer
+ *  @param  count      The number of bytes, the extents must exist
+ *  @param  direction  TO_FILE or FROM_FILE
+ *
+ *  @return The number of bytes copied on success, a negative number on
+ *          error
+ */
+static int copy_data(fs_file_t *file, unsigned int offset, char *buf,
+                     int count, int direction) {
+
+  if (count == 0) {
+    return 0;
+  }
+
+  char *bounce = malloc(PAGE_SIZE);
+  if (bounce == NULL) {
+    return -1;
+  }
+
+  int done = 0;
+  while (done < count) {
+    unsigned int position = offset + done;
+    unsigned int frame = file->pages->frames[position / PAGE_SIZE];
+    unsigned int in_page = position % PAGE_SIZE;
+    int len = (PAGE_SIZE - in_page < (unsigned int)(count - done)) ?
+              PAGE_SIZE - in_page : count - done;
+
+    if (direction == TO_FILE) {
+      memcpy(bounce, buf + done, len);
+      irq_disable();
+      memcpy(map_frame_window(frame) + in_page, bounce, len);
+      unmap_frame_window();
+      irq_enable();
+    } else {
+      irq_disable();
+      memcpy(bounce, map_frame_window(frame) + in_page, len);
+      unmap_frame_window();
+      irq_enable();
+      memcpy(buf + done, bounce, len);
+    }
+
+    done += len;
+  }
+
+  free(bounce);
+  return done;
+}
+
+/** @brief  Copies bytes between a file and a buffer of the invoking task,
+ *          the file's mutex must be held
+ *
+ *  @param  file       The file
+ *  @param  offset     The position of the first byte in the file
+ *  @param  buf        The task's buffer
+ *  @param  count      The number of bytes, within the file
+ *  @param  direction  TO_FILE or FROM_FILE
+ *
+ *  @return The number of bytes copied on success, a negative number on
+ *          error
+ */
+static int file_io(fs_file_t *file, unsigned int offset, char *buf,
+                   int count, int direction) {
+
+  if (file->device == FS_NO_DEVICE) {
+    return copy_data(file, offset, buf, count, direction);
+  }
+
+  if (direction == TO_FILE) {
+    return bcache_write(file->device, offset, buf, count);
+  }
+  return bcache_read(file->device, offset, buf, count);
+}
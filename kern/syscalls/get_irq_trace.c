@@ -0,0 +1,50 @@
+/** @file get_irq_trace.c
+ *  @brief This file contains the definition for the get_irq_trace() system
+ *         call.
+ *  @author akanjani, lramire1
+ */
+
+#include <syscall.h>
+#include <irq_trace.h>
+#include <virtual_memory.h>
+#include <virtual_memory_defines.h>
+
+/** @brief  Copies the longest interrupts-off intervals observed since system
+ *          boot into a user buffer
+ *
+ *  The intervals are sorted by decreasing length, and there is at most one
+ *  interval per site at which interrupts were disabled.
+ *
+ *  @param  entries   The buffer to fill
+ *  @param  count     The number of entries in the buffer
+ *
+ *  @return The number of entries filled on success, a negative number if
+ *          count is not positive or the buffer is invalid
+ */
+int kern_get_irq_trace(irq_trace_entry_t *entries, int count) {
+
+  if (count <= 0) {
+    return -1;
+  }
+  if (count > IRQ_TRACE_NB_ENTRIES) {
+    count = IRQ_TRACE_NB_ENTRIES;
+  }
+
+  if (is_buffer_valid((unsigned int)entries, 
+                      count * sizeof(irq_trace_entry_t), READ_WRITE) < 0) {
+    return -1;
+  }
+
+  // Take a snapshot so that the copy is not interleaved with updates
+  irq_trace_entry_t snapshot[IRQ_TRACE_NB_ENTRIES];
+  irq_disable();
+  int nb_entries = irq_trace_get(snapshot, count);
+  irq_enable();
+
+  int i;
+  for (i = 0 ; i < nb_entries ; ++i) {
+    entries[i] = snapshot[i];
+  }
+
+  return nb_entries;
+}
@@ -0,0 +1,32 @@
+/** @file get_swap_stats.c
+ *  @brief This file contains the definition for the get_swap_stats() system
+ *         call.
+ *  @author akanjani, lramire1
+ */
+
+#include <syscall.h>
+#include <swap.h>
+#include <virtual_memory.h>
+#include <virtual_memory_defines.h>
+
+/** @brief  Copies the current usage of physical memory and of the swap area
+ *          into a user buffer
+ *
+ *  @param  stats   The buffer to fill
+ *
+ *  @return 0 on success, a negative number if the buffer is invalid
+ */
+int kern_get_swap_stats(swap_stats_t *stats) {
+
+  if (is_buffer_valid((unsigned int)stats, sizeof(swap_stats_t),
+                      READ_WRITE) < 0) {
+    return -1;
+  }
+
+  // Take a snapshot so that the copy is not interleaved with updates
+  swap_stats_t snapshot;
+  swap_get_stats(&snapshot);
+  *stats = snapshot;
+
+  return 0;
+}
@@ -0,0 +1,557 @@
+/** @file mq.c
+ *  @brief This file contains the definitions for the mq_create(),
+ *  mq_destroy(), mq_send() and mq_recv() system calls.
+ *
+ *  Message queues are bounded: mq_send() blocks while the queue is full and
+ *  mq_recv() blocks while it is empty. Blocked threads wait on the queue's
+ *  senders/receivers queues, in the same way threads calling wait()
+ *  wait on their task.
+ *
+ *  Small or unaligned messages are copied into a kernel buffer. Messages
+ *  that are made of whole, page-aligned pages are instead transferred by
+ *  moving the frames: they are unmapped from the sender's address space
+ *  (which gets zero-filled pages in their place) and mapped in the receiver's
+ *  buffer, which then has to be page-aligned too.
+ *
+ *  A queue belongs to the task that created it: any task knowing its
+ *  identifier may use or destroy it, but it is destroyed, along with the
+ *  messages (and frames) it still holds, when its creator exits.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <mq.h>
+#include <page.h>
+#include <common_kern.h>
+#include <kernel_state.h>
+#include <scheduler.h>
+#include <irq_trace.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+
+/* VM system */
+#include <virtual_memory.h>
+#include <virtual_memory_helper.h>
+#include <virtual_memory_defines.h>
+
+/* Debugging */
+#include <simics.h>
+#include <assert.h>
+
+/* List of existing queues */
+static mq_t *queues = NULL;
+
+/* Identifier given to the next queue created */
+static int next_id = 0;
+
+/* Mutex protecting the list of queues and their number of users */
+static eff_mutex_t mq_list_mutex;
+
+/* Static functions prototypes */
+static mq_t *get_queue(int id, int unlink);
+static mq_t *get_owned_queue(pcb_t *task);
+static void destroy_queue(mq_t *queue);
+static void put_queue(mq_t *queue);
+static void free_queue(mq_t *queue);
+static void wait_on(mq_t *queue, tcb_queue_t *waiters);
+static void wake_up(tcb_queue_t *waiters);
+static mq_message_t *build_message(char *buf, int len);
+static int deliver_message(mq_message_t *msg, char *buf, int len);
+static void free_message(mq_message_t *msg);
+
+/** @brief  Initializes the message queues subsystem
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int mq_init() {
+  return eff_mutex_init(&mq_list_mutex);
+}
+
+/** @brief  Creates a new message queue
+ *
+ *  @param  capacity  The maximum number of messages in the queue, between 1
+ *                    and MQ_MAX_CAPACITY
+ *
+ *  @return The queue's identifier on success, a negative number on error
+ */
+int kern_mq_create(int capacity) {
+
+  if (capacity <= 0 || capacity > MQ_MAX_CAPACITY) {
+    lprintf("\tkern_mq_create(): Invalid capacity argument");
+    return -1;
+  }
+
+  mq_t *queue = malloc(sizeof(mq_t));
+  if (queue == NULL) {
+    return -1;
+  }
+
+  if (eff_mutex_init(&queue->mutex) < 0) {
+    free(queue);
+    return -1;
+  }
+
+  queue->capacity = capacity;
+  queue->count = 0;
+  Q_INIT_HEAD(&queue->messages);
+  Q_INIT_HEAD(&queue->senders);
+  Q_INIT_HEAD(&queue->receivers);
+  queue->users = 0;
+  queue->destroyed = MQ_DESTROYED_FALSE;
+  queue->owner = kernel.current_thread->task->tid;
+
+  eff_mutex_lock(&mq_list_mutex);
+  queue->id = next_id++;
+  queue->next = queues;
+  queues = queue;
+  eff_mutex_unlock(&mq_list_mutex);
+
+  return queue->id;
+}
+
+/** @brief  Destroys a message queue
+ *
+ *  Threads blocked on the queue are woken up and their call fails. Messages
+ *  still in the queue are discarded.
+ *
+ *  @param  id  The queue's identifier
+ *
+ *  @return 0 on success, a negative number if the queue does not exist
+ */
+int kern_mq_destroy(int id) {
+
+  mq_t *queue = get_queue(id, 1);
+  if (queue == NULL) {
+    return -1;
+  }
+
+  destroy_queue(queue);
+  return 0;
+}
+
+/** @brief  Destroys the message queues created by a task
+ *
+ *  Called when the task's last thread vanishes.
+ *
+ *  @param  task  The task
+ *
+ *  @return void
+ */
+void mq_release_all(pcb_t *task) {
+
+  mq_t *queue;
+  while ((queue = get_owned_queue(task)) != NULL) {
+    destroy_queue(queue);
+  }
+}
+
+/** @brief  Sends a message on a queue, blocking while the queue is full
+ *
+ *  If buf is page-aligned and len is a multiple of the page size, the pages
+ *  holding the message are moved to the queue and the sender's buffer is
+ *  zero-filled when the call returns.
+ *
+ *  @param  id    The queue's identifier
+ *  @param  buf   The message
+ *  @param  len   The message's length, between 1 and MQ_MAX_MSG_LEN
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int kern_mq_send(int id, char *buf, int len) {
+
+  if (len <= 0 || len > MQ_MAX_MSG_LEN) {
+    lprintf("\tkern_mq_send(): Invalid len argument");
+    return -1;
+  }
+
+  if (is_buffer_valid((unsigned int)buf, len, AT_LEAST_READ) < 0) {
+    lprintf("\tkern_mq_send(): Invalid buf argument");
+    return -1;
+  }
+
+  mq_t *queue = get_queue(id, 0);
+  if (queue == NULL) {
+    return -1;
+  }
+
+  eff_mutex_lock(&queue->mutex);
+
+  while (queue->count == queue->capacity &&
+         queue->destroyed == MQ_DESTROYED_FALSE) {
+    wait_on(queue, &queue->senders);
+  }
+
+  mq_message_t *msg = NULL;
+  if (queue->destroyed == MQ_DESTROYED_FALSE) {
+    msg = build_message(buf, len);
+  }
+
+  if (msg != NULL) {
+    Q_INSERT_TAIL(&queue->messages, msg, link);
+    queue->count++;
+    wake_up(&queue->receivers);
+  }
+
+  eff_mutex_unlock(&queue->mutex);
+  put_queue(queue);
+
+  return (msg != NULL) ? 0 : -1;
+}
+
+/** @brief  Receives the oldest message of a queue, blocking while the queue
+ *          is empty
+ *
+ *  The call fails, and the message stays in the queue, if the message is
+ *  longer than len, or if it was sent by page remapping and buf is not
+ *  page-aligned.
+ *
+ *  @param  id    The queue's identifier
+ *  @param  buf   The buffer in which to store the message
+ *  @param  len   The buffer's length
+ *
+ *  @return The message's length on success, a negative number on error
+ */
+int kern_mq_recv(int id, char *buf, int len) {
+
+  if (len <= 0) {
+    lprintf("\tkern_mq_recv(): Invalid len argument");
+    return -1;
+  }
+
+  mq_t *queue = get_queue(id, 0);
+  if (queue == NULL) {
+    return -1;
+  }
+
+  eff_mutex_lock(&queue->mutex);
+
+  while (queue->count == 0 && queue->destroyed == MQ_DESTROYED_FALSE) {
+    wait_on(queue, &queue->receivers);
+  }
+
+  int ret = -1;
+  if (queue->destroyed == MQ_DESTROYED_FALSE) {
+
+    mq_message_t *msg = Q_GET_FRONT(&queue->messages);
+    ret = deliver_message(msg, buf, len);
+
+    if (ret >= 0) {
+      Q_REMOVE(&queue->messages, msg, link);
+      queue->count--;
+      wake_up(&queue->senders);
+      free_message(msg);
+    }
+  }
+
+  eff_mutex_unlock(&queue->mutex);
+  put_queue(queue);
+
+  return ret;
+}
+
+/** @brief  Looks for a queue and registers the invoking thread as one of its
+ *          users
+ *
+ *  @param  id      The queue's identifier
+ *  @param  unlink  If non-zero, the queue is also removed from the list of
+ *                  existing queues
+ *
+ *  @return The queue if it exists, NULL otherwise
+ */
+static mq_t *get_queue(int id, int unlink) {
+
+  eff_mutex_lock(&mq_list_mutex);
+
+  mq_t **prev = &queues;
+  while (*prev != NULL && (*prev)->id != id) {
+    prev = &(*prev)->next;
+  }
+
+  mq_t *queue = *prev;
+  if (queue != NULL) {
+    queue->users++;
+    if (unlink) {
+      *prev = queue->next;
+    }
+  }
+
+  eff_mutex_unlock(&mq_list_mutex);
+  return queue;
+}
+
+/** @brief  Looks for a queue created by a task, removes it from the list of
+ *          existing queues and registers the invoking thread as one of its
+ *          users
+ *
+ *  @param  task  The task
+ *
+ *  @return A queue created by the task, NULL if there is none left
+ */
+static mq_t *get_owned_queue(pcb_t *task) {
+
+  eff_mutex_lock(&mq_list_mutex);
+
+  mq_t **prev = &queues;
+  while (*prev != NULL && (*prev)->owner != task->tid) {
+    prev = &(*prev)->next;
+  }
+
+  mq_t *queue = *prev;
+  if (queue != NULL) {
+    queue->users++;
+    *prev = queue->next;
+  }
+
+  eff_mutex_unlock(&mq_list_mutex);
+  return queue;
+}
+
+/** @brief  Marks a queue as destroyed, wakes up the threads blocked on it and
+ *          drops the invoking thread's reference
+ *
+ *  The queue must already be removed from the list of existing queues. It is
+ *  freed once its last user is gone.
+ *
+ *  @param  queue   The queue
+ *
+ *  @return void
+ */
+static void destroy_queue(mq_t *queue) {
+
+  eff_mutex_lock(&queue->mutex);
+  queue->destroyed = MQ_DESTROYED_TRUE;
+  while (Q_GET_FRONT(&queue->senders) != NULL) {
+    wake_up(&queue->senders);
+  }
+  while (Q_GET_FRONT(&queue->receivers) != NULL) {
+    wake_up(&queue->receivers);
+  }
+  eff_mutex_unlock(&queue->mutex);
+
+  put_queue(queue);
+}
+
+/** @brief  Unregisters the invoking thread as one of a queue's users, the
+ *          queue is freed if it was destroyed and this was the last user
+ *
+ *  @param  queue   The queue
+ *
+ *  @return void
+ */
+static void put_queue(mq_t *queue) {
+
+  eff_mutex_lock(&mq_list_mutex);
+  int last = (--queue->users == 0 && queue->destroyed == MQ_DESTROYED_TRUE);
+  eff_mutex_unlock(&mq_list_mutex);
+
+  if (last) {
+    free_queue(queue);
+  }
+}
+
+/** @brief  Frees a queue and the messages it still holds
+ *
+ *  @param  queue   The queue
+ *
+ *  @return void
+ */
+static void free_queue(mq_t *queue) {
+
+  mq_message_t *msg;
+  while ((msg = Q_GET_FRONT(&queue->messages)) != NULL) {
+    Q_REMOVE(&queue->messages, msg, link);
+    free_message(msg);
+  }
+
+  eff_mutex_destroy(&queue->mutex);
+  free(queue);
+}
+
+/** @brief  Blocks the invoking thread on one of a queue's waiting queues
+ *
+ *  The queue's mutex must be held, it is released while the thread is
+ *  blocked and held again when the function returns.
+ *
+ *  @param  queue     The queue
+ *  @param  waiters   The waiting queue (senders or receivers)
+ *
+ *  @return void
+ */
+static void wait_on(mq_t *queue, tcb_queue_t *waiters) {
+
+  Q_INSERT_TAIL(waiters, kernel.current_thread, wait_link);
+
+  // The mutex will be unlocked in block_and_switch
+  block_and_switch(HOLDING_MUTEX_TRUE, &queue->mutex);
+
+  eff_mutex_lock(&queue->mutex);
+}
+
+/** @brief  Wakes up the first thread of a waiting queue, if any
+ *
+ *  The queue's mutex must be held.
+ *
+ *  @param  waiters   The waiting queue (senders or receivers)
+ *
+ *  @return void
+ */
+static void wake_up(tcb_queue_t *waiters) {
+
+  tcb_t *waiter = Q_GET_FRONT(waiters);
+  if (waiter != NULL) {
+    Q_REMOVE(waiters, waiter, wait_link);
+    add_runnable_thread(waiter);
+  }
+}
+
+/** @brief  Creates a message from a user buffer
+ *
+ *  Whole page-aligned pages are moved out of the invoking task's address
+ *  space if possible, otherwise the buffer is copied.
+ *
+ *  @param  buf   The message's content
+ *  @param  len   The message's length
+ *
+ *  @return The new message on success, NULL on error
+ */
+static mq_message_t *build_message(char *buf, int len) {
+
+  mq_message_t *msg = malloc(sizeof(mq_message_t));
+  if (msg == NULL) {
+    return NULL;
+  }
+  msg->len = len;
+  msg->data = NULL;
+  msg->frames = NULL;
+
+  unsigned int start = (unsigned int)buf;
+  int nb_pages = len / PAGE_SIZE;
+
+  // The frames in the queue need their own reservation since the sender's
+  // pages keep theirs
+  if ((start % PAGE_SIZE) == 0 && (len % PAGE_SIZE) == 0 &&
+      reserve_frames(nb_pages) == 0) {
+
+    msg->frames = malloc(nb_pages * sizeof(unsigned int));
+    if (msg->frames != NULL) {
+
+      // Interrupts stay disabled so that the same-page merging daemon does
+      // not change the pages between the checks and the moves
+      irq_disable();
+
+      // Check that every page can be moved before touching any of them
+      int i;
+      for (i = 0 ; i < nb_pages ; ++i) {
+        if (get_movable_page_entry(start + i * PAGE_SIZE, MOVE_PAGE_OUT)
+            == NULL) {
+          break;
+        }
+      }
+
+      if (i == nb_pages) {
+        for (i = 0 ; i < nb_pages ; ++i) {
+          unsigned int address = start + i * PAGE_SIZE;
+          unsigned int *entry = get_movable_page_entry(address, MOVE_PAGE_OUT);
+          msg->frames[i] = detach_user_frame(entry, address);
+        }
+        irq_enable();
+        return msg;
+      }
+
+      irq_enable();
+      free(msg->frames);
+      msg->frames = NULL;
+    }
+    release_frames(nb_pages);
+  }
+
+  // Fall back to copying the message
+  msg->data = malloc(len);
+  if (msg->data == NULL) {
+    free(msg);
+    return NULL;
+  }
+  memcpy(msg->data, buf, len);
+
+  return msg;
+}
+
+/** @brief  Copies or maps a message into a user buffer
+ *
+ *  @param  msg   The message
+ *  @param  buf   The buffer
+ *  @param  len   The buffer's length
+ *
+ *  @return The message's length on success, a negative number if the message
+ *          can not be delivered to this buffer
+ */
+static int deliver_message(mq_message_t *msg, char *buf, int len) {
+
+  if (msg->len > len) {
+    return -1;
+  }
+
+  if (msg->data != NULL) {
+    if (is_buffer_valid((unsigned int)buf, msg->len, READ_WRITE) < 0) {
+      return -1;
+    }
+    memcpy(buf, msg->data, msg->len);
+    return msg->len;
+  }
+
+  unsigned int start = (unsigned int)buf;
+  int nb_pages = msg->len / PAGE_SIZE;
+  if ((start % PAGE_SIZE) != 0) {
+    return -1;
+  }
+
+  // Interrupts stay disabled so that the same-page merging daemon does not
+  // change the pages between the checks and the moves
+  irq_disable();
+
+  // Check that every page can receive a frame before touching any of them
+  int i;
+  for (i = 0 ; i < nb_pages ; ++i) {
+    if (get_movable_page_entry(start + i * PAGE_SIZE, MOVE_PAGE_IN) == NULL) {
+      irq_enable();
+      return -1;
+    }
+  }
+
+  for (i = 0 ; i < nb_pages ; ++i) {
+    unsigned int address = start + i * PAGE_SIZE;
+    unsigned int *entry = get_movable_page_entry(address, MOVE_PAGE_IN);
+    attach_user_frame(entry, address, msg->frames[i]);
+  }
+
+  irq_enable();
+
+  // The frames now belong to the receiver
+  free(msg->frames);
+  msg->frames = NULL;
+
+  return msg->len;
+}
+
+/** @brief  Frees a message, including the frames it still holds
+ *
+ *  @param  msg   The message
+ *
+ *  @return void
+ */
+static void free_message(mq_message_t *msg) {
+
+  if (msg->frames != NULL) {
+    int i;
+    for (i = 0 ; i < msg->len / PAGE_SIZE ; ++i) {
+      free_frame((unsigned int *)msg->frames[i]);
+    }
+    free(msg->frames);
+  }
+
+  if (msg->data != NULL) {
+    free(msg->data);
+  }
+  free(msg);
+}
@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <malloc.h>
+#include <reaper.h>
 
 /* VM system */
 #include <virtual_memory.h>
@@ -103,37 +104,34 @@ int kern_remove_pages(void *base) {
 static int reserve_frames_zfod(void* base, int nb_pages) {
 
   // Try to reserve frames
-  if (reserve_frames(nb_pages) < 0) {
+  if (reaper_reserve_frames(nb_pages) < 0) {
     return -1;
   }
 
   // Allocate space for new allocation structure
   alloc_t * new_alloc = malloc(sizeof(alloc_t));
   if (new_alloc == NULL) {
+    release_frames(nb_pages);
     return -1;
   }
   new_alloc->base = base;
   new_alloc->len = nb_pages;
 
-  // Register the allocation
-  pcb_t * current_pcb = kernel.current_thread->task;
-  if (linked_list_insert_node(&current_pcb->allocations, new_alloc) < 0) {
-    release_frames(nb_pages);
-    free(new_alloc);
-    lprintf("reserve_frames_zfod(): Registration of new allocation failed");
-    return -1;
-  }
-
   // Mark the pages as requested
   if (mark_address_range_requested((unsigned int)base, 
                                     (unsigned int)nb_pages) < 0) {
     release_frames(nb_pages);
     free(new_alloc);
-    linked_list_delete_node(&current_pcb->allocations, new_alloc);
     lprintf("reserve_frames_zfod(): mark_address_range_requested failed");
     return -1;
   }
 
+  // Register the allocation
+  pcb_t * current_pcb = kernel.current_thread->task;
+  eff_mutex_lock(&current_pcb->mutex);
+  Q_INSERT_TAIL(&current_pcb->allocations, new_alloc, link);
+  eff_mutex_unlock(&current_pcb->mutex);
+
   // Update the total number of frames requested by the invoking thread
   eff_mutex_lock(&kernel.current_thread->mutex);
   kernel.current_thread->num_of_frames_requested += nb_pages;
@@ -157,12 +155,17 @@ static int reserve_frames_zfod(void* base, int nb_pages) {
  */
 static int free_frames_zfod(void* base) {
 
-  // Retrieve the allocation from the linked list
-  alloc_t * alloc = 
-      linked_list_delete_node(&kernel.current_thread->task->allocations, base);
+  // Retrieve the allocation from the task's list
+  pcb_t *task = kernel.current_thread->task;
+  eff_mutex_lock(&task->mutex);
+  alloc_t * alloc = find_alloc(task, base);
+  if (alloc != NULL) {
+    Q_REMOVE(&task->allocations, alloc, link);
+  }
+  eff_mutex_unlock(&task->mutex);
 
   if (alloc == NULL) {
-    lprintf("Allocation can't be found in linked list");
+    lprintf("Allocation can't be found in the task's list");
     return -1;
   }
 
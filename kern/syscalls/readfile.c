@@ -7,6 +7,7 @@
 #include <common_kern.h>
 #include <virtual_memory.h>
 #include <virtual_memory_defines.h>
+#include <fs.h>
 
 /** @brief  Attempts to fill the user-specified buffer buf with count bytes 
  *          starting offset bytes from the beginning of the RAM disk file 
@@ -19,6 +20,9 @@
  *  - buf is not a valid buffer large enough to store count bytes
  *  In this case, the contents of buf are undefines.
  *
+ *  Files of the RAM filesystem (see fs.c) hide the executables' images with
+ *  the same name.
+ *
  *  @param  filename   The name of the file to copy data from
  *  @param  buf        The buffer to copy the data into
  *  @param  count      The number of bytes to be copied
@@ -39,6 +43,12 @@ int kern_readfile(char *filename, char *buf, int count, int offset) {
     return -1;
   }
 
+  // Read the RAM filesystem's file if there is one
+  int ret = fs_readfile(filename, buf, count, offset);
+  if (ret != FS_NOT_FOUND) {
+    return ret;
+  }
+
   // Get the bytes from the file and return
   return getbytes(filename, offset, count, buf);
 }
@@ -1,6 +1,6 @@
 /** @file scheduling_calls.c
- *  @brief  This file contains the definitions for the yield(), make_runnable()
- *          and deschedule() system calls.
+ *  @brief  This file contains the definitions for the yield(), make_runnable(),
+ *          make_runnable_many(), deschedule() and set_weight() system calls.
  *  @author akanjani, lramire1
  */
 
@@ -14,6 +14,12 @@
 /* For debugging */
 #include <simics.h>
 
+/* Maximum number of threads made runnable by one make_runnable_many() call,
+ * bounds the time spent in the kernel */
+#define MAKE_RUNNABLE_MANY_MAX 1024
+
+static int wake_descheduled(int tid);
+
 /** @brief  Defers execution of the invoking thread to a time determined by the
  *          scheduler, in favor of the thread with ID tid. If tid is -1, the 
  *          scheduler may determine which thread to run next.
@@ -33,9 +39,7 @@ int kern_yield(int tid) {
   
   } else if (tid >= 0) {
 
-    tcb_t tmp;
-    tmp.tid = tid;
-    tcb_t *next_thread = hash_table_get_element(&kernel.tcbs, &tmp);
+    tcb_t *next_thread = tid_table_get(&kernel.tcbs, tid);
 
     if (next_thread != NULL) {
       if (next_thread->thread_state == THR_RUNNABLE) { 
@@ -84,6 +88,9 @@ int kern_deschedule(int *reject) {
   int r = *reject;
 
   if (r == 0) {    
+    // Only make_runnable() may wake us up, not the queues we are not in
+    kernel.current_thread->descheduled = 1;
+
     // The mutex will be unlocked in block_and_switch
     block_and_switch(HOLDING_MUTEX_TRUE, &kernel.current_thread->mutex);
   } else {
@@ -102,25 +109,72 @@ int kern_deschedule(int *reject) {
  *          deschedule(). Zero on success
  */
 int kern_make_runnable(int tid) {
+  return wake_descheduled(tid);
+}
+
+/** @brief  Makes several deschedule()d threads runnable in a single system
+ *          call
+ *
+ *  Equivalent to calling make_runnable() on each element of tids in order, so
+ *  that waking up many threads (e.g. in cond_broadcast()) does not cost one
+ *  kernel entry per thread. Entries which do not designate a deschedule()d
+ *  thread are skipped.
+ *
+ *  @param  tids    An array of thread IDs
+ *  @param  count   The number of elements in tids
+ *
+ *  @return The number of threads made runnable, or an integer error code less
+ *          than zero if count is not positive or tids is not a valid array
+ */
+int kern_make_runnable_many(int *tids, int count) {
+
+  if (count <= 0 || count > MAKE_RUNNABLE_MANY_MAX) {
+    return -1;
+  }
+
+  // Check that tids is a valid array
+  if (is_buffer_valid((unsigned int)tids, count * sizeof(int),
+                      AT_LEAST_READ) < 0) {
+    return -1;
+  }
+
+  int i, nb_woken = 0;
+  for (i = 0; i < count; ++i) {
+    if (wake_descheduled(tids[i]) == 0) {
+      ++nb_woken;
+    }
+  }
+
+  return nb_woken;
+}
+
+/** @brief  Makes a deschedule()d thread runnable again
+ *
+ *  @param  tid   A thread ID
+ *
+ *  @return 0 if the thread was descheduled and is now runnable, a negative
+ *          number otherwise
+ */
+static int wake_descheduled(int tid) {
 
   // If the tid is less or equal to 0, we return immediately
   if (tid <= 0) {
     return -1;
   }
 
-  tcb_t tmp;
-  tmp.tid = tid;
-
   // Try to get the TCB with the given tid
-  tcb_t *tcb = hash_table_get_element(&kernel.tcbs, &tmp);
+  tcb_t *tcb = tid_table_get(&kernel.tcbs, tid);
   if (tcb == NULL) {
     return -1;
   }
 
   eff_mutex_lock(&tcb->mutex);
 
-  // If the thread exists and has been descheduled make it runnable again
-  if (tcb->thread_state == THR_BLOCKED) {
+  // If the thread exists and has been descheduled make it runnable again.
+  // Threads blocked for another reason are linked in a kernel queue and must
+  // be left alone.
+  if (tcb->thread_state == THR_BLOCKED && tcb->descheduled) {
+    tcb->descheduled = 0;
     add_runnable_thread(tcb);
     eff_mutex_unlock(&tcb->mutex);
     return 0;
@@ -129,3 +183,45 @@ int kern_make_runnable(int tid) {
   eff_mutex_unlock(&tcb->mutex);
   return -1;
 }
+
+/** @brief  Sets the number of tickets held by a task for stride scheduling
+ *
+ *  The CPU is shared between tasks proportionally to their weight, regardless
+ *  of their number of threads. A task may only change its own weight or the
+ *  weight of one of its children. Tasks created with fork() inherit the weight
+ *  of their parent.
+ *
+ *  @param  tid     The ID of any thread in the task, or -1 for the invoking
+ *                  task
+ *  @param  weight  The task's new weight, between 1 and MAX_TASK_WEIGHT
+ *
+ *  @return 0 on success, a negative number if the thread does not exist, if
+ *          the task is neither the invoking task nor one of its children, or
+ *          if the weight is invalid
+ */
+int kern_set_weight(int tid, int weight) {
+
+  if (weight <= 0 || weight > MAX_TASK_WEIGHT) {
+    return -1;
+  }
+
+  pcb_t *task = kernel.current_thread->task;
+
+  if (tid != -1) {
+
+    // Try to get the TCB with the given tid
+    tcb_t *tcb = tid_table_get(&kernel.tcbs, tid);
+    if (tcb == NULL || tcb->task == NULL) {
+      return -1;
+    }
+
+    if (tcb->task != task && tcb->task->parent != task) {
+      return -1;
+    }
+    task = tcb->task;
+  }
+
+  set_task_weight(task, (uint32_t)weight);
+
+  return 0;
+}
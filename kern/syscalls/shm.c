@@ -0,0 +1,624 @@
+/** @file shm.c
+ *  @brief This file contains the definitions for the shm_create(),
+ *  shm_attach() and shm_detach() system calls, as well as helper functions
+ *  used to manage shared memory segments.
+ *
+ *  A segment's frames are allocated (and reserved) once, when the segment is
+ *  created, and are freed when the last attachment to the segment goes away.
+ *  Tasks map the frames directly in their address space with the
+ *  PAGE_SHARED_BIT set in the page table entries, so that the frames are
+ *  neither freed by free_address_space() nor copied by fork(). A forked child
+ *  shares the segments attached to its parent.
+ *
+ *  Each attachment is also accounted in the num_of_frames_requested of the
+ *  task (and thread) attaching the segment, as for new_pages().
+ *
+ *  Other kernel objects whose pages may be mapped in tasks (e.g. the files
+ *  of the RAM filesystem) are backed by anonymous segments, which have no
+ *  name and can grow. Each attachment records how many pages it mapped.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <shm.h>
+#include <page.h>
+#include <common_kern.h>
+#include <kernel_state.h>
+#include <eff_mutex.h>
+#include <variable_queue.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+#include <reaper.h>
+#include <irq_trace.h>
+
+/* VM system */
+#include <virtual_memory.h>
+#include <virtual_memory_helper.h>
+#include <virtual_memory_defines.h>
+
+/* Debugging */
+#include <simics.h>
+#include <assert.h>
+
+/* List of existing segments */
+static shm_segment_t *segments = NULL;
+
+/* Mutex protecting the list of segments and their reference counts */
+static eff_mutex_t shm_mutex;
+
+/* Static functions prototypes */
+static int check_name(char *name);
+static shm_segment_t *find_segment(char *name);
+static shm_segment_t *create_segment(char *name, unsigned int nb_pages);
+static void put_segment(shm_segment_t *segment);
+static int attach_segment(shm_segment_t *segment, void *base,
+                          unsigned int nb_pages, int writable);
+static void allocate_frames(unsigned int *frames, unsigned int nb_pages);
+static void zero_frames(unsigned int *frames, unsigned int nb_pages);
+static shm_attachment_t *find_attachment(pcb_t *task, void *base);
+static void account_frames(pcb_t *task, tcb_t *thread, int nb_pages);
+
+/** @brief  Initializes the shared memory subsystem
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int shm_init() {
+  return eff_mutex_init(&shm_mutex);
+}
+
+/** @brief  Creates a named shared memory segment and attaches it to the
+ *          invoking task at base
+ *
+ *  The segment's content is zero-filled. shm_create() fails if a segment with
+ *  the same name already exists, if base is not page-aligned, if len is not a
+ *  positive integral multiple of the system page size, if any portion of the
+ *  region is already mapped or if there is not enough memory.
+ *
+ *  @param  name   The segment's name (at most SHM_NAME_MAX_LEN characters)
+ *  @param  base   The address at which to map the segment
+ *  @param  len    The segment's length (in bytes)
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int kern_shm_create(char *name, void *base, int len) {
+
+  if (check_name(name) < 0) {
+    lprintf("\tkern_shm_create(): Invalid name argument");
+    return -1;
+  }
+
+  if (len <= 0 || len % PAGE_SIZE != 0) {
+    lprintf("\tkern_shm_create(): Invalid len argument");
+    return -1;
+  }
+
+  eff_mutex_lock(&shm_mutex);
+
+  if (find_segment(name) != NULL) {
+    eff_mutex_unlock(&shm_mutex);
+    lprintf("\tkern_shm_create(): Segment %s already exists", name);
+    return -1;
+  }
+
+  shm_segment_t *segment = create_segment(name, len / PAGE_SIZE);
+  if (segment == NULL) {
+    eff_mutex_unlock(&shm_mutex);
+    return -1;
+  }
+
+  eff_mutex_unlock(&shm_mutex);
+
+  if (attach_segment(segment, base, segment->nb_pages, 1) < 0) {
+    put_segment(segment);
+    return -1;
+  }
+
+  return 0;
+}
+
+/** @brief  Attaches an existing shared memory segment to the invoking task
+ *
+ *  @param  name   The segment's name
+ *  @param  base   The address at which to map the segment
+ *
+ *  @return The segment's length (in bytes) on success, a negative number on
+ *          error
+ */
+int kern_shm_attach(char *name, void *base) {
+
+  if (check_name(name) < 0) {
+    lprintf("\tkern_shm_attach(): Invalid name argument");
+    return -1;
+  }
+
+  eff_mutex_lock(&shm_mutex);
+  shm_segment_t *segment = find_segment(name);
+  if (segment != NULL) {
+    segment->refcount++;
+  }
+  eff_mutex_unlock(&shm_mutex);
+
+  if (segment == NULL) {
+    return -1;
+  }
+
+  if (attach_segment(segment, base, segment->nb_pages, 1) < 0) {
+    put_segment(segment);
+    return -1;
+  }
+
+  return segment->nb_pages * PAGE_SIZE;
+}
+
+/** @brief  Detaches a shared memory segment from the invoking task
+ *
+ *  The segment is destroyed when the last task using it detaches it.
+ *
+ *  @param  base   The address at which the segment is mapped
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int kern_shm_detach(void *base) {
+
+  pcb_t *task = kernel.current_thread->task;
+  eff_mutex_lock(&task->mutex);
+  shm_attachment_t *attachment = find_attachment(task, base);
+  if (attachment != NULL) {
+    Q_REMOVE(&task->shm_attachments, attachment, link);
+  }
+  eff_mutex_unlock(&task->mutex);
+
+  if (attachment == NULL) {
+    lprintf("\tkern_shm_detach(): No segment attached at %p", base);
+    return -1;
+  }
+
+  shm_segment_t *segment = attachment->segment;
+  unsigned int nb_pages = attachment->nb_pages;
+  free(attachment);
+
+  unsigned int i, address = (unsigned int)base;
+  for (i = 0 ; i < nb_pages ; ++i, address += PAGE_SIZE) {
+    unmap_shared_frame(address);
+  }
+
+  account_frames(task, kernel.current_thread, -(int)nb_pages);
+  release_frames(nb_pages);
+
+  put_segment(segment);
+  return 0;
+}
+
+/** @brief  Makes a child task share the segments attached to its parent
+ *
+ *  The page table entries must already have been copied to the child's
+ *  address space.
+ *
+ *  @param  parent  The parent task
+ *  @param  child   The child task
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int shm_fork(pcb_t *parent, pcb_t *child) {
+
+  eff_mutex_lock(&parent->mutex);
+
+  shm_attachment_t *orig;
+  Q_FOREACH(orig, &parent->shm_attachments, link) {
+
+    shm_attachment_t *copy = malloc(sizeof(shm_attachment_t));
+    if (copy == NULL) {
+      eff_mutex_unlock(&parent->mutex);
+      return -1;
+    }
+    copy->base = orig->base;
+    copy->segment = orig->segment;
+    copy->nb_pages = orig->nb_pages;
+
+    // The child is not running yet, nobody else looks at its list
+    Q_INSERT_TAIL(&child->shm_attachments, copy, link);
+
+    eff_mutex_lock(&shm_mutex);
+    orig->segment->refcount++;
+    eff_mutex_unlock(&shm_mutex);
+
+    account_frames(child, NULL, orig->nb_pages);
+  }
+
+  eff_mutex_unlock(&parent->mutex);
+  return 0;
+}
+
+/** @brief  Drops all the segments attached to a task whose address space has
+ *          already been freed
+ *
+ *  The frames accounted for the attachments are not released, this is left
+ *  to the caller.
+ *
+ *  @param  task  The task
+ *
+ *  @return The number of frames that were accounted for the attachments
+ */
+unsigned int shm_release_all(pcb_t *task) {
+
+  unsigned int nb_frames = 0;
+
+  eff_mutex_lock(&task->mutex);
+
+  shm_attachment_t *attachment;
+  while ((attachment = Q_GET_FRONT(&task->shm_attachments)) != NULL) {
+    Q_REMOVE(&task->shm_attachments, attachment, link);
+    nb_frames += attachment->nb_pages;
+    put_segment(attachment->segment);
+    free(attachment);
+  }
+
+  eff_mutex_unlock(&task->mutex);
+
+  return nb_frames;
+}
+
+/** @brief  Creates an anonymous segment, with a reference count of one
+ *
+ *  The segment's frames are zero-filled. Anonymous segments can not be
+ *  attached by name, their creator attaches them with shm_segment_attach().
+ *
+ *  @param  nb_pages  The segment's size, in pages (at least one)
+ *
+ *  @return The new segment on success, NULL on error
+ */
+shm_segment_t *shm_segment_create(unsigned int nb_pages) {
+
+  if (nb_pages == 0) {
+    return NULL;
+  }
+
+  return create_segment(NULL, nb_pages);
+}
+
+/** @brief  Grows an anonymous segment with zero-filled frames
+ *
+ *  Attachments made before the segment grew keep mapping the pages they
+ *  mapped. The caller must serialize the calls to shm_segment_grow() and
+ *  shm_segment_attach() on a segment.
+ *
+ *  @param  segment   The segment
+ *  @param  nb_pages  The segment's new size, in pages
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int shm_segment_grow(shm_segment_t *segment, unsigned int nb_pages) {
+
+  if (nb_pages <= segment->nb_pages) {
+    return 0;
+  }
+
+  unsigned int nb_new = nb_pages - segment->nb_pages;
+  if (reaper_reserve_frames(nb_new) < 0) {
+    lprintf("shm_segment_grow(): Not enough memory");
+    return -1;
+  }
+
+  unsigned int *frames = realloc(segment->frames,
+                                 nb_pages * sizeof(unsigned int));
+  if (frames == NULL) {
+    release_frames(nb_new);
+    return -1;
+  }
+
+  allocate_frames(frames + segment->nb_pages, nb_new);
+  zero_frames(frames + segment->nb_pages, nb_new);
+
+  segment->frames = frames;
+  segment->nb_pages = nb_pages;
+  return 0;
+}
+
+/** @brief  Maps the first pages of an anonymous segment in the invoking
+ *          task's address space
+ *
+ *  The mapping is detached with shm_detach(), like a named segment's.
+ *
+ *  @param  segment   The segment
+ *  @param  base      The address at which to map the segment
+ *  @param  nb_pages  The number of pages to map
+ *  @param  writable  Whether the task may write to the pages
+ *
+ *  @return 0 on success, a negative number on error
+ */
+int shm_segment_attach(shm_segment_t *segment, void *base,
+                       unsigned int nb_pages, int writable) {
+
+  eff_mutex_lock(&shm_mutex);
+  segment->refcount++;
+  eff_mutex_unlock(&shm_mutex);
+
+  if (attach_segment(segment, base, nb_pages, writable) < 0) {
+    put_segment(segment);
+    return -1;
+  }
+
+  return 0;
+}
+
+/** @brief  Drops a reference on a segment, the segment is destroyed when the
+ *          last reference goes away
+ *
+ *  @param  segment  The segment
+ *
+ *  @return void
+ */
+void shm_segment_put(shm_segment_t *segment) {
+  put_segment(segment);
+}
+
+/** @brief  Checks that a segment name is a valid string of acceptable length
+ *
+ *  @param  name  The name
+ *
+ *  @return 0 if the name is valid, a negative number otherwise
+ */
+static int check_name(char *name) {
+
+  if ((unsigned int)name < USER_MEM_START || is_valid_string(name) < 0) {
+    return -1;
+  }
+
+  int len = strlen(name);
+  if (len == 0 || len > SHM_NAME_MAX_LEN) {
+    return -1;
+  }
+
+  return 0;
+}
+
+/** @brief  Looks for a segment by name, shm_mutex must be held
+ *
+ *  @param  name  The segment's name
+ *
+ *  @return The segment if it exists, NULL otherwise
+ */
+static shm_segment_t *find_segment(char *name) {
+
+  shm_segment_t *segment;
+  for (segment = segments ; segment != NULL ; segment = segment->next) {
+    if (strcmp(segment->name, name) == 0) {
+      return segment;
+    }
+  }
+
+  return NULL;
+}
+
+/** @brief  Creates a zero-filled segment with a reference count of one and
+ *          adds it to the list of segments, shm_mutex must be held
+ *
+ *  Anonymous segments are not added to the list, shm_mutex need not be held
+ *  to create them.
+ *
+ *  @param  name      The segment's name, NULL for an anonymous segment
+ *  @param  nb_pages  The segment's size, in pages
+ *
+ *  @return The new segment on success, NULL on error
+ */
+static shm_segment_t *create_segment(char *name, unsigned int nb_pages) {
+
+  if (reaper_reserve_frames(nb_pages) < 0) {
+    lprintf("create_segment(): Not enough memory");
+    return NULL;
+  }
+
+  shm_segment_t *segment = malloc(sizeof(shm_segment_t));
+  unsigned int *frames = malloc(nb_pages * sizeof(unsigned int));
+  if (segment == NULL || frames == NULL) {
+    if (segment != NULL) {
+      free(segment);
+    }
+    if (frames != NULL) {
+      free(frames);
+    }
+    release_frames(nb_pages);
+    return NULL;
+  }
+
+  // Zero the frames before the segment can be found by other tasks
+  allocate_frames(frames, nb_pages);
+  zero_frames(frames, nb_pages);
+
+  segment->nb_pages = nb_pages;
+  segment->frames = frames;
+  segment->refcount = 1;
+  segment->next = NULL;
+
+  if (name == NULL) {
+    segment->name[0] = '\0';
+    return segment;
+  }
+
+  strcpy(segment->name, name);
+  segment->next = segments;
+  segments = segment;
+
+  return segment;
+}
+
+/** @brief  Drops a reference on a segment, the segment is destroyed when the
+ *          last reference goes away
+ *
+ *  @param  segment  The segment
+ *
+ *  @return void
+ */
+static void put_segment(shm_segment_t *segment) {
+
+  eff_mutex_lock(&shm_mutex);
+
+  assert(segment->refcount > 0);
+  if (--segment->refcount > 0) {
+    eff_mutex_unlock(&shm_mutex);
+    return;
+  }
+
+  // Remove the segment from the list
+  if (segment->name[0] != '\0') {
+    shm_segment_t **prev = &segments;
+    while (*prev != segment) {
+      prev = &(*prev)->next;
+    }
+    *prev = segment->next;
+  }
+
+  eff_mutex_unlock(&shm_mutex);
+
+  // Free the frames (this also releases the frames reserved at creation)
+  unsigned int i;
+  for (i = 0 ; i < segment->nb_pages ; ++i) {
+    free_frame((unsigned int *)segment->frames[i]);
+  }
+
+  free(segment->frames);
+  free(segment);
+}
+
+/** @brief  Maps the first pages of a segment in the invoking task's address
+ *          space and records the attachment
+ *
+ *  The caller must hold a reference on the segment, which is transferred to
+ *  the attachment on success.
+ *
+ *  @param  segment   The segment
+ *  @param  base      The address at which to map the segment
+ *  @param  nb_pages  The number of pages to map
+ *  @param  writable  Whether the task may write to the pages
+ *
+ *  @return 0 on success, a negative number on error
+ */
+static int attach_segment(shm_segment_t *segment, void *base,
+                          unsigned int nb_pages, int writable) {
+
+  unsigned int start = (unsigned int)base;
+  unsigned int size = nb_pages * PAGE_SIZE;
+
+  if (nb_pages == 0 || nb_pages > segment->nb_pages) {
+    return -1;
+  }
+
+  // Check that the 'base' argument is valid
+  if (start < USER_MEM_START || (start % PAGE_SIZE) != 0 ||
+      start + size < start) {
+    lprintf("\tattach_segment(): Invalid base argument");
+    return -1;
+  }
+
+  // Each attachment is accounted like a new_pages() allocation
+  if (reaper_reserve_frames(nb_pages) < 0) {
+    return -1;
+  }
+
+  pcb_t *task = kernel.current_thread->task;
+  shm_attachment_t *attachment = malloc(sizeof(shm_attachment_t));
+  if (attachment == NULL) {
+    release_frames(nb_pages);
+    return -1;
+  }
+  attachment->base = base;
+  attachment->segment = segment;
+  attachment->nb_pages = nb_pages;
+
+  unsigned int i;
+  for (i = 0 ; i < nb_pages ; ++i) {
+    if (map_shared_frame(start + i * PAGE_SIZE, segment->frames[i],
+                         writable) < 0) {
+      // Undo the mappings done so far
+      while (i-- > 0) {
+        unmap_shared_frame(start + i * PAGE_SIZE);
+      }
+      free(attachment);
+      release_frames(nb_pages);
+      return -1;
+    }
+  }
+
+  eff_mutex_lock(&task->mutex);
+  Q_INSERT_TAIL(&task->shm_attachments, attachment, link);
+  eff_mutex_unlock(&task->mutex);
+
+  account_frames(task, kernel.current_thread, nb_pages);
+  return 0;
+}
+
+/** @brief  Finds the attachment of a task mapped at a given address
+ *
+ *  The task's mutex must be held.
+ *
+ *  @param  task  The task
+ *  @param  base  The address at which the segment is mapped
+ *
+ *  @return The attachment, NULL if no segment is attached at base
+ */
+static shm_attachment_t *find_attachment(pcb_t *task, void *base) {
+
+  shm_attachment_t *attachment;
+  Q_FOREACH(attachment, &task->shm_attachments, link) {
+    if (attachment->base == base) {
+      return attachment;
+    }
+  }
+  return NULL;
+}
+
+/** @brief  Updates the number of frames requested by a task and a thread
+ *
+ *  @param  task      The task
+ *  @param  thread    One of the task's threads, may be NULL
+ *  @param  nb_pages  The number of frames to add (may be negative)
+ *
+ *  @return void
+ */
+static void account_frames(pcb_t *task, tcb_t *thread, int nb_pages) {
+
+  if (thread != NULL) {
+    eff_mutex_lock(&thread->mutex);
+    thread->num_of_frames_requested += nb_pages;
+    eff_mutex_unlock(&thread->mutex);
+  }
+
+  eff_mutex_lock(&task->mutex);
+  task->num_of_frames_requested += nb_pages;
+  eff_mutex_unlock(&task->mutex);
+}
+
+/** @brief  Allocates frames that were already reserved
+ *
+ *  @param  frames    The array receiving the frames' physical addresses
+ *  @param  nb_pages  The number of frames
+ *
+ *  @return void
+ */
+static void allocate_frames(unsigned int *frames, unsigned int nb_pages) {
+
+  unsigned int i;
+  for (i = 0 ; i < nb_pages ; ++i) {
+    frames[i] = (unsigned int)allocate_frame();
+    assert(frames[i] != 0);
+  }
+}
+
+/** @brief  Fills frames with zeros through the kernel's frame window
+ *
+ *  @param  frames    The frames' physical addresses
+ *  @param  nb_pages  The number of frames
+ *
+ *  @return void
+ */
+static void zero_frames(unsigned int *frames, unsigned int nb_pages) {
+
+  unsigned int i;
+  for (i = 0 ; i < nb_pages ; ++i) {
+    irq_disable();
+    memset(map_frame_window(frames[i]), 0, PAGE_SIZE);
+    unmap_frame_window();
+    irq_enable();
+  }
+}
@@ -6,29 +6,28 @@
 
 #include <kernel_state.h>
 #include <scheduler.h>
-#include <generic_node.h>
+#include <variable_queue.h>
 #include <stdlib.h>
 #include <asm.h>
+#include <irq_trace.h>
+#include <async_io.h>
 
 /* Debugging */
 #include <simics.h>
-
-/** @brief  Data structure representing a sleeping thread */
-typedef struct sleeper {
-
-  /** @brief  Number of remaining ticks to sleep */
-  int ticks;
-
-  /** @brief  Sleeper's TCB */  
-  tcb_t* tcb;
-  
-} sleeper_t;
+#include <assert.h>
 
 /* File variables */
 static int ticks_buffer = 0;
 static int ticks_next_update = 0;
-static generic_double_node_t* head = NULL;
-static generic_double_node_t* tail = NULL;
+
+/* Sleeping threads, ordered by number of remaining ticks */
+static tcb_queue_t sleepers = {NULL, NULL};
+
+/* Set while the timer bottom half works on the sleep list with interrupts
+ * enabled. Threads only touch the list with interrupts disabled, and no
+ * thread switch happens while bottom halves run, so threads never find the
+ * list locked */
+static int sleepers_locked = 0;
 
 /** @brief  Deschedules the calling thread until at least ticks timer interrupts
  *          have occurred after the call.
@@ -47,64 +46,110 @@ int kern_sleep(int ticks) {
     return -1;
   }
 
-  sleeper_t new_sleeper = {ticks, kernel.current_thread};
-  generic_double_node_t new_node = {&new_sleeper, NULL, NULL};
-
   // We don't want any timer interrupt during this operation
-  disable_interrupts();
+  irq_disable();
 
-  generic_double_node_t* it = head;
-  if (head == NULL) {
-    // Queue is empty
+  sleep_add(kernel.current_thread, ticks);
+
+  // Block the thread and context switch
+  // (interrupts will be enabled after context switch)
+  block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+
+  return 0;
+}
+
+/** @brief  Adds a thread to the sleep list, it is made runnable once ticks
+ *          timer interrupts have occurred
+ *
+ *  The thread is not blocked. Must be called with interrupts disabled.
+ *
+ *  @param  me      The thread's TCB
+ *  @param  ticks   The number of timer interrupts, strictly positive
+ *
+ *  @return void
+ */
+void sleep_add(tcb_t *me, int ticks) {
+
+  assert(!sleepers_locked);
 
-    head = (tail = &new_node);
+  me->sleep_ticks = ticks;
+
+  if (Q_GET_FRONT(&sleepers) == NULL) {
+    // Queue is empty
+    Q_INSERT_TAIL(&sleepers, me, sleep_link);
     ticks_next_update = ticks;
   } else {
     // Queue is non-empty
 
-    new_sleeper.ticks += ticks_buffer;
+    me->sleep_ticks += ticks_buffer;
 
     // Find the good position in the queue
-    while(it != NULL && ((sleeper_t*)it->value)->ticks < new_sleeper.ticks) {
-      it = it->next;
+    tcb_t *it;
+    Q_FOREACH(it, &sleepers, sleep_link) {
+      if (it->sleep_ticks >= me->sleep_ticks) {
+        break;
+      }
     }
 
-    // Insert the new node at the correct position
+    // Insert the new element at the correct position
     if (it == NULL) {
-      // Insert new element at queue's tail
-
-      new_node.prev = tail;
-      tail->next = &new_node;
-      tail = &new_node;
+      Q_INSERT_TAIL(&sleepers, me, sleep_link);
     } else {
-      // Insert new element between two nodes
-      new_node.next = it;
-      
-      if (it->prev != NULL) {
-        // The new element 
-        new_node.prev = it->prev;
-        it->prev->next = &new_node;
-      } else {
-        // The new element is the new head
-        head = &new_node;
-        // Update the time to next update
+      if (it == Q_GET_FRONT(&sleepers)) {
+        // The new element is the new head, update the time to next update
         ticks_next_update = ticks;
       }
-
-      it->prev = &new_node;
+      Q_INSERT_BEFORE(&sleepers, it, me, sleep_link);
     }
 
   }
+}
 
-  // Block the thread and context switch
-  // (interrupts will be enabled after context switch)
-  block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+/** @brief  Removes a thread from the sleep list if it is in it
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @param  tcb   The thread's TCB
+ *
+ *  @return void
+ */
+void sleep_cancel(tcb_t *tcb) {
 
-  return 0;
+  assert(!sleepers_locked);
+
+  tcb_t *it;
+  Q_FOREACH(it, &sleepers, sleep_link) {
+    if (it == tcb) {
+      break;
+    }
+  }
+  if (it == NULL) {
+    return;
+  }
+
+  int was_head = (it == Q_GET_FRONT(&sleepers));
+  Q_REMOVE(&sleepers, tcb, sleep_link);
+
+  if (!was_head) {
+    return;
+  }
+
+  tcb_t *head = Q_GET_FRONT(&sleepers);
+  if (head == NULL) {
+    // The queue is now empty
+    ticks_next_update = 0;
+    ticks_buffer = 0;
+  } else {
+    ticks_next_update = head->sleep_ticks - ticks_buffer;
+  }
 }
 
 /** @brief  Callback function for timer interrupt handler, wakes up all threads
- *          that have been sleeping for the right amount of ticks
+ *          that have been sleeping for the right amount of ticks, and
+ *          completes the asynchronous sleep requests whose time is up
+ *
+ *  Called from the timer's bottom half, with interrupts enabled. Interrupts
+ *  are only disabled to make each thread runnable.
  *
  *  @brief  ticks   The total number of ticks since system boot
  *
@@ -112,39 +157,39 @@ int kern_sleep(int ticks) {
  */
 void wake_up_threads(unsigned int ticks) {
 
+  async_io_tick(ticks);
+
   // If no one is sleeping, return immediately
   if (ticks_next_update == 0) {
     return;
   }
 
+  sleepers_locked = 1;
+
   ++ticks_buffer;
   --ticks_next_update;
 
   if (ticks_next_update == 0) {
     // There must be at least one element in the queue
 
-    generic_double_node_t* node = head;
-    sleeper_t* sleeper = head->value;
+    tcb_t *sleeper = Q_GET_FRONT(&sleepers);
   
-    while (node != NULL && sleeper->ticks == ticks_buffer) { 
-      add_runnable_thread_noint(sleeper->tcb); 
-      node = node->next;
-      sleeper = (node == NULL) ? NULL : node->value;
+    while (sleeper != NULL && sleeper->sleep_ticks == ticks_buffer) { 
+      Q_REMOVE(&sleepers, sleeper, sleep_link);
+      add_runnable_thread(sleeper); 
+      sleeper = Q_GET_FRONT(&sleepers);
     }
 
-    if (node == NULL) {
+    if (sleeper == NULL) {
       // The queue is now empty
-      head = (tail = NULL);
       ticks_next_update = 0;
       ticks_buffer = 0;
     } else {
       // There are still elements in the queue
-      head = node;
-      node->prev = NULL;
-      ticks_next_update = sleeper->ticks - ticks_buffer;
-
+      ticks_next_update = sleeper->sleep_ticks - ticks_buffer;
     }
 
   }
 
+  sleepers_locked = 0;
 }
@@ -1,11 +1,15 @@
 /** @file termianl.c
  *  @brief  This file contains the definition for the kern_set_term_color(),
  *          kern_set_cursor_pos() and kern_get_cursor_pos() system calls. 
+ *
+ *          Output queued by print() is rendered before the cursor or the
+ *          color is changed or read.
  *  @author akanjani, lramire1
  */
 
 #include <kernel_state.h>
 #include <console.h>
+#include <console_ring.h>
 
 /* VM system */
 #include <virtual_memory.h>
@@ -20,6 +24,7 @@
  *          color 
  */
 int kern_set_term_color(int color) {
+  console_ring_flush();
   eff_mutex_lock(&kernel.console_mutex);
   int ret = set_terminal_color(color);
   eff_mutex_unlock(&kernel.console_mutex);
@@ -34,6 +39,7 @@ int kern_set_term_color(int color) {
  *  @return 0 on success, a negative number if the location is invalid
  */
 int kern_set_cursor_pos(int row, int col) {
+  console_ring_flush();
   eff_mutex_lock(&kernel.console_mutex);
   int ret = set_cursor(row, col);
   eff_mutex_unlock(&kernel.console_mutex);
@@ -56,6 +62,7 @@ int kern_get_cursor_pos(int *row, int *col) {
     return -1;
   }
 
+  console_ring_flush();
   eff_mutex_lock(&kernel.console_mutex);
   get_cursor(row, col);
   eff_mutex_unlock(&kernel.console_mutex);
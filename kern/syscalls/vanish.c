@@ -4,11 +4,11 @@
  *  @author akanjani, lramire1
  */
 
-#include <hash_table.h>
+#include <tid_table.h>
 #include <kernel_state.h>
 #include <eff_mutex.h>
 #include <cr.h>
-#include <linked_list.h>
+#include <variable_queue.h>
 #include <stddef.h>
 #include <pcb.h>
 #include <simics.h>
@@ -19,10 +19,17 @@
 #include <virtual_memory_defines.h>
 #include <syscalls.h>
 #include <asm.h>
+#include <irq_trace.h>
 #include <scheduler.h>
 #include <malloc.h>
-#include <stack_queue.h>
 #include <page.h>
+#include <fpu.h>
+#include <shm.h>
+#include <mq.h>
+#include <fs.h>
+#include <reaper.h>
+#include <async_io.h>
+#include <wait_any.h>
 
 #define EXITED 5
 #define LAST_THREAD_FALSE 0
@@ -48,6 +55,9 @@ void kern_vanish() {
 
   pcb_t *curr_task = kernel.current_thread->task;
 
+  // The thread will never use the FPU again
+  fpu_release(kernel.current_thread);
+
   eff_mutex_lock(&curr_task->mutex);
   if (curr_task->num_of_threads <= 1) {
     is_last_thread = LAST_THREAD_TRUE;
@@ -58,116 +68,116 @@ void kern_vanish() {
 
   if (is_last_thread == LAST_THREAD_TRUE) {
     // Last thread vanishing
+
+    // Stop the asynchronous ring's workers while the address space is alive
+    async_io_release(curr_task);
     
     eff_mutex_lock(&curr_task->list_mutex);
+    eff_mutex_lock(&kernel.init_task->list_mutex);
 
     // Update number of running children for init
-    eff_mutex_lock(&kernel.init_task->list_mutex);
     kernel.init_task->num_running_children += curr_task->num_running_children;
-    eff_mutex_unlock(&kernel.init_task->list_mutex);
     
-    // Mark all running children's parent as init
-    generic_node_t *temp = curr_task->running_children.head;
-    while(temp != NULL) {
-      pcb_t *pcb_tmp = (pcb_t*)temp->value;
-      generic_node_t *next = temp->next;
-      pcb_tmp->parent = kernel.init_task;
-      free(temp);
-      temp = next;
+    // Hand all running children over to init
+    pcb_t *child;
+    while ((child = Q_GET_FRONT(&curr_task->running_children)) != NULL) {
+      Q_REMOVE(&curr_task->running_children, child, child_link);
+      child->parent = kernel.init_task;
+      Q_INSERT_TAIL(&kernel.init_task->running_children, child, child_link);
     }
 
+    eff_mutex_unlock(&kernel.init_task->list_mutex);
     eff_mutex_unlock(&curr_task->list_mutex);
 
-    // Free any user space memory being used by this task
+    // Leave the task's address space for good
     unsigned int *cr3 = (unsigned int *)kernel.current_thread->cr3;
     kernel.current_thread->cr3 = kernel.init_cr3;
     set_cr3(kernel.init_cr3);
-    free_address_space(cr3, KERNEL_AND_USER_SPACE);
 
-    // Update the kernel count of frames
-    release_frames(curr_task->num_of_frames_requested);
+    // Drop the shared memory segments, the frames accounted for them are
+    // released with the others once the address space is torn down
+    shm_release_all(curr_task);
 
-    // Delete the linked list allocations which we store for new pages
-    linked_list_delete_list(&kernel.current_thread->task->allocations);
+    // Close the task's files
+    fs_close_all(curr_task);
 
-    eff_mutex_lock(&curr_task->list_mutex);
+    // Destroy the task's message queues and the messages they still hold
+    mq_release_all(curr_task);
 
-    generic_node_t *curr_zombie_list = curr_task->zombie_children.head;
+    // The reaper frees the address space and the allocations list, then
+    // updates the kernel count of frames
+    eff_mutex_lock(&curr_task->mutex);
+    reaper_free_address_space(cr3, curr_task->num_of_frames_requested,
+                              &curr_task->allocations);
+    eff_mutex_unlock(&curr_task->mutex);
 
-    if (curr_zombie_list != NULL) {
-      // At least 1 zombie child of this task
+    eff_mutex_lock(&curr_task->list_mutex);
+
+    if (Q_GET_FRONT(&curr_task->zombie_children) != NULL) {
+      // At least 1 zombie child of this task, hand them over to init
       eff_mutex_lock(&kernel.init_task->list_mutex);
-      generic_node_t *init_zombie_tail = kernel.init_task->zombie_children.tail;
-      if (init_zombie_tail == NULL) {
-        // Init has no zombie child. Make its list's head as that of mine
-        init_zombie_tail = 
-              (kernel.init_task->zombie_children.head = curr_zombie_list);
-      } else {
-        // Init at least has one zombie child. Append my list
-        init_zombie_tail->next = curr_zombie_list;
+      while ((child = Q_GET_FRONT(&curr_task->zombie_children)) != NULL) {
+        Q_REMOVE(&curr_task->zombie_children, child, child_link);
+        Q_INSERT_TAIL(&kernel.init_task->zombie_children, child, child_link);
       }
+      wait_any_notify(EVENT_CHILD, kernel.init_task);
       eff_mutex_unlock(&kernel.init_task->list_mutex);
     }
 
     eff_mutex_unlock(&curr_task->list_mutex);
 
-    eff_mutex_lock(&curr_task->parent->list_mutex);
+    // Our parent may hand us over to init while we wait for its list mutex
+    pcb_t *parent = curr_task->parent;
+    eff_mutex_lock(&parent->list_mutex);
+    while (parent != curr_task->parent) {
+      eff_mutex_unlock(&parent->list_mutex);
+      parent = curr_task->parent;
+      eff_mutex_lock(&parent->list_mutex);
+    }
     
     // Remove yourself from the running queue of the parent
-    // Even if the task is not in the linked list, this function will have no 
-    // side effect
-    linked_list_delete_node(&curr_task->parent->running_children, curr_task);
+    Q_REMOVE(&parent->running_children, curr_task, child_link);
 
-    if (is_stack_queue_empty(&curr_task->parent->waiting_threads)) {
+    tcb_t *wait_thread = Q_GET_FRONT(&parent->waiting_threads);
+    if (wait_thread == NULL) {
       // None of the threads of my parent process are waiting for me.
       // Add myself to the zombie queue of the parent
-      generic_node_t new_zombie = {curr_task, NULL};
-      stack_queue_enqueue(&curr_task->parent->zombie_children, &new_zombie);
+      Q_INSERT_TAIL(&parent->zombie_children, curr_task, child_link);
       curr_task->last_thread_esp0 = kernel.current_thread->esp0 - PAGE_SIZE;
+
+      // Threads multiplexing events can now collect us
+      wait_any_notify(EVENT_CHILD, parent);
     } else {
       // At least one thread is waiting in my parent process
-      generic_node_t *wait_thread_node = 
-                    stack_queue_dequeue(&curr_task->parent->waiting_threads);
-      assert(wait_thread_node != NULL);
-
-      tcb_t* wait_thread = wait_thread_node->value;
+      Q_REMOVE(&parent->waiting_threads, wait_thread, wait_link);
       curr_task->last_thread_esp0 = kernel.current_thread->esp0 - PAGE_SIZE;
       wait_thread->reaped_task = curr_task;
-      curr_task->parent->num_running_children--;
-      curr_task->parent->num_waiting_threads--;
+      parent->num_running_children--;
+      parent->num_waiting_threads--;
 
       add_runnable_thread(wait_thread);
     }
   } 
 
   // Remove the tcb from the hashmap
-  hash_table_remove_element(&kernel.tcbs, kernel.current_thread);
+  tid_table_remove(&kernel.tcbs, kernel.current_thread->tid);
 
   eff_mutex_lock(&kernel.gc.mp);
 
-  // Free everything in the garbage collector queue at this time
-  generic_node_t *delete_zombie_mem;
-  while((delete_zombie_mem = 
-                stack_queue_dequeue(&kernel.gc.zombie_memory)) != NULL) {
-    free((tcb_t*)delete_zombie_mem->value);
-  }
+  // The reaper frees the garbage collector's queue, it can not get the
+  // garbage collector's mutex before this thread has switched away. Wake it
+  // up first, as the TCB's wait link can not be used to wait on the reaper's
+  // mutex once it is in the queue.
+  reaper_wake();
+
+  // The stack of the last thread will be freed by the wait call
+  // Otherwise, the kernel stack is freed along with the TCB
+  kernel.current_thread->free_stack = (is_last_thread != LAST_THREAD_TRUE);
 
-  generic_node_t tmp_delete;
-  tmp_delete.value = kernel.current_thread;
-  tmp_delete.next = NULL;
   // Enqueue the tcb for the current thread in the garbage collector queue
-  stack_queue_enqueue(&kernel.gc.zombie_memory, &tmp_delete);
-
-  if (is_last_thread != LAST_THREAD_TRUE) {
-    // The stack of the last thread will be freed by the wait call
-    // Otherwise, add the kernel stack to the garbage collector queue
-    generic_node_t tmp_delete2;
-    tmp_delete2.value = (char*)(kernel.current_thread->esp0 - PAGE_SIZE);
-    tmp_delete2.next = NULL;
-    stack_queue_enqueue(&kernel.gc.zombie_memory, &tmp_delete2);
-  }
+  Q_INSERT_TAIL(&kernel.gc.zombie_memory, kernel.current_thread, wait_link);
 
-  disable_interrupts();
+  irq_disable();
 
   // Interrupts are disabled so no one can delete this kernel stack/tcb 
   // before context switch
@@ -14,8 +14,9 @@
 #include <eff_mutex.h>
 #include <syscalls.h>
 #include <malloc.h>
-#include <stack_queue.h>
+#include <variable_queue.h>
 #include <scheduler.h>
+#include <async_io.h>
 
 /** @brief Collects the exit status of a task and stores it in the integer 
  *         referenced by status ptr.
@@ -54,24 +55,20 @@ int kern_wait(int *status_ptr) {
   pcb_t *curr_task = kernel.current_thread->task;
   eff_mutex_lock(&curr_task->list_mutex);
 
-  // Check if this thread will wait infinitely 
-  if (curr_task->num_waiting_threads >= curr_task->num_running_children) {
+  // Check if this thread will wait infinitely (a ring's worker also gives up
+  // once its task is exiting)
+  if (curr_task->num_waiting_threads >= curr_task->num_running_children ||
+      async_io_is_closing(kernel.current_thread)) {
     // This thread will wait infinitely
     eff_mutex_unlock(&curr_task->list_mutex);
     return -1;
   }
   
-  if (curr_task->zombie_children.head != NULL) {
+  pcb_t *zombie_child = Q_GET_FRONT(&curr_task->zombie_children);
+  if (zombie_child != NULL) {
     
     // Remove the zombie child
-    generic_node_t * zombie_child_node = 
-      stack_queue_dequeue(&curr_task->zombie_children);
-    if (zombie_child_node == NULL) {
-      lprintf("kern_wait(): zombie queue delete failed");
-      return -1;
-    }
-
-    pcb_t* zombie_child = zombie_child_node->value;
+    Q_REMOVE(&curr_task->zombie_children, zombie_child, child_link);
 
     // Decrease the count of running or zombie children for this task
     curr_task->num_running_children--;
@@ -94,13 +91,19 @@ int kern_wait(int *status_ptr) {
   // No zombie children at the time
   // Wait for at least one thread to vanish
   curr_task->num_waiting_threads++;
+  kernel.current_thread->reaped_task = NULL;
 
   // Enqueue myself in the the queue of waiting threads
-  generic_node_t new_waiting = {kernel.current_thread, NULL};
-  stack_queue_enqueue(&curr_task->waiting_threads, &new_waiting);
+  Q_INSERT_TAIL(&curr_task->waiting_threads, kernel.current_thread,
+                wait_link);
   
   // Block this thread
   block_and_switch(HOLDING_MUTEX_TRUE, &curr_task->list_mutex);
+
+  // A ring's worker is woken up without a task when its task exits
+  if (kernel.current_thread->reaped_task == NULL) {
+    return -1;
+  }
   
   if (status_ptr != NULL) {
     // Set the status ptr if not NULL
@@ -125,20 +128,14 @@ int kern_wait(int *status_ptr) {
  */
 void cleanup_process(pcb_t *task) {
   // Remove element from the hash table
-  hash_table_remove_element(&kernel.pcbs, task);
-
-  // Free everything in the garbage collector queue
-  eff_mutex_lock(&kernel.gc.mp);
-  generic_node_t *delete_zombie_mem;
-  while((delete_zombie_mem = stack_queue_dequeue(&kernel.gc.zombie_memory)) 
-        != NULL) {
-    free((tcb_t*)delete_zombie_mem->value);
-  }
-  eff_mutex_unlock(&kernel.gc.mp);
+  tid_table_remove(&kernel.pcbs, task->tid);
 
   // Extract the stack pointer start addr from the exited task
   char *delete_me = (char*)task->last_thread_esp0;
 
+  // Give back the task's slot in the scheduler's heap
+  task_heap_release_slot(&kernel.runnable_tasks);
+
   // Free the pcb and the kernel stack
   free(task);
   free(delete_me);
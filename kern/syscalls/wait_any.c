@@ -0,0 +1,181 @@
+/** @file wait_any.c
+ *  @brief This file contains the definition for the wait_any() system call,
+ *  which lets a thread wait for whichever comes first among a child exiting,
+ *  a line of input and a timeout.
+ *
+ *  Events are reported when the matching system call would not block, the
+ *  thread then makes the call itself (as with poll()). A thread may only be
+ *  in one of the queues using its wait link, so the threads blocked in
+ *  wait_any() are kept in a single queue and each event source wakes up the
+ *  ones interested in its event (wait_any_notify()). The timeout uses the
+ *  sleep list, through the sleep link. The queue is protected by disabling
+ *  interrupts, since lines of input are reported by a bottom half.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <wait_any.h>
+#include <keyboard.h>
+#include <kernel_state.h>
+#include <scheduler.h>
+#include <syscalls.h>
+#include <variable_queue.h>
+#include <asm.h>
+#include <irq_trace.h>
+
+/* VM system */
+#include <virtual_memory.h>
+#include <virtual_memory_defines.h>
+
+/* Debugging */
+#include <simics.h>
+
+/* Threads blocked in wait_any(), protected by disabling interrupts */
+static tcb_queue_t event_waiters = {NULL, NULL};
+
+/* Static functions prototypes */
+static int first_ready_event(pcb_t *task, int *events, int n);
+
+/** @brief  Blocks the calling thread until one of several events happens or
+ *          until a timeout expires
+ *
+ *  EVENT_CHILD happens when a call to wait() would not block (a child
+ *  exited, or wait() would fail), EVENT_LINE when a whole line of input was
+ *  typed in, so that readline() does not wait for input.
+ *
+ *  @param  events          The events to wait for
+ *  @param  n               The number of events
+ *  @param  timeout_ticks   The number of timer interrupts after which the
+ *                          call gives up, 0 to only check the events, a
+ *                          negative number to wait without a timeout
+ *
+ *  @return The index of the first event that happened, n if the timeout
+ *          expired, a negative number if an event is unknown, if events is
+ *          not a valid memory address, or if the call would block forever
+ */
+int kern_wait_any(int *events, int n, int timeout_ticks) {
+
+  if (n < 0 || n > WAIT_ANY_MAX_EVENTS || (n == 0 && timeout_ticks < 0)) {
+    return -1;
+  }
+
+  if (n > 0 &&
+      is_buffer_valid((unsigned int)events, n * sizeof(int),
+                      AT_LEAST_READ) < 0) {
+    return -1;
+  }
+
+  // Copy the events, the task may change them while we are blocked
+  int types[WAIT_ANY_MAX_EVENTS];
+  int mask = 0;
+  int i;
+  for (i = 0 ; i < n ; ++i) {
+    types[i] = events[i];
+    if (types[i] != EVENT_CHILD && types[i] != EVENT_LINE) {
+      return -1;
+    }
+    mask |= (1 << types[i]);
+  }
+
+  tcb_t *me = kernel.current_thread;
+  unsigned int deadline = kern_get_ticks() + timeout_ticks;
+  int fired;
+
+  // Event sources may not run between the checks and the insertion in the
+  // queue
+  irq_disable();
+  while ((fired = first_ready_event(me->task, types, n)) < 0) {
+
+    int remaining = (int)(deadline - kern_get_ticks());
+    if (timeout_ticks >= 0 && remaining <= 0) {
+      fired = n;
+      break;
+    }
+
+    if (n > 0) {
+      me->event_mask = mask;
+      Q_INSERT_TAIL(&event_waiters, me, wait_link);
+    }
+    if (timeout_ticks >= 0) {
+      sleep_add(me, remaining);
+    }
+
+    // Interrupts are enabled after the context switch
+    block_and_switch(HOLDING_MUTEX_FALSE, NULL);
+    irq_disable();
+
+    // We may have been woken up by the timer or by an event source, leave
+    // the other one
+    if (me->event_mask != 0) {
+      Q_REMOVE(&event_waiters, me, wait_link);
+      me->event_mask = 0;
+    }
+    sleep_cancel(me);
+  }
+  irq_enable();
+
+  return fired;
+}
+
+/** @brief  Wakes up the threads blocked in wait_any() for an event
+ *
+ *  A woken up thread checks its events again. Threads that are already
+ *  awake are only removed from the queue.
+ *
+ *  @param  event   The event (EVENT_CHILD or EVENT_LINE)
+ *  @param  task    For EVENT_CHILD, the task whose child exited, NULL
+ *                  otherwise
+ *
+ *  @return void
+ */
+void wait_any_notify(int event, pcb_t *task) {
+
+  int enabled = save_and_disable_interrupts();
+
+  tcb_t *waiter = Q_GET_FRONT(&event_waiters);
+  while (waiter != NULL) {
+    tcb_t *next = Q_GET_NEXT(waiter, wait_link);
+    if ((waiter->event_mask & (1 << event)) &&
+        (task == NULL || waiter->task == task)) {
+      Q_REMOVE(&event_waiters, waiter, wait_link);
+      waiter->event_mask = 0;
+      if (waiter->thread_state == THR_BLOCKED) {
+        sleep_cancel(waiter);
+        add_runnable_thread_noint(waiter);
+      }
+    }
+    waiter = next;
+  }
+
+  restore_interrupts(enabled);
+}
+
+/** @brief  Returns the first event among several which happened
+ *
+ *  @param  task    The calling thread's task
+ *  @param  events  The events
+ *  @param  n       The number of events
+ *
+ *  @return The index of the event, a negative number if none happened
+ */
+static int first_ready_event(pcb_t *task, int *events, int n) {
+
+  int i;
+  for (i = 0 ; i < n ; ++i) {
+    switch (events[i]) {
+      case EVENT_CHILD:
+        if (Q_GET_FRONT(&task->zombie_children) != NULL ||
+            task->num_waiting_threads >= task->num_running_children) {
+          return i;
+        }
+        break;
+      case EVENT_LINE:
+        if (keyboard_has_line()) {
+          return i;
+        }
+        break;
+    }
+  }
+
+  return -1;
+}
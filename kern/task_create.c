@@ -18,12 +18,13 @@
 #include <scheduler.h>
 #include <syscall.h>
 #include <virtual_memory.h>
-#include <hash_table.h>
+#include <tid_table.h>
 #include <syscalls.h>
 #include <virtual_memory_defines.h>
 #include <common_kern.h>
 #include <asm.h>
 #include <string.h>
+#include <reaper.h>
 
 // Debugging
 #include <simics.h>
@@ -98,7 +99,7 @@ int create_task_from_executable(char *task_name) {
   if (new_tcb == NULL) {
     lprintf("create_task_from_executable(): TCB initialization failed");
     free(stack_kernel);
-    hash_table_remove_element(&kernel.pcbs, new_pcb);
+    tid_table_remove(&kernel.pcbs, new_pcb->tid);
     release_frames(num_frames_requested);
     return -1;
   }
@@ -144,14 +145,8 @@ int create_task_from_executable(char *task_name) {
   // Save stack pointer value in TCB
   new_tcb->esp = (uint32_t) stack_addr;
 
-  // Mark the thread as runnable
-  new_tcb->thread_state = THR_RUNNABLE;
-  generic_node_t new_tail = {new_tcb, NULL};
-  generic_node_t * node_addr = (generic_node_t *)(new_tcb->esp0 - PAGE_SIZE);
-  *(node_addr) = new_tail;
-
-  // Enqueue the current thread
-  stack_queue_enqueue(&kernel.runnable_queue, node_addr);
+  // Mark the thread as runnable (interrupts are still disabled at boot time)
+  add_runnable_thread_noint(new_tcb);
 
   return 0;
 }
@@ -213,7 +208,7 @@ unsigned int request_frames_needed_by_program(simple_elf_t *elf) {
   total_frames_reqd -= reduce_count;
 
   // Try to reserve frames
-  if (reserve_frames(total_frames_reqd) < 0) {
+  if (reaper_reserve_frames(total_frames_reqd) < 0) {
     return 0;
   }
 
@@ -0,0 +1,224 @@
+/** @file task_heap.c
+ *  @brief  This file contains the definitions for functions used to 
+ *          manipulate the task_heap_t data structure
+ *
+ *  Except for task_heap_reserve_slot() and task_heap_release_slot(), the
+ *  functions must be called with interrupts disabled.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <task_heap.h>
+#include <malloc.h>
+#include <string.h>
+#include <asm.h>
+#include <irq_trace.h>
+#include <assert.h>
+
+/* Initial number of slots in the heap */
+#define TASK_HEAP_INITIAL_CAPACITY 16
+
+/* Static functions prototypes */
+static void swap(task_heap_t *heap, int i, int j);
+static void sift_up(task_heap_t *heap, int index);
+static void sift_down(task_heap_t *heap, int index);
+
+/** @brief  Initializes an empty heap
+ *
+ *  @param  heap  The heap to initialize
+ *
+ *  @return void
+ */
+void task_heap_init(task_heap_t *heap) {
+  assert(heap != NULL);
+  heap->tasks = NULL;
+  heap->size = 0;
+  heap->reserved = 0;
+  heap->capacity = 0;
+}
+
+/** @brief  Reserves a slot in the heap for a newly created task
+ *
+ *  The tasks array is doubled when there is no free slot left. The function
+ *  may allocate memory, hence it must not be called from the scheduler.
+ *
+ *  @param  heap  The heap
+ *
+ *  @return 0 on success, a negative number if the array could not be grown
+ */
+int task_heap_reserve_slot(task_heap_t *heap) {
+
+  int enabled = save_and_disable_interrupts();
+  if (heap->reserved < heap->capacity) {
+    ++heap->reserved;
+    restore_interrupts(enabled);
+    return 0;
+  }
+  int old_capacity = heap->capacity;
+  restore_interrupts(enabled);
+
+  int new_capacity = (old_capacity == 0) ? TASK_HEAP_INITIAL_CAPACITY :
+                      2 * old_capacity;
+  pcb_t **new_tasks = malloc(new_capacity * sizeof(pcb_t *));
+  if (new_tasks == NULL) {
+    return -1;
+  }
+
+  enabled = save_and_disable_interrupts();
+
+  if (heap->capacity != old_capacity) {
+    // Someone else grew the array while we were allocating, retry
+    restore_interrupts(enabled);
+    free(new_tasks);
+    return task_heap_reserve_slot(heap);
+  }
+
+  pcb_t **old_tasks = heap->tasks;
+  if (old_tasks != NULL) {
+    memcpy(new_tasks, old_tasks, heap->size * sizeof(pcb_t *));
+  }
+  heap->tasks = new_tasks;
+  heap->capacity = new_capacity;
+  ++heap->reserved;
+
+  restore_interrupts(enabled);
+
+  free(old_tasks);
+  return 0;
+}
+
+/** @brief  Releases the slot reserved by a task that is being destroyed
+ *
+ *  @param  heap  The heap
+ *
+ *  @return void
+ */
+void task_heap_release_slot(task_heap_t *heap) {
+  int enabled = save_and_disable_interrupts();
+  assert(heap->reserved > heap->size);
+  --heap->reserved;
+  restore_interrupts(enabled);
+}
+
+/** @brief  Inserts a task in the heap
+ *
+ *  @param  heap  The heap
+ *  @param  task  The task to insert (must not already be in the heap)
+ *
+ *  @return void
+ */
+void task_heap_insert(task_heap_t *heap, pcb_t *task) {
+
+  assert(task->heap_index == TASK_NOT_IN_HEAP);
+  assert(heap->size < heap->capacity);
+
+  task->heap_index = heap->size;
+  heap->tasks[heap->size++] = task;
+  sift_up(heap, task->heap_index);
+}
+
+/** @brief  Returns the task with the smallest pass value without removing it
+ *
+ *  @param  heap  The heap
+ *
+ *  @return The task with the smallest pass value, NULL if the heap is empty
+ */
+pcb_t *task_heap_min(task_heap_t *heap) {
+  return (heap->size == 0) ? NULL : heap->tasks[0];
+}
+
+/** @brief  Removes a task from the heap
+ *
+ *  @param  heap  The heap
+ *  @param  task  The task to remove (must be in the heap)
+ *
+ *  @return void
+ */
+void task_heap_remove(task_heap_t *heap, pcb_t *task) {
+
+  int index = task->heap_index;
+  assert(index >= 0 && index < heap->size && heap->tasks[index] == task);
+
+  // Move the last task in the removed task's slot
+  int last = --heap->size;
+  if (index != last) {
+    heap->tasks[index] = heap->tasks[last];
+    heap->tasks[index]->heap_index = index;
+    task_heap_update(heap, heap->tasks[index]);
+  }
+
+  task->heap_index = TASK_NOT_IN_HEAP;
+}
+
+/** @brief  Restores the heap property after a task's pass value changed
+ *
+ *  @param  heap  The heap
+ *  @param  task  The task whose pass value changed (must be in the heap)
+ *
+ *  @return void
+ */
+void task_heap_update(task_heap_t *heap, pcb_t *task) {
+  sift_up(heap, task->heap_index);
+  sift_down(heap, task->heap_index);
+}
+
+/** @brief  Swaps two tasks in the heap
+ *
+ *  @param  heap  The heap
+ *  @param  i     Index of the first task
+ *  @param  j     Index of the second task
+ *
+ *  @return void
+ */
+static void swap(task_heap_t *heap, int i, int j) {
+  pcb_t *tmp = heap->tasks[i];
+  heap->tasks[i] = heap->tasks[j];
+  heap->tasks[j] = tmp;
+  heap->tasks[i]->heap_index = i;
+  heap->tasks[j]->heap_index = j;
+}
+
+/** @brief  Moves a task up until its parent has a smaller pass value
+ *
+ *  @param  heap  The heap
+ *  @param  index Index of the task to move
+ *
+ *  @return void
+ */
+static void sift_up(task_heap_t *heap, int index) {
+  while (index > 0) {
+    int parent = (index - 1) / 2;
+    if (heap->tasks[parent]->pass <= heap->tasks[index]->pass) {
+      return;
+    }
+    swap(heap, parent, index);
+    index = parent;
+  }
+}
+
+/** @brief  Moves a task down until its children have greater pass values
+ *
+ *  @param  heap  The heap
+ *  @param  index Index of the task to move
+ *
+ *  @return void
+ */
+static void sift_down(task_heap_t *heap, int index) {
+  while (1) {
+    int smallest = index;
+    int left = 2 * index + 1, right = 2 * index + 2;
+    if (left < heap->size &&
+        heap->tasks[left]->pass < heap->tasks[smallest]->pass) {
+      smallest = left;
+    }
+    if (right < heap->size &&
+        heap->tasks[right]->pass < heap->tasks[smallest]->pass) {
+      smallest = right;
+    }
+    if (smallest == index) {
+      return;
+    }
+    swap(heap, smallest, index);
+    index = smallest;
+  }
+}
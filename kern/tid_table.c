@@ -0,0 +1,359 @@
+/** @file tid_table.c
+ *
+ *  @brief  This file contains the definitions for functions which can be used
+ *          to manipulate the table mapping thread/task ids to their control
+ *          blocks
+ *
+ *  Entries are stored inline in an array of slots, so adding an entry does
+ *  not allocate anything unless the table has to grow. Ids are hashed with a
+ *  multiplicative hash, and collisions are resolved with linear probing.
+ *  Entries are removed from the current table by shifting back the entries
+ *  following them in the probe sequence, so it never contains deleted
+ *  markers. The old table of an ongoing resize only ever loses entries, so
+ *  those are simply replaced by a deleted marker.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#include <tid_table.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Debugging */
+#include <simics.h>
+#include <assert.h>
+
+/* Log2 of the initial number of slots */
+#define TID_TABLE_INITIAL_SLOTS_LOG2 6
+
+/* The table grows when more than 1/TID_TABLE_MAX_LOAD_INV of its slots are
+ * used */
+#define TID_TABLE_MAX_LOAD_INV 2
+
+/* Number of slots of the old table moved on each operation during a resize */
+#define TID_TABLE_MIGRATE_STEP 8
+
+/* Knuth's multiplicative hashing constant (2^32 divided by the golden ratio)
+ */
+#define TID_TABLE_HASH_MULTIPLIER 2654435769u
+
+/* Marks an entry removed from the old table during a resize */
+#define TID_TABLE_DELETED ((void *)-1)
+
+/* Static functions prototypes */
+static unsigned int hash(int tid, unsigned int nb_slots_log2);
+static tid_slot_t *find_slot(tid_slot_t *slots, unsigned int nb_slots_log2,
+                             int tid);
+static void insert_slot(tid_slot_t *slots, unsigned int nb_slots_log2,
+                        int tid, void *value);
+static void remove_slot(tid_slot_t *slots, unsigned int nb_slots_log2,
+                        tid_slot_t *slot);
+static void start_resize(tid_table_t *table);
+static void migrate(tid_table_t *table, unsigned int nb);
+
+/** @brief  Initializes the table
+ *
+ *  The function must be called once before any other function in this file,
+ *  otherwise the table's behavior is undefined.
+ *
+ *  @param  table   The table to initialize
+ *
+ *  @return 0 on success, a negative error code on failure
+ */
+int tid_table_init(tid_table_t *table) {
+
+  if (table == NULL || eff_mutex_init(&table->mutex) < 0) {
+    return -1;
+  }
+
+  table->nb_slots_log2 = TID_TABLE_INITIAL_SLOTS_LOG2;
+  table->nb_slots = 1 << TID_TABLE_INITIAL_SLOTS_LOG2;
+  table->slots = calloc(table->nb_slots, sizeof(tid_slot_t));
+  if (table->slots == NULL) {
+    return -1;
+  }
+  table->nb_entries = 0;
+
+  table->old_slots = NULL;
+  table->old_nb_slots = 0;
+  table->old_nb_slots_log2 = 0;
+  table->old_nb_entries = 0;
+  table->migrate_index = 0;
+
+  return 0;
+}
+
+/** @brief  Adds an entry to the table
+ *
+ *  The id must not already be in the table.
+ *
+ *  @param  table   The table
+ *  @param  tid     The entry's id
+ *  @param  value   The entry's value (not NULL)
+ *
+ *  @return 0 on success, a negative error code on failure
+ */
+int tid_table_insert(tid_table_t *table, int tid, void *value) {
+
+  // Check validity of arguments
+  if (table == NULL || value == NULL) {
+    return -1;
+  }
+
+  eff_mutex_lock(&table->mutex);
+
+  migrate(table, TID_TABLE_MIGRATE_STEP);
+
+  unsigned int total = table->nb_entries + table->old_nb_entries + 1;
+  if (total * TID_TABLE_MAX_LOAD_INV > table->nb_slots) {
+    start_resize(table);
+  }
+
+  // Always keep at least one empty slot so that probing terminates
+  if (table->nb_entries + 1 >= table->nb_slots) {
+    eff_mutex_unlock(&table->mutex);
+    return -1;
+  }
+
+  insert_slot(table->slots, table->nb_slots_log2, tid, value);
+  ++table->nb_entries;
+
+  eff_mutex_unlock(&table->mutex);
+
+  return 0;
+}
+
+/** @brief  Removes an entry from the table
+ *
+ *  @param  table   The table
+ *  @param  tid     The entry's id
+ *
+ *  @return The removed entry's value if it was found, NULL otherwise
+ */
+void *tid_table_remove(tid_table_t *table, int tid) {
+
+  // Check validity of arguments
+  if (table == NULL) {
+    return NULL;
+  }
+
+  eff_mutex_lock(&table->mutex);
+
+  migrate(table, TID_TABLE_MIGRATE_STEP);
+
+  void *value = NULL;
+  tid_slot_t *slot = find_slot(table->slots, table->nb_slots_log2, tid);
+  if (slot != NULL) {
+    value = slot->value;
+    remove_slot(table->slots, table->nb_slots_log2, slot);
+    --table->nb_entries;
+  } else if (table->old_slots != NULL) {
+    slot = find_slot(table->old_slots, table->old_nb_slots_log2, tid);
+    if (slot != NULL) {
+      value = slot->value;
+      slot->value = TID_TABLE_DELETED;
+      --table->old_nb_entries;
+    }
+  }
+
+  eff_mutex_unlock(&table->mutex);
+
+  return value;
+}
+
+/** @brief  Gets an entry from the table
+ *
+ *  @param  table   The table
+ *  @param  tid     The entry's id
+ *
+ *  @return The entry's value if it was found, NULL otherwise
+ */
+void *tid_table_get(tid_table_t *table, int tid) {
+
+  // Check validity of arguments
+  if (table == NULL) {
+    return NULL;
+  }
+
+  eff_mutex_lock(&table->mutex);
+
+  void *value = NULL;
+  tid_slot_t *slot = find_slot(table->slots, table->nb_slots_log2, tid);
+  if (slot == NULL && table->old_slots != NULL) {
+    slot = find_slot(table->old_slots, table->old_nb_slots_log2, tid);
+  }
+  if (slot != NULL) {
+    value = slot->value;
+  }
+
+  eff_mutex_unlock(&table->mutex);
+
+  return value;
+}
+
+/** @brief  Computes the home slot of an id
+ *
+ *  @param  tid             The id
+ *  @param  nb_slots_log2   Log2 of the number of slots in the table
+ *
+ *  @return The index of the id's home slot
+ */
+static unsigned int hash(int tid, unsigned int nb_slots_log2) {
+  return ((unsigned int)tid * TID_TABLE_HASH_MULTIPLIER) >>
+         (32 - nb_slots_log2);
+}
+
+/** @brief  Finds the slot holding an id
+ *
+ *  @param  slots           The table's slots
+ *  @param  nb_slots_log2   Log2 of the number of slots in the table
+ *  @param  tid             The id
+ *
+ *  @return The slot holding the id, NULL if the id is not in the table
+ */
+static tid_slot_t *find_slot(tid_slot_t *slots, unsigned int nb_slots_log2,
+                             int tid) {
+
+  unsigned int mask = (1 << nb_slots_log2) - 1;
+  unsigned int i = hash(tid, nb_slots_log2);
+
+  while (slots[i].value != NULL) {
+    if (slots[i].tid == tid && slots[i].value != TID_TABLE_DELETED) {
+      return &slots[i];
+    }
+    i = (i + 1) & mask;
+  }
+
+  return NULL;
+}
+
+/** @brief  Stores an entry in the first empty slot of its probe sequence
+ *
+ *  The table must have at least one empty slot.
+ *
+ *  @param  slots           The table's slots
+ *  @param  nb_slots_log2   Log2 of the number of slots in the table
+ *  @param  tid             The entry's id
+ *  @param  value           The entry's value
+ *
+ *  @return void
+ */
+static void insert_slot(tid_slot_t *slots, unsigned int nb_slots_log2,
+                        int tid, void *value) {
+
+  unsigned int mask = (1 << nb_slots_log2) - 1;
+  unsigned int i = hash(tid, nb_slots_log2);
+
+  while (slots[i].value != NULL) {
+    i = (i + 1) & mask;
+  }
+
+  slots[i].tid = tid;
+  slots[i].value = value;
+}
+
+/** @brief  Empties a slot and shifts back the entries following it in the
+ *          probe sequence, so that all entries can still be found
+ *
+ *  @param  slots           The table's slots
+ *  @param  nb_slots_log2   Log2 of the number of slots in the table
+ *  @param  slot            The slot to empty
+ *
+ *  @return void
+ */
+static void remove_slot(tid_slot_t *slots, unsigned int nb_slots_log2,
+                        tid_slot_t *slot) {
+
+  unsigned int mask = (1 << nb_slots_log2) - 1;
+  unsigned int hole = slot - slots;
+  unsigned int i = (hole + 1) & mask;
+
+  while (slots[i].value != NULL) {
+
+    // An entry may fill the hole if its home slot is not strictly between
+    // the hole and its current slot (cyclically)
+    unsigned int home = hash(slots[i].tid, nb_slots_log2);
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      slots[hole] = slots[i];
+      hole = i;
+    }
+
+    i = (i + 1) & mask;
+  }
+
+  slots[hole].value = NULL;
+}
+
+/** @brief  Replaces the current table by one twice as large, whose entries
+ *          will be moved progressively
+ *
+ *  If a resize is already in progress, it is completed first. If the new
+ *  table can not be allocated, the current one is kept.
+ *
+ *  @param  table   The table
+ *
+ *  @return void
+ */
+static void start_resize(tid_table_t *table) {
+
+  if (table->old_slots != NULL) {
+    migrate(table, table->old_nb_slots);
+  }
+
+  tid_slot_t *slots = calloc(table->nb_slots * 2, sizeof(tid_slot_t));
+  if (slots == NULL) {
+    lprintf("tid_table: Unable to grow table of %u slots", table->nb_slots);
+    return;
+  }
+
+  table->old_slots = table->slots;
+  table->old_nb_slots = table->nb_slots;
+  table->old_nb_slots_log2 = table->nb_slots_log2;
+  table->old_nb_entries = table->nb_entries;
+  table->migrate_index = 0;
+
+  table->slots = slots;
+  table->nb_slots *= 2;
+  ++table->nb_slots_log2;
+  table->nb_entries = 0;
+}
+
+/** @brief  Moves entries from the old table to the current one
+ *
+ *  The old table is freed once all its slots have been visited.
+ *
+ *  @param  table   The table
+ *  @param  nb      The maximum number of slots of the old table to visit
+ *
+ *  @return void
+ */
+static void migrate(tid_table_t *table, unsigned int nb) {
+
+  if (table->old_slots == NULL) {
+    return;
+  }
+
+  while (nb > 0 && table->migrate_index < table->old_nb_slots) {
+
+    tid_slot_t *slot = &table->old_slots[table->migrate_index];
+    if (slot->value != NULL && slot->value != TID_TABLE_DELETED) {
+      insert_slot(table->slots, table->nb_slots_log2, slot->tid, slot->value);
+      ++table->nb_entries;
+      --table->old_nb_entries;
+
+      // Keep the old table's probe sequences intact
+      slot->value = TID_TABLE_DELETED;
+    }
+
+    ++table->migrate_index;
+    --nb;
+  }
+
+  if (table->migrate_index == table->old_nb_slots) {
+    assert(table->old_nb_entries == 0);
+    free(table->old_slots);
+    table->old_slots = NULL;
+    table->old_nb_slots = 0;
+    table->old_nb_slots_log2 = 0;
+  }
+}
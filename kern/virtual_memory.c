@@ -11,6 +11,10 @@
 #include <loader.h>
 #include <page.h>
 #include <kernel_state.h>
+#include <scheduler.h>
+#include <ksm.h>
+#include <swap.h>
+#include <irq_trace.h>
 
 /* Standard library */
 #include <stdint.h>
@@ -32,9 +36,15 @@
 /* Hold the number of user frames in the system */
 unsigned int num_user_frames;
 
+/* Hold the number of user frames not backing anything */
+unsigned int num_unused_frames;
+
 /* Bitmap holding the set of (un)allocated frames */ 
 bitmap_t free_map;
 
+/* Static functions prototypes */
+static int is_page_writable(unsigned int *entry_addr);
+
 /** @brief  Initializes the virtual memory system
  *
  *  This function should be called once before any other function acting on
@@ -46,6 +56,7 @@ int vm_init() {
 
   // Figure out the number of user frames in the system
   num_user_frames = kernel.free_frame_count;
+  num_unused_frames = num_user_frames;
 
   int size = (kernel.free_frame_count / BITS_IN_UINT8_T) + 1;
 
@@ -95,6 +106,11 @@ unsigned int *setup_vm(const simple_elf_t *elf_info, int is_first_task) {
   kernel.current_thread->cr3 = (uint32_t)page_dir;
   set_cr3((uint32_t)page_dir);
 
+  // Let the same-page merging daemon and the swapper scan the new address
+  // space
+  ksm_register(page_dir);
+  swap_register(page_dir);
+
   return page_dir;
 }
 
@@ -197,17 +213,31 @@ int load_segment(const char *fname, unsigned long offset, unsigned long size,
                                       ? (PAGE_SIZE - temp_offset)
                                       : max_size;
 
-    // Fill in the section with appropriate data if needed
+    // Fill in the section with appropriate data if needed (the kernel runs
+    // with CR0.WP set, so read-only pages are made writable meanwhile)
+    unsigned int *page_table_entry_addr =
+        get_page_table_entry(get_page_dir_entry(addr), addr);
+    uint32_t entry = *page_table_entry_addr;
+    *page_table_entry_addr |= PAGE_WRITABLE;
+    invalidate_tlb(addr);
+
     if (type == SECTION_BSS) {
       memset((char*)addr, 0, size_allocated);
     } else if (type != SECTION_STACK && type != SECTION_BSS) {
       memcpy((char*)addr, buf + curr_offset, size_allocated);
     }
 
+    *page_table_entry_addr = entry;
+    invalidate_tlb(addr);
+
     // Update the remaining amount of bytes to allocate/copy
     remaining_size -= size_allocated;
     curr_offset += size_allocated;
     addr += size_allocated;
+
+    // The thread's cr3 points to the new address space, so it may be
+    // preempted here
+    preempt_point();
   }
 
   if (type != SECTION_STACK && type != SECTION_BSS) {
@@ -282,12 +312,8 @@ void *load_frame(unsigned int address, unsigned int type, unsigned int *cr3,
     
     if (type != SECTION_KERNEL) {
       
-      // Create flags for new entry depending on segment
-      unsigned int flags = (type == SECTION_RODATA || type == SECTION_TXT) ?
-                            PAGE_USER_RO_FLAGS : PAGE_USER_FLAGS;
-     
-      // Create page table entry
-      if (create_page_table_entry(page_table_entry, flags) == NULL) {
+      // Create page table entry (writable until the frame is zeroed out)
+      if (create_page_table_entry(page_table_entry, PAGE_USER_FLAGS) == NULL) {
         if (page_table_allocated) {
           sfree(get_page_table_addr(page_directory_entry_addr), PAGE_SIZE);
         }
@@ -303,6 +329,12 @@ void *load_frame(unsigned int address, unsigned int type, unsigned int *cr3,
       set_cr3((uint32_t)cr3);
       memset((char*)(address & ~FRAME_OFFSET_MASK), 0, PAGE_SIZE);
 
+      // Text and read-only data pages are not writable
+      if (type == SECTION_RODATA || type == SECTION_TXT) {
+        *page_table_entry &= ~PAGE_WRITABLE;
+        invalidate_tlb(address);
+      }
+
       // Reset the current's thread cr3
       kernel.current_thread->cr3 = (uint32_t)old_cr3;
       set_cr3(old_cr3);
@@ -346,6 +378,11 @@ int free_address_space(unsigned int *page_directory_addr,
   unsigned int nb_entries = PAGE_SIZE / SIZE_ENTRY_BYTES;
   unsigned int *page_directory_entry_addr;
   int something_remaining = 0;
+
+  // The same-page merging daemon and the swapper must not look at the
+  // address space anymore
+  ksm_unregister(page_directory_addr);
+  swap_unregister(page_directory_addr);
   
   // Iterate over the page directory entries
   for (page_directory_entry_addr = (page_directory_addr + 4);
@@ -364,6 +401,9 @@ int free_address_space(unsigned int *page_directory_addr,
       } else {
         something_remaining = 1;
       }
+
+      // Let a pending reschedule happen between two page tables
+      preempt_point();
     }
 
   }
@@ -414,8 +454,13 @@ int free_page_table(unsigned int * page_dir_entry_addr,
         continue;
       }
 
-      // Deallocate the frame if appropriate
-      if ((unsigned int)frame_addr >= USER_MEM_START) { 
+      // Deallocate the frame if appropriate (frames of shared memory segments
+      // are freed when the segment is destroyed, merged frames when their
+      // last mapping goes away)
+      if (is_page_merged(page_table_entry_addr)) {
+        ksm_put_frame((unsigned int)frame_addr);
+      } else if ((unsigned int)frame_addr >= USER_MEM_START && 
+          !is_page_shared(page_table_entry_addr)) { 
         // Free the frame
         if (free_frame(frame_addr) < 0) {
           panic("free_page_table(): Failed to free frame");
@@ -425,6 +470,10 @@ int free_page_table(unsigned int * page_dir_entry_addr,
       // Invalidate the entry
       set_entry_invalid(page_table_entry_addr, 
           get_virtual_address(page_dir_entry_addr, page_table_entry_addr));
+
+    } else if (is_page_swapped(page_table_entry_addr)) {
+      // Free the page's slot in the swap area
+      swap_drop_entry(page_table_entry_addr);
     }
   }
 
@@ -465,21 +514,38 @@ void free_frames_range(unsigned int address, unsigned int nb_frames) {
       unsigned int *page_table_entry_addr =
                         get_page_table_entry(page_dir_entry_addr, address);
 
-      if (is_entry_present(page_table_entry_addr)) {
+      // The same-page merging daemon may merge the page (and the swapper
+      // page it out) at any time
+      irq_disable();
+
+      if (is_entry_present(page_table_entry_addr) &&
+          !is_page_shared(page_table_entry_addr)) {
         
         // If the entry is present, free the frame
-        free_frame(get_frame_addr(page_table_entry_addr));
+        if (is_page_merged(page_table_entry_addr)) {
+          ksm_put_frame((unsigned int)get_frame_addr(page_table_entry_addr));
+        } else {
+          free_frame(get_frame_addr(page_table_entry_addr));
+        }
         
         // Invalidate the entry
         set_entry_invalid(page_table_entry_addr, address);
         
-      }      
+      } else if (is_page_swapped(page_table_entry_addr)) {
+        swap_drop_entry(page_table_entry_addr);
+      }
+
+      irq_enable();
     }
   }
 
 }
 
-/** @brief  Enables paging and the "Page Global Enable" bit in %cr4
+/** @brief  Enables paging, write protection of read-only pages in kernel mode
+ *          and the "Page Global Enable" bit in %cr4
+ *
+ *  Write protection lets the kernel catch its own writes to pages that are
+ *  shared copy-on-write (e.g. merged pages).
  *
  *  This function should only be called once before the first user-space frame
  *  is allocated. 
@@ -487,7 +553,7 @@ void free_frames_range(unsigned int address, unsigned int nb_frames) {
  *  @return void
  */
 void vm_enable() {
-  set_cr0(get_cr0() | PAGING_ENABLE_MASK);
+  set_cr0(get_cr0() | PAGING_ENABLE_MASK | WRITE_PROTECT_ENABLE_MASK);
   set_cr4(get_cr4() | PAGE_GLOBAL_ENABLE_MASK);
 }
 
@@ -528,15 +594,17 @@ int is_buffer_valid(unsigned int address, int len, int read_only) {
   unsigned int * page_table_entry_addr =
                         get_page_table_entry(page_dir_entry_addr, address);
 
-  // Check that the entry is valid 
-  if (!is_entry_present(page_table_entry_addr)) {
+  // Check that the entry is valid (pages in the swap area are paged back in
+  // on access)
+  if (!is_entry_present(page_table_entry_addr) &&
+      !is_page_swapped(page_table_entry_addr)) {
       return -1;
   }
 
   // Check for rw rights
-  if (read_only == READ_WRITE && !(*page_table_entry_addr & PAGE_WRITABLE)) {
+  if (read_only == READ_WRITE && !is_page_writable(page_table_entry_addr)) {
     return -1;
-  } else if(read_only == READ_ONLY && (*page_table_entry_addr & PAGE_WRITABLE)){
+  } else if(read_only == READ_ONLY && is_page_writable(page_table_entry_addr)){
     return -1;
   }
 
@@ -563,15 +631,16 @@ int is_buffer_valid(unsigned int address, int len, int read_only) {
     }
   
     // Check if the page table entry is valid
-    if (!is_entry_present(page_table_entry_addr)) {
+    if (!is_entry_present(page_table_entry_addr) &&
+        !is_page_swapped(page_table_entry_addr)) {
       return -1;
     }
 
     // Check for rw rights
-    if (read_only == READ_WRITE && !(*page_table_entry_addr & PAGE_WRITABLE)) {
+    if (read_only == READ_WRITE && !is_page_writable(page_table_entry_addr)) {
       return -1;
     } else if(read_only == READ_ONLY && 
-                  (*page_table_entry_addr & PAGE_WRITABLE)){
+                  is_page_writable(page_table_entry_addr)){
       return -1;
     }
 
@@ -585,6 +654,21 @@ int is_buffer_valid(unsigned int address, int len, int read_only) {
 
 }
 
+/** @brief  Checks whether a page is writable from user space
+ *
+ *  Merged pages and untouched pages from new_pages() are mapped read-only but
+ *  are private writable pages, the first write to such a page (from user
+ *  space or from the kernel) gives it its own frame.
+ *
+ *  @param  entry_addr  The page table entry's address
+ *
+ *  @return A non-zero value if the page is writable, 0 otherwise
+ */
+static int is_page_writable(unsigned int *entry_addr) {
+  return (*entry_addr & PAGE_WRITABLE) || is_page_merged(entry_addr) ||
+         is_page_requested(entry_addr);
+}
+
 /** @brief  Checks whether the string starting at a particular address
  *          lies withing the current task's address space
  *
@@ -607,8 +691,10 @@ int is_valid_string(char *addr) {
                                      page_directory_entry_addr,
                                      (unsigned int)addr);
 
-    // If there is no physical frame associated with this entry, return false
-    if (!is_entry_present(page_table_entry)) {
+    // If there is no physical frame associated with this entry (and the page
+    // is not in the swap area), return false
+    if (!is_entry_present(page_table_entry) &&
+        !is_page_swapped(page_table_entry)) {
       lprintf("page_table_entry_addr not present");
       return -1;
     }
@@ -11,6 +11,12 @@
 #include <common_kern.h>
 #include <cr.h>
 #include <kernel_state.h>
+#include <ksm.h>
+#include <swap.h>
+#include <atomic_ops.h>
+#include <asm.h>
+#include <eflags.h>
+#include <irq_trace.h>
 
 /* VM system */
 #include <virtual_memory.h>
@@ -23,9 +29,17 @@
 
 /* Hold the number of user frames in the system */
 extern unsigned int num_user_frames;
+/* Hold the number of user frames not backing anything */
+extern unsigned int num_unused_frames;
 /* Bitmap holding the set of (un)allocated frames */ 
 extern bitmap_t free_map;
 
+/* Page of kernel memory whose mapping is borrowed to access any frame */
+static char frame_window[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+/* Page table entry mapping the window when it is not borrowed */
+static unsigned int frame_window_entry;
+
 /** @brief  Checks if the given entry is valid (maps to something meaningful)
  *
  *  @param  The entry's address
@@ -47,6 +61,39 @@ int is_page_requested(unsigned int *addr) {
   return *addr & PAGE_TABLE_RESERVED_BIT;
 }
 
+/** @brief  Checks if the address of the page table entry passed maps a frame
+ *          belonging to a shared memory segment
+ *
+ *  @param  addr The address of the page table entry 
+ *
+ *  @return 0 if not shared, a non zero number otherwise
+ */
+int is_page_shared(unsigned int *addr) {
+  return *addr & PAGE_SHARED_BIT;
+}
+
+/** @brief  Checks if the address of the page table entry passed maps a frame
+ *          merged by the same-page merging daemon
+ *
+ *  @param  addr The address of the page table entry 
+ *
+ *  @return 0 if not merged, a non zero number otherwise
+ */
+int is_page_merged(unsigned int *addr) {
+  return *addr & PAGE_MERGED_BIT;
+}
+
+/** @brief  Checks if the address of the page table entry passed maps a page
+ *          whose content was paged out to the swap area
+ *
+ *  @param  addr The address of the page table entry 
+ *
+ *  @return 0 if not swapped, a non zero number otherwise
+ */
+int is_page_swapped(unsigned int *addr) {
+  return !(*addr & PRESENT_BIT) && (*addr & PAGE_SWAPPED_BIT);
+}
+
 /** @brief  Invalidates an entry in a page directory or page stable
  *
  *  The function also takes care of invalidating the entry in the TLB.
@@ -58,6 +105,9 @@ int is_page_requested(unsigned int *addr) {
 void set_entry_invalid(unsigned int *entry_addr, unsigned int address) {
   *entry_addr &= ~PRESENT_BIT;
   *entry_addr &= ~PAGE_TABLE_RESERVED_BIT;
+  *entry_addr &= ~PAGE_SHARED_BIT;
+  *entry_addr &= ~PAGE_MERGED_BIT;
+  *entry_addr &= ~PAGE_SWAPPED_BIT;
   invalidate_tlb(address);
 }
 
@@ -226,17 +276,37 @@ unsigned int get_virtual_address(unsigned int *page_directory_entry_addr,
 }
 
 /** @brief  Finds and allocates a free frame in memory
+ *
+ *  The swapper is woken up when frames run low. When no frame is left, the
+ *  invoking thread waits for the swapper to page some memory out, unless
+ *  interrupts are disabled.
  *
  *  @return The frame's address if one free frame was found, NULL otherwise
  */
 unsigned int *allocate_frame() {
-  int i;
-  for (i = 0; i < num_user_frames; i++) {
-    if (set_bit(&free_map, i) >= 0) {
-      return (void *)(USER_MEM_START + (i * PAGE_SIZE));
+  while (1) {
+    int i;
+    for (i = 0; i < num_user_frames; i++) {
+      if (set_bit(&free_map, i) >= 0) {
+        if (atomic_add_and_update(&num_unused_frames, -1) <=
+            SWAP_LOW_FRAMES) {
+          swap_wake();
+        }
+        return (void *)(USER_MEM_START + (i * PAGE_SIZE));
+      }
+    }
+
+    if (!(get_eflags() & EFL_IF)) {
+      return NULL;
+    }
+
+    irq_disable();
+    int ret = swap_wait_for_frames(SWAP_WAIT_STALLED_FALSE);
+    irq_enable();
+    if (ret < 0) {
+      return NULL;
     }
   }
-  return NULL;
 }
 
 /** @brief  Frees an allocated frame from memory. Only changes the free frame
@@ -254,16 +324,53 @@ int free_frame(unsigned int* addr) {
   if ((unsigned int)addr == kernel.zeroed_out_frame) {
     return 0;
   }
-  int frame_index = ((unsigned int)(addr) - USER_MEM_START) / PAGE_SIZE;
-  unset_bit(&free_map, frame_index);
+  free_frame_keep_reservation(addr);
   release_frames(1);
   return 0;
 }
 
+/** @brief  Frees an allocated frame from memory without releasing the frame
+ *          reservation it was allocated for
+ *
+ *  Used when the content of a page moves to the swap area, the page keeps
+ *  its reservation.
+ *
+ *  @param  addr The frame's address
+ *
+ *  @return void
+ */
+void free_frame_keep_reservation(unsigned int *addr) {
+  int frame_index = ((unsigned int)(addr) - USER_MEM_START) / PAGE_SIZE;
+  unset_bit(&free_map, frame_index);
+  atomic_add_and_update(&num_unused_frames, 1);
+}
+
+/** @brief  Gets the number of user frames in the system
+ *
+ *  @return The number of user frames
+ */
+unsigned int get_user_frame_count() {
+  return num_user_frames;
+}
+
+/** @brief  Gets the number of user frames that do not back anything
+ *
+ *  Unlike kernel.free_frame_count, which counts the frames that are not
+ *  reserved, this counts the frames that are not allocated.
+ *
+ *  @return The number of unused frames
+ */
+unsigned int get_unused_frame_count() {
+  return num_unused_frames;
+}
+
 /** @brief  Marks the page table entry for virtual address passed as parameter
  *          as requested by new_pages so that we can differentiate between a 
  *          valid and invalid page fault in the page fault handler
  *
+ *  The page is mapped present and read-only on the zeroed out frame, so reads
+ *  never fault and a private frame is only allocated on the first write.
+ *
  *  @param  address The virtual address to be marked as requested
  *
  *  @return 0 on success, a negative number if the address is already allocated
@@ -282,7 +389,8 @@ int mark_address_requested(unsigned int address) {
   unsigned int *page_table_entry_addr =
       get_page_table_entry(page_directory_entry_addr, address);
 
-  if (is_entry_present(page_table_entry_addr)) {
+  if (is_entry_present(page_table_entry_addr) ||
+      is_page_swapped(page_table_entry_addr)) {
     // new_pages on an already allocated memory
     lprintf("mark_address_requested(): Entry already present");
     return -1;
@@ -323,6 +431,9 @@ int mark_address_range_requested(unsigned int address, unsigned int count) {
  *          for through new_pages or not. If yes, a new frame is allocated and
  *          0 is returned. Otherwise, a negative value is returned 
  *
+ *  Requested pages are present, so only a write to them can fault. The frame
+ *  comes out of the reservation made by new_pages().
+ *
  *  @param  address The virtual address for which we need to find if a frame is
  *                  allocated or not
  *
@@ -360,3 +471,220 @@ int allocate_frame_if_address_requested(unsigned int address) {
 
   return 0;
 }
+
+/** @brief  Maps a frame of a shared memory segment at a given virtual address
+ *          in the current address space
+ *
+ *  The page table entry is marked as shared so that the frame is neither 
+ *  freed when the address space is destroyed nor copied on fork().
+ *
+ *  @param  address   The page-aligned virtual address
+ *  @param  frame     The frame's physical address
+ *  @param  writable  Whether the task may write to the page
+ *
+ *  @return 0 on success, a negative number if the address is already mapped
+ *          or if a page table could not be allocated
+ */
+int map_shared_frame(unsigned int address, unsigned int frame,
+                     int writable) {
+
+  if (address < USER_MEM_START) {
+    return -1;
+  }
+
+  unsigned int *page_directory_entry_addr = get_page_dir_entry(address);
+  if (!is_entry_present(page_directory_entry_addr)) {
+    if (!create_page_table(page_directory_entry_addr, 
+        DIRECTORY_FLAGS, FIRST_TASK_FALSE)) {
+      return -1;
+    }
+  }
+
+  unsigned int *page_table_entry_addr =
+      get_page_table_entry(page_directory_entry_addr, address);
+
+  if (is_entry_present(page_table_entry_addr) ||
+      is_page_swapped(page_table_entry_addr)) {
+    lprintf("map_shared_frame(): Entry already present");
+    return -1;
+  }
+
+  *page_table_entry_addr = (frame & PAGE_ADDR_MASK);
+  *page_table_entry_addr |= PAGE_SHARED_BIT;
+  *page_table_entry_addr |= writable ? PAGE_USER_FLAGS : PAGE_USER_RO_FLAGS;
+  invalidate_tlb(address);
+
+  return 0;
+}
+
+/** @brief  Unmaps a frame of a shared memory segment from the current address
+ *          space, the frame itself is not freed
+ *
+ *  @param  address The page-aligned virtual address
+ *
+ *  @return void
+ */
+void unmap_shared_frame(unsigned int address) {
+
+  unsigned int *page_directory_entry_addr = get_page_dir_entry(address);
+  if (!is_entry_present(page_directory_entry_addr)) {
+    return;
+  }
+
+  unsigned int *page_table_entry_addr =
+      get_page_table_entry(page_directory_entry_addr, address);
+
+  if (is_entry_present(page_table_entry_addr) &&
+      is_page_shared(page_table_entry_addr)) {
+    set_entry_invalid(page_table_entry_addr, address);
+  }
+}
+
+/** @brief  Gets the page table entry of a page whose frame may be moved out
+ *          of (or into) the current address space
+ *
+ *  A frame can be moved out of a page if the page is a private, writable,
+ *  user page backed by its own frame. A frame can be moved into a page if
+ *  the page is a private, writable, user page, a page requested by
+ *  new_pages() that was never written to, a page merged by the same-page
+ *  merging daemon or a writable page paged out to the swap area.
+ *
+ *  @param  address   The page-aligned virtual address
+ *  @param  receiving MOVE_PAGE_IN if a frame should be moved into the page,
+ *                    MOVE_PAGE_OUT if the page's frame should be moved out
+ *
+ *  @return The page table entry's address if the page is eligible, NULL
+ *          otherwise
+ */
+unsigned int *get_movable_page_entry(unsigned int address, int receiving) {
+
+  if (address < USER_MEM_START) {
+    return NULL;
+  }
+
+  unsigned int *page_directory_entry_addr = get_page_dir_entry(address);
+  if (!is_entry_present(page_directory_entry_addr)) {
+    return NULL;
+  }
+
+  unsigned int *page_table_entry_addr =
+      get_page_table_entry(page_directory_entry_addr, address);
+
+  if (is_page_swapped(page_table_entry_addr)) {
+    // The page's content is in the swap area, it is not lost unless a frame
+    // replaces it
+    return (receiving == MOVE_PAGE_IN &&
+            (*page_table_entry_addr & PAGE_WRITABLE)) ?
+           page_table_entry_addr : NULL;
+  }
+
+  if (!is_entry_present(page_table_entry_addr) ||
+      is_page_shared(page_table_entry_addr)) {
+    return NULL;
+  }
+
+  if (is_page_requested(page_table_entry_addr) ||
+      is_page_merged(page_table_entry_addr)) {
+    // The page's frame is not its own (the zeroed out frame or a merged one)
+    return (receiving == MOVE_PAGE_IN) ? page_table_entry_addr : NULL;
+  }
+
+  unsigned int user_flags = PAGE_USER_FLAGS;
+  if ((*page_table_entry_addr & user_flags) != user_flags ||
+      (unsigned int)get_frame_addr(page_table_entry_addr) < USER_MEM_START) {
+    return NULL;
+  }
+
+  return page_table_entry_addr;
+}
+
+/** @brief  Removes the frame backing a page from the current address space
+ *
+ *  The page is not freed, it is mapped back to the zeroed out frame as if it
+ *  had just been requested with new_pages(), so that its frame reservation
+ *  stays with the task.
+ *
+ *  @param  entry_addr  An entry returned by get_movable_page_entry() with
+ *                      MOVE_PAGE_OUT
+ *  @param  address     The page's virtual address
+ *
+ *  @return The frame's physical address
+ */
+unsigned int detach_user_frame(unsigned int *entry_addr, unsigned int address) {
+
+  unsigned int frame = (unsigned int)get_frame_addr(entry_addr);
+
+  *entry_addr = (kernel.zeroed_out_frame & PAGE_ADDR_MASK);
+  *entry_addr |= PAGE_TABLE_RESERVED_BIT;
+  *entry_addr |= PAGE_USER_RO_FLAGS;
+  invalidate_tlb(address);
+
+  return frame;
+}
+
+/** @brief  Maps a frame at a page of the current address space, freeing the
+ *          frame previously backing the page
+ *
+ *  @param  entry_addr  An entry returned by get_movable_page_entry() with
+ *                      MOVE_PAGE_IN
+ *  @param  address     The page's virtual address
+ *  @param  frame       The frame's physical address
+ *
+ *  @return void
+ */
+void attach_user_frame(unsigned int *entry_addr, unsigned int address,
+                       unsigned int frame) {
+
+  // The zeroed out frame is never freed, merged frames are freed when their
+  // last mapping goes away
+  if (is_page_swapped(entry_addr)) {
+    swap_drop_entry(entry_addr);
+  } else if (is_page_merged(entry_addr)) {
+    ksm_put_frame((unsigned int)get_frame_addr(entry_addr));
+  } else {
+    free_frame(get_frame_addr(entry_addr));
+  }
+
+  *entry_addr = (frame & PAGE_ADDR_MASK);
+  *entry_addr |= PAGE_USER_FLAGS;
+  invalidate_tlb(address);
+}
+
+/** @brief  Maps a frame in the kernel's frame window
+ *
+ *  User frames are not direct-mapped, the window gives the kernel access to
+ *  a frame that is not mapped in the current address space. Only one frame
+ *  can be mapped at a time, the function must be called with interrupts
+ *  disabled and unmap_frame_window() must be called before enabling them.
+ *
+ *  @param  frame The frame's physical address
+ *
+ *  @return The virtual address at which the frame is mapped
+ */
+char *map_frame_window(unsigned int frame) {
+
+  unsigned int address = (unsigned int)frame_window;
+  unsigned int *page_table_entry_addr =
+      get_page_table_entry(get_page_dir_entry(address), address);
+
+  frame_window_entry = *page_table_entry_addr;
+  *page_table_entry_addr = (frame & PAGE_ADDR_MASK) | PRESENT_BIT |
+                           PAGE_WRITABLE;
+  invalidate_tlb(address);
+
+  return frame_window;
+}
+
+/** @brief  Maps the kernel's frame window back to its own frame
+ *
+ *  @return void
+ */
+void unmap_frame_window() {
+
+  unsigned int address = (unsigned int)frame_window;
+  unsigned int *page_table_entry_addr =
+      get_page_table_entry(get_page_dir_entry(address), address);
+
+  *page_table_entry_addr = frame_window_entry;
+  invalidate_tlb(address);
+}
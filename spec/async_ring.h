@@ -0,0 +1,54 @@
+/** @file async_ring.h
+ *  @brief  Layout of the submission/completion ring shared between a task
+ *          and the kernel by the ring_setup() and ring_enter() system calls
+ *
+ *  The task writes requests in the submission queue (sq) at sq_tail and then
+ *  advances sq_tail, the kernel consumes them at sq_head on the next call to
+ *  ring_enter(). The kernel writes the result of each request in the
+ *  completion queue (cq) at cq_tail, the task consumes completions at cq_head.
+ *  Indices grow forever and are taken modulo ASYNC_RING_ENTRIES. A request
+ *  is only consumed if there is room for its completion, so the completion
+ *  queue never overflows.
+ *
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _ASYNC_RING_H_
+#define _ASYNC_RING_H_
+
+/* Number of entries in each queue (the ring fits in a page) */
+#define ASYNC_RING_ENTRIES 64
+
+/* Operations, the fields each one uses are given in parentheses */
+#define ASYNC_OP_PRINT 0      /* print(len, buf) */
+#define ASYNC_OP_READFILE 1   /* readfile(name, buf, len, offset) */
+#define ASYNC_OP_SLEEP 2      /* sleep(len) */
+#define ASYNC_OP_WAIT 3       /* wait((int *)buf) */
+
+/** @brief  A request in the submission queue */
+typedef struct async_sqe {
+  int op;                   /* One of the ASYNC_OP_* operations */
+  int len;                  /* Length of buf, or number of ticks to sleep */
+  char *buf;                /* Buffer to print or to read into */
+  char *name;               /* Name of the file to read */
+  int offset;               /* Offset in the file to read */
+  unsigned int user_data;   /* Copied as is in the request's completion */
+} async_sqe_t;
+
+/** @brief  A completion in the completion queue */
+typedef struct async_cqe {
+  unsigned int user_data;   /* The request's user_data */
+  int result;               /* What the matching system call returns */
+} async_cqe_t;
+
+/** @brief  The ring, mapped in the task's address space */
+typedef struct async_ring {
+  unsigned int sq_head;     /* Next request the kernel consumes */
+  unsigned int sq_tail;     /* Next free request, advanced by the task */
+  unsigned int cq_head;     /* Next completion, advanced by the task */
+  unsigned int cq_tail;     /* Next free completion */
+  async_sqe_t sq[ASYNC_RING_ENTRIES];
+  async_cqe_t cq[ASYNC_RING_ENTRIES];
+} async_ring_t;
+
+#endif /* _ASYNC_RING_H_ */
@@ -0,0 +1,16 @@
+/** @file irq_trace_entry.h
+ *  @brief  Entry returned by the get_irq_trace() system call
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _IRQ_TRACE_ENTRY_H_
+#define _IRQ_TRACE_ENTRY_H_
+
+/** @brief  An interval during which the kernel ran with interrupts disabled */
+typedef struct irq_trace_entry {
+  unsigned int cycles;  /* Length of the interval, in TSC cycles */
+  void *start_site;     /* Address where interrupts were disabled */
+  void *stop_site;      /* Address where interrupts were enabled */
+} irq_trace_entry_t;
+
+#endif /* _IRQ_TRACE_ENTRY_H_ */
@@ -0,0 +1,19 @@
+/** @file swap_stats.h
+ *  @brief  Statistics returned by the get_swap_stats() system call
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _SWAP_STATS_H_
+#define _SWAP_STATS_H_
+
+/** @brief  Usage of physical memory and of the swap area */
+typedef struct swap_stats {
+  unsigned int total_frames;  /* Frames of physical memory for user pages */
+  unsigned int free_frames;   /* Frames not backing anything */
+  unsigned int total_slots;   /* Pages the swap area holds, 0 without swap */
+  unsigned int free_slots;    /* Slots of the swap area not in use */
+  unsigned int swap_ins;      /* Pages read back from the swap area */
+  unsigned int swap_outs;     /* Pages written to the swap area */
+} swap_stats_t;
+
+#endif /* _SWAP_STATS_H_ */
@@ -21,17 +21,57 @@ void vanish(void) NORETURN;
 int wait(int *status_ptr);
 void task_vanish(int status) NORETURN;
 
+/* Multi-event wait */
+#include <wait_any_events.h> /* may be directly included by kernel guts */
+int wait_any(int *events, int n, int timeout_ticks);
+
 /* Thread management */
 int gettid(void);
 int yield(int pid);
 int deschedule(int *flag);
 int make_runnable(int pid);
+int make_runnable_many(int *tids, int count);
 unsigned int get_ticks(void);
 int sleep(int ticks);
+int set_weight(int tid, int weight);
+
+/* Interrupts-off latency tracer */
+#include <irq_trace_entry.h> /* may be directly included by kernel guts */
+int get_irq_trace(irq_trace_entry_t *entries, int count);
 
 /* Memory management */
 int new_pages(void * addr, int len);
 int remove_pages(void * addr);
+#include <swap_stats.h> /* may be directly included by kernel guts */
+int get_swap_stats(swap_stats_t *stats);
+
+/* Shared memory */
+int shm_create(char *name, void *base, int len);
+int shm_attach(char *name, void *base);
+int shm_detach(void *base);
+
+/* Message queues */
+int mq_create(int capacity);
+int mq_destroy(int id);
+int mq_send(int id, void *buf, int len);
+int mq_recv(int id, void *buf, int len);
+
+/* RAM filesystem */
+#define FS_READ   0x1 /* Open for reading */
+#define FS_WRITE  0x2 /* Open for writing */
+#define FS_CREATE 0x4 /* Create the file if it does not exist */
+#define FS_APPEND 0x8 /* Every write appends to the file */
+int open(char *name, int flags);
+int read(int fd, void *buf, int count);
+int write(int fd, void *buf, int count);
+int close(int fd);
+int unlink(char *name);
+int fmap(int fd, void *base);
+
+/* Asynchronous system calls */
+#include <async_ring.h> /* may be directly included by kernel guts */
+int ring_setup(void *base);
+int ring_enter(int min_complete);
 
 /* Console I/O */
 int getchar(void);
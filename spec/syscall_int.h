@@ -65,4 +65,29 @@
 #define SYSCALL_RESERVED_15       0x8F
 #define SYSCALL_RESERVED_END      0x8F
 
+/* Extensions to the spec, using the reserved syscall numbers */
+#define SET_WEIGHT_INT      SYSCALL_RESERVED_0
+#define GET_IRQ_TRACE_INT   SYSCALL_RESERVED_1
+#define SHM_CREATE_INT      SYSCALL_RESERVED_2
+#define SHM_ATTACH_INT      SYSCALL_RESERVED_3
+#define SHM_DETACH_INT      SYSCALL_RESERVED_4
+#define MQ_CREATE_INT       SYSCALL_RESERVED_5
+#define MQ_DESTROY_INT      SYSCALL_RESERVED_6
+#define MQ_SEND_INT         SYSCALL_RESERVED_7
+#define MQ_RECV_INT         SYSCALL_RESERVED_8
+#define MAKE_RUNNABLE_MANY_INT SYSCALL_RESERVED_9
+#define OPEN_INT            SYSCALL_RESERVED_10
+#define READ_INT            SYSCALL_RESERVED_11
+#define WRITE_INT           SYSCALL_RESERVED_12
+#define CLOSE_INT           SYSCALL_RESERVED_13
+#define UNLINK_INT          SYSCALL_RESERVED_14
+#define FMAP_INT            SYSCALL_RESERVED_15
+
+/* Extensions past the reserved syscall numbers (the IDT has no other use for
+ * these entries) */
+#define GET_SWAP_STATS_INT  0x90
+#define RING_SETUP_INT      0x91
+#define RING_ENTER_INT      0x92
+#define WAIT_ANY_INT        0x93
+
 #endif /* _SYSCALL_INT_H */
@@ -0,0 +1,12 @@
+/** @file wait_any_events.h
+ *  @brief  Events the wait_any() system call waits for
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _WAIT_ANY_EVENTS_H_
+#define _WAIT_ANY_EVENTS_H_
+
+#define EVENT_CHILD 0 /* wait() would not block */
+#define EVENT_LINE  1 /* readline() would not wait for input */
+
+#endif /* _WAIT_ANY_EVENTS_H_ */
@@ -6,9 +6,27 @@
 #ifndef _COND_TYPE_H
 #define _COND_TYPE_H
 
-#include <queue.h>
 #include <mutex_type.h>
 
+/** @brief A thread waiting on a condition variable, stored on the thread's
+ *   stack
+ */
+typedef struct cond_waiter {
+
+  /** @brief The thread's kernel issued tid
+   */
+  int tid;
+
+  /** @brief Passed to deschedule(), set when the thread is signaled
+   */
+  volatile int reject;
+
+  /** @brief Next waiter in the condition variable's list
+   */
+  struct cond_waiter *next;
+
+} cond_waiter_t;
+
 /** A structure of a condition variable
  */
 typedef struct cond {
@@ -19,10 +37,19 @@ typedef struct cond {
    */
   int init;
 
-  /** @brief A generic_queue_t type member which is used to store the
-   *   the TIDs of all the thread waiting for this condition variable
+  /** @brief Spinlock protecting the list of waiters
+   */
+  int guard;
+
+  /** @brief The threads waiting for this condition variable, in the order
+   *   they called cond_wait()
    */
-  generic_queue_t waiting_queue;
+  cond_waiter_t *head;
+
+  /** @brief The last element of the list of waiters
+   */
+  cond_waiter_t *tail;
+
 } cond_t;
 
 #endif /* _COND_TYPE_H */
@@ -11,6 +11,8 @@
 #include <cond_type.h>
 #include <syscall.h>
 #include <hash_table.h>
+#include <queue.h>
+#include <malloc_cache.h>
 
 /** @brief State of a thread which means that a thread has joined this thread
  */
@@ -75,6 +77,13 @@ typedef struct tcb {
    */
   mutex_t mutex_state;
 
+  /*------------------------------*/
+
+  /** @brief Free blocks cached by malloc for this thread, only used by the
+   *   thread itself
+   */
+  malloc_cache_t malloc_cache;
+
 } tcb_t;
 
 /** @brief A structure that represents a task
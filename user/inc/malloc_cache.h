@@ -0,0 +1,38 @@
+/** @file malloc_cache.h
+ *  @brief This file defines the type for the per-thread caches of the thread
+ *         safe malloc
+ *  @author akanjani, lramire1
+ */
+
+#ifndef _MALLOC_CACHE_H
+#define _MALLOC_CACHE_H
+
+/** @brief Number of size classes served from the per-thread caches
+ */
+#define MALLOC_NB_CLASSES 8
+
+struct free_block;
+
+/** @brief A thread's cache of free blocks, one list per size class
+ */
+typedef struct malloc_cache {
+
+  /** @brief Whether the cache can be used, it is disabled once its thread
+   *   starts exiting
+   */
+  int active;
+
+  /** @brief Heads of the lists of free blocks
+   */
+  struct free_block *heads[MALLOC_NB_CLASSES];
+
+  /** @brief Number of blocks in each list
+   */
+  int counts[MALLOC_NB_CLASSES];
+
+} malloc_cache_t;
+
+void malloc_cache_init(malloc_cache_t *cache);
+void malloc_cache_release(void);
+
+#endif /* _MALLOC_CACHE_H */
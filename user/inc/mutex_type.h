@@ -6,13 +6,35 @@
 #ifndef _MUTEX_TYPE_H
 #define _MUTEX_TYPE_H
 
+/** @brief A thread blocked on a mutex, stored on the thread's stack
+ */
+typedef struct mutex_waiter {
+
+  /** @brief The ticket the thread is waiting for
+   */
+  int ticket;
+
+  /** @brief The thread's kernel issued tid
+   */
+  int tid;
+
+  /** @brief Passed to deschedule(), set when the thread's turn has come
+   */
+  volatile int reject;
+
+  /** @brief Next waiter in the mutex's list
+   */
+  struct mutex_waiter *next;
+
+} mutex_waiter_t;
+
 /** @brief The structure of a mutex
  */
 typedef struct mutex {
 
   /** @brief An int which stores the ticket number of the thread which ran last
    */ 
-  int prev;
+  volatile int prev;
 
   /** @brief An int which stores the ticket number which should be given to the
    *   next thread which tries to acquire this lock 
@@ -22,6 +44,20 @@ typedef struct mutex {
   /** @brief An int which stores whether the miutex has been initialized or not
    */
   int init;
+
+  /** @brief Number of times a thread checks the mutex before blocking, adapted
+   *   to how often spinning paid off
+   */
+  int spin;
+
+  /** @brief Spinlock protecting the list of waiters
+   */
+  int guard;
+
+  /** @brief Threads blocked (or about to block) on the mutex
+   */
+  mutex_waiter_t *waiters;
+
 } mutex_t;
 
 #endif /* _MUTEX_TYPE_H */
@@ -13,32 +13,18 @@
  */
 typedef struct rwlock {
 
-  /** @brief An int storing the number of threads waiting to acquire the
-   *   read lock
+  /** @brief The packed state of the lock, only modified with atomic adds.
+   *   The low RWLOCK_READERS_BITS bits count the readers holding (or trying
+   *   to take) the lock, the remaining bits count the writers holding or
+   *   waiting for the lock. A reader gets the lock with a single atomic add
+   *   as long as the writers count is zero
    */
-  int waiting_readers;
+  int state;
 
-  /** @brief An int storing the number of threads which currently have the
-   *   read lock
+  /** @brief An int which is 1 when a writer holds the lock, 0 otherwise.
+   *   Protected by lock
    */
-  int active_readers;
-
-  /** @brief An int storing the number of threads waiting to acquire the
-   *   write lock
-   */
-  int waiting_writers;
-
-  /** @brief An int storing the number of threads which currently have the
-   *   write lock
-   */
-  int active_writers;
-
-  /** @brief An int storing the current operation being performed by threads 
-   *   holding this lock. It can be RWLOCK_READ when they are reading,
-   *   RWLOCK_WRITE when they are writing or RWLOCK_INVALID if no lock has 
-   *   been acquired yet 
-   */
-  int curr_op;
+  volatile int writer_active;
 
   /** @brief An int which stores the current state of the rwlock. It can be
    *   RWLOCK_INITIALIZED when the lock has been initialized, or 
@@ -46,8 +32,8 @@ typedef struct rwlock {
    */
   int init;
 
-  /** @brief A mutex for this read write lock to ensure atomicity and mutual
-   *   exclusion amongst the various rwlock functions
+  /** @brief A mutex protecting the slow paths, taken only when a writer is
+   *   involved
    */ 
   mutex_t lock;
 
@@ -8,8 +8,10 @@
  */
 
 #include <assert.h>
+#include <atomic_ops.h>
 #include <cond.h>
 #include <mutex.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <syscall.h>
 #include <thr_internals.h>
@@ -25,10 +27,14 @@
  */
 #define CVAR_UNINITIALIZED 0
 
-/** @brief The parameter to deschedule to put a thread from the running queu to
- *   the waiting queue of the scheduler.
+/** @brief Maximum number of threads woken up by one make_runnable_many() call
+ *   in cond_broadcast()
  */
-#define DONT_RUN 0
+#define CVAR_WAKE_BATCH 64
+
+static void guard_lock(cond_t *cv);
+static void guard_unlock(cond_t *cv);
+static void wake_waiters(cond_waiter_t *waiters);
 
 /** @brief Initializes a condition variable
  *
@@ -51,8 +57,10 @@ int cond_init(cond_t *cv) {
   // Initialize the cvar state
   cv->init = CVAR_INITIALIZED;
 
-  // Initialize the waiting queue
-  queue_init(&cv->waiting_queue);
+  // Initialize the list of waiters
+  cv->guard = 0;
+  cv->head = NULL;
+  cv->tail = NULL;
 
   return 0;
 }
@@ -78,7 +86,7 @@ void cond_destroy(cond_t *cv) {
   assert(cv->init == CVAR_INITIALIZED);
 
   // Illegal Operation. Destroy on a cvar for which thread(s) are waiting for
-  assert(is_queue_empty(&cv->waiting_queue) == 1);
+  assert(cv->head == NULL);
 
   // Reset the state
   cv->init = CVAR_UNINITIALIZED;
@@ -105,15 +113,36 @@ void cond_wait(cond_t *cv, mutex_t *mp) {
   // Illegal Operation. cond_wait on an uninitialized cvar
   assert(cv->init == CVAR_INITIALIZED);
 
-  // Add this thread to the waiting queue of this condition variable
-  queue_insert_node(&cv->waiting_queue, (void *)thr_get_my_kernel_id());
+  cond_waiter_t me;
+  me.tid = thr_get_my_kernel_id();
+  me.reject = 0;
+  me.next = NULL;
+
+  // Add this thread to the list of waiters before releasing the mutex, so
+  // that a signal sent after that is not missed
+  guard_lock(cv);
+  if (cv->tail == NULL) {
+    cv->head = &me;
+  } else {
+    cv->tail->next = &me;
+  }
+  cv->tail = &me;
+  guard_unlock(cv);
 
   // Release the mutex so that other threads can run now
   mutex_unlock(mp);
 
-  // Tell the scheduler to not run this thread
-  int dont_run = DONT_RUN;
-  deschedule(&dont_run);
+  // The signaling thread sets our reject flag before calling make_runnable(),
+  // so we do not block if it was faster than us
+  while (!me.reject) {
+    deschedule((int *)&me.reject);
+  }
+
+  // The signaling thread may still be about to call make_runnable() on us,
+  // wait for it to be done so that the wake up does not end another
+  // deschedule()
+  guard_lock(cv);
+  guard_unlock(cv);
 
   // Take the mutex before leaving cvar_wait
   mutex_lock(mp);
@@ -134,19 +163,20 @@ void cond_signal(cond_t *cv) {
   // Illegal operation. cond_signal on an uninitialized cvar
   assert(cv->init == CVAR_INITIALIZED);
 
-  // Pop the head element from the queue
-  void *tid = queue_delete_node(&cv->waiting_queue);
+  guard_lock(cv);
 
-  // Check that the queue was not empty
-  if (tid != NULL) {
-
-    // Start the thread which was just dequed from the waiting queue
-    while (make_runnable((int)tid) < 0) {
-      // The thread hasn't descheduled yet. Yield to it so that it can
-      // deschedule
-      yield((int)tid);
+  // Pop the head element from the list
+  cond_waiter_t *waiter = cv->head;
+  if (waiter != NULL) {
+    cv->head = waiter->next;
+    if (cv->head == NULL) {
+      cv->tail = NULL;
     }
+    waiter->next = NULL;
+    wake_waiters(waiter);
   }
+
+  guard_unlock(cv);
 }
 
 /** @brief Wakes up all threads waiting on the condition variable pointed to
@@ -164,14 +194,70 @@ void cond_broadcast(cond_t *cv) {
   // Illegal operation. cond_broadcast on an uninitialized cvar
   assert(cv->init == CVAR_INITIALIZED);
 
-  void* tid = NULL;
+  guard_lock(cv);
+
+  // Take the whole list of waiters at once
+  cond_waiter_t *waiters = cv->head;
+  cv->head = NULL;
+  cv->tail = NULL;
+  wake_waiters(waiters);
 
-  // Loop through the whole waiting queue
-  while ((tid = queue_delete_node(&cv->waiting_queue)) != NULL) {
-    while (make_runnable((int)tid) < 0) {
-      // The thread hasn't descheduled yet. Yield to it so that it can
-      // deschedule
-      yield((int)(tid));
+  guard_unlock(cv);
+}
+
+/** @brief Wakes up a list of waiters
+ *
+ *  The reject flag of each waiter is set so that a thread which hasn't called
+ *  deschedule() yet does not block, and the ones already descheduled are made
+ *  runnable with as few system calls as possible. The caller holds the
+ *  condition variable's guard, which prevents the waiters from leaving
+ *  cond_wait() (and their list element from going away) until it is released.
+ *
+ *  @param waiters The first waiter of a NULL terminated list
+ *
+ *  @return void
+ */
+static void wake_waiters(cond_waiter_t *waiters) {
+
+  int tids[CVAR_WAKE_BATCH];
+  int nb_tids = 0;
+
+  while (waiters != NULL) {
+    tids[nb_tids++] = waiters->tid;
+    waiters->reject = 1;
+    waiters = waiters->next;
+
+    if (nb_tids == CVAR_WAKE_BATCH || waiters == NULL) {
+      if (nb_tids == 1) {
+        make_runnable(tids[0]);
+      } else {
+        make_runnable_many(tids, nb_tids);
+      }
+      nb_tids = 0;
     }
   }
 }
+
+/** @brief Acquires the spinlock protecting a condition variable's list of
+ *   waiters
+ *
+ *  @param cv The condition variable
+ *
+ *  @return void
+ */
+static void guard_lock(cond_t *cv) {
+  while (atomic_exchange(&cv->guard, 1) != 0) {
+    yield(-1);
+  }
+}
+
+/** @brief Releases the spinlock protecting a condition variable's list of
+ *   waiters
+ *
+ *  @param cv The condition variable
+ *
+ *  @return void
+ */
+static void guard_unlock(cond_t *cv) {
+  atomic_exchange(&cv->guard, 0);
+}
@@ -1,13 +1,29 @@
 /** @file malloc.c
  *  @brief This file contains the definitions for thread safe malloc functions
+ *
+ *  Small requests are served from per-thread caches of free blocks, one list
+ *  per size class (16 to 2048 bytes, headers included), so that most calls
+ *  do not take any lock. A cache is refilled from (and overflows into) a
+ *  shared list per size class by batches of blocks. The shared lists are
+ *  themselves refilled by carving slabs allocated from the underlying heap,
+ *  which grows through new_pages(). Larger requests go straight to the
+ *  underlying heap, which is protected by a single mutex.
+ *
+ *  Small blocks are never given back to the underlying heap, they stay in
+ *  the shared lists once their thread has exited.
+ *
  *  @author akanjani, lramire1
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <types.h>
 #include <stddef.h>
 #include <mutex.h>
 #include <atomic_ops.h>
+#include <syscall.h>
+#include <global_state.h>
+#include <thr_internals.h>
 
 /** @brief A macro for 0 being treated as FALSE
  */
@@ -17,14 +33,141 @@
  */
 #define TRUE 1
 
-/** @brief State of the mutex
+/** @brief Size of the smallest class (log2), headers included
+ */
+#define MIN_CLASS_SHIFT 4
+
+/** @brief Size of the largest class, headers included
+ */
+#define MAX_CLASS_SIZE (1 << (MIN_CLASS_SHIFT + MALLOC_NB_CLASSES - 1))
+
+/** @brief Size class of the blocks allocated from the underlying heap
+ */
+#define LARGE_CLASS MALLOC_NB_CLASSES
+
+/** @brief Size of the slabs carved into small blocks
+ */
+#define SLAB_SIZE (4 * PAGE_SIZE)
+
+/** @brief Number of bytes moved at once between a cache and a shared list
+ */
+#define BATCH_BYTES 4096
+
+/** @brief Bounds on the number of blocks moved at once
+ */
+#define MIN_BATCH 4
+#define MAX_BATCH 32
+
+/** @brief Size of a class, headers included
+ */
+#define CLASS_SIZE(cls) (1 << (MIN_CLASS_SHIFT + (cls)))
+
+/** @brief Header preceding every block, keeps the payload 8-bytes aligned
+ */
+typedef struct block_header {
+
+  /** @brief The block's size class, LARGE_CLASS for the underlying heap
+   */
+  unsigned int size_class;
+
+  /** @brief Number of usable bytes in the block
+   */
+  unsigned int size;
+
+} block_header_t;
+
+/** @brief A free block, linked through its payload
  */
-static int initialized = FALSE;
+typedef struct free_block {
+
+  /** @brief Next free block in the list
+   */
+  struct free_block *next;
+
+} free_block_t;
 
-/** @brief Global mutex for malloc
+/** @brief List of free blocks of one size class shared by all threads
+ */
+typedef struct shared_list {
+
+  /** @brief Mutex protecting the list
+   */
+  mutex_t mutex;
+
+  /** @brief Head of the list
+   */
+  free_block_t *head;
+
+} shared_list_t;
+
+/** @brief Whether a thread started initializing the allocator
+ */
+static int init_started = FALSE;
+
+/** @brief Whether the allocator's mutexes are initialized
+ */
+static volatile int initialized = FALSE;
+
+/** @brief Mutex for the underlying heap
  */
 static mutex_t alloc_mutex;
 
+/** @brief Shared lists of free blocks, one per size class
+ */
+static shared_list_t shared_lists[MALLOC_NB_CLASSES];
+
+/** @brief Cache of the root thread (also used before thr_init())
+ */
+static malloc_cache_t root_cache = { 1, { NULL }, { 0 } };
+
+/* Static functions prototypes */
+static void check_init(void);
+static malloc_cache_t *get_cache(void);
+static int size_to_class(size_t size);
+static int batch_size(int cls);
+static void *alloc_small(int cls);
+static void free_small(free_block_t *block, int cls);
+static int refill(malloc_cache_t *cache, int cls);
+static void flush(malloc_cache_t *cache, int cls, int nb_blocks);
+static int carve_slab(int cls);
+static void *alloc_large(size_t size);
+
+/** @brief Initializes the per-thread cache of a new thread
+ *
+ *  @param cache The cache
+ *
+ *  @return void
+ */
+void malloc_cache_init(malloc_cache_t *cache) {
+
+  int cls;
+  for (cls = 0; cls < MALLOC_NB_CLASSES; ++cls) {
+    cache->heads[cls] = NULL;
+    cache->counts[cls] = 0;
+  }
+  cache->active = 1;
+}
+
+/** @brief Gives the blocks cached by the invoking thread back to the shared
+ *   lists and disables its cache
+ *
+ *  Called by an exiting thread, as its cache goes away with its TCB.
+ *
+ *  @return void
+ */
+void malloc_cache_release() {
+
+  check_init();
+
+  malloc_cache_t *cache = get_cache();
+  cache->active = 0;
+
+  int cls;
+  for (cls = 0; cls < MALLOC_NB_CLASSES; ++cls) {
+    flush(cache, cls, cache->counts[cls]);
+  }
+}
+
 /** @brief A thread-safe malloc
  *
  *  @param __size The size to be dynamically allocated
@@ -34,17 +177,18 @@ static mutex_t alloc_mutex;
  */
 void *malloc(size_t __size) {
 
-  if (initialized == FALSE && atomic_exchange(&initialized, TRUE) == FALSE) {
-    // The mutex has not been initialized yet. Initialize it
-    mutex_init(&alloc_mutex);
+  check_init();
+
+  if (__size == 0) {
+    return NULL;
   }
 
-  // Make the malloc call guarded by the mutex
-  mutex_lock(&alloc_mutex);
-  void* ptr = _malloc(__size);
-  mutex_unlock(&alloc_mutex);
+  int cls = size_to_class(__size);
+  if (cls == LARGE_CLASS) {
+    return alloc_large(__size);
+  }
 
-  return ptr;
+  return alloc_small(cls);
 }
 
 /** @brief A thread-safe calloc
@@ -57,22 +201,23 @@ void *malloc(size_t __size) {
  */
 void *calloc(size_t __nelt, size_t __eltsize) {
 
-  if (initialized == FALSE && atomic_exchange(&initialized, TRUE) == FALSE) {
-    // The mutex has not been initialized yet. Initialize it
-    mutex_init(&alloc_mutex);
+  // Check for overflow
+  if (__eltsize != 0 && __nelt > ((size_t)-1) / __eltsize) {
+    return NULL;
   }
 
-  // Make the calloc call guarded by the mutex
-  mutex_lock(&alloc_mutex);
-  void* ptr = _calloc(__nelt, __eltsize);
-  mutex_unlock(&alloc_mutex);
+  size_t size = __nelt * __eltsize;
+  void *ptr = malloc(size);
+  if (ptr != NULL) {
+    memset(ptr, 0, size);
+  }
 
   return ptr;
 }
 
 /** @brief A thread-safe realloc
  *
- *  @param __buf Pointer to a memory block previously allocated with 
+ *  @param __buf Pointer to a memory block previously allocated with
  *               malloc, calloc or realloc.
  *  @param __new_size New size for the memory block, in bytes.
  *
@@ -81,35 +226,323 @@ void *calloc(size_t __nelt, size_t __eltsize) {
  */
 void *realloc(void *__buf, size_t __new_size) {
 
-  if (initialized == FALSE && atomic_exchange(&initialized, TRUE) == FALSE) {
-    // The mutex has not been initialized yet. Initialize it
-    mutex_init(&alloc_mutex);
+  if (__buf == NULL) {
+    return malloc(__new_size);
   }
 
-  // Make the realloc call guarded by the mutex
-  mutex_lock(&alloc_mutex);
-  void* ptr = _realloc(__buf, __new_size);
-  mutex_unlock(&alloc_mutex);
+  if (__new_size == 0) {
+    free(__buf);
+    return NULL;
+  }
+
+  // The block may already be large enough
+  block_header_t *header = (block_header_t *)__buf - 1;
+  if (__new_size <= header->size) {
+    return __buf;
+  }
+
+  void *ptr = malloc(__new_size);
+  if (ptr != NULL) {
+    memcpy(ptr, __buf, header->size);
+    free(__buf);
+  }
 
   return ptr;
 }
 
 /** @brief A thread-safe free
  *
- *  @param __buf Pointer to a memory block previously allocated with 
+ *  @param __buf Pointer to a memory block previously allocated with
  *               malloc, calloc or realloc.
  *
  *  @return void
  */
 void free(void *__buf) {
 
-  if (initialized == FALSE && atomic_exchange(&initialized, TRUE) == FALSE) {
-    // The mutex has not been initialized yet. Initialize it
+  if (__buf == NULL) {
+    return;
+  }
+
+  check_init();
+
+  block_header_t *header = (block_header_t *)__buf - 1;
+  if (header->size_class == LARGE_CLASS) {
+    mutex_lock(&alloc_mutex);
+    _free(header);
+    mutex_unlock(&alloc_mutex);
+    return;
+  }
+
+  free_small(__buf, header->size_class);
+}
+
+/** @brief Initializes the allocator's mutexes on first use
+ *
+ *  @return void
+ */
+static void check_init() {
+
+  if (initialized == TRUE) {
+    return;
+  }
+
+  if (atomic_exchange(&init_started, TRUE) == FALSE) {
     mutex_init(&alloc_mutex);
+
+    int cls;
+    for (cls = 0; cls < MALLOC_NB_CLASSES; ++cls) {
+      mutex_init(&shared_lists[cls].mutex);
+      shared_lists[cls].head = NULL;
+    }
+
+    initialized = TRUE;
+    return;
   }
 
-  // Make the free call guarded by the mutex
+  // Another thread is initializing the allocator
+  while (initialized == FALSE) {
+    yield(-1);
+  }
+}
+
+/** @brief Returns the invoking thread's cache
+ *
+ *  @return The cache
+ */
+static malloc_cache_t *get_cache() {
+
+  tcb_t *tcb = get_tcb();
+  if (tcb == NULL || tcb == task.root_tcb) {
+    return &root_cache;
+  }
+
+  return &tcb->malloc_cache;
+}
+
+/** @brief Returns the size class for a request
+ *
+ *  @param size The requested size, in bytes
+ *
+ *  @return The smallest size class holding size bytes, LARGE_CLASS if the
+ *          request is too large for the caches
+ */
+static int size_to_class(size_t size) {
+
+  if (size > MAX_CLASS_SIZE - sizeof(block_header_t)) {
+    return LARGE_CLASS;
+  }
+
+  size += sizeof(block_header_t);
+
+  int cls = 0;
+  while (CLASS_SIZE(cls) < size) {
+    ++cls;
+  }
+  return cls;
+}
+
+/** @brief Returns the number of blocks moved at once between a cache and a
+ *   shared list
+ *
+ *  @param cls The size class
+ *
+ *  @return The number of blocks
+ */
+static int batch_size(int cls) {
+
+  int batch = BATCH_BYTES / CLASS_SIZE(cls);
+  if (batch < MIN_BATCH) {
+    return MIN_BATCH;
+  }
+  return (batch > MAX_BATCH) ? MAX_BATCH : batch;
+}
+
+/** @brief Allocates a small block from the invoking thread's cache
+ *
+ *  @param cls The block's size class
+ *
+ *  @return The block's payload on success, NULL otherwise
+ */
+static void *alloc_small(int cls) {
+
+  malloc_cache_t *cache = get_cache();
+
+  if (!cache->active) {
+    // Exiting thread, go to the shared list directly
+    shared_list_t *list = &shared_lists[cls];
+    mutex_lock(&list->mutex);
+    if (list->head == NULL && carve_slab(cls) < 0) {
+      mutex_unlock(&list->mutex);
+      return NULL;
+    }
+    free_block_t *block = list->head;
+    list->head = block->next;
+    mutex_unlock(&list->mutex);
+    return block;
+  }
+
+  if (cache->heads[cls] == NULL && refill(cache, cls) < 0) {
+    return NULL;
+  }
+
+  free_block_t *block = cache->heads[cls];
+  cache->heads[cls] = block->next;
+  --cache->counts[cls];
+
+  return block;
+}
+
+/** @brief Frees a small block to the invoking thread's cache
+ *
+ *  Half of the cached blocks of the class are given back to the shared list
+ *  when the cache holds too many of them.
+ *
+ *  @param block  The block's payload
+ *  @param cls    The block's size class
+ *
+ *  @return void
+ */
+static void free_small(free_block_t *block, int cls) {
+
+  malloc_cache_t *cache = get_cache();
+
+  if (!cache->active) {
+    // Exiting thread, go to the shared list directly
+    shared_list_t *list = &shared_lists[cls];
+    mutex_lock(&list->mutex);
+    block->next = list->head;
+    list->head = block;
+    mutex_unlock(&list->mutex);
+    return;
+  }
+
+  block->next = cache->heads[cls];
+  cache->heads[cls] = block;
+
+  int batch = batch_size(cls);
+  if (++cache->counts[cls] >= 2 * batch) {
+    flush(cache, cls, batch);
+  }
+}
+
+/** @brief Moves a batch of blocks from a shared list to a cache
+ *
+ *  @param cache  The cache
+ *  @param cls    The size class
+ *
+ *  @return 0 on success, a negative number if no memory is left
+ */
+static int refill(malloc_cache_t *cache, int cls) {
+
+  shared_list_t *list = &shared_lists[cls];
+  int batch = batch_size(cls);
+
+  mutex_lock(&list->mutex);
+
+  int nb_blocks = 0;
+  while (nb_blocks < batch) {
+    if (list->head == NULL && carve_slab(cls) < 0) {
+      break;
+    }
+    free_block_t *block = list->head;
+    list->head = block->next;
+    block->next = cache->heads[cls];
+    cache->heads[cls] = block;
+    ++nb_blocks;
+  }
+
+  mutex_unlock(&list->mutex);
+
+  cache->counts[cls] += nb_blocks;
+  return (nb_blocks > 0) ? 0 : -1;
+}
+
+/** @brief Moves blocks from a cache to a shared list
+ *
+ *  @param cache      The cache
+ *  @param cls        The size class
+ *  @param nb_blocks  The number of blocks to move
+ *
+ *  @return void
+ */
+static void flush(malloc_cache_t *cache, int cls, int nb_blocks) {
+
+  if (nb_blocks <= 0) {
+    return;
+  }
+
+  // Detach the first nb_blocks blocks from the cache
+  free_block_t *first = cache->heads[cls], *last = first;
+  int i;
+  for (i = 1; i < nb_blocks; ++i) {
+    last = last->next;
+  }
+  cache->heads[cls] = last->next;
+  cache->counts[cls] -= nb_blocks;
+
+  shared_list_t *list = &shared_lists[cls];
+  mutex_lock(&list->mutex);
+  last->next = list->head;
+  list->head = first;
+  mutex_unlock(&list->mutex);
+}
+
+/** @brief Allocates a slab from the underlying heap and carves it into blocks
+ *   pushed on a shared list
+ *
+ *  The shared list's mutex must be held.
+ *
+ *  @param cls The size class
+ *
+ *  @return 0 on success, a negative number if the heap is exhausted
+ */
+static int carve_slab(int cls) {
+
   mutex_lock(&alloc_mutex);
-  _free(__buf);
+  char *slab = _malloc(SLAB_SIZE);
   mutex_unlock(&alloc_mutex);
+
+  if (slab == NULL) {
+    return -1;
+  }
+
+  shared_list_t *list = &shared_lists[cls];
+  int size = CLASS_SIZE(cls);
+  char *block;
+  for (block = slab; block + size <= slab + SLAB_SIZE; block += size) {
+    block_header_t *header = (block_header_t *)block;
+    header->size_class = cls;
+    header->size = size - sizeof(block_header_t);
+
+    free_block_t *free_block = (free_block_t *)(header + 1);
+    free_block->next = list->head;
+    list->head = free_block;
+  }
+
+  return 0;
+}
+
+/** @brief Allocates a block from the underlying heap
+ *
+ *  @param size The requested size, in bytes
+ *
+ *  @return The block's payload on success, NULL otherwise
+ */
+static void *alloc_large(size_t size) {
+
+  if (size > ((size_t)-1) - sizeof(block_header_t)) {
+    return NULL;
+  }
+
+  mutex_lock(&alloc_mutex);
+  block_header_t *header = _malloc(sizeof(block_header_t) + size);
+  mutex_unlock(&alloc_mutex);
+
+  if (header == NULL) {
+    return NULL;
+  }
+
+  header->size_class = LARGE_CLASS;
+  header->size = size;
+  return header + 1;
 }
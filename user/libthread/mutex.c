@@ -1,13 +1,26 @@
 /** @file mutex.c
  *  @brief This file contains the definitions for mutex_type.h functions
+ *
+ *  The mutex is a ticket lock. A thread whose ticket is not served checks
+ *  the mutex a few times, then registers in the mutex's list of waiters and
+ *  deschedules itself. The unlocking thread hands the mutex off to the next
+ *  ticket holder by setting its reject flag and making it runnable, so that
+ *  the hand-off works whether or not the waiter already called deschedule().
+ *
+ *  The number of checks before blocking grows when spinning acquires the
+ *  mutex and shrinks when it does not (which is always the case on a single
+ *  processor, where the owner can not run while we spin).
+ *
  *  @author akanjani, lramire1
  */
 
 #include <mutex.h>
 #include <simics.h>
 #include <mutex_asm.h>
+#include <atomic_ops.h>
 #include <syscall.h>
 #include <assert.h>
+#include <stddef.h>
 
 /** @brief A state of the mutex which means that mutex_init hasn't been called
  *   after a mutex_destroy
@@ -19,6 +32,18 @@
  */
 #define MUTEX_INITIALIZED 1
 
+/** @brief Bounds and initial value for the number of checks before blocking
+ */
+#define MUTEX_MIN_SPIN 8
+#define MUTEX_MAX_SPIN 1024
+#define MUTEX_INITIAL_SPIN 64
+
+/* Static functions prototypes */
+static void guard_lock(mutex_t *mp);
+static void guard_unlock(mutex_t *mp);
+static int spin_for_ticket(mutex_t *mp, int my_ticket);
+static void block_for_ticket(mutex_t *mp, int my_ticket);
+
 /** @brief Initialize a mutex
  *
  *  This function initializes the mutex pointed to by mp.
@@ -40,6 +65,9 @@ int mutex_init(mutex_t *mp) {
   // Initialize the state for the mutex
   mp->prev = 0;
   mp->next_ticket = 1;
+  mp->spin = MUTEX_INITIAL_SPIN;
+  mp->guard = 0;
+  mp->waiters = NULL;
   mp->init = MUTEX_INITIALIZED;
 
   return 0;
@@ -95,10 +123,14 @@ void mutex_lock(mutex_t *mp) {
   // Generate a new ticket for this thread
   int my_ticket = atomic_add_and_update(&mp->next_ticket, j);
 
-  while((mp->prev + 1) != my_ticket) {
-    // A thread which acquired the mutex earlier is running
-    // Yield till it releases the lock
-    yield(-1);
+  if ((mp->prev + 1) == my_ticket) {
+    // Uncontended
+    return;
+  }
+
+  if (spin_for_ticket(mp, my_ticket) < 0) {
+    // A thread which acquired the mutex earlier is still holding it
+    block_for_ticket(mp, my_ticket);
   }
 
 }
@@ -117,6 +149,118 @@ void mutex_unlock(mutex_t *mp) {
   // Validate parameter and the fact that the mutex is initialized
   assert(mp && mp->init == MUTEX_INITIALIZED);
 
-  // Increment the prev value which stores the ticket of the last run thread
-  mp->prev++;
+  // Increment the prev value which stores the ticket of the last run thread.
+  // The locked instruction orders the increment before the read of the list
+  // of waiters.
+  int next = atomic_add_and_update((int *)&mp->prev, 1) + 2;
+
+  if (mp->waiters == NULL) {
+    // The next ticket holder (if any) has not registered, it will see the
+    // new value of prev before blocking
+    return;
+  }
+
+  // Hand the mutex off to the next ticket holder if it registered. The
+  // guard is held until make_runnable() returns so that the waiter is still
+  // blocked on this mutex when it is woken up.
+  guard_lock(mp);
+  mutex_waiter_t *waiter;
+  for (waiter = mp->waiters; waiter != NULL; waiter = waiter->next) {
+    if (waiter->ticket == next) {
+      waiter->reject = 1;
+      make_runnable(waiter->tid);
+      break;
+    }
+  }
+  guard_unlock(mp);
+}
+
+/** @brief Checks a mutex a few times, waiting for a ticket to be served
+ *
+ *  @param mp The mutex
+ *  @param my_ticket The invoking thread's ticket
+ *
+ *  @return 0 if the ticket is served, a negative number otherwise
+ */
+static int spin_for_ticket(mutex_t *mp, int my_ticket) {
+
+  int budget = mp->spin;
+  int i;
+  for (i = 0; i < budget; ++i) {
+    if ((mp->prev + 1) == my_ticket) {
+      // Spinning paid off, spin longer next time
+      if (budget < MUTEX_MAX_SPIN) {
+        mp->spin = budget * 2;
+      }
+      return 0;
+    }
+  }
+
+  if (budget > MUTEX_MIN_SPIN) {
+    mp->spin = budget / 2;
+  }
+  return -1;
+}
+
+/** @brief Blocks the invoking thread until its ticket is served
+ *
+ *  @param mp The mutex
+ *  @param my_ticket The invoking thread's ticket
+ *
+ *  @return void
+ */
+static void block_for_ticket(mutex_t *mp, int my_ticket) {
+
+  mutex_waiter_t me;
+  me.ticket = my_ticket;
+  me.tid = gettid();
+  me.reject = 0;
+
+  guard_lock(mp);
+  me.next = mp->waiters;
+  mp->waiters = &me;
+  guard_unlock(mp);
+
+  // The unlocking thread sets our reject flag if it saw us in the list,
+  // otherwise we see its update of prev here
+  while ((mp->prev + 1) != my_ticket) {
+    deschedule((int *)&me.reject);
+  }
+
+  // Leave the list of waiters
+  guard_lock(mp);
+  mutex_waiter_t **it = &mp->waiters;
+  while (*it != &me) {
+    it = &(*it)->next;
+  }
+  *it = me.next;
+  guard_unlock(mp);
+}
+
+/** @brief Acquires the spinlock protecting a mutex's list of waiters
+ *
+ *  The spinlock is only held for a few instructions (or one system call in
+ *  mutex_unlock()), its owner is given the CPU when it is contended.
+ *
+ *  @param mp The mutex
+ *
+ *  @return void
+ */
+static void guard_lock(mutex_t *mp) {
+  while (atomic_exchange(&mp->guard, 1) != 0) {
+    yield(-1);
+  }
+}
+
+/** @brief Releases the spinlock protecting a mutex's list of waiters
+ *
+ *  A locked instruction is used so that the updates of the list are visible
+ *  before the invoking thread reads the mutex's state again.
+ *
+ *  @param mp The mutex
+ *
+ *  @return void
+ */
+static void guard_unlock(mutex_t *mp) {
+  atomic_exchange(&mp->guard, 0);
 }
@@ -7,6 +7,11 @@
  *   allowed to start reading if the user is waiting for the lock. This 
  *   implementation can result in starvation of readers for now.
  *
+ *   Readers only touch the lock's state word, with one atomic add to take
+ *   the lock and one to release it, as long as no writer holds or waits for
+ *   the lock. The mutex and condition variables are only used when a writer
+ *   is involved.
+ *
  *  @author akanjani, lramire1
  */
 
@@ -16,6 +21,7 @@
 #include <simics.h>
 #include <assert.h>
 #include <rwlock_helper.h>
+#include <mutex_asm.h>
 
 /** @brief A state of a reader writer lock meaning that a rwlock_destroy has
  *   not been called after a rwlock_init as of now.
@@ -27,12 +33,6 @@
  */
 #define RWLOCK_UNINITIALIZED 0
 
-/** @brief A type of the current operation being performed by threads holding
- *   the lock. This value is set when rwlock_init has been called and no 
- *   threads currently hold any locks
- */
-#define RWLOCK_INVALID 2
-
 /** @brief Initializes a reader writer lock
  *
  *  This function initializes the reader writer lock pointed to by rwlock.
@@ -67,9 +67,8 @@ int rwlock_init(rwlock_t *rwlock) {
 
   // Initialize the state of the reader writer lock
   rwlock->init = RWLOCK_INITIALIZED;
-  rwlock->waiting_readers = rwlock->active_readers = 0;
-  rwlock->waiting_writers = rwlock->active_writers = 0;
-  rwlock->curr_op = RWLOCK_INVALID;
+  rwlock->state = 0;
+  rwlock->writer_active = 0;
 
   // Unlock the mutex. We are done
   mutex_unlock(&rwlock->lock);
@@ -99,6 +98,14 @@ void rwlock_lock(rwlock_t *rwlock, int type) {
   assert(rwlock->init == RWLOCK_INITIALIZED);
 
   if (type == RWLOCK_READ) {
+
+    // Fast path: announce ourselves as a reader, we got the lock if no writer
+    // holds or waits for it
+    int old = atomic_add_and_update(&rwlock->state, RWLOCK_READER);
+    if (RWLOCK_WRITERS(old) == 0) {
+      return;
+    }
+
     // The thread wants to read
     start_read(rwlock);
   } else {
@@ -116,10 +123,10 @@ void rwlock_lock(rwlock_t *rwlock, int type) {
  *  reader threads waiting on this reader writer lock runnable
  *
  *  If the current lock being given up is an shared lock( reader was 
- *  running), then we check if this is the last of the running threads or not.
- *  If it isn't, we do not do anything. Otherwise, we check if any writer is
- *  waiting and if that's true, we give the writer the lock. Otherwise, we 
- *  continue;
+ *  running), then we leave with an atomic decrement of the state word and
+ *  check if this is the last of the running threads or not. If it isn't, we
+ *  do not do anything. Otherwise, we check if any writer is waiting and if
+ *  that's true, we give the writer the lock. Otherwise, we continue;
  *
  *  @param rwlock A pointer to the reader writer lock
  *
@@ -135,21 +142,21 @@ void rwlock_unlock(rwlock_t *rwlock) {
   // Assert that the rwlock is initialized when this function is called
   assert(rwlock->init == RWLOCK_INITIALIZED);
 
-  // Take the lock to check state
-  mutex_lock(&rwlock->lock);
+  if (rwlock->writer_active) {
+    // This thread was a writer, no reader may hold the lock at the same time
+    stop_write(rwlock);
+    return;
+  }
 
-  // Assert that at least one thread is actively running with this lock
-  assert(rwlock->active_readers != 0 || rwlock->active_writers != 0);
+  // This thread was a reader
+  int old = atomic_add_and_update(&rwlock->state, -RWLOCK_READER);
 
-  // Unlock the lock as we are done accessing state
-  mutex_unlock(&rwlock->lock);
+  // Assert that at least one thread is actively running with this lock
+  assert(RWLOCK_READERS(old) != 0);
 
-  if (rwlock->curr_op == RWLOCK_READ) {
-    // This thread was a reader
+  if (RWLOCK_READERS(old) == 1 && RWLOCK_WRITERS(old) != 0) {
+    // We were the last reader and a writer is waiting for us
     stop_read(rwlock);
-  } else {
-    // This thread was a writer
-    stop_write(rwlock);
   }
 }
 
@@ -178,8 +185,7 @@ void rwlock_destroy(rwlock_t *rwlock) {
   mutex_lock(&rwlock->lock);
 
   // Assert that there is no thread currently waiting/running for this rwlock
-  assert(rwlock->active_readers == 0 && rwlock->active_writers == 0); 
-  assert(rwlock->waiting_readers == 0 && rwlock->waiting_writers == 0);
+  assert(rwlock->state == 0 && rwlock->writer_active == 0);
 
   // Destroy the condition variables
   cond_destroy(&rwlock->read_cvar);
@@ -215,7 +221,7 @@ void rwlock_downgrade(rwlock_t *rwlock) {
     return;
   }
 
-  if (rwlock->active_writers <= 0) {
+  if (!rwlock->writer_active) {
     // No writer is running
     return;
   }
@@ -223,20 +229,16 @@ void rwlock_downgrade(rwlock_t *rwlock) {
   // Lock the mutex to modify state
   mutex_lock(&rwlock->lock);
 
-  // Decrement the number of active_writers
-  rwlock->active_writers--;
+  // Become a reader before giving up the write lock so that the lock is never
+  // released
+  atomic_add_and_update(&rwlock->state, RWLOCK_READER);
+  rwlock->writer_active = 0;
+  int old = atomic_add_and_update(&rwlock->state, -RWLOCK_WRITER);
 
-  // Assert that there is now no active_writer
-  assert(rwlock->active_writers == 0);
-
-  // Increment the number of active readers
-  rwlock->active_readers++;
-
-  // Set the current operation being performed as read
-  rwlock->curr_op = RWLOCK_READ;
-
-  // Broadcast to all reader threads waiting for the read_cvar
-  cond_broadcast(&rwlock->read_cvar);
+  if (RWLOCK_WRITERS(old) == 1) {
+    // No other writer is waiting, let the blocked readers in
+    cond_broadcast(&rwlock->read_cvar);
+  }
 
   // Unlock the mutex. We are done
   mutex_unlock(&rwlock->lock);
@@ -3,9 +3,14 @@
 
 #include <rwlock_type.h>
 
-int wait_for_read(rwlock_t *rwlock);
+/* Layout of a rwlock's state word */
+#define RWLOCK_READERS_BITS 16
+#define RWLOCK_READER 1
+#define RWLOCK_WRITER (1 << RWLOCK_READERS_BITS)
+#define RWLOCK_READERS(state) ((state) & (RWLOCK_WRITER - 1))
+#define RWLOCK_WRITERS(state) ((state) >> RWLOCK_READERS_BITS)
+
 void start_read(rwlock_t *rwlock);
-int wait_for_write(rwlock_t *rwlock);
 void start_write(rwlock_t *rwlock);
 void stop_read(rwlock_t *rwlock);
 void stop_write(rwlock_t *rwlock);
@@ -61,6 +61,7 @@ int thr_create(void *(*func)(void *), void *arg) {
   tcb->return_status = NULL;
   tcb->kernel_tid = -1;
   tcb->thread_state = RUNNING;
+  malloc_cache_init(&tcb->malloc_cache);
 
   // Try to find space for a new stack in the queue
   child_stack_high = queue_delete_node(&task.stack_queue);
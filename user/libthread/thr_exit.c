@@ -26,6 +26,9 @@ void thr_exit(void *status) {
     // panic("thr_exit(): Thread's TCB does not exist !\n");
   }
 
+  // Give our cached memory back before our TCB can be freed by a joiner
+  malloc_cache_release();
+
   // Set return status
   tcb->return_status = status;
 
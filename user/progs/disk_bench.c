@@ -0,0 +1,98 @@
+/* Disk throughput benchmark: reads the first disk ("ata0", run QEMU with
+ * -hda <image>) sequentially in 4 KB reads through a file descriptor, then
+ * reads random 4 KB blocks of the same area with readfile(), and reports the
+ * throughput of both. Sequential reads benefit from the buffer cache's
+ * read-ahead, random reads mostly miss in the cache */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DISK_NAME "ata0"
+
+/* Timer interrupts per second */
+#define TICKS_PER_SECOND 100
+
+#define BLOCK_SIZE 4096
+
+/* Number of blocks read sequentially, at most (8 MB) */
+#define SEQ_BLOCKS 2048
+
+/* Number of random reads */
+#define RANDOM_READS 1024
+
+/* Linear congruential generator parameters */
+#define LCG_MULTIPLIER 1103515245u
+#define LCG_INCREMENT 12345u
+
+static void loop(int ret);
+static void report(char *name, unsigned int blocks, unsigned int ticks);
+
+int main() {
+
+  static char buf[BLOCK_SIZE];
+
+  int fd = open(DISK_NAME, FS_READ);
+  if (fd < 0) {
+    lprintf("disk_bench(): no disk, boot with a disk image on hda");
+    loop(-1);
+  }
+
+  // Sequential reads, until the end of the disk or SEQ_BLOCKS blocks
+  unsigned int blocks = 0;
+  unsigned int start = get_ticks();
+  while (blocks < SEQ_BLOCKS) {
+    int len = read(fd, buf, BLOCK_SIZE);
+    if (len < 0) {
+      lprintf("disk_bench(): sequential read failed");
+      loop(-1);
+    }
+    if (len < BLOCK_SIZE) {
+      break;
+    }
+    ++blocks;
+  }
+  report("sequential", blocks, get_ticks() - start);
+  close(fd);
+
+  if (blocks == 0) {
+    loop(-1);
+  }
+
+  // Random reads within the area read sequentially
+  unsigned int seed = 1;
+  int i;
+  start = get_ticks();
+  for (i = 0; i < RANDOM_READS; ++i) {
+    seed = seed * LCG_MULTIPLIER + LCG_INCREMENT;
+    unsigned int block = (seed >> 16) % blocks;
+    if (readfile(DISK_NAME, buf, BLOCK_SIZE, block * BLOCK_SIZE) !=
+        BLOCK_SIZE) {
+      lprintf("disk_bench(): random read failed");
+      loop(-1);
+    }
+  }
+  report("random", RANDOM_READS, get_ticks() - start);
+
+  loop(0);
+}
+
+/** Prints the throughput of a round of reads */
+static void report(char *name, unsigned int blocks, unsigned int ticks) {
+  unsigned int kb = blocks * (BLOCK_SIZE / 1024);
+  unsigned int rate = (ticks == 0) ? 0 : (kb * TICKS_PER_SECOND) / ticks;
+  printf("disk: %s, %u KB in %u ticks, %u KB/s\n", name, kb, ticks, rate);
+  lprintf("disk_bench(): %s, %u KB in %u ticks, %u KB/s", name, kb, ticks,
+          rate);
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("disk_bench() completed successfully !");
+  } else {
+    lprintf("disk_bench() failed !");
+  }
+  while(1);
+}
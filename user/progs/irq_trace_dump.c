@@ -0,0 +1,96 @@
+/* Interrupts-off latency report: forks a task with a large address space a
+ * few times, then keeps a long list of threads sleeping for a while so that
+ * the timer's bottom half has work on every tick, and prints the longest
+ * interrupts-off windows seen by the kernel along with the sites that opened
+ * and closed them */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Size of the region touched before forking, in pages */
+#define NB_PAGES 1024
+
+#define NB_FORKS 4
+
+/* Number of tasks sleeping at the same time, and number of times each one
+ * goes to sleep */
+#define NB_SLEEPERS 32
+#define NB_SLEEPS 16
+
+#define BASE_ADDR ((void *)0x40000000)
+
+static void loop(int ret);
+
+int main() {
+
+  if (new_pages(BASE_ADDR, NB_PAGES * PAGE_SIZE) < 0) {
+    printf("irq_trace_dump: new_pages() failed\n");
+    loop(-1);
+  }
+
+  // Touch every page so that fork() has to copy them
+  char *addr = BASE_ADDR;
+  int i;
+  for (i = 0 ; i < NB_PAGES ; ++i) {
+    addr[i * PAGE_SIZE] = (char)i;
+  }
+
+  for (i = 0 ; i < NB_FORKS ; ++i) {
+    int tid = fork();
+    if (tid == 0) {
+      vanish();
+    }
+    if (tid < 0) {
+      printf("irq_trace_dump: fork() failed\n");
+      loop(-1);
+    }
+    int status;
+    wait(&status);
+  }
+
+  // Sleepers wake up on different ticks and go back to sleep right away
+  for (i = 0 ; i < NB_SLEEPERS ; ++i) {
+    int tid = fork();
+    if (tid == 0) {
+      int j;
+      for (j = 0 ; j < NB_SLEEPS ; ++j) {
+        sleep(1 + (i + j) % 8);
+      }
+      vanish();
+    }
+    if (tid < 0) {
+      printf("irq_trace_dump: fork() failed\n");
+      loop(-1);
+    }
+  }
+  for (i = 0 ; i < NB_SLEEPERS ; ++i) {
+    int status;
+    wait(&status);
+  }
+
+  irq_trace_entry_t entries[8];
+  int nb_entries = get_irq_trace(entries, 8);
+  if (nb_entries < 0) {
+    printf("irq_trace_dump: get_irq_trace() failed\n");
+    loop(-1);
+  }
+
+  printf("Longest interrupts-off windows (cycles, start, stop):\n");
+  for (i = 0 ; i < nb_entries ; ++i) {
+    printf("%10u  %p  %p\n", entries[i].cycles, entries[i].start_site,
+           entries[i].stop_site);
+  }
+
+  loop(0);
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("irq_trace_dump() completed successfully !");
+  } else {
+    lprintf("irq_trace_dump() failed !");
+  }
+  while(1);
+}
@@ -0,0 +1,128 @@
+/* Multithreaded malloc benchmark: 1 to 32 threads allocate and free small
+ * blocks of various sizes, reports how many malloc()/free() calls per second
+ * went through for each number of threads */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread.h>
+
+#define STACK_SIZE 4096
+#define MAX_THREADS 32
+
+/* Timer interrupts per second */
+#define TICKS_PER_SECOND 100
+
+/* Total number of malloc()/free() pairs, split between the threads */
+#define TOTAL_PAIRS (1 << 17)
+
+/* Number of blocks a thread holds at once */
+#define WINDOW 32
+
+static void loop(int ret);
+static int run_round(int nb_threads);
+static void *worker(void *arg);
+
+/* Set by the main thread once every worker is created */
+static volatile int go = 0;
+
+int main() {
+
+  thr_init(STACK_SIZE);
+
+  int nb_threads;
+  for (nb_threads = 1; nb_threads <= MAX_THREADS; nb_threads *= 2) {
+    if (run_round(nb_threads) < 0) {
+      loop(-1);
+    }
+  }
+
+  loop(0);
+}
+
+/** Runs the benchmark with nb_threads threads and prints the throughput */
+static int run_round(int nb_threads) {
+
+  int tids[MAX_THREADS];
+  int rounds = TOTAL_PAIRS / (nb_threads * WINDOW);
+
+  go = 0;
+  int i;
+  for (i = 0; i < nb_threads; ++i) {
+    tids[i] = thr_create(worker, (void *)rounds);
+    if (tids[i] < 0) {
+      lprintf("malloc_scale_test(): thr_create failed");
+      return -1;
+    }
+  }
+
+  unsigned int start = get_ticks();
+  go = 1;
+
+  for (i = 0; i < nb_threads; ++i) {
+    void *status;
+    if (thr_join(tids[i], &status) < 0 || status != NULL) {
+      lprintf("malloc_scale_test(): worker failed");
+      return -1;
+    }
+  }
+
+  unsigned int ticks = get_ticks() - start;
+  if (ticks == 0) {
+    ticks = 1;
+  }
+
+  unsigned int ops = 2 * rounds * nb_threads * WINDOW;
+  unsigned int ops_per_sec = (ops / ticks) * TICKS_PER_SECOND;
+  printf("malloc: %d threads, %u ops in %u ticks (%u ops/sec)\n",
+         nb_threads, ops, ticks, ops_per_sec);
+  lprintf("malloc_scale_test(): %d threads, %u ops/sec", nb_threads,
+          ops_per_sec);
+  return 0;
+}
+
+/** Allocates and frees WINDOW blocks at a time, checking that blocks do not
+ *  overlap */
+static void *worker(void *arg) {
+
+  int rounds = (int)arg;
+  char *blocks[WINDOW];
+
+  while (!go) {
+    yield(-1);
+  }
+
+  int round, i;
+  for (round = 0; round < rounds; ++round) {
+
+    for (i = 0; i < WINDOW; ++i) {
+      int size = 8 << ((round + i) % 8);
+      blocks[i] = malloc(size);
+      if (blocks[i] == NULL) {
+        return (void *)-1;
+      }
+      blocks[i][0] = (char)i;
+      blocks[i][size - 1] = (char)i;
+    }
+
+    for (i = 0; i < WINDOW; ++i) {
+      int size = 8 << ((round + i) % 8);
+      if (blocks[i][0] != (char)i || blocks[i][size - 1] != (char)i) {
+        return (void *)-1;
+      }
+      free(blocks[i]);
+    }
+  }
+
+  return NULL;
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("malloc_scale_test() completed successfully !");
+  } else {
+    lprintf("malloc_scale_test() failed !");
+  }
+  while(1);
+}
@@ -0,0 +1,162 @@
+/* Message queue pipeline benchmark: a "cat" task streams data to a "work"
+ * task through a message queue, first with small messages (copied by the
+ * kernel) and then with large page-aligned messages (whose frames are moved
+ * from the sender to the receiver). Both runs report their throughput and
+ * check the data with a checksum. */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Capacity of the queue, in messages */
+#define QUEUE_CAPACITY 8
+
+/* Amount of data transferred in each run, in bytes */
+#define TOTAL_BYTES (8 * 1024 * 1024)
+
+/* Size of the messages in each run, in bytes */
+#define SMALL_MSG_SIZE 256
+#define LARGE_MSG_SIZE (16 * PAGE_SIZE)
+
+/* Page-aligned buffers used by the large message run */
+#define SEND_BUF ((char *)0x40000000)
+#define RECV_BUF ((char *)0x40100000)
+
+static void loop(int ret);
+static int run(const char *name, int msg_size, char *send_buf,
+               char *recv_buf);
+static void cat(int id, int msg_size, char *buf);
+static unsigned int work(int id, int msg_size, char *buf);
+
+int main() {
+
+  static char small_send[SMALL_MSG_SIZE], small_recv[SMALL_MSG_SIZE];
+
+  if (new_pages(SEND_BUF, LARGE_MSG_SIZE) < 0 ||
+      new_pages(RECV_BUF, LARGE_MSG_SIZE) < 0) {
+    lprintf("mq_pipeline_test(): new_pages failed");
+    loop(-1);
+  }
+
+  if (run("copy", SMALL_MSG_SIZE, small_send, small_recv) < 0 ||
+      run("remap", LARGE_MSG_SIZE, SEND_BUF, RECV_BUF) < 0) {
+    loop(-1);
+  }
+
+  loop(0);
+}
+
+/** Streams TOTAL_BYTES bytes from a "cat" task to a "work" task using
+ *  messages of msg_size bytes, and prints the throughput */
+static int run(const char *name, int msg_size, char *send_buf,
+               char *recv_buf) {
+
+  int id = mq_create(QUEUE_CAPACITY);
+  if (id < 0) {
+    lprintf("mq_pipeline_test(): mq_create failed");
+    return -1;
+  }
+
+  unsigned int start = get_ticks();
+
+  int cat_tid = fork();
+  if (cat_tid < 0) {
+    lprintf("mq_pipeline_test(): fork failed");
+    return -1;
+  }
+  if (cat_tid == 0) {
+    cat(id, msg_size, send_buf);
+  }
+
+  int work_tid = fork();
+  if (work_tid < 0) {
+    lprintf("mq_pipeline_test(): fork failed");
+    return -1;
+  }
+  if (work_tid == 0) {
+    exit((int)work(id, msg_size, recv_buf));
+  }
+
+  // The cat task's status is the checksum of what it sent, and so is the
+  // work task's for what it received
+  int status, sent = 0, received = 0, i;
+  for (i = 0; i < 2; ++i) {
+    int tid = wait(&status);
+    if (tid == cat_tid) {
+      sent = status;
+    } else if (tid == work_tid) {
+      received = status;
+    }
+  }
+
+  unsigned int ticks = get_ticks() - start;
+  if (ticks == 0) {
+    ticks = 1;
+  }
+
+  mq_destroy(id);
+
+  if (sent != received) {
+    lprintf("mq_pipeline_test(): %s checksum mismatch", name);
+    return -1;
+  }
+
+  // The timer ticks 100 times per second
+  unsigned int kb = TOTAL_BYTES / 1024;
+  printf("mq %s: %u KB in %u ticks (%u KB/s, %d bytes/msg)\n", name, kb,
+         ticks, (kb * 100) / ticks, msg_size);
+  lprintf("mq_pipeline_test(): %s %u KB in %u ticks (%u KB/s)", name, kb,
+          ticks, (kb * 100) / ticks);
+  return 0;
+}
+
+/** Sends TOTAL_BYTES bytes and exits with their checksum */
+static void cat(int id, int msg_size, char *buf) {
+
+  unsigned int checksum = 0, sent = 0;
+
+  while (sent < TOTAL_BYTES) {
+    int i;
+    for (i = 0; i < msg_size; ++i) {
+      buf[i] = (char)(sent + i);
+      checksum += (unsigned char)buf[i];
+    }
+    if (mq_send(id, buf, msg_size) != 0) {
+      exit(-1);
+    }
+    sent += msg_size;
+  }
+
+  exit((int)checksum);
+}
+
+/** Receives TOTAL_BYTES bytes and returns their checksum */
+static unsigned int work(int id, int msg_size, char *buf) {
+
+  unsigned int checksum = 0, received = 0;
+
+  while (received < TOTAL_BYTES) {
+    int len = mq_recv(id, buf, msg_size);
+    if (len < 0) {
+      return 0;
+    }
+    int i;
+    for (i = 0; i < len; ++i) {
+      checksum += (unsigned char)buf[i];
+    }
+    received += len;
+  }
+
+  return checksum;
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("mq_pipeline_test() completed successfully !");
+  } else {
+    lprintf("mq_pipeline_test() failed !");
+  }
+  while(1);
+}
@@ -0,0 +1,151 @@
+/* Mutex contention benchmark: 1 to 32 threads increment a shared counter
+ * protected by a single mutex, reports the number of increments per second
+ * and how many times the mutex went from one thread to another (each of
+ * these hand-offs costs at least one context switch) */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread.h>
+#include <mutex.h>
+
+#define STACK_SIZE 4096
+#define MAX_THREADS 32
+
+/* Timer interrupts per second */
+#define TICKS_PER_SECOND 100
+
+/* Total number of increments, split between the threads */
+#define TOTAL_INCREMENTS (1 << 18)
+
+/* Work done inside and outside the critical section */
+#define WORK_INSIDE 16
+#define WORK_OUTSIDE 64
+
+static void loop(int ret);
+static int run_round(int nb_threads);
+static void *worker(void *arg);
+static void work(int amount);
+
+static mutex_t mutex;
+
+/* Protected by mutex */
+static unsigned int counter;
+static int last_owner;
+static unsigned int handoffs;
+
+/* Set by the main thread once every worker is created */
+static volatile int go = 0;
+
+int main() {
+
+  thr_init(STACK_SIZE);
+
+  if (mutex_init(&mutex) < 0) {
+    loop(-1);
+  }
+
+  int nb_threads;
+  for (nb_threads = 1; nb_threads <= MAX_THREADS; nb_threads *= 2) {
+    if (run_round(nb_threads) < 0) {
+      loop(-1);
+    }
+  }
+
+  mutex_destroy(&mutex);
+  loop(0);
+}
+
+/** Runs the benchmark with nb_threads threads and prints the results */
+static int run_round(int nb_threads) {
+
+  int tids[MAX_THREADS];
+  int increments = TOTAL_INCREMENTS / nb_threads;
+
+  counter = 0;
+  last_owner = -1;
+  handoffs = 0;
+  go = 0;
+
+  int i;
+  for (i = 0; i < nb_threads; ++i) {
+    tids[i] = thr_create(worker, (void *)increments);
+    if (tids[i] < 0) {
+      lprintf("mutex_contention_test(): thr_create failed");
+      return -1;
+    }
+  }
+
+  unsigned int start = get_ticks();
+  go = 1;
+
+  for (i = 0; i < nb_threads; ++i) {
+    if (thr_join(tids[i], NULL) < 0) {
+      lprintf("mutex_contention_test(): thr_join failed");
+      return -1;
+    }
+  }
+
+  unsigned int ticks = get_ticks() - start;
+  if (ticks == 0) {
+    ticks = 1;
+  }
+
+  if (counter != (unsigned int)(increments * nb_threads)) {
+    lprintf("mutex_contention_test(): lost increments");
+    return -1;
+  }
+
+  unsigned int per_sec = (counter / ticks) * TICKS_PER_SECOND;
+  printf("mutex: %d threads, %u increments/sec, %u hand-offs in %u ticks\n",
+         nb_threads, per_sec, handoffs, ticks);
+  lprintf("mutex_contention_test(): %d threads, %u increments/sec, "
+          "%u hand-offs", nb_threads, per_sec, handoffs);
+  return 0;
+}
+
+/** Increments the shared counter */
+static void *worker(void *arg) {
+
+  int increments = (int)arg;
+  int me = thr_getid();
+
+  while (!go) {
+    yield(-1);
+  }
+
+  int i;
+  for (i = 0; i < increments; ++i) {
+    mutex_lock(&mutex);
+    if (last_owner != me) {
+      last_owner = me;
+      ++handoffs;
+    }
+    ++counter;
+    work(WORK_INSIDE);
+    mutex_unlock(&mutex);
+
+    work(WORK_OUTSIDE);
+  }
+
+  return NULL;
+}
+
+/** Burns some CPU */
+static void work(int amount) {
+  volatile int sink = 0;
+  int i;
+  for (i = 0; i < amount; ++i) {
+    sink += i;
+  }
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("mutex_contention_test() completed successfully !");
+  } else {
+    lprintf("mutex_contention_test() failed !");
+  }
+  while(1);
+}
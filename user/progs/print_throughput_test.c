@@ -0,0 +1,97 @@
+/* Console output benchmark: prints log-like lines of various lengths for a
+ * few seconds and reports how many characters per second went through
+ * print(), for one task and for several tasks printing concurrently. Boot
+ * the kernel with console=serial (or console=both) to measure the serial
+ * port instead of (or along with) the screen */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Timer interrupts per second */
+#define TICKS_PER_SECOND 100
+
+/* Length of a round */
+#define ROUND_TICKS 300
+
+/* Number of tasks printing at once in the second round */
+#define NB_CHILDREN 4
+
+#define LINE_LEN 256
+
+static void loop(int ret);
+static unsigned int print_for(unsigned int ticks, int id);
+
+int main() {
+
+  // One task
+  unsigned int chars = print_for(ROUND_TICKS, 0);
+  unsigned int solo = (chars / ROUND_TICKS) * TICKS_PER_SECOND;
+
+  // Several tasks, each one reports through its exit status
+  int i;
+  for (i = 0; i < NB_CHILDREN; ++i) {
+    int pid = fork();
+    if (pid < 0) {
+      loop(-1);
+    }
+    if (pid == 0) {
+      set_status((int)print_for(ROUND_TICKS, i + 1));
+      vanish();
+    }
+  }
+
+  unsigned int total = 0;
+  for (i = 0; i < NB_CHILDREN; ++i) {
+    int status;
+    if (wait(&status) < 0) {
+      loop(-1);
+    }
+    total += (unsigned int)status;
+  }
+  unsigned int shared = (total / ROUND_TICKS) * TICKS_PER_SECOND;
+
+  printf("print: 1 task %u chars/sec, %d tasks %u chars/sec\n", solo,
+         NB_CHILDREN, shared);
+  lprintf("print_throughput_test(): 1 task %u chars/sec, %d tasks "
+          "%u chars/sec", solo, NB_CHILDREN, shared);
+  loop(0);
+}
+
+/** Prints lines until the given number of ticks has elapsed, returns the
+ *  number of characters printed */
+static unsigned int print_for(unsigned int ticks, int id) {
+
+  char line[LINE_LEN];
+  unsigned int chars = 0;
+  unsigned int start = get_ticks();
+  int n = 0;
+
+  while (get_ticks() - start < ticks) {
+    // Lines from 20 to ~140 characters, some of them wrap
+    int len = snprintf(line, LINE_LEN, "[task %d] message %d: ", id, n);
+    int pad = (n * 37) % 120;
+    memset(line + len, 'a' + (n % 26), pad);
+    len += pad;
+    line[len++] = '\n';
+
+    if (print(len, line) < 0) {
+      loop(-1);
+    }
+    chars += len;
+    ++n;
+  }
+
+  return chars;
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("print_throughput_test() completed successfully !");
+  } else {
+    lprintf("print_throughput_test() failed !");
+  }
+  while(1);
+}
@@ -0,0 +1,139 @@
+/* Priority inversion test: a light task keeps the console busy with long
+ * print() calls while heavier tasks hog the CPU. A heavy task measures how
+ * long its own short print() calls wait for the console; thanks to priority
+ * inheritance the light task runs with the heavy task's tickets while it
+ * holds the console, so the wait stays bounded. */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Weights of the tasks involved */
+#define WEIGHT_HIGH 200
+#define WEIGHT_MEDIUM 50
+#define WEIGHT_LOW 1
+
+/* Number of CPU hogs of medium weight */
+#define NB_HOGS 4
+
+/* Length of the experiment, in ticks */
+#define RUN_TICKS 1000
+
+/* Length of the light task's print() calls, in characters */
+#define LONG_PRINT_LEN 1600
+
+/* Number of short print() calls timed by the heavy task */
+#define NB_SAMPLES 40
+
+/* Maximum acceptable wait for the console, in ticks */
+#define MAX_WAIT_TICKS 100
+
+static void loop(int ret);
+static int spawn_hog(unsigned int end);
+static int spawn_printer(unsigned int end);
+
+int main() {
+
+  if (set_weight(-1, WEIGHT_HIGH) < 0) {
+    lprintf("priority_inversion_test(): set_weight failed");
+    loop(-1);
+  }
+
+  unsigned int end = get_ticks() + RUN_TICKS;
+
+  if (spawn_printer(end) < 0) {
+    lprintf("priority_inversion_test(): fork failed");
+    loop(-1);
+  }
+
+  int i;
+  for (i = 0; i < NB_HOGS; ++i) {
+    if (spawn_hog(end) < 0) {
+      lprintf("priority_inversion_test(): fork failed");
+      loop(-1);
+    }
+  }
+
+  // Let the light task grab the console
+  sleep(5);
+
+  unsigned int max_wait = 0, total_wait = 0;
+  for (i = 0; i < NB_SAMPLES; ++i) {
+    unsigned int before = get_ticks();
+    print(1, "*");
+    unsigned int wait_ticks = get_ticks() - before;
+
+    total_wait += wait_ticks;
+    if (wait_ticks > max_wait) {
+      max_wait = wait_ticks;
+    }
+    sleep(2);
+  }
+
+  // Reap the other tasks
+  int status;
+  for (i = 0; i < NB_HOGS + 1; ++i) {
+    wait(&status);
+  }
+
+  printf("\nconsole wait: max %u ticks, average %u ticks (bound %d)\n",
+         max_wait, total_wait / NB_SAMPLES, MAX_WAIT_TICKS);
+  lprintf("priority_inversion_test(): max wait %u ticks, average %u ticks",
+          max_wait, total_wait / NB_SAMPLES);
+
+  loop(max_wait <= MAX_WAIT_TICKS ? 0 : -1);
+}
+
+/** Forks a light task that prints long lines until the end of the test */
+static int spawn_printer(unsigned int end) {
+
+  int tid = fork();
+  if (tid != 0) {
+    return tid;
+  }
+
+  if (set_weight(-1, WEIGHT_LOW) < 0) {
+    exit(-1);
+  }
+
+  static char buf[LONG_PRINT_LEN];
+  memset(buf, '.', LONG_PRINT_LEN);
+
+  while (get_ticks() < end) {
+    print(LONG_PRINT_LEN, buf);
+  }
+
+  exit(0);
+  return -1;
+}
+
+/** Forks a medium weight task that spins until the end of the test */
+static int spawn_hog(unsigned int end) {
+
+  int tid = fork();
+  if (tid != 0) {
+    return tid;
+  }
+
+  if (set_weight(-1, WEIGHT_MEDIUM) < 0) {
+    exit(-1);
+  }
+
+  while (get_ticks() < end) {
+    continue;
+  }
+
+  exit(0);
+  return -1;
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("priority_inversion_test() completed successfully !");
+  } else {
+    lprintf("priority_inversion_test() failed !");
+  }
+  while(1);
+}
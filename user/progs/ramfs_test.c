@@ -0,0 +1,194 @@
+/* RAM filesystem test: writes a scratch file, reads it back through read()
+ * and through a mapping, checks that fork()ed children share open files and
+ * that unlink() removes the file. Then compares the time taken to scan an
+ * executable's image with readfile() (one copy per scan) and through an
+ * fmap() mapping (no copy) */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCRATCH_NAME "ramfs_scratch"
+#define IMAGE_NAME "ramfs_test"
+#define MAP_BASE ((void *)0x40000000)
+#define BUF_BASE ((void *)0x50000000)
+
+/* Size of the scratch file, not a multiple of the page size on purpose */
+#define SCRATCH_SIZE (3 * PAGE_SIZE + 123)
+
+/* Number of scans of the executable's image */
+#define NB_SCANS 200
+
+static void loop(int ret);
+static int test_scratch(void);
+static int test_fork(void);
+static int bench_image(void);
+static unsigned int checksum(char *buf, int len);
+
+int main() {
+
+  if (test_scratch() < 0 || test_fork() < 0 || bench_image() < 0) {
+    loop(-1);
+  }
+
+  loop(0);
+}
+
+/** Creates, reads, maps and unlinks a scratch file */
+static int test_scratch() {
+
+  static char buf[SCRATCH_SIZE];
+  int i;
+  for (i = 0; i < SCRATCH_SIZE; ++i) {
+    buf[i] = (char)(i * 7);
+  }
+
+  int fd = open(SCRATCH_NAME, FS_WRITE | FS_CREATE);
+  if (fd < 0 || write(fd, buf, SCRATCH_SIZE) != SCRATCH_SIZE) {
+    lprintf("ramfs_test(): write failed");
+    return -1;
+  }
+  close(fd);
+
+  fd = open(SCRATCH_NAME, FS_READ);
+  memset(buf, 0, SCRATCH_SIZE);
+  if (fd < 0 || read(fd, buf, SCRATCH_SIZE + 1) != SCRATCH_SIZE ||
+      read(fd, buf, 1) != 0) {
+    lprintf("ramfs_test(): read failed");
+    return -1;
+  }
+  for (i = 0; i < SCRATCH_SIZE; ++i) {
+    if (buf[i] != (char)(i * 7)) {
+      lprintf("ramfs_test(): read back wrong data");
+      return -1;
+    }
+  }
+
+  if (fmap(fd, MAP_BASE) != SCRATCH_SIZE ||
+      memcmp(MAP_BASE, buf, SCRATCH_SIZE) != 0) {
+    lprintf("ramfs_test(): mapping does not match the file");
+    return -1;
+  }
+  if (shm_detach(MAP_BASE) < 0) {
+    lprintf("ramfs_test(): could not remove the mapping");
+    return -1;
+  }
+  close(fd);
+
+  if (unlink(SCRATCH_NAME) < 0 || open(SCRATCH_NAME, FS_READ) >= 0) {
+    lprintf("ramfs_test(): unlink failed");
+    return -1;
+  }
+
+  // Executables' images are read-only
+  if (open(IMAGE_NAME, FS_WRITE) >= 0 || unlink(IMAGE_NAME) >= 0) {
+    lprintf("ramfs_test(): executable's image is writable");
+    return -1;
+  }
+
+  return 0;
+}
+
+/** Checks that a child shares the offset of its parent's open file */
+static int test_fork() {
+
+  int fd = open(SCRATCH_NAME, FS_READ | FS_WRITE | FS_APPEND | FS_CREATE);
+  if (fd < 0) {
+    return -1;
+  }
+
+  int tid = fork();
+  if (tid < 0) {
+    return -1;
+  }
+  if (tid == 0) {
+    write(fd, "child\n", 6);
+    exit(0);
+  }
+
+  int status;
+  wait(&status);
+  write(fd, "parent\n", 7);
+  close(fd);
+
+  char buf[16];
+  fd = open(SCRATCH_NAME, FS_READ);
+  int len = read(fd, buf, sizeof(buf));
+  close(fd);
+  unlink(SCRATCH_NAME);
+
+  if (len != 13 || memcmp(buf, "child\nparent\n", 13) != 0) {
+    lprintf("ramfs_test(): child and parent did not share the file");
+    return -1;
+  }
+
+  return 0;
+}
+
+/** Scans an executable's image with readfile() and through a mapping */
+static int bench_image() {
+
+  int fd = open(IMAGE_NAME, FS_READ);
+  int size = (fd < 0) ? -1 : fmap(fd, MAP_BASE);
+  if (size <= 0) {
+    lprintf("ramfs_test(): could not map %s", IMAGE_NAME);
+    return -1;
+  }
+
+  int len = ((size + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+  if (new_pages(BUF_BASE, len) < 0) {
+    return -1;
+  }
+
+  unsigned int expected = checksum(MAP_BASE, size);
+
+  int i;
+  unsigned int start = get_ticks();
+  for (i = 0; i < NB_SCANS; ++i) {
+    if (readfile(IMAGE_NAME, BUF_BASE, size, 0) != size ||
+        checksum(BUF_BASE, size) != expected) {
+      lprintf("ramfs_test(): readfile returned wrong data");
+      return -1;
+    }
+  }
+  unsigned int copy_ticks = get_ticks() - start;
+
+  start = get_ticks();
+  for (i = 0; i < NB_SCANS; ++i) {
+    if (checksum(MAP_BASE, size) != expected) {
+      return -1;
+    }
+  }
+  unsigned int map_ticks = get_ticks() - start;
+
+  printf("ramfs: %d scans of %d bytes, readfile %u ticks, fmap %u ticks\n",
+         NB_SCANS, size, copy_ticks, map_ticks);
+  lprintf("ramfs_test(): readfile %u ticks, fmap %u ticks", copy_ticks,
+          map_ticks);
+
+  remove_pages(BUF_BASE);
+  shm_detach(MAP_BASE);
+  close(fd);
+  return 0;
+}
+
+/** Sums the bytes of a buffer */
+static unsigned int checksum(char *buf, int len) {
+  unsigned int sum = 0;
+  int i;
+  for (i = 0; i < len; ++i) {
+    sum = sum * 31 + (unsigned char)buf[i];
+  }
+  return sum;
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("ramfs_test() completed successfully !");
+  } else {
+    lprintf("ramfs_test() failed !");
+  }
+  while(1);
+}
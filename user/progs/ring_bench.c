@@ -0,0 +1,180 @@
+/* Asynchronous system call benchmark: compares a loop of blocking sleep()
+ * and print() calls with the same requests submitted at once through a
+ * ring_setup() ring, reporting the ticks and kernel entries each took. Also
+ * checks readfile() and wait() requests: the program reads its own ELF
+ * header and collects children that exit in the reverse order they were
+ * forked in */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RING_BASE ((void *)0x40000000)
+
+/* Number of requests in flight in each round */
+#define NB_OPS 32
+
+/* Length of each sleep request */
+#define SLEEP_TICKS 2
+
+/* Number of children collected by wait requests */
+#define NB_CHILDREN 4
+
+static async_ring_t *ring = RING_BASE;
+
+static void loop(int ret);
+static void submit(int op, int len, char *buf, char *name,
+                   unsigned int user_data);
+static int reap(async_cqe_t *cqe);
+static void report(char *name, unsigned int ticks, unsigned int entries,
+                   unsigned int ring_ticks, unsigned int ring_entries);
+
+int main() {
+
+  if (ring_setup(RING_BASE) < 0) {
+    lprintf("ring_bench(): ring_setup failed");
+    loop(-1);
+  }
+
+  async_cqe_t cqe;
+  unsigned int start, ticks, entries;
+  int i;
+
+  // Sleeps, one after the other then all at once
+  start = get_ticks();
+  for (i = 0; i < NB_OPS; ++i) {
+    sleep(SLEEP_TICKS);
+  }
+  ticks = get_ticks() - start;
+
+  start = get_ticks();
+  for (i = 0; i < NB_OPS; ++i) {
+    submit(ASYNC_OP_SLEEP, SLEEP_TICKS, NULL, NULL, i);
+  }
+  entries = 0;
+  int done = 0;
+  while (done < NB_OPS) {
+    ring_enter(NB_OPS - done);
+    ++entries;
+    while (reap(&cqe) == 0) {
+      if (cqe.result != 0) {
+        lprintf("ring_bench(): sleep request %u failed", cqe.user_data);
+        loop(-1);
+      }
+      ++done;
+    }
+  }
+  report("sleep", ticks, NB_OPS, get_ticks() - start, entries);
+
+  // Prints
+  char *line = "ring_bench: print\n";
+  int len = strlen(line);
+  start = get_ticks();
+  for (i = 0; i < NB_OPS; ++i) {
+    print(len, line);
+  }
+  ticks = get_ticks() - start;
+
+  start = get_ticks();
+  for (i = 0; i < NB_OPS; ++i) {
+    submit(ASYNC_OP_PRINT, len, line, NULL, i);
+  }
+  entries = 0;
+  done = 0;
+  while (done < NB_OPS) {
+    ring_enter(NB_OPS - done);
+    ++entries;
+    while (reap(&cqe) == 0) {
+      ++done;
+    }
+  }
+  report("print", ticks, NB_OPS, get_ticks() - start, entries);
+
+  // Read our own ELF header
+  char header[4];
+  submit(ASYNC_OP_READFILE, sizeof(header), header, "ring_bench", 0);
+  ring_enter(1);
+  if (reap(&cqe) < 0 || cqe.result != sizeof(header) ||
+      header[0] != 0x7f || header[1] != 'E') {
+    lprintf("ring_bench(): readfile request failed");
+    loop(-1);
+  }
+
+  // Collect children with wait requests, submitted before they exit
+  int tids[NB_CHILDREN], statuses[NB_CHILDREN];
+  for (i = 0; i < NB_CHILDREN; ++i) {
+    tids[i] = fork();
+    if (tids[i] == 0) {
+      sleep((NB_CHILDREN - i) * SLEEP_TICKS);
+      set_status(i);
+      vanish();
+    } else if (tids[i] < 0) {
+      lprintf("ring_bench(): fork failed");
+      loop(-1);
+    }
+  }
+  for (i = 0; i < NB_CHILDREN; ++i) {
+    submit(ASYNC_OP_WAIT, 0, (char *)&statuses[i], NULL, i);
+  }
+  done = 0;
+  while (done < NB_CHILDREN) {
+    ring_enter(1);
+    while (reap(&cqe) == 0) {
+      int status = statuses[cqe.user_data];
+      if (cqe.result < 0 || status < 0 || status >= NB_CHILDREN ||
+          tids[status] != cqe.result) {
+        lprintf("ring_bench(): wait request %u failed", cqe.user_data);
+        loop(-1);
+      }
+      ++done;
+    }
+  }
+  printf("ring: collected %d children\n", NB_CHILDREN);
+
+  loop(0);
+}
+
+/** Writes a request in the submission queue */
+static void submit(int op, int len, char *buf, char *name,
+                   unsigned int user_data) {
+  async_sqe_t *sqe = &ring->sq[ring->sq_tail % ASYNC_RING_ENTRIES];
+  sqe->op = op;
+  sqe->len = len;
+  sqe->buf = buf;
+  sqe->name = name;
+  sqe->offset = 0;
+  sqe->user_data = user_data;
+  ring->sq_tail++;
+}
+
+/** Consumes a completion, returns -1 if there is none */
+static int reap(async_cqe_t *cqe) {
+  if (ring->cq_head == ring->cq_tail) {
+    return -1;
+  }
+  *cqe = ring->cq[ring->cq_head % ASYNC_RING_ENTRIES];
+  ring->cq_head++;
+  return 0;
+}
+
+/** Prints the ticks and kernel entries a loop of system calls and the same
+ *  requests through the ring took */
+static void report(char *name, unsigned int ticks, unsigned int entries,
+                   unsigned int ring_ticks, unsigned int ring_entries) {
+  printf("ring: %d %s, %u ticks in %u calls, %u ticks in %u ring_enter\n",
+         NB_OPS, name, ticks, entries, ring_ticks, ring_entries);
+  lprintf("ring_bench(): %d %s, %u ticks in %u calls, %u ticks in %u "
+          "ring_enter", NB_OPS, name, ticks, entries, ring_ticks,
+          ring_entries);
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("ring_bench() completed successfully !");
+  } else {
+    lprintf("ring_bench() failed !");
+  }
+  while(1);
+}
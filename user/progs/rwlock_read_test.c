@@ -0,0 +1,170 @@
+/* Reader/writer lock benchmark: 1 writer and 1 to 16 readers share a record
+ * protected by a rwlock, reports how many read-side critical sections per
+ * second went through for each number of readers. The writer updates the
+ * record once per tick so the workload is read-mostly */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread.h>
+#include <rwlock.h>
+
+#define STACK_SIZE 4096
+#define MAX_READERS 16
+
+/* Timer interrupts per second */
+#define TICKS_PER_SECOND 100
+
+/* Length of a round */
+#define ROUND_TICKS 200
+
+static void loop(int ret);
+static int run_round(int nb_readers);
+static void *reader(void *arg);
+static void *writer(void *arg);
+
+static rwlock_t rwlock;
+
+/* Protected by rwlock, both fields are always equal outside of a write */
+static volatile int record_a;
+static volatile int record_b;
+
+/* Number of reads done by each reader */
+static unsigned int reads[MAX_READERS];
+
+/* Set by the main thread to start and end a round */
+static volatile int go = 0;
+static volatile int stop = 0;
+
+int main() {
+
+  thr_init(STACK_SIZE);
+
+  if (rwlock_init(&rwlock) < 0) {
+    loop(-1);
+  }
+
+  int nb_readers;
+  for (nb_readers = 1; nb_readers <= MAX_READERS; nb_readers *= 2) {
+    if (run_round(nb_readers) < 0) {
+      loop(-1);
+    }
+  }
+
+  rwlock_destroy(&rwlock);
+  loop(0);
+}
+
+/** Runs the benchmark with nb_readers readers and prints the throughput */
+static int run_round(int nb_readers) {
+
+  int tids[MAX_READERS + 1];
+
+  go = 0;
+  stop = 0;
+
+  int i;
+  for (i = 0; i < nb_readers; ++i) {
+    reads[i] = 0;
+    tids[i] = thr_create(reader, (void *)i);
+    if (tids[i] < 0) {
+      lprintf("rwlock_read_test(): thr_create failed");
+      return -1;
+    }
+  }
+  tids[nb_readers] = thr_create(writer, NULL);
+  if (tids[nb_readers] < 0) {
+    lprintf("rwlock_read_test(): thr_create failed");
+    return -1;
+  }
+
+  go = 1;
+  sleep(ROUND_TICKS);
+  stop = 1;
+
+  unsigned int total = 0;
+  for (i = 0; i <= nb_readers; ++i) {
+    void *status;
+    if (thr_join(tids[i], &status) < 0 || status != NULL) {
+      lprintf("rwlock_read_test(): worker failed");
+      return -1;
+    }
+    if (i < nb_readers) {
+      total += reads[i];
+    }
+  }
+
+  unsigned int per_sec = (total / ROUND_TICKS) * TICKS_PER_SECOND;
+  printf("rwlock: 1 writer, %d readers, %u reads/sec\n", nb_readers,
+         per_sec);
+  lprintf("rwlock_read_test(): %d readers, %u reads/sec", nb_readers,
+          per_sec);
+  return 0;
+}
+
+/** Reads the record until the round ends, checking that no write is seen
+ *  half done */
+static void *reader(void *arg) {
+
+  int index = (int)arg;
+  unsigned int count = 0;
+
+  while (!go) {
+    yield(-1);
+  }
+
+  while (!stop) {
+    rwlock_lock(&rwlock, RWLOCK_READ);
+    int a = record_a;
+    int b = record_b;
+    rwlock_unlock(&rwlock);
+
+    if (a != b) {
+      return (void *)-1;
+    }
+    ++count;
+  }
+
+  reads[index] = count;
+  return NULL;
+}
+
+/** Updates the record once per tick until the round ends, downgrading the
+ *  lock every other time */
+static void *writer(void *arg) {
+
+  int round = 0;
+
+  while (!go) {
+    yield(-1);
+  }
+
+  while (!stop) {
+    rwlock_lock(&rwlock, RWLOCK_WRITE);
+    ++record_a;
+    ++record_b;
+
+    if (round++ % 2 == 0) {
+      rwlock_downgrade(&rwlock);
+      if (record_a != record_b) {
+        rwlock_unlock(&rwlock);
+        return (void *)-1;
+      }
+    }
+    rwlock_unlock(&rwlock);
+
+    sleep(1);
+  }
+
+  return NULL;
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("rwlock_read_test() completed successfully !");
+  } else {
+    lprintf("rwlock_read_test() failed !");
+  }
+  while(1);
+}
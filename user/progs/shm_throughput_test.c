@@ -0,0 +1,159 @@
+/* Shared memory throughput benchmark: a producer task streams data to a
+ * consumer task through a ring buffer living in a shared memory segment, and
+ * reports how many bytes per tick went through */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEGMENT_NAME "shm_throughput"
+#define SEGMENT_BASE ((void *)0x40000000)
+
+/* Size of the segment, in pages (the first one holds the ring's indexes) */
+#define SEGMENT_PAGES 17
+
+#define RING_SIZE ((SEGMENT_PAGES - 1) * PAGE_SIZE)
+
+/* Amount of data transferred, in bytes */
+#define TOTAL_BYTES (32 * 1024 * 1024)
+
+/* Size of each chunk written or read at once, in bytes */
+#define CHUNK_SIZE 2048
+
+/** Single producer/single consumer ring buffer */
+typedef struct ring {
+  volatile unsigned int head;   /* Total bytes written by the producer */
+  volatile unsigned int tail;   /* Total bytes read by the consumer */
+  volatile unsigned int checksum;
+  char pad[PAGE_SIZE - 3 * sizeof(unsigned int)];
+  char data[RING_SIZE];
+} ring_t;
+
+static void loop(int ret);
+static void produce(ring_t *ring);
+static unsigned int consume(ring_t *ring);
+
+int main() {
+
+  int tid = fork();
+  if (tid < 0) {
+    lprintf("shm_throughput_test(): fork failed");
+    loop(-1);
+  }
+
+  if (tid == 0) {
+    // Consumer: wait for the producer to create the segment
+    int len;
+    while ((len = shm_attach(SEGMENT_NAME, SEGMENT_BASE)) < 0) {
+      yield(-1);
+    }
+    if (len != SEGMENT_PAGES * PAGE_SIZE) {
+      exit(-1);
+    }
+
+    ring_t *ring = SEGMENT_BASE;
+    unsigned int checksum = consume(ring);
+    int ok = (checksum == ring->checksum);
+
+    shm_detach(SEGMENT_BASE);
+    exit(ok ? 0 : -1);
+  }
+
+  // Producer
+  if (shm_create(SEGMENT_NAME, SEGMENT_BASE, SEGMENT_PAGES * PAGE_SIZE) < 0) {
+    lprintf("shm_throughput_test(): shm_create failed");
+    loop(-1);
+  }
+
+  ring_t *ring = SEGMENT_BASE;
+  unsigned int start = get_ticks();
+  produce(ring);
+
+  int status;
+  if (wait(&status) != tid || status != 0) {
+    lprintf("shm_throughput_test(): consumer failed");
+    loop(-1);
+  }
+  unsigned int ticks = get_ticks() - start;
+  if (ticks == 0) {
+    ticks = 1;
+  }
+
+  shm_detach(SEGMENT_BASE);
+
+  printf("shm: %d KB in %u ticks (%u bytes/tick)\n", TOTAL_BYTES / 1024,
+         ticks, TOTAL_BYTES / ticks);
+  lprintf("shm_throughput_test(): %d KB in %u ticks (%u bytes/tick)",
+          TOTAL_BYTES / 1024, ticks, TOTAL_BYTES / ticks);
+
+  loop(0);
+}
+
+/** Writes TOTAL_BYTES bytes to the ring, chunk by chunk */
+static void produce(ring_t *ring) {
+
+  char chunk[CHUNK_SIZE];
+  unsigned int checksum = 0, written = 0;
+
+  while (written < TOTAL_BYTES) {
+
+    int i;
+    for (i = 0; i < CHUNK_SIZE; ++i) {
+      chunk[i] = (char)(written + i);
+      checksum += (unsigned char)chunk[i];
+    }
+
+    // Wait for enough room in the ring
+    while (ring->head - ring->tail > RING_SIZE - CHUNK_SIZE) {
+      yield(-1);
+    }
+
+    memcpy(ring->data + (ring->head % RING_SIZE), chunk, CHUNK_SIZE);
+    ring->head += CHUNK_SIZE;
+    written += CHUNK_SIZE;
+  }
+
+  ring->checksum = checksum;
+}
+
+/** Reads TOTAL_BYTES bytes from the ring and returns their checksum */
+static unsigned int consume(ring_t *ring) {
+
+  char chunk[CHUNK_SIZE];
+  unsigned int checksum = 0, read = 0;
+
+  while (read < TOTAL_BYTES) {
+
+    // Wait for a full chunk
+    while (ring->head - ring->tail < CHUNK_SIZE) {
+      yield(-1);
+    }
+
+    memcpy(chunk, ring->data + (ring->tail % RING_SIZE), CHUNK_SIZE);
+    ring->tail += CHUNK_SIZE;
+    read += CHUNK_SIZE;
+
+    int i;
+    for (i = 0; i < CHUNK_SIZE; ++i) {
+      checksum += (unsigned char)chunk[i];
+    }
+  }
+
+  // Wait for the producer to publish its checksum
+  while (ring->checksum == 0) {
+    yield(-1);
+  }
+
+  return checksum;
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("shm_throughput_test() completed successfully !");
+  } else {
+    lprintf("shm_throughput_test() failed !");
+  }
+  while(1);
+}
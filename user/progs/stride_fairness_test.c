@@ -0,0 +1,159 @@
+/* Stride scheduler fairness benchmark: competing tasks with different thread
+ * counts and weights, reports the CPU share each task received */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread.h>
+
+/* Length of a measurement, in ticks */
+#define MEASURE_TICKS 500
+
+/* Delay before the measurement starts, lets every task get created */
+#define START_DELAY 20
+
+/* Counts are divided by this before being passed as exit status */
+#define COUNT_SCALE 16
+
+#define NB_THREADS_MANY 8
+#define STACK_SIZE 4096
+
+static void loop(int ret);
+static int run_experiment(int weight_single, int weight_many);
+static int spawn_task(int nb_threads, int weight, unsigned int start);
+static void *count_loop(void *start);
+
+int main() {
+
+  thr_init(STACK_SIZE);
+
+  // Same weight: both tasks should get half of the CPU, no matter how many
+  // threads each one has
+  if (run_experiment(10, 10) < 0) {
+    loop(-1);
+  }
+
+  // 3:1 weights: the single-threaded task should get 75% of the CPU
+  if (run_experiment(30, 10) < 0) {
+    loop(-1);
+  }
+
+  // 1:3 weights: the multi-threaded task should get 75% of the CPU
+  if (run_experiment(10, 30) < 0) {
+    loop(-1);
+  }
+
+  loop(0);
+}
+
+/** Runs a single-threaded task and a NB_THREADS_MANY threads task side by
+ *  side and prints the share of work each one did */
+static int run_experiment(int weight_single, int weight_many) {
+
+  unsigned int start = get_ticks() + START_DELAY;
+
+  int tid_single = spawn_task(1, weight_single, start);
+  int tid_many = spawn_task(NB_THREADS_MANY, weight_many, start);
+  if (tid_single < 0 || tid_many < 0) {
+    lprintf("stride_fairness_test(): fork failed");
+    return -1;
+  }
+
+  int count_single = 0, count_many = 0;
+  int i, status;
+  for (i = 0; i < 2; ++i) {
+    int tid = wait(&status);
+    if (tid == tid_single) {
+      count_single = status;
+    } else if (tid == tid_many) {
+      count_many = status;
+    } else {
+      lprintf("stride_fairness_test(): wait failed");
+      return -1;
+    }
+  }
+
+  int per_mille = (count_single + count_many) / 1000;
+  if (per_mille <= 0) {
+    return -1;
+  }
+
+  int share_single = count_single / per_mille;
+  if (share_single > 1000) {
+    share_single = 1000;
+  }
+  int expected = (1000 * weight_single) / (weight_single + weight_many);
+
+  printf("weights %d:%d (1 vs %d threads): %d.%d%% vs %d.%d%% "
+         "(expected %d.%d%%)\n", weight_single, weight_many, NB_THREADS_MANY,
+         share_single / 10, share_single % 10,
+         (1000 - share_single) / 10, (1000 - share_single) % 10,
+         expected / 10, expected % 10);
+  lprintf("stride_fairness_test(): weights %d:%d, share %d/1000 "
+          "(expected %d/1000)", weight_single, weight_many, share_single,
+          expected);
+
+  return 0;
+}
+
+/** Forks a task that sets its weight and counts with nb_threads threads
+ *  during the measurement window. The task's exit status is its scaled
+ *  count. */
+static int spawn_task(int nb_threads, int weight, unsigned int start) {
+
+  int tid = fork();
+  if (tid != 0) {
+    return tid;
+  }
+
+  if (set_weight(-1, weight) < 0) {
+    lprintf("stride_fairness_test(): set_weight failed");
+    exit(-1);
+  }
+
+  int tids[NB_THREADS_MANY];
+  int i;
+  for (i = 1; i < nb_threads; ++i) {
+    tids[i] = thr_create(count_loop, (void *)start);
+  }
+
+  int total = (int)count_loop((void *)start);
+
+  for (i = 1; i < nb_threads; ++i) {
+    void *count;
+    if (tids[i] >= 0 && thr_join(tids[i], &count) == 0) {
+      total += (int)count;
+    }
+  }
+
+  exit(total);
+  return -1;
+}
+
+/** Spins until the measurement starts then counts until it ends */
+static void *count_loop(void *start) {
+
+  unsigned int begin = (unsigned int)start;
+  unsigned int end = begin + MEASURE_TICKS;
+  unsigned int count = 0;
+
+  while (get_ticks() < begin) {
+    continue;
+  }
+
+  while (get_ticks() < end) {
+    ++count;
+  }
+
+  return (void *)(count / COUNT_SCALE);
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("stride_fairness_test() completed successfully !");
+  } else {
+    lprintf("stride_fairness_test() failed !");
+  }
+  while(1);
+}
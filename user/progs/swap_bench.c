@@ -0,0 +1,131 @@
+/* Swap benchmark: allocates twice as many pages as there are frames of
+ * physical memory (boot with "swap=ata1" and a disk image on hdb), writes
+ * every page sequentially, then touches pages sequentially and at random,
+ * checking their content. Reports, for each round, the number of pages
+ * touched per second and the number of pages read back from the swap area
+ * per 1000 touches */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REGION_BASE ((void *)0x40000000)
+
+/* Timer interrupts per second */
+#define TICKS_PER_SECOND 100
+
+/* Physical memory oversubscription factor */
+#define OVERSUBSCRIPTION 2
+
+/* Number of random touches, per page of the region */
+#define RANDOM_ROUNDS 2
+
+/* Linear congruential generator parameters */
+#define LCG_MULTIPLIER 1103515245u
+#define LCG_INCREMENT 12345u
+
+static void loop(int ret);
+static int touch(char *page, unsigned int index, int check);
+static void report(char *name, unsigned int touches, unsigned int ticks,
+                   swap_stats_t *before);
+
+int main() {
+
+  swap_stats_t stats;
+  if (get_swap_stats(&stats) < 0) {
+    lprintf("swap_bench(): get_swap_stats failed");
+    loop(-1);
+  }
+  if (stats.total_slots == 0) {
+    lprintf("swap_bench(): no swap, boot with swap=ata1");
+    loop(-1);
+  }
+
+  unsigned int nb_pages = stats.total_frames * OVERSUBSCRIPTION;
+  if (nb_pages > stats.total_slots) {
+    nb_pages = stats.total_slots;
+  }
+  if (new_pages(REGION_BASE, nb_pages * PAGE_SIZE) < 0) {
+    lprintf("swap_bench(): could not allocate %u pages", nb_pages);
+    loop(-1);
+  }
+  printf("swap: %u frames, %u slots, touching %u pages\n",
+         stats.total_frames, stats.total_slots, nb_pages);
+
+  char *region = REGION_BASE;
+  unsigned int i;
+
+  // Sequential writes, every page gets its own frame
+  unsigned int start = get_ticks();
+  for (i = 0; i < nb_pages; ++i) {
+    touch(region + i * PAGE_SIZE, i, 0);
+  }
+  report("first write", nb_pages, get_ticks() - start, &stats);
+
+  // Sequential reads, the least recently used pages are in the swap area
+  start = get_ticks();
+  for (i = 0; i < nb_pages; ++i) {
+    if (touch(region + i * PAGE_SIZE, i, 1) < 0) {
+      loop(-1);
+    }
+  }
+  report("sequential", nb_pages, get_ticks() - start, &stats);
+
+  // Random reads and writes
+  unsigned int seed = 1;
+  unsigned int nb_touches = nb_pages * RANDOM_ROUNDS;
+  start = get_ticks();
+  for (i = 0; i < nb_touches; ++i) {
+    seed = seed * LCG_MULTIPLIER + LCG_INCREMENT;
+    unsigned int page = (seed >> 8) % nb_pages;
+    if (touch(region + page * PAGE_SIZE, page, 1) < 0) {
+      loop(-1);
+    }
+  }
+  report("random", nb_touches, get_ticks() - start, &stats);
+
+  remove_pages(REGION_BASE);
+  loop(0);
+}
+
+/** Writes a page's index at the start and at the end of the page, checking
+ *  first that the page holds its index if check is set */
+static int touch(char *page, unsigned int index, int check) {
+  unsigned int *first = (unsigned int *)page;
+  unsigned int *last = (unsigned int *)(page + PAGE_SIZE) - 1;
+  if (check && (*first != index || *last != ~index)) {
+    lprintf("swap_bench(): page %u holds wrong data", index);
+    return -1;
+  }
+  *first = index;
+  *last = ~index;
+  return 0;
+}
+
+/** Prints the throughput and fault rate of a round, and updates the stats
+ *  to the ones at the end of the round */
+static void report(char *name, unsigned int touches, unsigned int ticks,
+                   swap_stats_t *before) {
+  swap_stats_t after;
+  get_swap_stats(&after);
+  unsigned int ins = after.swap_ins - before->swap_ins;
+  unsigned int outs = after.swap_outs - before->swap_outs;
+  unsigned int rate = (ticks == 0) ? 0 : (touches * TICKS_PER_SECOND) / ticks;
+  unsigned int faults = (touches == 0) ? 0 : (ins * 1000) / touches;
+  printf("swap: %s, %u pages/s, %u in, %u out, %u faults per 1000\n", name,
+         rate, ins, outs, faults);
+  lprintf("swap_bench(): %s, %u pages/s, %u in, %u out, %u faults per 1000",
+          name, rate, ins, outs, faults);
+  *before = after;
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("swap_bench() completed successfully !");
+  } else {
+    lprintf("swap_bench() failed !");
+  }
+  while(1);
+}
@@ -0,0 +1,114 @@
+/* wait_any() test: a single thread supervises children exiting at different
+ * times and the console with one wait_any() loop, using a timeout to print
+ * a heartbeat. Checks that timeouts are honored, that every child is
+ * collected without wait() blocking, and reports how many times the thread
+ * woke up. Typed lines are echoed back while the test runs */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of children to supervise */
+#define NB_CHILDREN 4
+
+/* Ticks between two children exiting */
+#define CHILD_TICKS 20
+
+/* Ticks between two heartbeats */
+#define HEARTBEAT_TICKS 15
+
+#define LINE_LEN 80
+
+static void loop(int ret);
+
+int main() {
+
+  int events[] = {EVENT_CHILD, EVENT_LINE};
+  int nb_events = sizeof(events) / sizeof(events[0]);
+  char line[LINE_LEN];
+
+  // A timeout alone behaves like sleep()
+  unsigned int start = get_ticks();
+  if (wait_any(NULL, 0, HEARTBEAT_TICKS) != 0 ||
+      get_ticks() - start < HEARTBEAT_TICKS) {
+    lprintf("wait_any_test(): timeout returned early");
+    loop(-1);
+  }
+
+  // Invalid arguments
+  int bad_event = 42;
+  if (wait_any(&bad_event, 1, 0) >= 0 || wait_any(NULL, 0, -1) >= 0 ||
+      wait_any((int *)0x10, 1, 0) >= 0) {
+    lprintf("wait_any_test(): invalid arguments accepted");
+    loop(-1);
+  }
+
+  int i;
+  for (i = 0; i < NB_CHILDREN; ++i) {
+    int tid = fork();
+    if (tid == 0) {
+      sleep((i + 1) * CHILD_TICKS);
+      set_status(i);
+      vanish();
+    } else if (tid < 0) {
+      lprintf("wait_any_test(): fork failed");
+      loop(-1);
+    }
+  }
+
+  int collected = 0, wakeups = 0, heartbeats = 0;
+  start = get_ticks();
+  while (collected < NB_CHILDREN) {
+    int fired = wait_any(events, nb_events, HEARTBEAT_TICKS);
+    ++wakeups;
+    if (fired < 0) {
+      lprintf("wait_any_test(): wait_any failed");
+      loop(-1);
+    } else if (fired == nb_events) {
+      ++heartbeats;
+      printf("wait_any: heartbeat at %u ticks\n", get_ticks() - start);
+    } else if (events[fired] == EVENT_CHILD) {
+      int status;
+      int tid = wait(&status);
+      if (tid < 0 || status != collected) {
+        lprintf("wait_any_test(): child %d collected out of order",
+                status);
+        loop(-1);
+      }
+      ++collected;
+    } else {
+      int len = readline(LINE_LEN - 1, line);
+      line[len] = '\0';
+      printf("wait_any: read %s", line);
+    }
+  }
+
+  if (heartbeats == 0) {
+    lprintf("wait_any_test(): no timeout while children were running");
+    loop(-1);
+  }
+
+  printf("wait_any: %d children, %d heartbeats, %d wakeups in %u ticks\n",
+         NB_CHILDREN, heartbeats, wakeups, get_ticks() - start);
+  lprintf("wait_any_test(): %d children, %d heartbeats, %d wakeups",
+          NB_CHILDREN, heartbeats, wakeups);
+
+  // No child left, wait() would fail so the event is reported at once
+  if (wait_any(events, 1, -1) != 0) {
+    lprintf("wait_any_test(): child event not reported without children");
+    loop(-1);
+  }
+
+  loop(0);
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("wait_any_test() completed successfully !");
+  } else {
+    lprintf("wait_any_test() failed !");
+  }
+  while(1);
+}
@@ -0,0 +1,98 @@
+/* Sparse new_pages() region test: reads of untouched pages must see zeroes
+ * without needing any frame, forked children must see the same zeroes, and
+ * writes must only change the pages they touch */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdlib.h>
+
+#define REGION_BASE ((char *)0x40000000)
+
+/* Size of the region, in pages */
+#define REGION_PAGES 1024
+
+/* Only one page out of WRITE_STRIDE is written to */
+#define WRITE_STRIDE 64
+
+static void loop(int ret);
+static int check_region(int written);
+
+int main() {
+
+  if (new_pages(REGION_BASE, REGION_PAGES * PAGE_SIZE) < 0) {
+    lprintf("zfod_sparse_test(): new_pages failed");
+    loop(-1);
+  }
+
+  // Reading the whole region should not allocate anything
+  unsigned int start = get_ticks();
+  if (check_region(0) < 0) {
+    lprintf("zfod_sparse_test(): untouched region is not zeroed");
+    loop(-1);
+  }
+  lprintf("zfod_sparse_test(): read %d untouched pages in %u ticks",
+          REGION_PAGES, get_ticks() - start);
+
+  // The child shares the untouched pages and writes to a few of them
+  int tid = fork();
+  if (tid < 0) {
+    lprintf("zfod_sparse_test(): fork failed");
+    loop(-1);
+  }
+
+  int i;
+  for (i = 0; i < REGION_PAGES; i += WRITE_STRIDE) {
+    REGION_BASE[i * PAGE_SIZE] = (tid == 0) ? 2 : 1;
+  }
+
+  if (tid == 0) {
+    exit(check_region(2));
+  }
+
+  int status;
+  if (wait(&status) != tid || status != 0) {
+    lprintf("zfod_sparse_test(): child saw wrong contents");
+    loop(-1);
+  }
+
+  if (check_region(1) < 0) {
+    lprintf("zfod_sparse_test(): parent saw wrong contents");
+    loop(-1);
+  }
+
+  // Give back both written and untouched pages
+  if (remove_pages(REGION_BASE) < 0) {
+    lprintf("zfod_sparse_test(): remove_pages failed");
+    loop(-1);
+  }
+
+  loop(0);
+}
+
+/** Checks that written pages start with the given value and that everything
+ *  else in the region is zero */
+static int check_region(int written) {
+  int i, j;
+  for (i = 0; i < REGION_PAGES; ++i) {
+    char *page = REGION_BASE + i * PAGE_SIZE;
+    int first = (written != 0 && i % WRITE_STRIDE == 0) ? written : 0;
+    if (page[0] != first) {
+      return -1;
+    }
+    for (j = 1; j < PAGE_SIZE; j += 512) {
+      if (page[j] != 0) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+static void loop(int ret) {
+  if (ret == 0) {
+    lprintf("zfod_sparse_test() completed successfully !");
+  } else {
+    lprintf("zfod_sparse_test() failed !");
+  }
+  while(1);
+}